@@ -109,6 +109,10 @@ function(compile_cl_to_bc FILENAME SUBDIR BC_FILE_LIST EXTRA_CONFIG)
         "-include" "${EXTRA_CONFIG}")
     endif()
 
+    if(FILENAME MATCHES "host/async")
+      list(APPEND DEPENDLIST "${CMAKE_SOURCE_DIR}/lib/kernel/host/async_copy.h")
+    endif()
+
     if(FILENAME MATCHES "libclc")
       list(APPEND DEPENDLIST ${LIBCLC_KERNEL_DEPEND_HEADERS})
 
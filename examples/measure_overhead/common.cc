@@ -49,6 +49,11 @@ void print_measurements(const std::string &title,
             << ind << "\taverage: " << sum_time << " µs" << std::endl
             << ind << "\tmin: " << min_time << " µs" << std::endl
             << ind << "\tmax: " << max_time << " µs" << std::endl
+            << ind << "\tmedian: " << sorted_times[sorted_times.size() / 2]
+            << " µs" << std::endl
+            << ind << "\t90th percentile: "
+            << sorted_times[sorted_times.size() * 90 / 100] << " µs"
+            << std::endl
             << ind << "\t99th percentile: "
             << sorted_times[sorted_times.size() * 99 / 100] << " µs"
             << std::endl;
@@ -0,0 +1,250 @@
+/* Benchmark for the OpenCL 2.0 atomics in histogram and reduction kernels
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+// Runs atomic-bound histogram and sum reduction kernels, once with all the
+// updates going to global memory with device scope and once with the
+// updates going to work-group scoped __local copies that are merged to
+// global memory at the end of the work-group, checks their results and
+// reports the kernel run times.
+
+#define CL_HPP_ENABLE_EXCEPTIONS
+#define CL_HPP_MINIMUM_OPENCL_VERSION 120
+#define CL_HPP_TARGET_OPENCL_VERSION 120
+#include <CL/opencl.hpp>
+
+#include "common.hh"
+#include <cstring>
+#include <iostream>
+#include <string>
+
+struct {
+  int platform_index = 0;
+  int device_index = 0;
+  int sample_count = 20;
+  int size = 1 << 22;
+} options;
+
+static const int Bins = 256;
+static const int WorkGroupSize = 256;
+
+static const char *kernel_source = R"CLC(
+#define BINS 256
+
+kernel void histogram_global(global const uint *in, global atomic_uint *bins) {
+  uint v = in[get_global_id(0)];
+  atomic_fetch_add_explicit(&bins[v % BINS], 1, memory_order_relaxed,
+                            memory_scope_device);
+}
+
+kernel void histogram_local(global const uint *in, global atomic_uint *bins) {
+  local atomic_uint local_bins[BINS];
+  for (uint i = get_local_id(0); i < BINS; i += get_local_size(0))
+    atomic_init(&local_bins[i], 0);
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  uint v = in[get_global_id(0)];
+  atomic_fetch_add_explicit(&local_bins[v % BINS], 1, memory_order_relaxed,
+                            memory_scope_work_group);
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  for (uint i = get_local_id(0); i < BINS; i += get_local_size(0))
+    atomic_fetch_add_explicit(
+        &bins[i],
+        atomic_load_explicit(&local_bins[i], memory_order_relaxed,
+                             memory_scope_work_group),
+        memory_order_relaxed, memory_scope_device);
+}
+
+kernel void sum_global(global const uint *in, global atomic_uint *sum) {
+  atomic_fetch_add(sum, in[get_global_id(0)] & 0xff);
+}
+
+kernel void sum_local(global const uint *in, global atomic_uint *sum) {
+  local atomic_uint local_sum;
+  if (get_local_id(0) == 0)
+    atomic_init(&local_sum, 0);
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  atomic_fetch_add_explicit(&local_sum, in[get_global_id(0)] & 0xff,
+                            memory_order_seq_cst, memory_scope_work_group);
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  if (get_local_id(0) == 0)
+    atomic_fetch_add(sum, atomic_load_explicit(&local_sum,
+                                               memory_order_relaxed,
+                                               memory_scope_work_group));
+}
+)CLC";
+
+void print_help(const char *name) {
+  std::cerr << "Usage: " << name << " [-p platform_index] [-d device_index] "
+            << "[-s sample_count] [-n size]" << std::endl
+            << "-p specifies which platform to use. (default: "
+            << options.platform_index << ")" << std::endl
+            << "-d specifies which device to use. (default: "
+            << options.device_index << ")" << std::endl
+            << "-s sets the number of samples measured. (default: "
+            << options.sample_count << ")" << std::endl
+            << "-n sets the number of input elements, rounded up to a "
+            << "multiple of " << WorkGroupSize << ". (default: "
+            << options.size << ")" << std::endl;
+}
+
+bool parse_args(char **argv) {
+  const char *name = *argv++;
+  while (*argv) {
+    const char *arg = *argv;
+    int *value = nullptr;
+    if (!strcmp(arg, "-p"))
+      value = &options.platform_index;
+    else if (!strcmp(arg, "-d"))
+      value = &options.device_index;
+    else if (!strcmp(arg, "-s"))
+      value = &options.sample_count;
+    else if (!strcmp(arg, "-n"))
+      value = &options.size;
+    else {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      print_help(name);
+      return false;
+    }
+    argv++;
+    if (!*argv) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      print_help(name);
+      return false;
+    }
+    *value = std::stoi(*argv);
+    argv++;
+  }
+  return options.sample_count > 0 && options.size > 0;
+}
+
+// Runs the kernel sample_count times, checking the result of each run
+// against the expected one.
+bool measure_kernel(cl::CommandQueue &cq, cl::Kernel &k, cl::Buffer &result,
+                    const std::vector<cl_uint> &expected, size_t n,
+                    const std::string &title) {
+  std::vector<double> times(options.sample_count);
+  std::vector<cl_uint> host_result(expected.size());
+  cl_uint zero = 0;
+
+  for (int i = 0; i < options.sample_count; ++i) {
+    cq.enqueueFillBuffer(result, zero, 0, expected.size() * sizeof(cl_uint));
+    cl::Event e;
+    cq.enqueueNDRangeKernel(k, cl::NullRange, cl::NDRange(n),
+                            cl::NDRange(WorkGroupSize), nullptr, &e);
+    cq.enqueueReadBuffer(result, CL_TRUE, 0,
+                         expected.size() * sizeof(cl_uint),
+                         host_result.data());
+    times[i] = double(e.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+                      e.getProfilingInfo<CL_PROFILING_COMMAND_START>()) /
+               1e6;
+    if (host_result != expected) {
+      std::cerr << title << " returned a wrong result" << std::endl;
+      return false;
+    }
+  }
+
+  double sum = 0;
+  for (double t : times)
+    sum += t;
+  std::cout << "\t" << title << std::endl;
+  print_measurements("kernel run time (ms):", times, 2);
+  std::cout << "\t\tMupdates/s: " << n / (sum / options.sample_count) / 1e3
+            << std::endl;
+  return true;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  if (!parse_args(argv))
+    return 1;
+
+  try {
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    if ((size_t)options.platform_index >= platforms.size()) {
+      std::cerr << "Platform index out of range" << std::endl;
+      return 1;
+    }
+    std::vector<cl::Device> devices;
+    platforms[options.platform_index].getDevices(CL_DEVICE_TYPE_ALL,
+                                                 &devices);
+    if ((size_t)options.device_index >= devices.size()) {
+      std::cerr << "Device index out of range" << std::endl;
+      return 1;
+    }
+    cl::Device &device = devices[options.device_index];
+    std::cout << "Device: " << device.getInfo<CL_DEVICE_NAME>() << std::endl;
+
+    cl::Context ctx(device);
+    cl::CommandQueue cq(ctx, device, cl::QueueProperties::Profiling);
+
+    cl::Program prog(ctx, kernel_source);
+    try {
+      prog.build("-cl-std=CL3.0");
+    } catch (cl::Error &err) {
+      std::string log = prog.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device);
+      std::cerr << "Failed to build kernel: " << log << std::endl;
+      return 1;
+    }
+
+    size_t n = (options.size + WorkGroupSize - 1) / WorkGroupSize *
+               WorkGroupSize;
+    std::vector<cl_uint> data(n);
+    std::vector<cl_uint> expected_bins(Bins, 0);
+    std::vector<cl_uint> expected_sum(1, 0);
+    for (size_t i = 0; i < n; ++i) {
+      data[i] = (cl_uint)(i * 2654435761u) >> 7;
+      expected_bins[data[i] % Bins]++;
+      expected_sum[0] += data[i] & 0xff;
+    }
+    cl::Buffer in(ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                  n * sizeof(cl_uint), data.data());
+    cl::Buffer bins(ctx, CL_MEM_READ_WRITE, Bins * sizeof(cl_uint));
+    cl::Buffer sum(ctx, CL_MEM_READ_WRITE, sizeof(cl_uint));
+
+    const char *histograms[] = {"histogram_global", "histogram_local"};
+    for (const char *name : histograms) {
+      cl::Kernel k(prog, name);
+      k.setArg(0, in);
+      k.setArg(1, bins);
+      if (!measure_kernel(cq, k, bins, expected_bins, n, name))
+        return 1;
+    }
+
+    const char *sums[] = {"sum_global", "sum_local"};
+    for (const char *name : sums) {
+      cl::Kernel k(prog, name);
+      k.setArg(0, in);
+      k.setArg(1, sum);
+      if (!measure_kernel(cq, k, sum, expected_sum, n, name))
+        return 1;
+    }
+  } catch (cl::Error &err) {
+    std::cerr << err.what() << " (" << err.err() << ")" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,217 @@
+/* Benchmark for measuring the speed of filtered image sampling
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+// Runs kernels that blur a 2D RGBA8 image and a 3D RGBA float image with
+// bilinear / trilinear filtering, sampling each work-item's vertical (and
+// in 3D, depth) neighbours, and reports the kernel run times. Compare runs
+// with POCL_CPU_TILED_IMAGES=0 and 1 to see the effect of the tiled image
+// layout of the CPU devices.
+
+#define CL_HPP_ENABLE_EXCEPTIONS
+#define CL_HPP_MINIMUM_OPENCL_VERSION 120
+#define CL_HPP_TARGET_OPENCL_VERSION 120
+#include <CL/opencl.hpp>
+
+#include "common.hh"
+#include <cstring>
+#include <iostream>
+#include <string>
+
+struct {
+  int platform_index = 0;
+  int device_index = 0;
+  int sample_count = 20;
+  int size_2d = 2048;
+  int size_3d = 128;
+} options;
+
+static const char *kernel_source = R"CLC(
+constant sampler_t smp =
+    CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+
+kernel void blur_2d(read_only image2d_t src, global float4 *out) {
+  int x = get_global_id(0), y = get_global_id(1);
+  float4 sum = (float4)(0.0f);
+  for (int i = -3; i <= 3; ++i)
+    sum += read_imagef(src, smp, (float2)(x + 0.5f, y + i + 0.25f));
+  out[y * get_global_size(0) + x] = sum;
+}
+
+kernel void blur_3d(read_only image3d_t src, global float4 *out) {
+  int x = get_global_id(0), y = get_global_id(1), z = get_global_id(2);
+  float4 sum = (float4)(0.0f);
+  for (int i = -1; i <= 1; ++i)
+    for (int j = -1; j <= 1; ++j)
+      sum += read_imagef(src, smp,
+                         (float4)(x + 0.5f, y + i + 0.25f, z + j + 0.25f, 0));
+  out[(z * get_global_size(1) + y) * get_global_size(0) + x] = sum;
+}
+)CLC";
+
+void print_help(const char *name) {
+  std::cerr << "Usage: " << name << " [-p platform_index] [-d device_index] "
+            << "[-s sample_count] [-w size_2d] [-n size_3d]" << std::endl
+            << "-p specifies which platform to use. (default: "
+            << options.platform_index << ")" << std::endl
+            << "-d specifies which device to use. (default: "
+            << options.device_index << ")" << std::endl
+            << "-s sets the number of samples measured. (default: "
+            << options.sample_count << ")" << std::endl
+            << "-w sets the width and height of the 2D image. (default: "
+            << options.size_2d << ")" << std::endl
+            << "-n sets the width, height and depth of the 3D image. "
+            << "(default: " << options.size_3d << ")" << std::endl;
+}
+
+bool parse_args(char **argv) {
+  const char *name = *argv++;
+  while (*argv) {
+    const char *arg = *argv;
+    int *value = nullptr;
+    if (!strcmp(arg, "-p"))
+      value = &options.platform_index;
+    else if (!strcmp(arg, "-d"))
+      value = &options.device_index;
+    else if (!strcmp(arg, "-s"))
+      value = &options.sample_count;
+    else if (!strcmp(arg, "-w"))
+      value = &options.size_2d;
+    else if (!strcmp(arg, "-n"))
+      value = &options.size_3d;
+    else {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      print_help(name);
+      return false;
+    }
+    argv++;
+    if (!*argv) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      print_help(name);
+      return false;
+    }
+    *value = std::stoi(*argv);
+    argv++;
+  }
+  return options.sample_count > 0 && options.size_2d > 0 &&
+         options.size_3d > 0;
+}
+
+void measure_kernel(cl::CommandQueue &cq, cl::Kernel &k,
+                    const cl::NDRange &global, size_t pixels,
+                    const std::string &title) {
+  std::vector<double> times(options.sample_count);
+
+  // the first run includes the kernel compilation and image migration
+  cq.enqueueNDRangeKernel(k, cl::NullRange, global);
+  cq.finish();
+
+  for (int i = 0; i < options.sample_count; ++i) {
+    cl::Event e;
+    cq.enqueueNDRangeKernel(k, cl::NullRange, global, cl::NullRange, nullptr,
+                            &e);
+    e.wait();
+    times[i] = double(e.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+                      e.getProfilingInfo<CL_PROFILING_COMMAND_START>()) /
+               1e6;
+  }
+
+  double sum = 0;
+  for (double t : times)
+    sum += t;
+  std::cout << "\t" << title << std::endl;
+  print_measurements("kernel run time (ms):", times, 2);
+  std::cout << "\t\tMpixels/s: "
+            << pixels / (sum / options.sample_count) / 1e3 << std::endl;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  if (!parse_args(argv))
+    return 1;
+
+  try {
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    if ((size_t)options.platform_index >= platforms.size()) {
+      std::cerr << "Platform index out of range" << std::endl;
+      return 1;
+    }
+    std::vector<cl::Device> devices;
+    platforms[options.platform_index].getDevices(CL_DEVICE_TYPE_ALL,
+                                                 &devices);
+    if ((size_t)options.device_index >= devices.size()) {
+      std::cerr << "Device index out of range" << std::endl;
+      return 1;
+    }
+    cl::Device &device = devices[options.device_index];
+    std::cout << "Device: " << device.getInfo<CL_DEVICE_NAME>() << std::endl;
+    if (!device.getInfo<CL_DEVICE_IMAGE_SUPPORT>()) {
+      std::cerr << "The device does not support images" << std::endl;
+      return 1;
+    }
+
+    cl::Context ctx(device);
+    cl::CommandQueue cq(ctx, device, cl::QueueProperties::Profiling);
+
+    cl::Program prog(ctx, kernel_source);
+    try {
+      prog.build();
+    } catch (cl::Error &err) {
+      std::string log = prog.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device);
+      std::cerr << "Failed to build kernel: " << log << std::endl;
+      return 1;
+    }
+
+    size_t w = options.size_2d;
+    std::vector<cl_uchar> data_2d(w * w * 4);
+    for (size_t i = 0; i < data_2d.size(); ++i)
+      data_2d[i] = (cl_uchar)(i * 31 + (i >> 12));
+    cl::Image2D image_2d(ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                         cl::ImageFormat(CL_RGBA, CL_UNORM_INT8), w, w, 0,
+                         data_2d.data());
+    cl::Buffer out_2d(ctx, CL_MEM_WRITE_ONLY, w * w * sizeof(cl_float4));
+    cl::Kernel blur_2d(prog, "blur_2d");
+    blur_2d.setArg(0, image_2d);
+    blur_2d.setArg(1, out_2d);
+    measure_kernel(cq, blur_2d, cl::NDRange(w, w), w * w,
+                   "2D RGBA8 bilinear, " + std::to_string(w) + "^2:");
+
+    size_t n = options.size_3d;
+    std::vector<cl_float> data_3d(n * n * n * 4);
+    for (size_t i = 0; i < data_3d.size(); ++i)
+      data_3d[i] = (float)(i % 1021) / 1021.0f;
+    cl::Image3D image_3d(ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                         cl::ImageFormat(CL_RGBA, CL_FLOAT), n, n, n, 0, 0,
+                         data_3d.data());
+    cl::Buffer out_3d(ctx, CL_MEM_WRITE_ONLY, n * n * n * sizeof(cl_float4));
+    cl::Kernel blur_3d(prog, "blur_3d");
+    blur_3d.setArg(0, image_3d);
+    blur_3d.setArg(1, out_3d);
+    measure_kernel(cq, blur_3d, cl::NDRange(n, n, n), n * n * n,
+                   "3D RGBA float trilinear, " + std::to_string(n) + "^3:");
+  } catch (cl::Error &err) {
+    std::cerr << err.what() << " (" << err.err() << ")" << std::endl;
+    return 1;
+  }
+  return 0;
+}
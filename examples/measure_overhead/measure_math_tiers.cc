@@ -0,0 +1,277 @@
+/* Benchmark comparing the accuracy and throughput of the math builtin tiers
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+// For each float math builtin, measures the maximum error against a double
+// precision host reference and the throughput of its full precision
+// version, of the same built with -cl-fast-relaxed-math, and of its native_
+// and half_ versions. The errors are reported in ulps and as absolute
+// errors, which the OpenCL C specification uses for the logarithms near 1
+// and for sin and cos.
+
+#define CL_HPP_ENABLE_EXCEPTIONS
+#define CL_HPP_MINIMUM_OPENCL_VERSION 120
+#define CL_HPP_TARGET_OPENCL_VERSION 120
+#include <CL/opencl.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct {
+  int platform_index = 0;
+  int device_index = 0;
+  int sample_count = 10;
+  int size = 1 << 20;
+} options;
+
+// calls per work-item in the throughput kernels
+static const int Repeats = 32;
+
+struct math_function {
+  const char *name;
+  int arity;
+  // input range of x; sampled logarithmically if log_scale
+  double lo, hi;
+  bool log_scale;
+  double (*reference)(double x, double y);
+};
+
+static const math_function functions[] = {
+    {"exp", 1, -80, 80, false, [](double x, double) { return std::exp(x); }},
+    {"exp2", 1, -120, 120, false,
+     [](double x, double) { return std::exp2(x); }},
+    {"exp10", 1, -35, 35, false,
+     [](double x, double) { return std::pow(10.0, x); }},
+    {"log", 1, 1e-30, 1e30, true, [](double x, double) { return std::log(x); }},
+    {"log2", 1, 1e-30, 1e30, true,
+     [](double x, double) { return std::log2(x); }},
+    {"log10", 1, 1e-30, 1e30, true,
+     [](double x, double) { return std::log10(x); }},
+    {"sin", 1, -M_PI, M_PI, false,
+     [](double x, double) { return std::sin(x); }},
+    {"cos", 1, -M_PI, M_PI, false,
+     [](double x, double) { return std::cos(x); }},
+    {"tan", 1, -1.5, 1.5, false, [](double x, double) { return std::tan(x); }},
+    {"powr", 2, 1e-3, 1e3, true,
+     [](double x, double y) { return std::pow(x, y); }},
+    {"rsqrt", 1, 1e-30, 1e30, true,
+     [](double x, double) { return 1.0 / std::sqrt(x); }},
+    {"recip", 1, 1e-30, 1e30, true, [](double x, double) { return 1.0 / x; }},
+};
+
+struct tier {
+  const char *name;
+  const char *prefix;
+  const char *build_options;
+};
+
+static const tier tiers[] = {{"precise", "", ""},
+                             {"fast-relaxed", "", "-cl-fast-relaxed-math"},
+                             {"native", "native_", ""},
+                             {"half", "half_", ""}};
+
+// Returns a program source with an accuracy and a throughput kernel for each
+// function, calling its version with the given prefix.
+static std::string kernel_source(const std::string &prefix) {
+  std::string src = "#define recip(x) (1.0f / (x))\n";
+  for (const math_function &f : functions) {
+    std::string name = prefix + f.name;
+    std::string args = f.arity == 1 ? "(x)" : "(x, y)";
+    src += "kernel void acc_" + std::string(f.name) +
+           "(global const float *a, global const float *b, global float *out)"
+           " {\n  size_t i = get_global_id(0);\n"
+           "  float x = a[i], y = b[i];\n  out[i] = " +
+           name + args + ";\n}\n";
+    src += "kernel void tput_" + std::string(f.name) +
+           "(global const float *a, global const float *b, global float *out)"
+           " {\n  size_t i = get_global_id(0);\n"
+           "  float x0 = a[i], y = b[i], sum = 0.0f;\n"
+           "  for (int r = 0; r < " +
+           std::to_string(Repeats) +
+           "; ++r) {\n"
+           "    float x = x0 * (1.0f + r * 1e-6f);\n    sum += " +
+           name + args + ";\n  }\n  out[i] = sum;\n}\n";
+  }
+  return src;
+}
+
+static double ulp_error(float value, double ref) {
+  if (value == ref)
+    return 0;
+  int exp;
+  std::frexp(ref, &exp);
+  // ulps of denormals are those of the smallest normal exponent
+  exp = std::max(exp, -125);
+  return std::fabs(value - ref) / std::ldexp(1.0, exp - 24);
+}
+
+void print_help(const char *name) {
+  std::cerr << "Usage: " << name << " [-p platform_index] [-d device_index] "
+            << "[-s sample_count] [-n size]" << std::endl
+            << "-p specifies which platform to use. (default: "
+            << options.platform_index << ")" << std::endl
+            << "-d specifies which device to use. (default: "
+            << options.device_index << ")" << std::endl
+            << "-s sets the number of samples measured. (default: "
+            << options.sample_count << ")" << std::endl
+            << "-n sets the number of inputs per function. (default: "
+            << options.size << ")" << std::endl;
+}
+
+bool parse_args(char **argv) {
+  const char *name = *argv++;
+  while (*argv) {
+    const char *arg = *argv;
+    int *value = nullptr;
+    if (!strcmp(arg, "-p"))
+      value = &options.platform_index;
+    else if (!strcmp(arg, "-d"))
+      value = &options.device_index;
+    else if (!strcmp(arg, "-s"))
+      value = &options.sample_count;
+    else if (!strcmp(arg, "-n"))
+      value = &options.size;
+    else {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      print_help(name);
+      return false;
+    }
+    argv++;
+    if (!*argv) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      print_help(name);
+      return false;
+    }
+    *value = std::stoi(*argv);
+    argv++;
+  }
+  return options.sample_count > 0 && options.size > 0;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  if (!parse_args(argv))
+    return 1;
+
+  try {
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    if ((size_t)options.platform_index >= platforms.size()) {
+      std::cerr << "Platform index out of range" << std::endl;
+      return 1;
+    }
+    std::vector<cl::Device> devices;
+    platforms[options.platform_index].getDevices(CL_DEVICE_TYPE_ALL,
+                                                 &devices);
+    if ((size_t)options.device_index >= devices.size()) {
+      std::cerr << "Device index out of range" << std::endl;
+      return 1;
+    }
+    cl::Device &device = devices[options.device_index];
+    std::cout << "Device: " << device.getInfo<CL_DEVICE_NAME>() << std::endl;
+
+    cl::Context ctx(device);
+    cl::CommandQueue cq(ctx, device, cl::QueueProperties::Profiling);
+    size_t n = options.size;
+    size_t bytes = n * sizeof(float);
+    cl::Buffer a(ctx, CL_MEM_READ_ONLY, bytes);
+    cl::Buffer b(ctx, CL_MEM_READ_ONLY, bytes);
+    cl::Buffer out(ctx, CL_MEM_WRITE_ONLY, bytes);
+    std::vector<float> host_a(n), host_b(n), host_out(n);
+
+    std::vector<cl::Program> programs;
+    for (const tier &t : tiers) {
+      cl::Program program(ctx, kernel_source(t.prefix));
+      try {
+        program.build(t.build_options);
+      } catch (cl::Error &) {
+        std::cerr << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device)
+                  << std::endl;
+        throw;
+      }
+      programs.push_back(program);
+    }
+
+    for (const math_function &f : functions) {
+      for (size_t i = 0; i < n; ++i) {
+        double t = (i + 0.5) / n;
+        host_a[i] = f.log_scale ? f.lo * std::pow(f.hi / f.lo, t)
+                                : f.lo + (f.hi - f.lo) * t;
+        // the second argument of powr runs through [-20, 20] independently
+        host_b[i] = (float)(40.0 * std::fmod(t * 7919.0, 1.0) - 20.0);
+      }
+      cq.enqueueWriteBuffer(a, CL_TRUE, 0, bytes, host_a.data());
+      cq.enqueueWriteBuffer(b, CL_TRUE, 0, bytes, host_b.data());
+
+      std::cout << f.name << std::endl;
+      for (size_t ti = 0; ti < programs.size(); ++ti) {
+        cl::Kernel acc(programs[ti], (std::string("acc_") + f.name).c_str());
+        acc.setArg(0, a);
+        acc.setArg(1, b);
+        acc.setArg(2, out);
+        cq.enqueueNDRangeKernel(acc, cl::NullRange, cl::NDRange(n));
+        cq.enqueueReadBuffer(out, CL_TRUE, 0, bytes, host_out.data());
+
+        double max_ulp = 0, max_abs = 0;
+        for (size_t i = 0; i < n; ++i) {
+          double ref = f.reference(host_a[i], host_b[i]);
+          if (!std::isfinite(ref) || std::fabs(ref) > 3.4e38)
+            continue;
+          max_ulp = std::max(max_ulp, ulp_error(host_out[i], ref));
+          max_abs = std::max(max_abs, std::fabs(host_out[i] - ref));
+        }
+
+        cl::Kernel tput(programs[ti],
+                        (std::string("tput_") + f.name).c_str());
+        tput.setArg(0, a);
+        tput.setArg(1, b);
+        tput.setArg(2, out);
+        std::vector<double> times;
+        for (int s = 0; s <= options.sample_count; ++s) {
+          cl::Event e;
+          cq.enqueueNDRangeKernel(tput, cl::NullRange, cl::NDRange(n),
+                                  cl::NullRange, nullptr, &e);
+          e.wait();
+          // the first run includes the work-group function compilation
+          if (s > 0)
+            times.push_back(
+                double(e.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+                       e.getProfilingInfo<CL_PROFILING_COMMAND_START>()));
+        }
+        std::sort(times.begin(), times.end());
+        double median_ns = times[times.size() / 2];
+
+        std::cout << "\t" << tiers[ti].name << ": max error " << max_ulp
+                  << " ulp / " << max_abs << ", "
+                  << n * Repeats / median_ns << " Gcalls/s" << std::endl;
+      }
+    }
+  } catch (cl::Error &err) {
+    std::cerr << err.what() << " (" << err.err() << ")" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,196 @@
+/* Benchmark for measuring the bandwidth of buffer fills and copies
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+// Measures the bandwidth of clEnqueueFillBuffer, clEnqueueCopyBuffer,
+// clEnqueueCopyBufferRect and buffer reads and writes, and of memset() and
+// memcpy() loops on the host for comparison. With the CPU devices, the
+// commands should approach the bandwidth of the host loops times the number
+// of memory channels the worker threads can keep busy.
+
+#define CL_HPP_ENABLE_EXCEPTIONS
+#define CL_HPP_MINIMUM_OPENCL_VERSION 120
+#define CL_HPP_TARGET_OPENCL_VERSION 120
+#include <CL/opencl.hpp>
+
+#include "common.hh"
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+
+struct {
+  int platform_index = 0;
+  int device_index = 0;
+  int sample_count = 10;
+  int size_mb = 256;
+} options;
+
+void print_help(const char *name) {
+  std::cerr << "Usage: " << name << " [-p platform_index] [-d device_index] "
+            << "[-s sample_count] [-m size_mb]" << std::endl
+            << "-p specifies which platform to use. (default: "
+            << options.platform_index << ")" << std::endl
+            << "-d specifies which device to use. (default: "
+            << options.device_index << ")" << std::endl
+            << "-s sets the number of samples measured. (default: "
+            << options.sample_count << ")" << std::endl
+            << "-m sets the size of the buffers in MiB. (default: "
+            << options.size_mb << ")" << std::endl;
+}
+
+bool parse_args(char **argv) {
+  const char *name = *argv++;
+  while (*argv) {
+    const char *arg = *argv;
+    int *value = nullptr;
+    if (!strcmp(arg, "-p"))
+      value = &options.platform_index;
+    else if (!strcmp(arg, "-d"))
+      value = &options.device_index;
+    else if (!strcmp(arg, "-s"))
+      value = &options.sample_count;
+    else if (!strcmp(arg, "-m"))
+      value = &options.size_mb;
+    else {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      print_help(name);
+      return false;
+    }
+    argv++;
+    if (!*argv) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      print_help(name);
+      return false;
+    }
+    *value = std::stoi(*argv);
+    argv++;
+  }
+  return options.sample_count > 0 && options.size_mb > 0;
+}
+
+// Runs the operation sample_count times after a warm-up run and prints its
+// run times and bandwidth. The operation returns its run time in µs.
+void measure(const std::string &title, size_t bytes,
+             const std::function<double()> &run) {
+  std::vector<double> times(options.sample_count);
+  run();
+  double sum = 0;
+  for (int i = 0; i < options.sample_count; ++i) {
+    times[i] = run();
+    sum += times[i];
+  }
+  std::cout << "\t" << title << std::endl;
+  print_measurements("run time:", times, 2);
+  std::cout << "\t\tGB/s: " << bytes / (sum / options.sample_count) / 1e3
+            << std::endl;
+}
+
+double host_time(const std::function<void()> &op) {
+  auto start = std::chrono::steady_clock::now();
+  op();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+double event_time(const cl::Event &e) {
+  e.wait();
+  return double(e.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+                e.getProfilingInfo<CL_PROFILING_COMMAND_START>()) /
+         1e3;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  if (!parse_args(argv))
+    return 1;
+
+  try {
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    if ((size_t)options.platform_index >= platforms.size()) {
+      std::cerr << "Platform index out of range" << std::endl;
+      return 1;
+    }
+    std::vector<cl::Device> devices;
+    platforms[options.platform_index].getDevices(CL_DEVICE_TYPE_ALL,
+                                                 &devices);
+    if ((size_t)options.device_index >= devices.size()) {
+      std::cerr << "Device index out of range" << std::endl;
+      return 1;
+    }
+    cl::Device &device = devices[options.device_index];
+    std::cout << "Device: " << device.getInfo<CL_DEVICE_NAME>() << std::endl;
+
+    size_t size = (size_t)options.size_mb << 20;
+    cl::Context ctx(device);
+    cl::CommandQueue cq(ctx, device, cl::QueueProperties::Profiling);
+    cl::Buffer a(ctx, CL_MEM_READ_WRITE, size);
+    cl::Buffer b(ctx, CL_MEM_READ_WRITE, size);
+    std::vector<char> host_a(size, 1), host_b(size, 2);
+
+    std::cout << "Host:" << std::endl;
+    measure("memset", size, [&] {
+      return host_time([&] { memset(host_a.data(), 3, size); });
+    });
+    measure("memcpy", size, [&] {
+      return host_time([&] { memcpy(host_b.data(), host_a.data(), size); });
+    });
+
+    std::cout << "Device:" << std::endl;
+    cl_uint pattern = 0x01020304;
+    measure("clEnqueueFillBuffer (4-byte pattern)", size, [&] {
+      cl::Event e;
+      cq.enqueueFillBuffer(a, pattern, 0, size, nullptr, &e);
+      return event_time(e);
+    });
+    measure("clEnqueueCopyBuffer", size, [&] {
+      cl::Event e;
+      cq.enqueueCopyBuffer(a, b, 0, 0, size, nullptr, &e);
+      return event_time(e);
+    });
+    // rows of 4 KiB with a gap in between
+    size_t row = 4096, pitch = row + 64, rows = size / pitch;
+    measure("clEnqueueCopyBufferRect (4 KiB rows)", rows * row, [&] {
+      cl::Event e;
+      cq.enqueueCopyBufferRect(a, b, {0, 0, 0}, {0, 0, 0}, {row, rows, 1},
+                               pitch, 0, pitch, 0, nullptr, &e);
+      return event_time(e);
+    });
+    measure("clEnqueueWriteBuffer", size, [&] {
+      cl::Event e;
+      cq.enqueueWriteBuffer(a, CL_FALSE, 0, size, host_a.data(), nullptr,
+                            &e);
+      return event_time(e);
+    });
+    measure("clEnqueueReadBuffer", size, [&] {
+      cl::Event e;
+      cq.enqueueReadBuffer(a, CL_FALSE, 0, size, host_b.data(), nullptr, &e);
+      return event_time(e);
+    });
+  } catch (cl::Error &err) {
+    std::cerr << err.what() << " (" << err.err() << ")" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,178 @@
+/* Benchmark for measuring the per-command overhead of event profiling
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+// Enqueues batches of small buffer fills, which need no kernel compilation,
+// into an in-order queue with and without CL_QUEUE_PROFILING_ENABLE, and
+// measures the average time per command from the first enqueue until the
+// batch has completed. The difference is the cost of taking the profiling
+// timestamps of a command, plus reading them back when -r is given. Compare
+// runs with POCL_TSC_CLOCK=0 and the default TSC clock.
+
+#include "pocl_opencl.h"
+
+#define CL_HPP_ENABLE_EXCEPTIONS
+#define CL_HPP_MINIMUM_OPENCL_VERSION 120
+#define CL_HPP_TARGET_OPENCL_VERSION 120
+#include <CL/opencl.hpp>
+
+#include "common.hh"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+struct {
+  int platform_index = 0;
+  int device_index = 0;
+  int sample_count = 200;
+  int warmup = 5;
+  int batch_size = 100;
+  int read_profiling = 0;
+} options;
+
+void print_help(const char *name) {
+  std::cerr << "Usage: " << name << " [-p platform_index] [-d device_index] "
+            << "[-s sample_count] [-b batch_size] [-r 0|1]" << std::endl
+            << "-p specifies which platform to use. (default: "
+            << options.platform_index << ")" << std::endl
+            << "-d specifies which device to use. (default: "
+            << options.device_index << ")" << std::endl
+            << "-s sets the number of samples measured. (default: "
+            << options.sample_count << ")" << std::endl
+            << "-b sets the number of commands per sample. (default: "
+            << options.batch_size << ")" << std::endl
+            << "-r if nonzero, the profiling info of every command is "
+            << "also read back. (default: " << options.read_profiling << ")"
+            << std::endl;
+}
+
+bool parse_args(char **argv) {
+  const char *name = *argv++;
+  while (*argv) {
+    const char *arg = *argv;
+    int *value = nullptr;
+    if (!strcmp(arg, "-p"))
+      value = &options.platform_index;
+    else if (!strcmp(arg, "-d"))
+      value = &options.device_index;
+    else if (!strcmp(arg, "-s"))
+      value = &options.sample_count;
+    else if (!strcmp(arg, "-b"))
+      value = &options.batch_size;
+    else if (!strcmp(arg, "-r"))
+      value = &options.read_profiling;
+    else {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      print_help(name);
+      return false;
+    }
+    argv++;
+    if (!*argv) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      print_help(name);
+      return false;
+    }
+    *value = std::stoi(*argv);
+    argv++;
+  }
+  return options.sample_count > 0 && options.batch_size > 0;
+}
+
+std::vector<double> measure_commands(cl::CommandQueue &cq, cl::Buffer &buf,
+                                     bool profiling) {
+  using namespace std::chrono;
+
+  std::vector<double> per_command(options.sample_count);
+  std::vector<cl::Event> events(options.batch_size);
+  cl_uint pattern = 0;
+
+  for (int i = -options.warmup; i < options.sample_count; ++i) {
+    auto start = steady_clock::now();
+    for (int j = 0; j < options.batch_size; ++j)
+      cq.enqueueFillBuffer(buf, pattern, 0, sizeof(pattern), nullptr,
+                           &events[j]);
+    cq.finish();
+    if (profiling && options.read_profiling) {
+      cl_ulong sum = 0;
+      for (cl::Event &e : events)
+        sum += e.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+               e.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+      (void)sum;
+    }
+    auto end = steady_clock::now();
+    if (i < 0)
+      continue;
+    per_command[i] =
+        duration<double, std::micro>(end - start).count() / options.batch_size;
+  }
+  return per_command;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  if (!parse_args(argv))
+    return 1;
+
+  try {
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    if ((size_t)options.platform_index >= platforms.size()) {
+      std::cerr << "Platform index out of range" << std::endl;
+      return 1;
+    }
+    std::vector<cl::Device> devices;
+    platforms[options.platform_index].getDevices(CL_DEVICE_TYPE_ALL,
+                                                 &devices);
+    if ((size_t)options.device_index >= devices.size()) {
+      std::cerr << "Device index out of range" << std::endl;
+      return 1;
+    }
+    cl::Device &device = devices[options.device_index];
+    std::cout << "Device: " << device.getInfo<CL_DEVICE_NAME>() << std::endl;
+
+    cl::Context ctx(device);
+    cl::CommandQueue plain_cq(ctx, device);
+    cl::CommandQueue profiling_cq(ctx, device, cl::QueueProperties::Profiling);
+    cl::Buffer buf(ctx, CL_MEM_READ_WRITE, sizeof(cl_uint));
+
+    std::vector<double> plain = measure_commands(plain_cq, buf, false);
+    std::vector<double> profiled = measure_commands(profiling_cq, buf, true);
+    std::vector<double> overhead(plain.size());
+    std::vector<double> sorted_plain(plain);
+    std::sort(sorted_plain.begin(), sorted_plain.end());
+    double plain_median = sorted_plain[sorted_plain.size() / 2];
+    for (size_t i = 0; i < plain.size(); ++i)
+      overhead[i] = profiled[i] - plain_median;
+
+    print_measurements("per command, without profiling:", plain, 1);
+    print_measurements("per command, with profiling:", profiled, 1);
+    print_measurements("profiling overhead per command "
+                       "(vs. the median without):",
+                       overhead, 1);
+  } catch (cl::Error &err) {
+    std::cerr << err.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,203 @@
+/* Benchmark for kernels streaming their output to large buffers
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+// Runs a kernel that writes its output buffer without reading it, and one
+// that updates its buffer in place, and reports the kernel run times and
+// the memory bandwidths they reach. On the CPU devices the output of the
+// first kernel is written with non-temporal stores when the buffer is larger
+// than the last level cache; run with POCL_CPU_STREAMING_STORES=0 to compare
+// to regular stores.
+
+#define CL_HPP_ENABLE_EXCEPTIONS
+#define CL_HPP_MINIMUM_OPENCL_VERSION 120
+#define CL_HPP_TARGET_OPENCL_VERSION 120
+#include <CL/opencl.hpp>
+
+#include "common.hh"
+#include <cstring>
+#include <iostream>
+#include <string>
+
+struct {
+  int platform_index = 0;
+  int device_index = 0;
+  int sample_count = 20;
+  int size = 1 << 25;
+} options;
+
+static const char *kernel_source = R"CLC(
+kernel void scale(global const float *in, global float *out, float a) {
+  size_t i = get_global_id(0);
+  out[i] = a * in[i];
+}
+
+kernel void scale_in_place(global float *inout, float a) {
+  size_t i = get_global_id(0);
+  inout[i] = a * inout[i];
+}
+)CLC";
+
+void print_help(const char *name) {
+  std::cerr << "Usage: " << name << " [-p platform_index] [-d device_index] "
+            << "[-s sample_count] [-n size]" << std::endl
+            << "-p specifies which platform to use. (default: "
+            << options.platform_index << ")" << std::endl
+            << "-d specifies which device to use. (default: "
+            << options.device_index << ")" << std::endl
+            << "-s sets the number of samples measured. (default: "
+            << options.sample_count << ")" << std::endl
+            << "-n sets the number of floats in each buffer. (default: "
+            << options.size << ")" << std::endl;
+}
+
+bool parse_args(char **argv) {
+  const char *name = *argv++;
+  while (*argv) {
+    const char *arg = *argv;
+    int *value = nullptr;
+    if (!strcmp(arg, "-p"))
+      value = &options.platform_index;
+    else if (!strcmp(arg, "-d"))
+      value = &options.device_index;
+    else if (!strcmp(arg, "-s"))
+      value = &options.sample_count;
+    else if (!strcmp(arg, "-n"))
+      value = &options.size;
+    else {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      print_help(name);
+      return false;
+    }
+    argv++;
+    if (!*argv) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      print_help(name);
+      return false;
+    }
+    *value = std::stoi(*argv);
+    argv++;
+  }
+  return options.sample_count > 0 && options.size > 0;
+}
+
+// Runs the kernel sample_count times after a warm-up run, which includes
+// the compilation of its work-group function, and prints the run times and
+// the bandwidth for the given number of bytes read and written per run.
+void measure_kernel(cl::CommandQueue &cq, cl::Kernel &k, size_t n,
+                    size_t bytes, const std::string &title) {
+  std::vector<double> times(options.sample_count);
+  cq.enqueueNDRangeKernel(k, cl::NullRange, cl::NDRange(n));
+  cq.finish();
+
+  for (int i = 0; i < options.sample_count; ++i) {
+    cl::Event e;
+    cq.enqueueNDRangeKernel(k, cl::NullRange, cl::NDRange(n), cl::NullRange,
+                            nullptr, &e);
+    e.wait();
+    times[i] = double(e.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+                      e.getProfilingInfo<CL_PROFILING_COMMAND_START>()) /
+               1e6;
+  }
+
+  double sum = 0;
+  for (double t : times)
+    sum += t;
+  std::cout << "\t" << title << std::endl;
+  print_measurements("kernel run time (ms):", times, 2);
+  std::cout << "\t\tGB/s: " << bytes / (sum / options.sample_count) / 1e6
+            << std::endl;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  if (!parse_args(argv))
+    return 1;
+
+  try {
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    if ((size_t)options.platform_index >= platforms.size()) {
+      std::cerr << "Platform index out of range" << std::endl;
+      return 1;
+    }
+    std::vector<cl::Device> devices;
+    platforms[options.platform_index].getDevices(CL_DEVICE_TYPE_ALL,
+                                                 &devices);
+    if ((size_t)options.device_index >= devices.size()) {
+      std::cerr << "Device index out of range" << std::endl;
+      return 1;
+    }
+    cl::Device &device = devices[options.device_index];
+    std::cout << "Device: " << device.getInfo<CL_DEVICE_NAME>() << std::endl;
+    std::cout << "Last level cache size (KiB): "
+              << device.getInfo<CL_DEVICE_GLOBAL_MEM_CACHE_SIZE>() / 1024
+              << std::endl;
+
+    cl::Context ctx(device);
+    cl::CommandQueue cq(ctx, device, cl::QueueProperties::Profiling);
+
+    cl::Program prog(ctx, kernel_source);
+    try {
+      prog.build();
+    } catch (cl::Error &err) {
+      std::string log = prog.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device);
+      std::cerr << "Failed to build kernel: " << log << std::endl;
+      return 1;
+    }
+
+    size_t n = options.size;
+    size_t bytes = n * sizeof(cl_float);
+    std::vector<cl_float> data(n);
+    for (size_t i = 0; i < n; ++i)
+      data[i] = (cl_float)(i % 1000);
+    cl::Buffer in(ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes,
+                  data.data());
+    cl::Buffer out(ctx, CL_MEM_WRITE_ONLY, bytes);
+    cl::Buffer inout(ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, bytes,
+                     data.data());
+
+    cl::Kernel scale(prog, "scale");
+    scale.setArg(0, in);
+    scale.setArg(1, out);
+    scale.setArg(2, 2.0f);
+    measure_kernel(cq, scale, n, 2 * bytes, "scale (write-only output)");
+
+    std::vector<cl_float> result(n);
+    cq.enqueueReadBuffer(out, CL_TRUE, 0, bytes, result.data());
+    for (size_t i = 0; i < n; ++i) {
+      if (result[i] != 2.0f * data[i]) {
+        std::cerr << "scale returned a wrong result at " << i << std::endl;
+        return 1;
+      }
+    }
+
+    cl::Kernel in_place(prog, "scale_in_place");
+    in_place.setArg(0, inout);
+    in_place.setArg(1, 1.0f);
+    measure_kernel(cq, in_place, n, 2 * bytes, "scale_in_place");
+  } catch (cl::Error &err) {
+    std::cerr << err.what() << " (" << err.err() << ")" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,181 @@
+/* Benchmark for measuring the completion wait latency of short commands
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+// Enqueues a kernel doing a configurable amount of work and measures the
+// time until the host sees it complete, both with clFinish() and with
+// clWaitForEvents(). The time the kernel itself took (from event profiling)
+// is subtracted, leaving the latency of the completion notification. Compare
+// runs with different POCL_CPU_WAIT_SPIN_US / POCL_CPU_WAIT_YIELD_US values.
+
+#include "pocl_opencl.h"
+
+#define CL_HPP_ENABLE_EXCEPTIONS
+#define CL_HPP_MINIMUM_OPENCL_VERSION 110
+#define CL_HPP_TARGET_OPENCL_VERSION 110
+#include <CL/opencl.hpp>
+
+#include "common.hh"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+struct {
+  int platform_index = 0;
+  int device_index = 0;
+  int sample_count = 1000;
+  int warmup = 10;
+  int iterations = 10000;
+} options;
+
+void print_help(const char *name) {
+  std::cerr << "Usage: " << name << " [-p platform_index] [-d device_index] "
+            << "[-s sample_count] [-i iterations]" << std::endl
+            << "-p specifies which platform to use. (default: "
+            << options.platform_index << ")" << std::endl
+            << "-d specifies which device to use. (default: "
+            << options.device_index << ")" << std::endl
+            << "-s sets the number of samples measured. (default: "
+            << options.sample_count << ")" << std::endl
+            << "-i sets the number of loop iterations in the kernel, "
+            << "which determines its run time. (default: "
+            << options.iterations << ")" << std::endl;
+}
+
+bool parse_args(char **argv) {
+  const char *name = *argv++;
+  while (*argv) {
+    const char *arg = *argv;
+    int *value = nullptr;
+    if (!strcmp(arg, "-p"))
+      value = &options.platform_index;
+    else if (!strcmp(arg, "-d"))
+      value = &options.device_index;
+    else if (!strcmp(arg, "-s"))
+      value = &options.sample_count;
+    else if (!strcmp(arg, "-i"))
+      value = &options.iterations;
+    else {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      print_help(name);
+      return false;
+    }
+    argv++;
+    if (!*argv) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      print_help(name);
+      return false;
+    }
+    *value = std::stoi(*argv);
+    argv++;
+  }
+  return options.sample_count > 0;
+}
+
+enum class WaitMethod { Finish, WaitForEvents };
+
+void measure_wait_latency(cl::CommandQueue &cq, cl::Kernel &k,
+                          WaitMethod method, const std::string &title) {
+  using namespace std::chrono;
+
+  std::vector<double> round_trip(options.sample_count);
+  std::vector<double> latency(options.sample_count);
+  std::vector<double> kernel(options.sample_count);
+
+  for (int i = -options.warmup; i < options.sample_count; ++i) {
+    cl::Event e;
+    auto start = steady_clock::now();
+    cq.enqueueNDRangeKernel(k, cl::NullRange, cl::NDRange(1), cl::NullRange,
+                            nullptr, &e);
+    if (method == WaitMethod::Finish)
+      cq.finish();
+    else
+      e.wait();
+    auto end = steady_clock::now();
+    if (i < 0)
+      continue;
+
+    round_trip[i] = duration<double, std::micro>(end - start).count();
+    kernel[i] = double(e.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+                       e.getProfilingInfo<CL_PROFILING_COMMAND_START>()) /
+                1e3;
+    latency[i] = round_trip[i] - kernel[i];
+  }
+
+  std::cout << "\t" << title << std::endl;
+  print_measurements("kernel run time:", kernel, 2);
+  print_measurements("enqueue to completion seen by host:", round_trip, 2);
+  print_measurements("overhead (difference of the above):", latency, 2);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  if (!parse_args(argv))
+    return 1;
+
+  try {
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    if ((size_t)options.platform_index >= platforms.size()) {
+      std::cerr << "Platform index out of range" << std::endl;
+      return 1;
+    }
+    std::vector<cl::Device> devices;
+    platforms[options.platform_index].getDevices(CL_DEVICE_TYPE_ALL,
+                                                 &devices);
+    if ((size_t)options.device_index >= devices.size()) {
+      std::cerr << "Device index out of range" << std::endl;
+      return 1;
+    }
+    cl::Device &device = devices[options.device_index];
+    std::cout << "Device: " << device.getInfo<CL_DEVICE_NAME>() << std::endl;
+
+    cl::Context ctx(device);
+    cl::CommandQueue cq(ctx, device, cl::QueueProperties::Profiling);
+
+    cl::Buffer output(ctx, CL_MEM_WRITE_ONLY, sizeof(float));
+    cl::Program prog(ctx, "__kernel void spin(int n, __global float *out) {"
+                          "  float x = 0.0f;"
+                          "  for (int i = 0; i < n; ++i)"
+                          "    x = x * 0.999f + 1.0f;"
+                          "  out[get_global_id(0)] = x; }");
+    try {
+      prog.build();
+    } catch (cl::Error &err) {
+      std::string log = prog.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device);
+      std::cerr << "Failed to build kernel: " << log << std::endl;
+      return 1;
+    }
+    cl::Kernel kern(prog, "spin");
+    kern.setArg(0, options.iterations);
+    kern.setArg(1, output);
+
+    measure_wait_latency(cq, kern, WaitMethod::Finish, "clFinish:");
+    measure_wait_latency(cq, kern, WaitMethod::WaitForEvents,
+                         "clWaitForEvents:");
+  } catch (cl::Error &err) {
+    std::cerr << err.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -39,6 +39,16 @@ extern "C"
 {
 #endif
 
+/* The experimental extensions below take their enum values from pocl's
+   block starting at CL_POCL_EXPERIMENTAL_ENUM_BASE, in the order they were
+   added. New values go after the last one in use:
+
+   0xff01  CL_MEM_DEVICE_PTR_EXT
+   0xff02  CL_MEM_DEVICE_PTRS_EXT
+   0xff03  CL_MEM_ALLOC_POLICY_POCL
+*/
+#define CL_POCL_EXPERIMENTAL_ENUM_BASE 0xff00
+
 /* cl_pocl_content_size should be defined in CL/cl_ext.h; however,
  * if we PoCL is built against the system headers, it's possible
  * that they have an outdated version of CL/cl_ext.h.
@@ -145,6 +155,26 @@ typedef cl_int (CL_API_CALL *clSetKernelArgDevicePointerEXT_fn) (
 /* cl_ext_buffer_device_address (experimental stage) */
 #endif
 
+/* clCreateBufferWithProperties(): CL_MEM_ALLOC_POLICY_POCL (experimental)
+
+   Controls how the host memory backing a buffer of at least 2 MiB is
+   allocated. The host memory is the device memory of the CPU devices. The
+   value is a cl_mem_alloc_policy_pocl bitfield; it overrides the default
+   set with the POCL_HOST_BUFFER_HUGE_PAGES and POCL_HOST_BUFFER_PREFAULT
+   environment variables, and 0 requests a plain allocation.
+*/
+#define CL_MEM_ALLOC_POLICY_POCL (CL_POCL_EXPERIMENTAL_ENUM_BASE + 3)
+
+typedef cl_bitfield cl_mem_alloc_policy_pocl;
+
+/* Align the allocation to 2 MiB and ask the OS to back it with
+   transparent huge pages. */
+#define CL_MEM_ALLOC_HUGE_PAGES_POCL (1 << 0)
+
+/* Touch all pages of the allocation in parallel when it is made, so the
+   first command using the buffer does not take the page faults. */
+#define CL_MEM_ALLOC_PREFAULT_POCL (1 << 1)
+
 /***********************************
 * cl_pocl_svm_rect +
 * cl_pocl_command_buffer_svm +
@@ -1076,4 +1076,29 @@
 #define write_imagei _cl_write_imagei
 #define write_imagef _cl_write_imagef
 
+/* With -cl-fast-relaxed-math, use the lower precision implementations of
+   the kernel library (lib/kernel/fast_math.cl) if the device has them. */
+#ifdef __POCL_FAST_MATH_BUILTINS__
+#undef cos
+#undef exp
+#undef exp10
+#undef exp2
+#undef log
+#undef log10
+#undef log2
+#undef powr
+#undef sin
+#undef tan
+#define cos            _cl_fast_cos
+#define exp            _cl_fast_exp
+#define exp10          _cl_fast_exp10
+#define exp2           _cl_fast_exp2
+#define log            _cl_fast_log
+#define log10          _cl_fast_log10
+#define log2           _cl_fast_log2
+#define powr           _cl_fast_powr
+#define sin            _cl_fast_sin
+#define tan            _cl_fast_tan
+#endif
+
 #endif
@@ -527,6 +527,9 @@ struct _cl_command_node
   cl_uint memobj_count;
   cl_mem *memobj_list;
   char *readonly_flag_list;
+  /* If set, a command created at command buffer finalization which runs
+   * this command and the next recorded one as a single fused kernel. */
+  _cl_command_node *fused;
 };
 
 /**
@@ -33,6 +33,16 @@
 
 typedef uintptr_t dev_sampler_t;
 
+/* The CPU devices can store 2D and 3D images tiled (POCL_CPU_TILED_IMAGES):
+   the image is divided to tiles of 4x4 (2D) or 4x4x4 (3D) pixels which are
+   stored contiguously in row-major order, as are the pixels in a tile. For
+   such images _tiling is the number of tiled dimensions (2 or 3), and
+   _row_pitch / _slice_pitch are the byte pitches of a row / slice of
+   tiles. Linear images have _tiling 0. */
+#define POCL_IMAGE_TILE_SHIFT 2
+#define POCL_IMAGE_TILE_DIM (1 << POCL_IMAGE_TILE_SHIFT)
+#define POCL_IMAGE_TILE_MASK (POCL_IMAGE_TILE_DIM - 1)
+
 typedef struct dev_image_t {
   void *_data;
   INTTYPE _width;
@@ -47,6 +57,14 @@ typedef struct dev_image_t {
   INTTYPE _data_type;
   INTTYPE _num_channels;
   INTTYPE _elem_size;
+  INTTYPE _tiling;
 } dev_image_t;
 
+/* Byte offset of an int field of dev_image_t from _width, the first field
+   after the data pointer. Unlike offsetof() alone it does not depend on the
+   pointer size, so the kernel compiler can add the pointer size of the
+   target to it (see the specialize-image-args pass). */
+#define POCL_IMAGE_INT_FIELD_OFFSET(field)                                    \
+  (offsetof (dev_image_t, field) - offsetof (dev_image_t, _width))
+
 #endif
@@ -26,13 +26,15 @@
 #include "common.h"
 #include "devices.h"
 #include "pocl_cl.h"
+#include "pocl_mem_management.h"
 #include "pocl_shared.h"
 #include "pocl_util.h"
 
 extern unsigned long buffer_c;
 
 cl_mem
-pocl_create_memobject (cl_context context, cl_mem_flags flags, size_t size,
+pocl_create_memobject (cl_context context, const cl_mem_properties *properties,
+                       cl_mem_flags flags, size_t size,
                        cl_mem_object_type type, int* device_image_support,
                        void *host_ptr, int host_ptr_is_svm, cl_int *errcode_ret)
 {
@@ -40,11 +42,35 @@ pocl_create_memobject (cl_context context, cl_mem_flags flags, size_t size,
   int errcode = CL_SUCCESS;
   unsigned i;
   cl_mem_flags stdflags = flags;
+  unsigned num_properties = 0;
+  int alloc_policy_set = 0;
+  cl_bitfield alloc_policy = 0;
 
   POCL_GOTO_ERROR_COND((size == 0), CL_INVALID_BUFFER_SIZE);
 
   POCL_GOTO_ERROR_COND ((!IS_CL_OBJECT_VALID (context)), CL_INVALID_CONTEXT);
 
+  if (properties)
+    {
+      for (i = 0; properties[i] != 0; i += 2)
+        {
+          POCL_GOTO_ERROR_ON ((properties[i] != CL_MEM_ALLOC_POLICY_POCL),
+                              CL_INVALID_PROPERTY,
+                              "Unknown memory property %" PRIu64 "\n",
+                              (uint64_t)properties[i]);
+          POCL_GOTO_ERROR_ON (alloc_policy_set, CL_INVALID_PROPERTY,
+                              "CL_MEM_ALLOC_POLICY_POCL given twice\n");
+          alloc_policy = properties[i + 1];
+          POCL_GOTO_ERROR_ON ((alloc_policy
+                               & ~(cl_bitfield)(CL_MEM_ALLOC_HUGE_PAGES_POCL
+                                                | CL_MEM_ALLOC_PREFAULT_POCL)),
+                              CL_INVALID_VALUE,
+                              "Unknown CL_MEM_ALLOC_POLICY_POCL flags\n");
+          alloc_policy_set = 1;
+        }
+      num_properties = i + 1;
+    }
+
   if (flags == 0)
     flags = CL_MEM_READ_WRITE;
 
@@ -140,6 +166,15 @@ pocl_create_memobject (cl_context context, cl_mem_flags flags, size_t size,
 
   mem->size = size;
   mem->context = context;
+  mem->alloc_policy = alloc_policy_set
+                          ? alloc_policy
+                          : pocl_mem_manager_default_alloc_policy ();
+  if (properties)
+    {
+      memcpy (mem->properties, properties,
+              num_properties * sizeof (cl_mem_properties));
+      mem->num_properties = num_properties;
+    }
   mem->is_image = (type != CL_MEM_OBJECT_PIPE && type != CL_MEM_OBJECT_BUFFER);
   mem->is_pipe = (type == CL_MEM_OBJECT_PIPE);
   mem->mem_host_ptr_version = 0;
@@ -291,7 +326,10 @@ ERROR:
     }
 
     if (((flags & CL_MEM_USE_HOST_PTR) == 0) && mem->mem_host_ptr)
-      POCL_MEM_FREE (mem->mem_host_ptr);
+      {
+        pocl_mem_manager_free_host_buffer (mem->mem_host_ptr, mem->size);
+        mem->mem_host_ptr = NULL;
+      }
 
     POCL_MEM_FREE (mem);
   }
@@ -307,9 +345,14 @@ SUCCESS:
 
 
 
-CL_API_ENTRY cl_mem CL_API_CALL POname (clCreateBuffer) (
-    cl_context context, cl_mem_flags flags, size_t size, void *host_ptr,
-    cl_int *errcode_ret) CL_API_SUFFIX__VERSION_1_0
+CL_API_ENTRY cl_mem CL_API_CALL POname (clCreateBufferWithProperties)(
+                               cl_context                context,
+                               const cl_mem_properties * properties,
+                               cl_mem_flags              flags,
+                               size_t                    size,
+                               void *                    host_ptr,
+                               cl_int *                  errcode_ret)
+CL_API_SUFFIX__VERSION_3_0
 {
   cl_mem mem = NULL;
   int errcode = CL_SUCCESS;
@@ -329,8 +372,9 @@ CL_API_ENTRY cl_mem CL_API_CALL POname (clCreateBuffer) (
         }
     }
 
-  mem = pocl_create_memobject (context, flags, size, CL_MEM_OBJECT_BUFFER,
-                               NULL, host_ptr, host_ptr_is_svm, &errcode);
+  mem = pocl_create_memobject (context, properties, flags, size,
+                               CL_MEM_OBJECT_BUFFER, NULL, host_ptr,
+                               host_ptr_is_svm, &errcode);
   if (mem == NULL)
     goto ERROR;
 
@@ -351,42 +395,14 @@ ERROR:
 
   return mem;
 }
-POsym (clCreateBuffer)
+POsym (clCreateBufferWithProperties)
 
 
-CL_API_ENTRY cl_mem CL_API_CALL POname (clCreateBufferWithProperties)(
-                               cl_context                context,
-                               const cl_mem_properties * properties,
-                               cl_mem_flags              flags,
-                               size_t                    size,
-                               void *                    host_ptr,
-                               cl_int *                  errcode_ret)
-CL_API_SUFFIX__VERSION_3_0
+CL_API_ENTRY cl_mem CL_API_CALL POname (clCreateBuffer) (
+    cl_context context, cl_mem_flags flags, size_t size, void *host_ptr,
+    cl_int *errcode_ret) CL_API_SUFFIX__VERSION_1_0
 {
-  int errcode;
-  /* pocl doesn't support any extra properties ATM */
-  POCL_GOTO_ERROR_ON ((properties && properties[0] != 0), CL_INVALID_PROPERTY,
-                      "PoCL doesn't support any properties on buffers yet\n");
-
-  cl_mem mem_ret = POname(clCreateBuffer) (context, flags, size,
-                                           host_ptr, errcode_ret);
-  if (mem_ret == NULL)
-    return NULL;
-
-  if (properties && properties[0] == 0)
-    {
-      mem_ret->num_properties = 1;
-      mem_ret->properties[0] = 0;
-    }
-
-  return mem_ret;
-
-ERROR:
-  if (errcode_ret)
-    {
-      *errcode_ret = errcode;
-    }
-
-  return NULL;
+  return POname (clCreateBufferWithProperties) (context, NULL, flags, size,
+                                                host_ptr, errcode_ret);
 }
-POsym (clCreateBufferWithProperties)
+POsym (clCreateBuffer)
@@ -23,6 +23,7 @@
 
 #include "pocl_cl.h"
 #include "pocl_cq_profiling.h"
+#include "pocl_tracing.h"
 #include "pocl_util.h"
 
 extern unsigned long queue_c;
@@ -52,7 +53,9 @@ POname(clCreateCommandQueue)(cl_context context,
   POCL_GOTO_ERROR_ON ((properties & (~all_properties)), CL_INVALID_VALUE,
                       "Unknown properties requested\n");
 
-  if (POCL_DEBUGGING_ON || pocl_cq_profiling_enabled)
+  /* the event tracers log the profiling timestamps */
+  if (POCL_DEBUGGING_ON || pocl_cq_profiling_enabled
+      || pocl_is_tracing_enabled ())
     properties |= CL_QUEUE_PROFILING_ENABLE;
 
   for (i=0; i<context->num_devices; i++)
@@ -79,6 +82,7 @@ POname(clCreateCommandQueue)(cl_context context,
   command_queue->context = context;
   command_queue->device = device;
   command_queue->properties = properties;
+  command_queue->priority = CL_QUEUE_PRIORITY_MED_KHR;
 
   /* hidden queues don't retain the context. */
   if ((properties & CL_QUEUE_HIDDEN) == 0)
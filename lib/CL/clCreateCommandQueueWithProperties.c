@@ -35,6 +35,7 @@ POname(clCreateCommandQueueWithProperties)(cl_context context,
   cl_command_queue_properties queue_props = 0;
   int queue_props_set = 0, queue_size_set = 0;
   int queue_priority_set = 0, queue_throttle_set = 0;
+  cl_queue_priority_khr queue_priority = CL_QUEUE_PRIORITY_MED_KHR;
   cl_uint queue_size = 0;
   const cl_command_queue_properties valid_prop_flags =
       (CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE
@@ -87,8 +88,9 @@ POname(clCreateCommandQueueWithProperties)(cl_context context,
                                 CL_INVALID_VALUE,
                                 "Invalid CL_QUEUE_PRIORITY_KHR value");
             queue_priority_set = 1;
-            /* This is a hint that provides no behavior or minimum guarantees
-             * so it is always safe to bring it along (no action required) */
+            /* This is a hint that provides no behavior or minimum guarantees;
+             * drivers may use it to order the commands of different queues */
+            queue_priority = (cl_queue_priority_khr)value;
             i += 2;
             break;
           }
@@ -141,6 +143,7 @@ POname(clCreateCommandQueueWithProperties)(cl_context context,
       context, device, queue_props, errcode_ret);
   if (cq_ret == NULL)
     return NULL;
+  cq_ret->priority = queue_priority;
 
   if (properties)
     {
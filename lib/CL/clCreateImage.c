@@ -236,7 +236,7 @@ pocl_create_image_internal (cl_context context, cl_mem_flags flags,
               }
           }
 
-        mem = pocl_create_memobject (context, flags, size,
+        mem = pocl_create_memobject (context, NULL, flags, size,
                                      image_desc->image_type,
                                      device_image_support,
                                      host_ptr, host_ptr_is_svm, &errcode);
@@ -74,7 +74,7 @@ CL_API_ENTRY cl_mem CL_API_CALL POname (clCreatePipe) (
     }
 
   cl_mem mem = NULL;
-  mem = pocl_create_memobject (context, flags, pipe_max_packets,
+  mem = pocl_create_memobject (context, NULL, flags, pipe_max_packets,
                                CL_MEM_OBJECT_PIPE, NULL, NULL, 0, &errcode);
   if (mem == NULL)
     goto ERROR;
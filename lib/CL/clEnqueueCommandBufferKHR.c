@@ -151,13 +151,16 @@ POname (clEnqueueCommandBufferKHR) (cl_uint num_queues,
       LL_FOREACH (command_buffer->cmds, cmd)
       {
         unsigned j = 0, k = 0;
+        /* A command fused with the next one at finalization is launched
+           in place of both. */
+        _cl_command_node *src = cmd->fused != NULL ? cmd->fused : cmd;
 
         /* Add events from syncpoints to waitlist */
-        for (; j < cmd->sync.syncpoint.num_sync_points_in_wait_list; ++j)
+        for (; j < src->sync.syncpoint.num_sync_points_in_wait_list; ++j)
           {
             // sync point ids start at 1
             deps[j]
-                = syncpoints[cmd->sync.syncpoint.sync_point_wait_list[j] - 1];
+                = syncpoints[src->sync.syncpoint.sync_point_wait_list[j] - 1];
           }
         /* Add events from command buffer dependencies to waitlist */
         for (; k < num_events_in_wait_list; ++k, ++j)
@@ -168,18 +171,18 @@ POname (clEnqueueCommandBufferKHR) (cl_uint num_queues,
         _cl_command_node *node = NULL;
         char *readonly_flag_list = NULL;
         cl_mem *memobj_list = NULL;
-        if (cmd->memobj_count != 0)
+        if (src->memobj_count != 0)
           {
-            readonly_flag_list = malloc (cmd->memobj_count);
-            memcpy (readonly_flag_list, cmd->readonly_flag_list,
-                    cmd->memobj_count);
-            memobj_list = malloc (sizeof (cl_mem) * cmd->memobj_count);
-            memcpy (memobj_list, cmd->memobj_list,
-                    sizeof (cl_mem) * cmd->memobj_count);
+            readonly_flag_list = malloc (src->memobj_count);
+            memcpy (readonly_flag_list, src->readonly_flag_list,
+                    src->memobj_count);
+            memobj_list = malloc (sizeof (cl_mem) * src->memobj_count);
+            memcpy (memobj_list, src->memobj_list,
+                    sizeof (cl_mem) * src->memobj_count);
           }
         errcode = pocl_create_command (
-          &node, used_queues[cmd->queue_idx], cmd->type, &syncpoints[sync_id],
-          j, deps, cmd->memobj_count, memobj_list, readonly_flag_list);
+          &node, used_queues[cmd->queue_idx], src->type, &syncpoints[sync_id],
+          j, deps, src->memobj_count, memobj_list, readonly_flag_list);
         ++sync_id;
 
         POCL_MEM_FREE (readonly_flag_list);
@@ -193,7 +196,7 @@ POname (clEnqueueCommandBufferKHR) (cl_uint num_queues,
             return errcode;
           }
 
-        errcode = pocl_copy_event_node (node, cmd);
+        errcode = pocl_copy_event_node (node, src);
 
         if (errcode != CL_SUCCESS)
           {
@@ -203,6 +206,16 @@ POname (clEnqueueCommandBufferKHR) (cl_uint num_queues,
           }
 
         pocl_command_enqueue (used_queues[cmd->queue_idx], node);
+
+        if (cmd->fused != NULL)
+          {
+            /* The sync point of the consumer is reached together with the
+               one of the producer. */
+            cmd = cmd->next;
+            syncpoints[sync_id] = syncpoints[sync_id - 1];
+            POname (clRetainEvent) (syncpoints[sync_id]);
+            ++sync_id;
+          }
       }
 
       /* We need an event for the completion of the command buffer as a whole.
@@ -24,7 +24,6 @@
 */
 
 #include "pocl_cl.h"
-#include "pocl_cq_profiling.h"
 #include "pocl_llvm.h"
 #include "pocl_mem_management.h"
 #include "pocl_shared.h"
@@ -63,13 +62,6 @@ POname(clEnqueueNDRangeKernel)(cl_command_queue command_queue,
     num_events_in_wait_list, event_wait_list, event, NULL, NULL, &cmd);
   POCL_RETURN_ERROR_COND (errcode != CL_SUCCESS, errcode);
 
-  if (pocl_cq_profiling_enabled)
-    {
-      pocl_cq_profiling_register_event (cmd->sync.event.event);
-      POname(clRetainKernel) (kernel);
-      cmd->sync.event.event->meta_data->kernel = kernel;
-    }
-
   pocl_command_enqueue (command_queue, cmd);
   return CL_SUCCESS;
 }
@@ -24,6 +24,8 @@
 #include <CL/cl_ext.h>
 
 #include "pocl_cl.h"
+#include "pocl_shared.h"
+#include "pocl_util.h"
 
 CL_API_ENTRY cl_int CL_API_CALL
 POname (clFinalizeCommandBufferKHR) (cl_command_buffer_khr command_buffer)
@@ -39,7 +41,9 @@ POname (clFinalizeCommandBufferKHR) (cl_command_buffer_khr command_buffer)
       (command_buffer->state != CL_COMMAND_BUFFER_STATE_RECORDING_KHR),
       CL_INVALID_OPERATION);
 
-  /* TODO: perform task graph optimizations here */
+  /* TODO: perform more task graph optimizations here */
+  if (pocl_get_bool_option ("POCL_KERNEL_FUSION", 0))
+    pocl_cmdbuf_fuse_kernels (command_buffer);
 
   /* Command buffers API is per queue but internal handling is per device */
   cl_device_id *finalized_devs
@@ -27,6 +27,53 @@
 
 #include <alloca.h>
 
+static void
+free_recorded_command (_cl_command_node *cmd)
+{
+  switch (cmd->type)
+    {
+    case CL_COMMAND_NDRANGE_KERNEL:
+      for (unsigned i = 0; i < cmd->command.run.kernel->meta->num_args;
+           ++i)
+        {
+          struct pocl_argument_info *ai
+              = &cmd->command.run.kernel->meta->arg_info[i];
+          if (ai->type == POCL_ARG_TYPE_SAMPLER)
+            POname (clReleaseSampler) (
+                cmd->command.run.arguments[i].value);
+          if (cmd->command.run.arguments[i].value != NULL)
+            POCL_MEM_FREE (cmd->command.run.arguments[i].value);
+        }
+      POname (clReleaseKernel) (cmd->command.run.kernel);
+      POCL_MEM_FREE (cmd->command.run.arguments);
+      break;
+    case CL_COMMAND_COPY_BUFFER:
+    case CL_COMMAND_COPY_BUFFER_RECT:
+    case CL_COMMAND_COPY_BUFFER_TO_IMAGE:
+    case CL_COMMAND_COPY_IMAGE:
+    case CL_COMMAND_COPY_IMAGE_TO_BUFFER:
+      break;
+    case CL_COMMAND_FILL_BUFFER:
+      POCL_MEM_FREE (cmd->command.memfill.pattern);
+      break;
+    case CL_COMMAND_SVM_MEMFILL:
+      POCL_MEM_FREE (cmd->command.svm_fill.pattern);
+      break;
+    case CL_COMMAND_FILL_IMAGE:
+      break;
+    case CL_COMMAND_BARRIER:
+      break;
+    default:
+      break;
+    }
+
+  for (unsigned i = 0; i < cmd->memobj_count; ++i)
+    {
+      POname (clReleaseMemObject) (cmd->memobj_list[i]);
+    }
+  pocl_mem_manager_free_command (cmd);
+}
+
 CL_API_ENTRY cl_int CL_API_CALL
 POname (clReleaseCommandBufferKHR) (cl_command_buffer_khr command_buffer)
     CL_API_SUFFIX__VERSION_1_2
@@ -79,51 +126,10 @@ POname (clReleaseCommandBufferKHR) (cl_command_buffer_khr command_buffer)
       _cl_command_node *cmd = command_buffer->cmds;
       while (cmd != NULL)
         {
-          switch (cmd->type)
-            {
-            case CL_COMMAND_NDRANGE_KERNEL:
-              for (unsigned i = 0; i < cmd->command.run.kernel->meta->num_args;
-                   ++i)
-                {
-                  struct pocl_argument *a
-                      = &cmd->command.run.kernel->dyn_arguments[i];
-                  struct pocl_argument_info *ai
-                      = &cmd->command.run.kernel->meta->arg_info[i];
-                  if (ai->type == POCL_ARG_TYPE_SAMPLER)
-                    POname (clReleaseSampler) (
-                        cmd->command.run.arguments[i].value);
-                  if (cmd->command.run.arguments[i].value != NULL)
-                    POCL_MEM_FREE (cmd->command.run.arguments[i].value);
-                }
-              POname (clReleaseKernel) (cmd->command.run.kernel);
-              POCL_MEM_FREE (cmd->command.run.arguments);
-              break;
-            case CL_COMMAND_COPY_BUFFER:
-            case CL_COMMAND_COPY_BUFFER_RECT:
-            case CL_COMMAND_COPY_BUFFER_TO_IMAGE:
-            case CL_COMMAND_COPY_IMAGE:
-            case CL_COMMAND_COPY_IMAGE_TO_BUFFER:
-              break;
-            case CL_COMMAND_FILL_BUFFER:
-              POCL_MEM_FREE (cmd->command.memfill.pattern);
-              break;
-            case CL_COMMAND_SVM_MEMFILL:
-              POCL_MEM_FREE (cmd->command.svm_fill.pattern);
-              break;
-            case CL_COMMAND_FILL_IMAGE:
-              break;
-            case CL_COMMAND_BARRIER:
-              break;
-            default:
-              break;
-            }
-
-          for (unsigned i = 0; i < cmd->memobj_count; ++i)
-            {
-              POname (clReleaseMemObject) (cmd->memobj_list[i]);
-            }
+          if (cmd->fused != NULL)
+            free_recorded_command (cmd->fused);
           _cl_command_node *next = cmd->next;
-          pocl_mem_manager_free_command (cmd);
+          free_recorded_command (cmd);
           cmd = next;
         }
 
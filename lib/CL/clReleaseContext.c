@@ -23,6 +23,7 @@
 */
 
 #include "devices/devices.h"
+#include "pocl_mem_management.h"
 #include "pocl_runtime_config.h"
 
 #ifdef ENABLE_LLVM
@@ -110,6 +111,12 @@ POname(clReleaseContext)(cl_context context) CL_API_SUFFIX__VERSION_1_0
 
       /* see below on why we don't call uninit_devices here anymore */
       --cl_context_count;
+      /* nothing can reuse the pooled buffer memory anymore */
+      if (cl_context_count == 0)
+        {
+          pocl_print_system_memory_stats ();
+          pocl_mem_manager_trim_host_buffers (0);
+        }
     }
   else
     {
@@ -24,6 +24,7 @@
 
 #include "devices.h"
 #include "pocl_cl.h"
+#include "pocl_mem_management.h"
 #include "utlist.h"
 
 #ifdef ENABLE_RDMA
@@ -120,7 +121,9 @@ POname(clReleaseMemObject)(cl_mem memobj) CL_API_SUFFIX__VERSION_1_0
                 memobj->mem_host_ptr = NULL; /* user allocated, do not free */
               else
                 {
-                  POCL_MEM_FREE (memobj->mem_host_ptr);
+                  pocl_mem_manager_free_host_buffer (memobj->mem_host_ptr,
+                                                     memobj->size);
+                  memobj->mem_host_ptr = NULL;
                 }
             }
 
@@ -111,6 +111,11 @@ POname(clReleaseProgram)(cl_program program) CL_API_SUFFIX__VERSION_1_0
         pocl_free_kernel_metadata (program, i);
       POCL_MEM_FREE (program->kernel_meta);
 
+      for (i = 0; i < program->num_fused_kernels; i++)
+        pocl_free_fused_kernel_metadata (program,
+                                         program->fused_kernel_meta[i]);
+      POCL_MEM_FREE (program->fused_kernel_meta);
+
       POCL_MEM_FREE (program->build_hash);
       POCL_MEM_FREE (program->compiler_options);
       POCL_MEM_FREE (program->data);
@@ -1,5 +1,6 @@
 #include "pocl_cl.h"
 #include "pocl_timing.h"
+#include "pocl_util.h"
 
 CL_API_ENTRY cl_int CL_API_CALL
 POname(clSetUserEventStatus)(cl_event event ,
@@ -31,6 +32,8 @@ CL_API_SUFFIX__VERSION_1_1
 
   POCL_LOCK_OBJ (event);
   pocl_event_updated (event, execution_status);
+  if (execution_status <= CL_COMPLETE)
+    pocl_notify_event_waiters (event);
   pocl_user_event_data *p = (pocl_user_event_data *)event->data;
   if (execution_status <= CL_COMPLETE)
     POCL_BROADCAST_COND (p->wakeup_cond);
@@ -38,6 +38,7 @@ CL_API_SUFFIX__VERSION_1_2
           "clUnloadPlatformCompiler called with non-pocl platform! \n");
       return CL_INVALID_PLATFORM;
     }
+  pocl_llvm_report_pass_stats ();
 #endif
   pocl_check_uninit_devices ();
   return CL_SUCCESS;
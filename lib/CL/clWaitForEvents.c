@@ -44,55 +44,70 @@ POname(clWaitForEvents)(cl_uint              num_events ,
               (event_list[i]->context != event_list[i - 1]->context),
               CL_INVALID_CONTEXT);
         }
+      if (event_list[i]->command_type != CL_COMMAND_USER)
+        POCL_RETURN_ERROR_COND (
+            (*(event_list[i]->queue->device->available) == CL_FALSE),
+            CL_DEVICE_NOT_AVAILABLE);
     }
 
-  // dummy implementation, waits until *all* events have completed.
+  /* Flush each distinct command queue once. This is necessary, man clFlush
+   * says: Any blocking commands .. perform an implicit flush of the cmd
+   * queue. To use event objects that refer to commands enqueued in a cmd
+   * queue as event objects to wait on by commands enqueued in a different
+   * command-queue, the application must call a clFlush or any blocking
+   * commands that perform an implicit flush */
+  cl_command_queue *queues
+      = (cl_command_queue *)malloc (num_events * sizeof (cl_command_queue));
+  POCL_RETURN_ERROR_COND ((queues == NULL), CL_OUT_OF_HOST_MEMORY);
+  unsigned num_queues = 0;
+  for (i = 0; i < num_events; ++i)
+    {
+      cl_command_queue cq = event_list[i]->queue;
+      if (event_list[i]->command_type == CL_COMMAND_USER)
+        continue;
+      unsigned j;
+      for (j = 0; j < num_queues; ++j)
+        if (queues[j] == cq)
+          break;
+      if (j < num_queues)
+        continue;
+      queues[num_queues++] = cq;
+      POname (clFlush) (cq);
+    }
+
+  /* Drivers without wait_event complete the commands in clFinish */
+  for (i = 0; i < num_queues; ++i)
+    {
+      dev = queues[i]->device;
+      if (dev->ops->wait_event == NULL)
+        POname (clFinish) (queues[i]);
+    }
+  POCL_MEM_FREE (queues);
+
+  /* Some drivers complete the commands in wait_event, and waiting for a
+   * single event through it can use a driver-specific fast path. Some
+   * drivers keep no wait state for implicit events. */
   for (i = 0; i < num_events; ++i)
     {
-      /* lets handle user events later */
       if (event_list[i]->command_type == CL_COMMAND_USER)
         continue;
       dev = event_list[i]->queue->device;
-      POCL_RETURN_ERROR_COND ((*(dev->available) == CL_FALSE),
-                              CL_DEVICE_NOT_AVAILABLE);
-      /* this is necessary, man clFlush says:
-       * Any blocking commands .. perform an implicit flush of the cmd queue.
-       * To use event objects that refer to commands enqueued in a cmd queue
-       * as event objects to wait on by commands enqueued in a different
-       * command-queue, the application must call a clFlush or any blocking
-       * commands that perform an implicit flush */
-      POname(clFlush) (event_list[i]->queue);
-      if (dev->ops->wait_event)
+      if (dev->ops->wait_event == NULL)
+        continue;
+      if (event_list[i]->implicit_event && dev->skip_implicit_event_notify)
+        continue;
+      if (dev->wait_event_required || num_events == 1)
         dev->ops->wait_event (dev, event_list[i]);
-      else
-        POname(clFinish) (event_list[i]->queue);
-      if (event_list[i]->status < 0)
-        ret = CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST;
     }
 
+  /* Wait for the rest, including the user events, at once. */
+  ret = pocl_wait_for_events (num_events, event_list);
   if (ret != CL_SUCCESS)
     return ret;
 
-  /* wait for user events */
-  struct timespec time_to_wait = { 0, 0 };
-
   for (i = 0; i < num_events; ++i)
-    {
-      cl_event e = event_list[i];
-      POCL_LOCK_OBJ (e);
-      pocl_user_event_data *p = (pocl_user_event_data *)e->data;
-      if (e->command_type == CL_COMMAND_USER)
-        {
-          while (e->status > CL_COMPLETE)
-            {
-              time_to_wait.tv_sec = time (NULL) + 1;
-              POCL_TIMEDWAIT_COND (p->wakeup_cond, e->pocl_lock, time_to_wait);
-            }
-          if (e->status < 0)
-            ret = CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST;
-        }
-      POCL_UNLOCK_OBJ (e);
-    }
+    if (event_list[i]->status < 0)
+      ret = CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST;
 
   return ret;
 }
@@ -50,6 +50,7 @@
 
 #include "common_driver.h"
 #include "common_utils.h"
+#include "printf_buffer.h"
 
 #ifdef ENABLE_LLVM
 #include "pocl_llvm.h"
@@ -90,8 +91,8 @@ pocl_basic_init_device_ops(struct pocl_device_ops *ops)
   ops->reinit = pocl_basic_reinit;
   ops->init = pocl_basic_init;
 
-  ops->alloc_mem_obj = pocl_driver_alloc_mem_obj;
-  ops->free = pocl_driver_free;
+  ops->alloc_mem_obj = pocl_basic_alloc_mem_obj;
+  ops->free = pocl_basic_free;
 
   ops->read = pocl_driver_read;
   ops->read_rect = pocl_driver_read_rect;
@@ -341,15 +342,21 @@ pocl_basic_run (void *data, _cl_command_node *cmd)
         }
     }
 
-#ifndef ENABLE_PRINTF_IMMEDIATE_FLUSH
-  pc->printf_buffer = d->printf_buffer;
-  assert (pc->printf_buffer != NULL);
   uint32_t position = 0;
-  pc->printf_buffer_position = &position;
-#else
-  pc->printf_buffer = NULL;
-  pc->printf_buffer_position = NULL;
+#ifdef ENABLE_PRINTF_IMMEDIATE_FLUSH
+  /* the deferred printf records are always formatted afterwards */
+  if (!cmd->device->deferred_printf)
+    {
+      pc->printf_buffer = NULL;
+      pc->printf_buffer_position = NULL;
+    }
+  else
 #endif
+    {
+      pc->printf_buffer = d->printf_buffer;
+      assert (pc->printf_buffer != NULL);
+      pc->printf_buffer_position = &position;
+    }
 
   pc->printf_buffer_capacity = cmd->device->printf_buffer_size;
   assert (pc->printf_buffer_capacity > 0);
@@ -369,13 +376,12 @@ pocl_basic_run (void *data, _cl_command_node *cmd)
   pocl_restore_rm (rm);
   pocl_restore_ftz (ftz);
 
-#ifndef ENABLE_PRINTF_IMMEDIATE_FLUSH
   if (position > 0)
     {
-      write (STDOUT_FILENO, pc->printf_buffer, position);
+      pocl_write_printf_buffer (cmd->device, (const char *)pc->printf_buffer,
+                                position);
       position = 0;
     }
-#endif
 
   for (i = 0; i < meta->num_args; ++i)
     {
@@ -580,6 +586,148 @@ pocl_basic_free_program (cl_device_id device, cl_program program,
 }
 /*********************** IMAGES ********************************/
 
+/* Returns the number of dimensions the given image is stored tiled in
+   (see POCL_IMAGE_TILE_SHIFT), or 0 if it's stored linearly. Images backed
+   by a buffer or a host pointer must keep the linear layout. */
+static int
+basic_image_tiling (cl_device_id device, cl_mem mem)
+{
+  if (!device->tiled_images || !mem->is_image || mem->buffer != NULL
+      || (mem->flags & CL_MEM_USE_HOST_PTR))
+    return 0;
+  if (mem->type == CL_MEM_OBJECT_IMAGE2D)
+    return 2;
+  if (mem->type == CL_MEM_OBJECT_IMAGE3D)
+    return 3;
+  return 0;
+}
+
+cl_int
+pocl_basic_alloc_mem_obj (cl_device_id device, cl_mem mem, void *host_ptr)
+{
+  pocl_mem_identifier *p = &mem->device_ptrs[device->global_mem_id];
+  int tiling = basic_image_tiling (device, mem);
+  size_t row_pitch, slice_pitch, size;
+
+  if (tiling == 0)
+    return pocl_driver_alloc_mem_obj (device, mem, host_ptr);
+
+  /* Tiled images cannot alias mem_host_ptr like the other objects, which
+     keeps the linear layout for mapping and migrating. The content is
+     converted by the image read / write callbacks. */
+  pocl_image_tiled_pitches (mem, tiling, &row_pitch, &slice_pitch, &size);
+  p->mem_ptr = pocl_aligned_malloc (MAX_EXTENDED_ALIGNMENT, size);
+  if (p->mem_ptr == NULL)
+    return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+
+  pocl_alloc_or_retain_mem_host_ptr (mem);
+  p->device_addr = p->mem_ptr;
+  p->extra = tiling;
+  p->version = 0;
+
+  POCL_MSG_PRINT_MEMORY ("CPU: ALLOC %dD tiled image %p / size %zu \n",
+                         tiling, p->mem_ptr, size);
+
+  return CL_SUCCESS;
+}
+
+void
+pocl_basic_free (cl_device_id device, cl_mem mem)
+{
+  pocl_mem_identifier *p = &mem->device_ptrs[device->global_mem_id];
+
+  if (p->extra == 0)
+    {
+      pocl_driver_free (device, mem);
+      return;
+    }
+
+  pocl_aligned_free (p->mem_ptr);
+  pocl_release_mem_host_ptr (mem);
+  p->mem_ptr = NULL;
+  p->device_addr = NULL;
+  p->version = 0;
+  p->extra = 0;
+}
+
+/* The storage of an image region copy source or destination: a linear
+   buffer or image with the given byte pitches, or a tiled image with the
+   pitches of its rows and slices of tiles. */
+typedef struct
+{
+  char *ptr;
+  size_t row_pitch;
+  size_t slice_pitch;
+  int tiling;
+} image_layout_t;
+
+static void
+image_layout (image_layout_t *l, cl_mem image, pocl_mem_identifier *mem_id)
+{
+  size_t size;
+  l->ptr = (char *)mem_id->mem_ptr;
+  l->tiling = (int)mem_id->extra;
+  if (l->tiling)
+    pocl_image_tiled_pitches (image, l->tiling, &l->row_pitch,
+                              &l->slice_pitch, &size);
+  else
+    {
+      l->row_pitch = image->image_row_pitch;
+      l->slice_pitch = image->image_slice_pitch;
+    }
+}
+
+static size_t
+image_pixel_offset (const image_layout_t *l, size_t px, size_t x, size_t y,
+                    size_t z)
+{
+  if (l->tiling == 0)
+    return x * px + y * l->row_pitch + z * l->slice_pitch;
+
+  size_t tile_index = (x & POCL_IMAGE_TILE_MASK)
+                      + ((y & POCL_IMAGE_TILE_MASK) << POCL_IMAGE_TILE_SHIFT);
+  size_t z_offset = z * l->slice_pitch;
+  if (l->tiling == 3)
+    {
+      tile_index += (z & POCL_IMAGE_TILE_MASK) << (2 * POCL_IMAGE_TILE_SHIFT);
+      z_offset = (z >> POCL_IMAGE_TILE_SHIFT) * l->slice_pitch;
+    }
+  tile_index += (x >> POCL_IMAGE_TILE_SHIFT)
+                << (POCL_IMAGE_TILE_SHIFT * l->tiling);
+  return tile_index * px + (y >> POCL_IMAGE_TILE_SHIFT) * l->row_pitch
+         + z_offset;
+}
+
+/* Copies a region of pixels between two storages of which at least one
+   is tiled, in runs of pixels that are contiguous in both. */
+static void
+copy_image_region (const image_layout_t *dst, const size_t *dst_origin,
+                   const image_layout_t *src, const size_t *src_origin,
+                   const size_t *region, size_t px)
+{
+  size_t x, y, z;
+  for (z = 0; z < region[2]; ++z)
+    for (y = 0; y < region[1]; ++y)
+      for (x = 0; x < region[0];)
+        {
+          size_t dx = dst_origin[0] + x;
+          size_t sx = src_origin[0] + x;
+          size_t run = region[0] - x;
+          if (dst->tiling)
+            run = min (run, POCL_IMAGE_TILE_DIM - (dx & POCL_IMAGE_TILE_MASK));
+          if (src->tiling)
+            run = min (run, POCL_IMAGE_TILE_DIM - (sx & POCL_IMAGE_TILE_MASK));
+          memcpy (dst->ptr
+                      + image_pixel_offset (dst, px, dx, dst_origin[1] + y,
+                                            dst_origin[2] + z),
+                  src->ptr
+                      + image_pixel_offset (src, px, sx, src_origin[1] + y,
+                                            src_origin[2] + z),
+                  run * px);
+          x += run;
+        }
+}
+
 cl_int pocl_basic_copy_image_rect( void *data,
                                    cl_mem src_image,
                                    cl_mem dst_image,
@@ -612,6 +760,15 @@ cl_int pocl_basic_copy_image_rect( void *data,
       region[0], region[1], region[2],
       px);
 
+  if (src_mem_id->extra || dst_mem_id->extra)
+    {
+      image_layout_t src, dst;
+      image_layout (&src, src_image, src_mem_id);
+      image_layout (&dst, dst_image, dst_mem_id);
+      copy_image_region (&dst, dst_origin, &src, src_origin, region, px);
+      return CL_SUCCESS;
+    }
+
   pocl_driver_copy_rect (
       data, dst_mem_id, NULL, src_mem_id, NULL, adj_dst_origin, adj_src_origin,
       adj_region, dst_image->image_row_pitch, dst_image->image_slice_pitch,
@@ -655,6 +812,15 @@ cl_int pocl_basic_write_image_rect (  void *data,
   if (src_slice_pitch == 0)
     src_slice_pitch = src_row_pitch * region[1];
 
+  if (dst_mem_id->extra)
+    {
+      image_layout_t src = { (char *)ptr, src_row_pitch, src_slice_pitch, 0 };
+      image_layout_t dst;
+      image_layout (&dst, dst_image, dst_mem_id);
+      copy_image_region (&dst, origin, &src, zero_origin, region, px);
+      return CL_SUCCESS;
+    }
+
   const size_t adj_origin[3] = { origin[0] * px, origin[1], origin[2] };
   const size_t adj_region[3] = { region[0] * px, region[1], region[2] };
 
@@ -698,6 +864,16 @@ cl_int pocl_basic_read_image_rect(  void *data,
     dst_row_pitch = px * region[0];
   if (dst_slice_pitch == 0)
     dst_slice_pitch = dst_row_pitch * region[1];
+
+  if (src_mem_id->extra)
+    {
+      image_layout_t dst = { (char *)ptr, dst_row_pitch, dst_slice_pitch, 0 };
+      image_layout_t src;
+      image_layout (&src, src_image, src_mem_id);
+      copy_image_region (&dst, zero_origin, &src, origin, region, px);
+      return CL_SUCCESS;
+    }
+
   const size_t adj_origin[3] = { origin[0] * px, origin[1], origin[2] };
   const size_t adj_region[3] = { region[0] * px, region[1], region[2] };
 
@@ -761,6 +937,35 @@ pocl_basic_fill_image (void *data, cl_mem image,
                           region[0], region[1], region[2],
                           fill_pixel, pixel_size);
 
+  size_t i, j, k;
+  /* all pixel sizes except those of the 3-channel formats */
+  int pow2_pixel = (pixel_size & (pixel_size - 1)) == 0;
+
+  if (image_data->extra)
+    {
+      image_layout_t l;
+      image_layout (&l, image, image_data);
+      for (k = 0; k < region[2]; ++k)
+        for (j = 0; j < region[1]; ++j)
+          for (i = 0; i < region[0];)
+            {
+              size_t x = origin[0] + i;
+              size_t run = min (region[0] - i,
+                                POCL_IMAGE_TILE_DIM - (x & POCL_IMAGE_TILE_MASK));
+              char *p = l.ptr
+                        + image_pixel_offset (&l, pixel_size, x,
+                                              origin[1] + j, origin[2] + k);
+              if (pow2_pixel)
+                pocl_fill_aligned_buf_with_pattern (p, 0, run * pixel_size,
+                                                    fill_pixel, pixel_size);
+              else
+                for (size_t r = 0; r < run; ++r)
+                  memcpy (p + r * pixel_size, fill_pixel, pixel_size);
+              i += run;
+            }
+      return CL_SUCCESS;
+    }
+
   size_t row_pitch = image->image_row_pitch;
   size_t slice_pitch = image->image_slice_pitch;
   char *__restrict const adjusted_device_ptr
@@ -769,17 +974,43 @@ pocl_basic_fill_image (void *data, cl_mem image,
         + row_pitch * origin[1]
         + slice_pitch * origin[2];
 
-  size_t i, j, k;
+  if (!pow2_pixel)
+    {
+      for (k = 0; k < region[2]; ++k)
+        for (j = 0; j < region[1]; ++j)
+          for (i = 0; i < region[0]; ++i)
+            memcpy (adjusted_device_ptr
+                      + pixel_size * i
+                      + row_pitch * j
+                      + slice_pitch * k,
+                    fill_pixel,
+                    pixel_size);
+      return CL_SUCCESS;
+    }
+
+  /* fill whole rows, or whole slices / the whole region if they are
+     contiguous, with the vectorized pattern fill */
+  size_t row_size = region[0] * pixel_size;
+  size_t rows = region[1];
+  size_t slices = region[2];
+  if (row_pitch == row_size)
+    {
+      row_size *= rows;
+      rows = 1;
+      if (slice_pitch == row_size)
+        {
+          row_size *= slices;
+          slices = 1;
+        }
+    }
 
-  for (k = 0; k < region[2]; ++k)
-    for (j = 0; j < region[1]; ++j)
-      for (i = 0; i < region[0]; ++i)
-        memcpy (adjusted_device_ptr
-                  + pixel_size * i
-                  + row_pitch * j
-                  + slice_pitch * k,
-                fill_pixel,
-                pixel_size);
+  for (k = 0; k < slices; ++k)
+    for (j = 0; j < rows; ++j)
+      pocl_fill_aligned_buf_with_pattern (adjusted_device_ptr
+                                            + row_pitch * j
+                                            + slice_pitch * k,
+                                          0, row_size, fill_pixel,
+                                          pixel_size);
   return CL_SUCCESS;
 }
 
@@ -284,6 +284,7 @@ pocl_fill_dev_image_t (dev_image_t *di, struct pocl_argument *parg,
                        cl_device_id device)
 {
   cl_mem mem = *(cl_mem *)parg->value;
+  pocl_mem_identifier *mem_id = &mem->device_ptrs[device->global_mem_id];
   di->_width = mem->image_width;
   di->_height = mem->image_height;
   di->_depth = mem->image_depth;
@@ -296,10 +297,44 @@ pocl_fill_dev_image_t (dev_image_t *di, struct pocl_argument *parg,
                               mem->image_channel_data_type,
                               &(di->_num_channels), &(di->_elem_size));
 
+  di->_tiling = 0;
+  if (device->tiled_images && mem_id->extra != 0)
+    {
+      size_t row_pitch, slice_pitch, size;
+      di->_tiling = (int)mem_id->extra;
+      pocl_image_tiled_pitches (mem, di->_tiling, &row_pitch, &slice_pitch,
+                                &size);
+      di->_row_pitch = row_pitch;
+      di->_slice_pitch = slice_pitch;
+    }
+
   IMAGE1D_TO_BUFFER (mem);
   di->_data = (mem->device_ptrs[device->global_mem_id].mem_ptr);
 }
 
+/**
+ * Returns the byte pitches of a row and a slice of tiles, and the storage
+ * size of the given image stored with 'tiling' tiled dimensions.
+ */
+void
+pocl_image_tiled_pitches (cl_mem mem, int tiling, size_t *row_pitch,
+                          size_t *slice_pitch, size_t *size)
+{
+  size_t px = mem->image_elem_size * mem->image_channels;
+  size_t tiles_x
+      = (mem->image_width + POCL_IMAGE_TILE_MASK) >> POCL_IMAGE_TILE_SHIFT;
+  size_t tiles_y
+      = (mem->image_height + POCL_IMAGE_TILE_MASK) >> POCL_IMAGE_TILE_SHIFT;
+  size_t tiles_z
+      = tiling == 3
+            ? (mem->image_depth + POCL_IMAGE_TILE_MASK) >> POCL_IMAGE_TILE_SHIFT
+            : 1;
+
+  *row_pitch = (tiles_x * px) << (POCL_IMAGE_TILE_SHIFT * tiling);
+  *slice_pitch = *row_pitch * tiles_y;
+  *size = *slice_pitch * tiles_z;
+}
+
 /**
  * executes given command. Call with node->sync.event.event UNLOCKED.
  */
@@ -877,6 +912,118 @@ pocl_cmd_max_grid_dim_width (_cl_command_run *cmd)
               cmd->pc.local_size[2] * cmd->pc.local_size[2]);
 }
 
+/* Writes the image argument specialization key of the given run command to
+   'key' (POCL_IMAGE_ARG_KEY_LENGTH bytes). The key lists the channel order
+   and data type of each image argument ("<order>.<type>") and the value of
+   each sampler argument ("s<value>") in hex, separated by '_', so
+   work-group functions specialized for them can be told apart. The key is
+   left empty if the kernel has no image or sampler arguments, the key does
+   not fit, or the device does not support images. */
+void
+pocl_cmd_image_arg_key (_cl_command_run *cmd, cl_device_id dev, char *key)
+{
+  pocl_kernel_metadata_t *meta = cmd->kernel->meta;
+  char *pos = key;
+  unsigned i;
+  int n;
+
+  key[0] = 0;
+  if (!dev->image_support)
+    return;
+
+  for (i = 0; i < meta->num_args; ++i)
+    {
+      struct pocl_argument *al = &cmd->arguments[i];
+      size_t left = POCL_IMAGE_ARG_KEY_LENGTH - (pos - key);
+      const char *sep = pos == key ? "" : "_";
+      if (meta->arg_info[i].type == POCL_ARG_TYPE_IMAGE)
+        {
+          cl_mem mem = al->value ? *(cl_mem *)al->value : NULL;
+          if (mem == NULL)
+            goto no_key;
+          n = snprintf (pos, left, "%s%x.%x", sep,
+                        (unsigned)mem->image_channel_order,
+                        (unsigned)mem->image_channel_data_type);
+        }
+      else if (meta->arg_info[i].type == POCL_ARG_TYPE_SAMPLER)
+        {
+          dev_sampler_t ds;
+          if (al->value == NULL || *(cl_sampler *)al->value == NULL)
+            goto no_key;
+          pocl_fill_dev_sampler_t (&ds, al);
+          n = snprintf (pos, left, "%ss%llx", sep, (unsigned long long)ds);
+        }
+      else
+        continue;
+      if (n < 0 || (size_t)n >= left)
+        goto no_key;
+      pos += n;
+    }
+  return;
+
+no_key:
+  key[0] = 0;
+}
+
+/* Writes the streaming store specialization key of the given run command to
+   'key' (POCL_STREAMING_STORE_KEY_LENGTH bytes). The key lists the indices
+   of the non-const global buffer arguments that are larger than the last
+   level cache of the device and aligned to MAX_EXTENDED_ALIGNMENT, and whose
+   stores the kernel compiler therefore may make non-temporal (see the
+   streaming-stores pass). A buffer that is passed in more than one argument
+   is left out, since the kernel might read it through the other one. The
+   key is left empty for devices that do not use the default work-group
+   launcher, or if POCL_CPU_STREAMING_STORES is disabled. */
+void
+pocl_cmd_streaming_store_key (_cl_command_run *cmd, cl_device_id dev,
+                              char *key)
+{
+  pocl_kernel_metadata_t *meta = cmd->kernel->meta;
+  char *pos = key;
+  unsigned i, j;
+
+  key[0] = 0;
+  if (!(dev->type & CL_DEVICE_TYPE_CPU) || !dev->run_workgroup_pass
+      || dev->arg_buffer_launcher || dev->spmd
+      || dev->global_mem_cache_size == 0
+      || !pocl_get_bool_option ("POCL_CPU_STREAMING_STORES", 1))
+    return;
+
+  for (i = 0; i < meta->num_args; ++i)
+    {
+      struct pocl_argument *al = &cmd->arguments[i];
+      if (meta->arg_info[i].type != POCL_ARG_TYPE_POINTER
+          || meta->arg_info[i].address_qualifier
+                 != CL_KERNEL_ARG_ADDRESS_GLOBAL
+          || meta->arg_info[i].type_qualifier & CL_KERNEL_ARG_TYPE_CONST
+          || al->is_raw_ptr || al->value == NULL)
+        continue;
+      cl_mem mem = *(cl_mem *)al->value;
+      if (mem == NULL || mem->flags & CL_MEM_READ_ONLY
+          || mem->size <= dev->global_mem_cache_size)
+        continue;
+      /* the kernel compiler assumes the streamed buffers to be aligned */
+      char *ptr = (char *)mem->device_ptrs[dev->global_mem_id].mem_ptr;
+      if ((uintptr_t)(ptr + al->offset) % MAX_EXTENDED_ALIGNMENT != 0)
+        continue;
+
+      for (j = 0; j < meta->num_args; ++j)
+        {
+          struct pocl_argument *other = &cmd->arguments[j];
+          if (j != i && meta->arg_info[j].type == POCL_ARG_TYPE_POINTER
+              && !other->is_raw_ptr && other->value != NULL
+              && *(cl_mem *)other->value == mem)
+            break;
+        }
+      if (j < meta->num_args)
+        continue;
+
+      if (POCL_STREAMING_STORE_KEY_LENGTH - (pos - key) < 3 || i > 0xff)
+        break;
+      pos += snprintf (pos, 3, "%02x", i);
+    }
+}
+
 
 /* CPU driver stuff */
 
@@ -895,6 +1042,10 @@ struct pocl_dlhandle_cache_item
   int specialize;
   /* Maximum grid dimension this WG function works with. */
   size_t max_grid_dim_width;
+  /* The image formats and samplers this WG function is specialized for. */
+  char image_arg_key[POCL_IMAGE_ARG_KEY_LENGTH];
+  /* The buffer arguments this WG function streams its stores to. */
+  char streaming_store_key[POCL_STREAMING_STORE_KEY_LENGTH];
 
   void *wg;
   void *dlhandle;
@@ -1059,12 +1210,49 @@ pocl_check_kernel_disk_cache (_cl_command_node *command, int specialized)
 }
 
 
+/**
+ * Builds the work-group function binary of the kernel command to the disk
+ * cache unless it is there already. Unlike pocl_check_kernel_disk_cache(),
+ * returns an error instead of aborting, for callers which can fall back to
+ * something else.
+ */
+int
+pocl_build_kernel_disk_cache (_cl_command_node *command, int specialized)
+{
+#ifdef ENABLE_LLVM
+  char module_fn[POCL_MAX_PATHNAME_LENGTH];
+  cl_kernel k = command->command.run.kernel;
+  cl_program p = k->program;
+  unsigned dev_i = command->program_device_i;
+
+  pocl_cache_final_binary_path (module_fn, p, dev_i, k, command, specialized);
+  if (pocl_exists (module_fn))
+    return CL_SUCCESS;
+  if (p->binaries[dev_i] == NULL)
+    return CL_INVALID_PROGRAM_EXECUTABLE;
+
+  POCL_LOCK (pocl_llvm_codegen_lock);
+  int error = llvm_codegen (module_fn, dev_i, k, command->device, command,
+                            specialized);
+  POCL_UNLOCK (pocl_llvm_codegen_lock);
+  if (error)
+    {
+      POCL_MSG_PRINT_LLVM ("Final linking of kernel %s failed.\n", k->name);
+      return CL_BUILD_PROGRAM_FAILURE;
+    }
+  return CL_SUCCESS;
+#else
+  return CL_COMPILER_NOT_AVAILABLE;
+#endif
+}
+
 /* Look for a dlhandle in the dlhandle cache for the given kernel command.
    If found, push the handle up in the cache to improve cache hit speed,
    and return it. Otherwise return NULL. The caller should hold
    pocl_dlhandle_lock. */
 static pocl_dlhandle_cache_item *
-fetch_dlhandle_cache_item (_cl_command_run *run_cmd, int specialize)
+fetch_dlhandle_cache_item (_cl_command_run *run_cmd, const char *image_key,
+                           const char *streaming_store_key, int specialize)
 {
   pocl_dlhandle_cache_item *ci = NULL, *tmp = NULL;
   size_t max_grid_width = pocl_cmd_max_grid_dim_width (run_cmd);
@@ -1076,6 +1264,9 @@ fetch_dlhandle_cache_item (_cl_command_run *run_cmd, int specialize)
         && (ci->local_wgs[2] == run_cmd->pc.local_size[2])
         && (max_grid_width <= ci->max_grid_dim_width)
         && (ci->specialize == specialize)
+        && (!specialize || strcmp (ci->image_arg_key, image_key) == 0)
+        && (!specialize
+            || strcmp (ci->streaming_store_key, streaming_store_key) == 0)
         && (ci->goffs_zero == (run_cmd->pc.global_offset[0] == 0
                 && run_cmd->pc.global_offset[1] == 0
                 && run_cmd->pc.global_offset[2] == 0)))
@@ -1119,8 +1310,15 @@ pocl_check_kernel_dlhandle_cache (_cl_command_node *command,
   if (!pocl_get_bool_option("POCL_WORK_GROUP_SPECIALIZATION", 1))
     specialize = 0;
 
+  char image_key[POCL_IMAGE_ARG_KEY_LENGTH];
+  pocl_cmd_image_arg_key (run_cmd, command->device, image_key);
+  char streaming_store_key[POCL_STREAMING_STORE_KEY_LENGTH];
+  pocl_cmd_streaming_store_key (run_cmd, command->device,
+                                streaming_store_key);
+
   POCL_LOCK (pocl_dlhandle_lock);
-  ci = fetch_dlhandle_cache_item (run_cmd, specialize);
+  ci = fetch_dlhandle_cache_item (run_cmd, image_key, streaming_store_key,
+                                  specialize);
   if (ci != NULL)
     {
       if (retain) ++ci->ref_count;
@@ -1142,6 +1340,9 @@ pocl_check_kernel_dlhandle_cache (_cl_command_node *command,
 
   size_t max_grid_width = pocl_cmd_max_grid_dim_width (run_cmd);
   ci->max_grid_dim_width = max_grid_width;
+  memcpy (ci->image_arg_key, image_key, POCL_IMAGE_ARG_KEY_LENGTH);
+  memcpy (ci->streaming_store_key, streaming_store_key,
+          POCL_STREAMING_STORE_KEY_LENGTH);
 
   char *module_fn = pocl_check_kernel_disk_cache (command, specialize);
 
@@ -1404,6 +1605,19 @@ pocl_print_system_memory_stats()
                     system_memory.total_alloc_limit >> 10,
                     system_memory.currently_allocated >> 10,
                     system_memory.max_ever_allocated >> 10);
+
+  pocl_host_buffer_stats pool;
+  pocl_mem_manager_host_buffer_stats (&pool);
+  POCL_MSG_PRINT_F (MEMORY, INFO, "",
+                    "____ Host buffer pool retained      : %10zu KB\n"
+                    " ____ Host buffer pool max retained  : %10zu KB\n"
+                    " ____ Host buffer pool retain limit  : %10zu KB\n"
+                    " ____ Host buffer pool hits / misses : %10" PRIu64
+                    " / %" PRIu64 "\n"
+                    " ____ Host buffer pool freed blocks  : %10" PRIu64 "\n",
+                    pool.retained >> 10, pool.max_ever_retained >> 10,
+                    pool.max_retained >> 10, pool.hits, pool.misses,
+                    pool.trimmed);
 }
 
 /* default WG size in each dimension & total WG size.
@@ -69,6 +69,10 @@ void pocl_fill_dev_image_t (dev_image_t *di, struct pocl_argument *parg,
 POCL_EXPORT
 void pocl_fill_dev_sampler_t (dev_sampler_t *ds, struct pocl_argument *parg);
 
+POCL_EXPORT
+void pocl_image_tiled_pitches (cl_mem mem, int tiling, size_t *row_pitch,
+                               size_t *slice_pitch, size_t *size);
+
 POCL_EXPORT
 void pocl_exec_command (_cl_command_node *node);
 
@@ -84,9 +88,29 @@ void pocl_init_dlhandle_cache ();
 POCL_EXPORT
 char *pocl_check_kernel_disk_cache (_cl_command_node *cmd, int specialized);
 
+POCL_EXPORT
+int pocl_build_kernel_disk_cache (_cl_command_node *cmd, int specialized);
+
 POCL_EXPORT
 size_t pocl_cmd_max_grid_dim_width (_cl_command_run *cmd);
 
+/* Size of an image argument specialization key including the terminating
+   NUL. The key is a part of a cache directory name, so kernels whose key
+   does not fit are not specialized for their image arguments. */
+#define POCL_IMAGE_ARG_KEY_LENGTH 128
+
+POCL_EXPORT
+void pocl_cmd_image_arg_key (_cl_command_run *cmd, cl_device_id dev,
+                             char *key);
+
+/* Buffer arguments listed at most in a streaming store key. */
+#define POCL_MAX_STREAMING_STORE_ARGS 16
+#define POCL_STREAMING_STORE_KEY_LENGTH (POCL_MAX_STREAMING_STORE_ARGS * 2 + 1)
+
+POCL_EXPORT
+void pocl_cmd_streaming_store_key (_cl_command_run *cmd, cl_device_id dev,
+                                   char *key);
+
 POCL_EXPORT
 void pocl_check_kernel_dlhandle_cache (_cl_command_node *command,
                                        int retain,
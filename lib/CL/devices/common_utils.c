@@ -91,6 +91,12 @@ void free_kernel_run_command (kernel_run_command *k)
 
 #define ARGS_SIZE (sizeof (void *) * (meta->num_args + meta->num_locals + 1))
 
+/* Memory commands of at least this many bytes are split into chunks that
+   the threads of the driver process in parallel. */
+#define POCL_CPU_PARALLEL_MEM_BYTES (4 << 20)
+/* the size of the chunks, a multiple of all fill pattern sizes */
+#define POCL_CPU_MEM_CHUNK_BYTES (1 << 20)
+
 static char *
 align_ptr (char *p)
 {
@@ -241,9 +247,29 @@ pocl_cpu_init_common (cl_device_id device)
   device->local_mem_size = pocl_get_int_option ("POCL_CPU_LOCAL_MEM_SIZE",
                                                 device->local_mem_size);
 
+  device->deferred_printf
+      = pocl_get_bool_option ("POCL_CPU_DEFERRED_PRINTF", 0);
+
+  device->tiled_images = pocl_get_bool_option ("POCL_CPU_TILED_IMAGES", 0);
+
   return ret;
 }
 
+/* Returns the size above which the memory commands of the given CPU device
+   write with non-temporal stores, since larger writes would only evict the
+   rest of the working set from the caches: the last level cache size of
+   the device, or SIZE_MAX if it is unknown or POCL_CPU_STREAMING_STORES is
+   disabled. Call after pocl_cpu_init_common (). */
+size_t
+pocl_cpu_streaming_store_bytes (cl_device_id device)
+{
+  if (device->global_mem_cache_size == 0
+      || device->global_mem_cache_size > SIZE_MAX
+      || !pocl_get_bool_option ("POCL_CPU_STREAMING_STORES", 1))
+    return SIZE_MAX;
+  return (size_t)device->global_mem_cache_size;
+}
+
 /* called from kernel setup code.
  * Sets up the actual arguments, except the local ones. */
 void
@@ -460,3 +486,160 @@ pocl_free_kernel_arg_array_with_locals (void **arguments, void **arguments2,
       arguments2[meta->num_args + i] = NULL;
     }
 }
+
+typedef struct
+{
+  char *dst;
+  const char *src;
+  size_t size;
+  const void *pattern;
+  size_t pattern_size;
+  int stream;
+} mem_job;
+
+static void
+memfill_chunk (void *arg, size_t begin, size_t end)
+{
+  mem_job *job = (mem_job *)arg;
+  size_t first = begin * POCL_CPU_MEM_CHUNK_BYTES;
+  size_t size = min (end * POCL_CPU_MEM_CHUNK_BYTES, job->size) - first;
+  if (job->stream)
+    pocl_stream_fill_aligned_buf_with_pattern (job->dst, first, size,
+                                               job->pattern,
+                                               job->pattern_size);
+  else
+    pocl_fill_aligned_buf_with_pattern (job->dst, first, size, job->pattern,
+                                        job->pattern_size);
+}
+
+static void
+memcpy_chunk (void *arg, size_t begin, size_t end)
+{
+  mem_job *job = (mem_job *)arg;
+  size_t first = begin * POCL_CPU_MEM_CHUNK_BYTES;
+  size_t size = min (end * POCL_CPU_MEM_CHUNK_BYTES, job->size) - first;
+  if (job->stream)
+    pocl_stream_memcpy (job->dst + first, job->src + first, size);
+  else
+    memcpy (job->dst + first, job->src + first, size);
+}
+
+/* Runs the job in chunks with pfor if it is large enough. */
+static void
+run_mem_job (pocl_cpu_parallel_for_func pfor, size_t stream_bytes,
+             mem_job *job, void (*func) (void *arg, size_t begin, size_t end))
+{
+  size_t num_chunks
+      = (job->size + POCL_CPU_MEM_CHUNK_BYTES - 1) / POCL_CPU_MEM_CHUNK_BYTES;
+  job->stream = job->size > stream_bytes;
+  if (job->size < POCL_CPU_PARALLEL_MEM_BYTES)
+    func (job, 0, num_chunks);
+  else
+    pfor (num_chunks, 1, func, job);
+}
+
+void
+pocl_cpu_memfill (pocl_cpu_parallel_for_func pfor, size_t stream_bytes,
+                  void *__restrict__ ptr, size_t offset, size_t size,
+                  const void *__restrict__ pattern, size_t pattern_size)
+{
+  mem_job job = { .dst = (char *)ptr + offset,
+                  .size = size,
+                  .pattern = pattern,
+                  .pattern_size = pattern_size };
+  run_mem_job (pfor, stream_bytes, &job, memfill_chunk);
+}
+
+void
+pocl_cpu_memcpy (pocl_cpu_parallel_for_func pfor, size_t stream_bytes,
+                 void *__restrict__ dst, const void *__restrict__ src,
+                 size_t size)
+{
+  if (dst == src)
+    return;
+  mem_job job = { .dst = (char *)dst, .src = (const char *)src, .size = size };
+  run_mem_job (pfor, stream_bytes, &job, memcpy_chunk);
+}
+
+typedef struct
+{
+  char *dst;
+  const char *src;
+  const size_t *region;
+  size_t dst_row_pitch;
+  size_t dst_slice_pitch;
+  size_t src_row_pitch;
+  size_t src_slice_pitch;
+  /* the rows or the slices of the region are the items */
+  int by_slices;
+  int stream;
+} rect_job;
+
+static void
+memcpy_rect_items (void *arg, size_t begin, size_t end)
+{
+  rect_job *job = (rect_job *)arg;
+  size_t j, k;
+  size_t j0 = job->by_slices ? 0 : begin;
+  size_t j1 = job->by_slices ? job->region[1] : end;
+  size_t k0 = job->by_slices ? begin : 0;
+  size_t k1 = job->by_slices ? end : 1;
+
+  for (k = k0; k < k1; ++k)
+    for (j = j0; j < j1; ++j)
+      {
+        char *d = job->dst + job->dst_row_pitch * j + job->dst_slice_pitch * k;
+        const char *s
+            = job->src + job->src_row_pitch * j + job->src_slice_pitch * k;
+        if (job->stream)
+          pocl_stream_memcpy (d, s, job->region[0]);
+        else
+          memcpy (d, s, job->region[0]);
+      }
+}
+
+void
+pocl_cpu_memcpy_rect (pocl_cpu_parallel_for_func pfor, size_t stream_bytes,
+                      void *__restrict__ dst, const void *__restrict__ src,
+                      const size_t *__restrict__ const dst_origin,
+                      const size_t *__restrict__ const src_origin,
+                      const size_t *__restrict__ const region,
+                      size_t dst_row_pitch, size_t dst_slice_pitch,
+                      size_t src_row_pitch, size_t src_slice_pitch)
+{
+  size_t size = region[0] * region[1] * region[2];
+  dst = (char *)dst + dst_origin[0] + dst_row_pitch * dst_origin[1]
+        + dst_slice_pitch * dst_origin[2];
+  src = (const char *)src + src_origin[0] + src_row_pitch * src_origin[1]
+        + src_slice_pitch * src_origin[2];
+
+  if (src_row_pitch == dst_row_pitch && dst_row_pitch == region[0]
+      && src_slice_pitch == dst_slice_pitch
+      && dst_slice_pitch == (region[1] * region[0]))
+    {
+      pocl_cpu_memcpy (pfor, stream_bytes, dst, src, size);
+      return;
+    }
+
+  rect_job job = { .dst = (char *)dst,
+                   .src = (const char *)src,
+                   .region = region,
+                   .dst_row_pitch = dst_row_pitch,
+                   .dst_slice_pitch = dst_slice_pitch,
+                   .src_row_pitch = src_row_pitch,
+                   .src_slice_pitch = src_slice_pitch,
+                   .by_slices = region[2] > 1,
+                   .stream = size > stream_bytes };
+
+  size_t num_items = job.by_slices ? region[2] : region[1];
+  if (size < POCL_CPU_PARALLEL_MEM_BYTES || num_items < 2)
+    {
+      memcpy_rect_items (&job, 0, num_items);
+      return;
+    }
+
+  size_t item_bytes = size / num_items;
+  pfor (num_items,
+        (POCL_CPU_MEM_CHUNK_BYTES + item_bytes - 1) / item_bytes,
+        memcpy_rect_items, &job);
+}
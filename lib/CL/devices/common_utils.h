@@ -45,6 +45,8 @@ struct kernel_run_command
   kernel_run_command *prev;
   kernel_run_command *next;
   unsigned long ref_count;
+  /* when the command started running, for the run time estimate */
+  uint64_t start_time;
 
   /* actual kernel arguments. these are setup once at the kernel setup
    * phase, then each thread sets up the local arguments for itself. */
@@ -98,6 +100,40 @@ POCL_EXPORT
 void pocl_free_kernel_arg_array_with_locals (void **arguments, void **arguments2,
                                         kernel_run_command *k);
 
+/* Calls func(arg, begin, end) for consecutive ranges of at most chunk of
+ * the num_items items, possibly on multiple threads, and returns when all
+ * of them have been processed. Provided by the CPU drivers. */
+typedef void (*pocl_cpu_parallel_for_func) (
+    size_t num_items, size_t chunk,
+    void (*func) (void *arg, size_t begin, size_t end), void *arg);
+
+POCL_EXPORT
+size_t pocl_cpu_streaming_store_bytes (cl_device_id device);
+
+/* Fills, copies and rectangular copies of host memory for the buffer
+ * commands of the CPU drivers. Large ones are split into chunks run with
+ * pfor, and ones larger than stream_bytes (see
+ * pocl_cpu_streaming_store_bytes ()) use non-temporal stores. */
+POCL_EXPORT
+void pocl_cpu_memfill (pocl_cpu_parallel_for_func pfor, size_t stream_bytes,
+                       void *__restrict__ ptr, size_t offset, size_t size,
+                       const void *__restrict__ pattern, size_t pattern_size);
+
+POCL_EXPORT
+void pocl_cpu_memcpy (pocl_cpu_parallel_for_func pfor, size_t stream_bytes,
+                      void *__restrict__ dst, const void *__restrict__ src,
+                      size_t size);
+
+POCL_EXPORT
+void pocl_cpu_memcpy_rect (pocl_cpu_parallel_for_func pfor,
+                           size_t stream_bytes, void *__restrict__ dst,
+                           const void *__restrict__ src,
+                           const size_t *__restrict__ const dst_origin,
+                           const size_t *__restrict__ const src_origin,
+                           const size_t *__restrict__ const region,
+                           size_t dst_row_pitch, size_t dst_slice_pitch,
+                           size_t src_row_pitch, size_t src_slice_pitch);
+
 #ifdef __cplusplus
 }
 #endif
@@ -534,6 +534,9 @@ pocl_cuda_init (unsigned j, cl_device_id dev, const char *parameters)
 
   dev->spmd = CL_TRUE;
   dev->run_workgroup_pass = CL_FALSE;
+  /* without the queue threads, the commands are finalized in wait_event */
+  dev->wait_event_required
+      = pocl_get_bool_option ("POCL_CUDA_DISABLE_QUEUE_THREADS", 1);
   dev->execution_capabilities = CL_EXEC_KERNEL;
 
   dev->global_as_id = 1;
@@ -0,0 +1,552 @@
+/* printf_buffer.c - writing out the printf buffers of the CPU devices
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include "vccompat.hpp"
+#endif
+
+#include "printf_buffer.h"
+
+/* The record layout written by __pocl_printf_deferred() in
+ * lib/kernel/printf.c: a 16-byte header (uint32_t size, uint32_t flags,
+ * uint64_t format string address) followed by the raw argument bytes. */
+#define RECORD_HEADER_SIZE 16
+#define RECORD_FLAG_FLOAT_ARGS 1
+#define RECORD_NULL_STRING 0xffffffffU
+
+/* These must produce the same output as the device-side formatter. */
+#define ERROR_STRING " printf format string error: 0x"
+
+#define ERROR_NULL_AFTER_FORMAT_SIGN 0x11
+#define ERROR_REPEATED_FLAG_MINUS 0x12
+#define ERROR_REPEATED_FLAG_PLUS 0x13
+#define ERROR_REPEATED_FLAG_SPACE 0x14
+#define ERROR_REPEATED_FLAG_SHARP 0x15
+#define ERROR_REPEATED_FLAG_ZERO 0x16
+#define ERROR_FIELD_WIDTH_ZERO 0x17
+#define ERROR_FIELD_WIDTH_OVERFLOW 0x18
+#define ERROR_PRECISION_OVERFLOW 0x19
+#define ERROR_VECTOR_LENGTH_ZERO 0x20
+#define ERROR_VECTOR_LENGTH_OVERFLOW 0x21
+#define ERROR_VECTOR_LENGTH_UNKNOWN 0x22
+#define ERROR_VECTOR_LENGTH_WITHOUT_ELEMENT_SIZE 0x23
+#define ERROR_HL_MODIFIER_USED_WITHOUT_VECTOR_LENGTH 0x24
+#define ERROR_FLAGS_WITH_C_CONVERSION_SPECIFIER 0x25
+#define ERROR_FLAGS_WITH_S_CONVERSION_SPECIFIER 0x26
+#define ERROR_VECTOR_LENGTH_WITH_S_CONVERSION_SPECIFIER 0x27
+#define ERROR_LENGTH_MODIFIER_WITH_S_CONVERSION_SPECIFIER 0x28
+#define ERROR_FLAGS_WITH_P_CONVERSION_SPECIFIER 0x29
+#define ERROR_PRECISION_WITH_P_CONVERSION_SPECIFIER 0x30
+#define ERROR_VECTOR_LENGTH_WITH_P_CONVERSION_SPECIFIER 0x31
+#define ERROR_LENGTH_MODIFIER_WITH_P_CONVERSION_SPECIFIER 0x32
+#define ERROR_UNKNOWN_CONVERSION_SPECIFIER 0x33
+
+#define OUTPUT_BUFFER_SIZE 16384
+
+/* the formatted output is collected and written with as few write() calls
+ * as possible, so the output of a work-group stays together */
+typedef struct
+{
+  size_t pos;
+  char buf[OUTPUT_BUFFER_SIZE];
+} output_t;
+
+typedef struct
+{
+  const char *pos;
+  const char *end;
+} record_args_t;
+
+static void
+output_flush (output_t *out)
+{
+  if (out->pos > 0)
+    write (STDOUT_FILENO, out->buf, out->pos);
+  out->pos = 0;
+}
+
+static void
+output_append (output_t *out, const char *str, size_t len)
+{
+  while (len > 0)
+    {
+      if (out->pos == OUTPUT_BUFFER_SIZE)
+        output_flush (out);
+      size_t n = OUTPUT_BUFFER_SIZE - out->pos;
+      if (n > len)
+        n = len;
+      memcpy (out->buf + out->pos, str, n);
+      out->pos += n;
+      str += n;
+      len -= n;
+    }
+}
+
+static void
+output_format (output_t *out, const char *spec, ...)
+{
+  char tmp[1200];
+  va_list ap;
+
+  va_start (ap, spec);
+  int len = vsnprintf (tmp, sizeof (tmp), spec, ap);
+  va_end (ap);
+  if (len < 0)
+    return;
+  if ((size_t)len < sizeof (tmp))
+    {
+      output_append (out, tmp, len);
+      return;
+    }
+
+  /* very wide fields */
+  char *large = malloc (len + 1);
+  if (large == NULL)
+    return;
+  va_start (ap, spec);
+  vsnprintf (large, len + 1, spec, ap);
+  va_end (ap);
+  output_append (out, large, len);
+  free (large);
+}
+
+static int
+read_arg (record_args_t *args, void *dst, size_t size)
+{
+  if ((size_t)(args->end - args->pos) < size)
+    return 0;
+  memcpy (dst, args->pos, size);
+  args->pos += size;
+  return 1;
+}
+
+/* Formats one record. Follows __pocl_printf_format_full() in
+ * lib/kernel/printf.c, using the C library for the conversions. */
+static void
+format_record (output_t *out, const char *format, uint32_t record_flags,
+               record_args_t *args)
+{
+  char ch;
+  unsigned errcode = 0;
+
+  while ((ch = *format++))
+    {
+      if (ch != '%')
+        {
+          output_append (out, &ch, 1);
+          continue;
+        }
+
+      ch = *format++;
+      if (ch == 0)
+        {
+          errcode = ERROR_NULL_AFTER_FORMAT_SIGN;
+          goto error;
+        }
+      if (ch == '%')
+        {
+          output_append (out, "%", 1);
+          continue;
+        }
+
+      int align_left = 0, always_sign = 0, space = 0, alt = 0, zero = 0;
+      for (;; ch = *format++)
+        {
+          if (ch == '-')
+            {
+              if (align_left)
+                {
+                  errcode = ERROR_REPEATED_FLAG_MINUS;
+                  goto error;
+                }
+              align_left = 1;
+            }
+          else if (ch == '+')
+            {
+              if (always_sign)
+                {
+                  errcode = ERROR_REPEATED_FLAG_PLUS;
+                  goto error;
+                }
+              always_sign = 1;
+            }
+          else if (ch == ' ')
+            {
+              if (space)
+                {
+                  errcode = ERROR_REPEATED_FLAG_SPACE;
+                  goto error;
+                }
+              space = 1;
+            }
+          else if (ch == '#')
+            {
+              if (alt)
+                {
+                  errcode = ERROR_REPEATED_FLAG_SHARP;
+                  goto error;
+                }
+              alt = 1;
+            }
+          else if (ch == '0')
+            {
+              if (zero)
+                {
+                  errcode = ERROR_REPEATED_FLAG_ZERO;
+                  goto error;
+                }
+              if (!align_left)
+                zero = 1;
+            }
+          else
+            break;
+        }
+
+      int width = 0;
+      while (ch >= '0' && ch <= '9')
+        {
+          if (ch == '0' && width == 0)
+            {
+              errcode = ERROR_FIELD_WIDTH_ZERO;
+              goto error;
+            }
+          if (width > (INT_MAX - 9) / 10)
+            {
+              errcode = ERROR_FIELD_WIDTH_OVERFLOW;
+              goto error;
+            }
+          width = 10 * width + (ch - '0');
+          ch = *format++;
+        }
+
+      int precision = -1;
+      if (ch == '.')
+        {
+          precision = 0;
+          ch = *format++;
+          while (ch >= '0' && ch <= '9')
+            {
+              if (precision > (INT_MAX - 9) / 10)
+                {
+                  errcode = ERROR_PRECISION_OVERFLOW;
+                  goto error;
+                }
+              precision = 10 * precision + (ch - '0');
+              ch = *format++;
+            }
+        }
+
+      unsigned vector_length = 0;
+      if (ch == 'v')
+        {
+          ch = *format++;
+          while (ch >= '0' && ch <= '9')
+            {
+              if (ch == '0' && vector_length == 0)
+                {
+                  errcode = ERROR_VECTOR_LENGTH_ZERO;
+                  goto error;
+                }
+              if (vector_length > (INT_MAX - 9) / 10)
+                {
+                  errcode = ERROR_VECTOR_LENGTH_OVERFLOW;
+                  goto error;
+                }
+              vector_length = 10 * vector_length + (ch - '0');
+              ch = *format++;
+            }
+          if (!(vector_length == 2 || vector_length == 3 || vector_length == 4
+                || vector_length == 8 || vector_length == 16))
+            {
+              errcode = ERROR_VECTOR_LENGTH_UNKNOWN;
+              goto error;
+            }
+        }
+
+      unsigned length = 0;
+      if (ch == 'h')
+        {
+          ch = *format++;
+          if (ch == 'h')
+            {
+              ch = *format++;
+              length = 1;
+            }
+          else if (ch == 'l')
+            {
+              ch = *format++;
+              length = 4;
+            }
+          else
+            length = 2;
+        }
+      else if (ch == 'l')
+        {
+          ch = *format++;
+          length = 8;
+        }
+      if (vector_length > 0 && length == 0)
+        {
+          errcode = ERROR_VECTOR_LENGTH_WITHOUT_ELEMENT_SIZE;
+          goto error;
+        }
+      if (vector_length == 0 && length == 4)
+        {
+          errcode = ERROR_HL_MODIFIER_USED_WITHOUT_VECTOR_LENGTH;
+          goto error;
+        }
+
+      /* 3-element vectors are stored as 4 elements */
+      unsigned stored_length = vector_length == 3 ? 4 : vector_length;
+      if (vector_length == 0)
+        vector_length = stored_length = 1;
+
+      char spec[16];
+      snprintf (spec, sizeof (spec), "%%%s%s%s%s%s*.*", align_left ? "-" : "",
+                always_sign ? "+" : "", space ? " " : "", alt ? "#" : "",
+                zero ? "0" : "");
+      size_t spec_len = strlen (spec);
+
+      switch (ch)
+        {
+        case 'd':
+        case 'i':
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+          {
+            int is_signed = (ch == 'd' || ch == 'i');
+            /* scalars are promoted to int */
+            unsigned elem_size = length == 0 ? 4 : length;
+            unsigned stored_size
+                = (vector_length == 1 && elem_size < 4) ? 4 : elem_size;
+            spec[spec_len++] = 'l';
+            spec[spec_len++] = 'l';
+            spec[spec_len++] = ch;
+            spec[spec_len] = 0;
+
+            for (unsigned d = 0; d < stored_length; ++d)
+              {
+                uint64_t raw = 0;
+                if (!read_arg (args, &raw, stored_size))
+                  return;
+                if (d >= vector_length)
+                  continue;
+                if (d != 0)
+                  output_append (out, ",", 1);
+
+                if (elem_size < 8)
+                  raw &= (1ULL << (elem_size * 8)) - 1;
+                long long val = (long long)raw;
+                if (is_signed && elem_size < 8
+                    && (raw >> (elem_size * 8 - 1)) != 0)
+                  val = (long long)(raw | ~((1ULL << (elem_size * 8)) - 1));
+                output_format (out, spec, width, precision, val);
+              }
+            break;
+          }
+
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+          {
+            unsigned elem_size;
+            if (length == 2)
+              goto error; /* half is not yet implemented */
+            if (vector_length == 1)
+              elem_size = (record_flags & RECORD_FLAG_FLOAT_ARGS) ? 4 : 8;
+            else
+              elem_size = length;
+            spec[spec_len++] = ch;
+            spec[spec_len] = 0;
+
+            for (unsigned d = 0; d < stored_length; ++d)
+              {
+                double val;
+                if (elem_size == 4)
+                  {
+                    float f;
+                    if (!read_arg (args, &f, sizeof (f)))
+                      return;
+                    val = f;
+                  }
+                else if (!read_arg (args, &val, sizeof (val)))
+                  return;
+                if (d >= vector_length)
+                  continue;
+                if (d != 0)
+                  output_append (out, ",", 1);
+
+                /* NaNs are printed always positive */
+                if (isnan (val))
+                  val = fabs (val);
+                output_format (out, spec, width, precision, val);
+              }
+            break;
+          }
+
+        case 'c':
+          {
+            if (always_sign || space || alt || zero || precision >= 0
+                || vector_length != 1 || length != 0)
+              {
+                errcode = ERROR_FLAGS_WITH_C_CONVERSION_SPECIFIER;
+                goto error;
+              }
+            int val;
+            if (!read_arg (args, &val, sizeof (val)))
+              return;
+            output_format (out, align_left ? "%-*c" : "%*c", width,
+                           (unsigned char)val);
+            break;
+          }
+
+        case 's':
+          {
+            if (always_sign || space || alt || zero)
+              {
+                errcode = ERROR_FLAGS_WITH_S_CONVERSION_SPECIFIER;
+                goto error;
+              }
+            if (vector_length != 1)
+              {
+                errcode = ERROR_VECTOR_LENGTH_WITH_S_CONVERSION_SPECIFIER;
+                goto error;
+              }
+            if (length != 0)
+              {
+                errcode = ERROR_LENGTH_MODIFIER_WITH_S_CONVERSION_SPECIFIER;
+                goto error;
+              }
+            uint32_t len;
+            const char *str = "(null)";
+            if (!read_arg (args, &len, sizeof (len)))
+              return;
+            if (len == RECORD_NULL_STRING)
+              len = 6;
+            else
+              {
+                if ((size_t)(args->end - args->pos) < len)
+                  return;
+                str = args->pos;
+                args->pos += len;
+              }
+            if (precision < 0 || (uint32_t)precision > len)
+              precision = len;
+            output_format (out, align_left ? "%-*.*s" : "%*.*s", width,
+                           precision, str);
+            break;
+          }
+
+        case 'p':
+          {
+            if (always_sign || space || alt || zero)
+              {
+                errcode = ERROR_FLAGS_WITH_P_CONVERSION_SPECIFIER;
+                goto error;
+              }
+            if (precision >= 0)
+              {
+                errcode = ERROR_PRECISION_WITH_P_CONVERSION_SPECIFIER;
+                goto error;
+              }
+            if (vector_length != 1)
+              {
+                errcode = ERROR_VECTOR_LENGTH_WITH_P_CONVERSION_SPECIFIER;
+                goto error;
+              }
+            if (length != 0)
+              {
+                errcode = ERROR_LENGTH_MODIFIER_WITH_P_CONVERSION_SPECIFIER;
+                goto error;
+              }
+            uint64_t val;
+            char hex[24];
+            if (!read_arg (args, &val, sizeof (val)))
+              return;
+            snprintf (hex, sizeof (hex), "0x%llx", (unsigned long long)val);
+            output_format (out, align_left ? "%-*s" : "%*s", width, hex);
+            break;
+          }
+
+        default:
+          errcode = ERROR_UNKNOWN_CONVERSION_SPECIFIER;
+          goto error;
+        }
+    }
+  return;
+
+error:;
+  char code[3] = { '0' + (char)(errcode >> 4), '0' + (char)(errcode & 7),
+                   '\n' };
+  output_append (out, ERROR_STRING, strlen (ERROR_STRING));
+  output_append (out, code, sizeof (code));
+}
+
+void
+pocl_write_printf_buffer (cl_device_id device, const char *buffer,
+                          uint32_t size)
+{
+  if (!device->deferred_printf)
+    {
+      write (STDOUT_FILENO, buffer, size);
+      return;
+    }
+
+  output_t out;
+  out.pos = 0;
+  uint32_t pos = 0;
+  while (size - pos >= RECORD_HEADER_SIZE)
+    {
+      uint32_t record_size, record_flags;
+      uint64_t format;
+      memcpy (&record_size, buffer + pos, sizeof (uint32_t));
+      memcpy (&record_flags, buffer + pos + 4, sizeof (uint32_t));
+      memcpy (&format, buffer + pos + 8, sizeof (uint64_t));
+      if (record_size < RECORD_HEADER_SIZE || record_size > size - pos)
+        break;
+
+      record_args_t args;
+      args.pos = buffer + pos + RECORD_HEADER_SIZE;
+      args.end = buffer + pos + record_size;
+      format_record (&out, (const char *)(uintptr_t)format, record_flags,
+                     &args);
+      pos += record_size;
+    }
+  output_flush (&out);
+}
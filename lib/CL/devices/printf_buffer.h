@@ -0,0 +1,47 @@
+/* printf_buffer.h - writing out the printf buffers of the CPU devices
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#ifndef POCL_PRINTF_BUFFER_H
+#define POCL_PRINTF_BUFFER_H
+
+#include "pocl_cl.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Writes the first 'size' bytes of a printf buffer filled by the kernels
+ * to stdout. With device->deferred_printf the buffer holds binary records
+ * written by __pocl_printf_deferred(), which are formatted here. Must be
+ * called while the kernel's program is still loaded, since the records
+ * refer to its format strings. */
+POCL_EXPORT
+void pocl_write_printf_buffer (cl_device_id device, const char *buffer,
+                               uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* POCL_PRINTF_BUFFER_H */
@@ -42,6 +42,26 @@ void pthread_scheduler_uninit (cl_device_id device);
 /* Gives ready-to-execute command for scheduler */
 void pthread_scheduler_push_command (_cl_command_node *cmd);
 
+/* Polls done(arg) for the time configured with POCL_CPU_WAIT_SPIN_US and
+ * POCL_CPU_WAIT_YIELD_US. Returns nonzero if it returned nonzero, in which
+ * case the caller can skip blocking on its condition variable. */
+int pthread_scheduler_spin_wait (int (*done) (void *), void *arg);
+
+/* With POCL_CPU_INLINE_EXEC, runs the ready commands of the in-order queue
+ * cq on the calling thread until done(arg) returns nonzero or there is
+ * nothing left to run. */
+void pthread_scheduler_run_inline (cl_command_queue cq,
+                                   int (*done) (void *), void *arg);
+
+/* Calls func(arg, begin, end) for consecutive ranges of at most chunk of
+ * the num_items items, on the calling thread and the idle worker threads,
+ * and returns when all of them have been processed. For splitting large
+ * host-side operations of a command across the worker pool. */
+void pthread_scheduler_parallel_for (size_t num_items, size_t chunk,
+                                     void (*func) (void *arg, size_t begin,
+                                                   size_t end),
+                                     void *arg);
+
 #ifdef __GNUC__
 #pragma GCC visibility pop
 #endif
@@ -59,10 +59,15 @@ struct event_data {
 };
 
 
+/* the basic driver's operations, which the image operations below call
+   for the parts of the commands they split */
+static struct pocl_device_ops basic_ops;
+
 void
 pocl_pthread_init_device_ops(struct pocl_device_ops *ops)
 {
   pocl_basic_init_device_ops(ops);
+  pocl_basic_init_device_ops (&basic_ops);
 
   ops->device_name = "cpu";
 
@@ -85,6 +90,19 @@ pocl_pthread_init_device_ops(struct pocl_device_ops *ops)
 
   ops->init_queue = pocl_pthread_init_queue;
   ops->free_queue = pocl_pthread_free_queue;
+
+  ops->read = pocl_pthread_read;
+  ops->read_rect = pocl_pthread_read_rect;
+  ops->write = pocl_pthread_write;
+  ops->write_rect = pocl_pthread_write_rect;
+  ops->copy = pocl_pthread_copy;
+  ops->copy_rect = pocl_pthread_copy_rect;
+  ops->memfill = pocl_pthread_memfill;
+
+  ops->copy_image_rect = pocl_pthread_copy_image_rect;
+  ops->write_image_rect = pocl_pthread_write_image_rect;
+  ops->read_image_rect = pocl_pthread_read_image_rect;
+  ops->fill_image = pocl_pthread_fill_image;
 }
 
 unsigned int
@@ -115,6 +133,13 @@ static int scheduler_initialized = 0;
 static cl_bool pthread_available = CL_TRUE;
 static cl_bool pthread_unavailable = CL_FALSE;
 
+/* The data of a pthread device, shared with its sub-devices. */
+typedef struct pthread_device_data
+{
+  /* see pocl_cpu_streaming_store_bytes () */
+  size_t streaming_store_bytes;
+} pthread_device_data;
+
 cl_int
 pocl_pthread_init (unsigned j, cl_device_id device, const char* parameters)
 {
@@ -122,11 +147,20 @@ pocl_pthread_init (unsigned j, cl_device_id device, const char* parameters)
 
   device->data = NULL;
   device->available = &pthread_unavailable;
+  /* the event condition variable only serves pocl_pthread_wait_event () */
+  device->skip_implicit_event_notify = 1;
 
   cl_int ret = pocl_cpu_init_common (device);
   if (ret != CL_SUCCESS)
     return ret;
 
+  pthread_device_data *d
+      = (pthread_device_data *)calloc (1, sizeof (pthread_device_data));
+  if (d == NULL)
+    return CL_OUT_OF_HOST_MEMORY;
+  d->streaming_store_bytes = pocl_cpu_streaming_store_bytes (device);
+  device->data = d;
+
   pocl_init_dlhandle_cache ();
   pocl_init_kernel_run_command_manager ();
 
@@ -215,9 +249,17 @@ pocl_pthread_flush(cl_device_id device, cl_command_queue cq)
 
 }
 
+static int
+pocl_pthread_cq_finished (void *cq)
+{
+  return POCL_ATOMIC_LOAD (((cl_command_queue)cq)->command_count) == 0;
+}
+
 void
 pocl_pthread_join(cl_device_id device, cl_command_queue cq)
 {
+  pthread_scheduler_run_inline (cq, pocl_pthread_cq_finished, cq);
+  pthread_scheduler_spin_wait (pocl_pthread_cq_finished, cq);
   POCL_LOCK_OBJ (cq);
   pthread_cond_t *cq_cond = (pthread_cond_t *)cq->data;
   while (1)
@@ -283,6 +325,9 @@ void
 pocl_pthread_update_event (cl_device_id device, cl_event event)
 {
   struct event_data *e_d = NULL;
+  /* see skip_implicit_event_notify */
+  if (event->implicit_event)
+    return;
   if (event->data == NULL && event->status == CL_QUEUED)
     {
       e_d = malloc(sizeof(struct event_data));
@@ -295,10 +340,20 @@ pocl_pthread_update_event (cl_device_id device, cl_event event)
     }
 }
 
+static int
+pocl_pthread_event_complete (void *event)
+{
+  return POCL_ATOMIC_LOAD (((cl_event)event)->status) <= CL_COMPLETE;
+}
+
 void pocl_pthread_wait_event (cl_device_id device, cl_event event)
 {
   struct event_data *e_d = event->data;
 
+  if (event->queue != NULL)
+    pthread_scheduler_run_inline (event->queue, pocl_pthread_event_complete,
+                                  event);
+  pthread_scheduler_spin_wait (pocl_pthread_event_complete, event);
   POCL_LOCK_OBJ (event);
   while (event->status > CL_COMPLETE)
     {
@@ -310,7 +365,10 @@ void pocl_pthread_wait_event (cl_device_id device, cl_event event)
 
 void pocl_pthread_free_event_data (cl_event event)
 {
-  assert(event->data != NULL);
+  if (event->data == NULL)
+    return;
+  struct event_data *e_d = event->data;
+  PTHREAD_CHECK (pthread_cond_destroy (&e_d->event_cond));
   free(event->data);
   event->data = NULL;
 }
@@ -338,3 +396,311 @@ pocl_pthread_free_queue (cl_device_id device, cl_command_queue queue)
   POCL_MEM_FREE (queue->data);
   return CL_SUCCESS;
 }
+
+/* The buffer commands split large copies and fills across the worker
+   threads, see pocl_cpu_memcpy(). */
+static size_t
+stream_bytes (void *data)
+{
+  return ((pthread_device_data *)data)->streaming_store_bytes;
+}
+
+void
+pocl_pthread_read (void *data, void *__restrict__ host_ptr,
+                   pocl_mem_identifier *src_mem_id, cl_mem src_buf,
+                   size_t offset, size_t size)
+{
+  pocl_cpu_memcpy (pthread_scheduler_parallel_for, stream_bytes (data),
+                   host_ptr, (char *)src_mem_id->mem_ptr + offset, size);
+}
+
+void
+pocl_pthread_write (void *data, const void *__restrict__ host_ptr,
+                    pocl_mem_identifier *dst_mem_id, cl_mem dst_buf,
+                    size_t offset, size_t size)
+{
+  pocl_cpu_memcpy (pthread_scheduler_parallel_for, stream_bytes (data),
+                   (char *)dst_mem_id->mem_ptr + offset, host_ptr, size);
+}
+
+void
+pocl_pthread_copy (void *data, pocl_mem_identifier *dst_mem_id,
+                   cl_mem dst_buf, pocl_mem_identifier *src_mem_id,
+                   cl_mem src_buf, size_t dst_offset, size_t src_offset,
+                   size_t size)
+{
+  pocl_cpu_memcpy (pthread_scheduler_parallel_for, stream_bytes (data),
+                   (char *)dst_mem_id->mem_ptr + dst_offset,
+                   (char *)src_mem_id->mem_ptr + src_offset, size);
+}
+
+void
+pocl_pthread_read_rect (void *data, void *__restrict__ host_ptr,
+                        pocl_mem_identifier *src_mem_id, cl_mem src_buf,
+                        const size_t *buffer_origin,
+                        const size_t *host_origin, const size_t *region,
+                        size_t buffer_row_pitch, size_t buffer_slice_pitch,
+                        size_t host_row_pitch, size_t host_slice_pitch)
+{
+  pocl_cpu_memcpy_rect (pthread_scheduler_parallel_for, stream_bytes (data),
+                        host_ptr, src_mem_id->mem_ptr, host_origin,
+                        buffer_origin, region, host_row_pitch,
+                        host_slice_pitch, buffer_row_pitch,
+                        buffer_slice_pitch);
+}
+
+void
+pocl_pthread_write_rect (void *data, const void *__restrict__ host_ptr,
+                         pocl_mem_identifier *dst_mem_id, cl_mem dst_buf,
+                         const size_t *buffer_origin,
+                         const size_t *host_origin, const size_t *region,
+                         size_t buffer_row_pitch, size_t buffer_slice_pitch,
+                         size_t host_row_pitch, size_t host_slice_pitch)
+{
+  pocl_cpu_memcpy_rect (pthread_scheduler_parallel_for, stream_bytes (data),
+                        dst_mem_id->mem_ptr, host_ptr, buffer_origin,
+                        host_origin, region, buffer_row_pitch,
+                        buffer_slice_pitch, host_row_pitch, host_slice_pitch);
+}
+
+void
+pocl_pthread_copy_rect (void *data, pocl_mem_identifier *dst_mem_id,
+                        cl_mem dst_buf, pocl_mem_identifier *src_mem_id,
+                        cl_mem src_buf, const size_t *dst_origin,
+                        const size_t *src_origin, const size_t *region,
+                        size_t dst_row_pitch, size_t dst_slice_pitch,
+                        size_t src_row_pitch, size_t src_slice_pitch)
+{
+  pocl_cpu_memcpy_rect (pthread_scheduler_parallel_for, stream_bytes (data),
+                        dst_mem_id->mem_ptr, src_mem_id->mem_ptr, dst_origin,
+                        src_origin, region, dst_row_pitch, dst_slice_pitch,
+                        src_row_pitch, src_slice_pitch);
+}
+
+void
+pocl_pthread_memfill (void *data, pocl_mem_identifier *dst_mem_id,
+                      cl_mem dst_buf, size_t size, size_t offset,
+                      const void *__restrict__ pattern, size_t pattern_size)
+{
+  pocl_cpu_memfill (pthread_scheduler_parallel_for, stream_bytes (data),
+                    dst_mem_id->mem_ptr, offset, size, pattern, pattern_size);
+}
+
+/* Image commands moving at least this many bytes are split into slabs of
+   slices or rows, which are processed by the worker threads in parallel. */
+#define POCL_PTHREAD_PARALLEL_IMAGE_BYTES (1 << 20)
+/* minimum size of the slab a thread processes at a time */
+#define POCL_PTHREAD_IMAGE_SLAB_BYTES (1 << 18)
+
+/* the arguments of an image command, see image_slab () */
+typedef struct
+{
+  cl_command_type type;
+  void *data;
+  cl_mem image;
+  pocl_mem_identifier *mem_id;
+  const size_t *origin;
+  const size_t *region;
+  /* the source of image copies */
+  cl_mem src_image;
+  pocl_mem_identifier *src_mem_id;
+  const size_t *src_origin;
+  /* the host side of reads and writes */
+  char *host_ptr;
+  pocl_mem_identifier *host_mem_id;
+  size_t row_pitch;
+  size_t slice_pitch;
+  size_t offset;
+  /* fills */
+  cl_uint4 orig_pixel;
+  char *fill_pixel;
+  size_t pixel_size;
+  /* the dimension the region is split along, 1 or 2 */
+  unsigned dim;
+} image_job;
+
+/* Executes the command for slices or rows [begin, end) of the region. */
+static void
+image_slab (void *arg, size_t begin, size_t end)
+{
+  image_job *job = (image_job *)arg;
+  unsigned d = job->dim;
+  size_t origin[3] = { job->origin[0], job->origin[1], job->origin[2] };
+  size_t region[3] = { job->region[0], job->region[1], job->region[2] };
+  origin[d] += begin;
+  region[d] = end - begin;
+  size_t host_offset
+      = job->offset + begin * (d == 2 ? job->slice_pitch : job->row_pitch);
+
+  switch (job->type)
+    {
+    case CL_COMMAND_COPY_IMAGE:
+      {
+        size_t src_origin[3]
+            = { job->src_origin[0], job->src_origin[1], job->src_origin[2] };
+        src_origin[d] += begin;
+        basic_ops.copy_image_rect (job->data, job->src_image, job->image,
+                                   job->src_mem_id, job->mem_id, src_origin,
+                                   origin, region);
+        break;
+      }
+    case CL_COMMAND_WRITE_IMAGE:
+      basic_ops.write_image_rect (job->data, job->image, job->mem_id,
+                                  job->host_ptr, job->host_mem_id, origin,
+                                  region, job->row_pitch, job->slice_pitch,
+                                  host_offset);
+      break;
+    case CL_COMMAND_READ_IMAGE:
+      basic_ops.read_image_rect (job->data, job->image, job->mem_id,
+                                 job->host_ptr, job->host_mem_id, origin,
+                                 region, job->row_pitch, job->slice_pitch,
+                                 host_offset);
+      break;
+    case CL_COMMAND_FILL_IMAGE:
+      basic_ops.fill_image (job->data, job->image, job->mem_id, origin,
+                            region, job->orig_pixel, job->fill_pixel,
+                            job->pixel_size);
+      break;
+    default:
+      assert (0 && "unexpected image command");
+    }
+}
+
+/* Splits the job's region along its outermost dimension larger than one if
+   it is large enough. Returns 0 if the job should run as a whole. */
+static int
+split_image_job (image_job *job, cl_mem image, size_t *num_items,
+                 size_t *chunk)
+{
+  size_t px = image->image_elem_size * image->image_channels;
+  size_t bytes = job->region[0] * job->region[1] * job->region[2] * px;
+  if (bytes < POCL_PTHREAD_PARALLEL_IMAGE_BYTES)
+    return 0;
+
+  job->dim = job->region[2] > 1 ? 2 : 1;
+  if (job->region[job->dim] < 2)
+    return 0;
+
+  /* the host pitches of reads and writes may be zero = tightly packed */
+  if (job->type == CL_COMMAND_WRITE_IMAGE
+      || job->type == CL_COMMAND_READ_IMAGE)
+    {
+      if (job->row_pitch == 0)
+        job->row_pitch = job->region[0] * px;
+      if (job->slice_pitch == 0)
+        job->slice_pitch = job->row_pitch * job->region[1];
+    }
+
+  size_t item_bytes = bytes / job->region[job->dim];
+  *num_items = job->region[job->dim];
+  *chunk = (POCL_PTHREAD_IMAGE_SLAB_BYTES + item_bytes - 1) / item_bytes;
+  return 1;
+}
+
+cl_int
+pocl_pthread_copy_image_rect (void *data, cl_mem src_image, cl_mem dst_image,
+                              pocl_mem_identifier *src_mem_id,
+                              pocl_mem_identifier *dst_mem_id,
+                              const size_t *src_origin,
+                              const size_t *dst_origin, const size_t *region)
+{
+  image_job job = { .type = CL_COMMAND_COPY_IMAGE,
+                    .data = data,
+                    .image = dst_image,
+                    .mem_id = dst_mem_id,
+                    .origin = dst_origin,
+                    .region = region,
+                    .src_image = src_image,
+                    .src_mem_id = src_mem_id,
+                    .src_origin = src_origin };
+  size_t num_items, chunk;
+  if (!split_image_job (&job, src_image, &num_items, &chunk))
+    return basic_ops.copy_image_rect (data, src_image, dst_image,
+                                      src_mem_id, dst_mem_id, src_origin,
+                                      dst_origin, region);
+  pthread_scheduler_parallel_for (num_items, chunk, image_slab, &job);
+  return CL_SUCCESS;
+}
+
+cl_int
+pocl_pthread_write_image_rect (void *data, cl_mem dst_image,
+                               pocl_mem_identifier *dst_mem_id,
+                               const void *__restrict__ src_host_ptr,
+                               pocl_mem_identifier *src_mem_id,
+                               const size_t *origin, const size_t *region,
+                               size_t src_row_pitch, size_t src_slice_pitch,
+                               size_t src_offset)
+{
+  image_job job = { .type = CL_COMMAND_WRITE_IMAGE,
+                    .data = data,
+                    .image = dst_image,
+                    .mem_id = dst_mem_id,
+                    .origin = origin,
+                    .region = region,
+                    .host_ptr = (char *)src_host_ptr,
+                    .host_mem_id = src_mem_id,
+                    .row_pitch = src_row_pitch,
+                    .slice_pitch = src_slice_pitch,
+                    .offset = src_offset };
+  size_t num_items, chunk;
+  if (!split_image_job (&job, dst_image, &num_items, &chunk))
+    return basic_ops.write_image_rect (data, dst_image, dst_mem_id,
+                                       src_host_ptr, src_mem_id, origin,
+                                       region, src_row_pitch,
+                                       src_slice_pitch, src_offset);
+  pthread_scheduler_parallel_for (num_items, chunk, image_slab, &job);
+  return CL_SUCCESS;
+}
+
+cl_int
+pocl_pthread_read_image_rect (void *data, cl_mem src_image,
+                              pocl_mem_identifier *src_mem_id,
+                              void *__restrict__ dst_host_ptr,
+                              pocl_mem_identifier *dst_mem_id,
+                              const size_t *origin, const size_t *region,
+                              size_t dst_row_pitch, size_t dst_slice_pitch,
+                              size_t dst_offset)
+{
+  image_job job = { .type = CL_COMMAND_READ_IMAGE,
+                    .data = data,
+                    .image = src_image,
+                    .mem_id = src_mem_id,
+                    .origin = origin,
+                    .region = region,
+                    .host_ptr = (char *)dst_host_ptr,
+                    .host_mem_id = dst_mem_id,
+                    .row_pitch = dst_row_pitch,
+                    .slice_pitch = dst_slice_pitch,
+                    .offset = dst_offset };
+  size_t num_items, chunk;
+  if (!split_image_job (&job, src_image, &num_items, &chunk))
+    return basic_ops.read_image_rect (data, src_image, src_mem_id,
+                                      dst_host_ptr, dst_mem_id, origin,
+                                      region, dst_row_pitch, dst_slice_pitch,
+                                      dst_offset);
+  pthread_scheduler_parallel_for (num_items, chunk, image_slab, &job);
+  return CL_SUCCESS;
+}
+
+cl_int
+pocl_pthread_fill_image (void *data, cl_mem image,
+                         pocl_mem_identifier *mem_id, const size_t *origin,
+                         const size_t *region, cl_uint4 orig_pixel,
+                         pixel_t fill_pixel, size_t pixel_size)
+{
+  image_job job = { .type = CL_COMMAND_FILL_IMAGE,
+                    .data = data,
+                    .image = image,
+                    .mem_id = mem_id,
+                    .origin = origin,
+                    .region = region,
+                    .orig_pixel = orig_pixel,
+                    .fill_pixel = fill_pixel,
+                    .pixel_size = pixel_size };
+  size_t num_items, chunk;
+  if (!split_image_job (&job, image, &num_items, &chunk))
+    return basic_ops.fill_image (data, image, mem_id, origin, region,
+                                 orig_pixel, fill_pixel, pixel_size);
+  pthread_scheduler_parallel_for (num_items, chunk, image_slab, &job);
+  return CL_SUCCESS;
+}
@@ -23,9 +23,7 @@
 
 #define _GNU_SOURCE
 
-#ifdef __linux__
 #include <sched.h>
-#endif
 
 #include <pthread.h>
 #include <string.h>
@@ -39,7 +37,9 @@
 #include "pocl-pthread_scheduler.h"
 #include "pocl_cl.h"
 #include "pocl_mem_management.h"
+#include "pocl_timing.h"
 #include "pocl_util.h"
+#include "printf_buffer.h"
 #include "utlist.h"
 
 #ifdef __APPLE__
@@ -66,6 +66,26 @@ struct pool_thread_data
   void *printf_buffer;
 } __attribute__ ((aligned (HOST_CPU_CACHELINE_SIZE)));
 
+/* A host-side operation split into items that the worker threads process
+   in chunks, see pthread_scheduler_parallel_for(). Lives on the stack of
+   the thread that started it. */
+typedef struct parallel_job
+{
+  void (*func) (void *arg, size_t begin, size_t end);
+  void *arg;
+  size_t num_items;
+  size_t chunk;
+  /* the next item to hand out, updated atomically */
+  size_t items_dealt;
+  /* number of worker threads helping with the job, protected by
+     wq_lock_fast */
+  unsigned ref_count;
+  /* signalled when ref_count drops to zero, waited on by the thread that
+     started the job */
+  pthread_cond_t finished;
+  struct parallel_job *prev, *next;
+} parallel_job;
+
 typedef struct scheduler_data_
 {
   pthread_cond_t wake_pool __attribute__ ((aligned (HOST_CPU_CACHELINE_SIZE)));
@@ -78,12 +98,28 @@ typedef struct scheduler_data_
   unsigned printf_buf_size;
   size_t local_mem_size;
 
+  /* how long waiting threads poll before blocking, see
+     pthread_scheduler_spin_wait() */
+  uint64_t wait_spin_ns;
+  uint64_t wait_yield_ns;
+
+  /* if set, the ready command with the highest priority is run first
+     instead of the oldest one, see cmd_runs_before() */
+  int priority_scheduling;
+
+  /* the state of a user thread executing commands in
+     pthread_scheduler_run_inline(), NULL if that is disabled. Only one user
+     thread at a time can use it, as guarded by caller_lock. */
+  struct pool_thread_data *caller_td;
+  pocl_lock_t caller_lock;
+
   int thread_pool_shutdown_requested;
   int worker_out_of_memory;
 
   struct pool_thread_data *thread_pool;
 #ifndef ENABLE_HOST_CPU_DEVICES_OPENMP
   kernel_run_command *kernel_queue;
+  parallel_job *job_queue;
 #endif
 
   pthread_barrier_t init_barrier
@@ -132,6 +168,35 @@ pthread_scheduler_init (cl_device_id device)
 
   scheduler.worker_out_of_memory = 0;
 
+  int spin_us = pocl_get_int_option ("POCL_CPU_WAIT_SPIN_US", 0);
+  int yield_us = pocl_get_int_option ("POCL_CPU_WAIT_YIELD_US", 0);
+  scheduler.wait_spin_ns = spin_us > 0 ? (uint64_t)spin_us * 1000 : 0;
+  scheduler.wait_yield_ns = yield_us > 0 ? (uint64_t)yield_us * 1000 : 0;
+
+  scheduler.priority_scheduling
+      = pocl_get_bool_option ("POCL_CPU_PRIORITY_SCHEDULING", 0);
+
+#ifndef ENABLE_HOST_CPU_DEVICES_OPENMP
+  if (pocl_get_bool_option ("POCL_CPU_INLINE_EXEC", 0))
+    {
+      struct pool_thread_data *td = pocl_aligned_malloc (
+          HOST_CPU_CACHELINE_SIZE, sizeof (struct pool_thread_data));
+      memset (td, 0, sizeof (struct pool_thread_data));
+      /* past the worker thread indices, so it won't run subdevice commands */
+      td->index = num_worker_threads;
+      td->num_threads = num_worker_threads;
+      td->current_ftz = 213;
+      td->printf_buffer = pocl_aligned_malloc (MAX_EXTENDED_ALIGNMENT,
+                                               scheduler.printf_buf_size);
+      td->local_mem = pocl_aligned_malloc (MAX_EXTENDED_ALIGNMENT,
+                                           scheduler.local_mem_size);
+      POCL_INIT_LOCK (scheduler.caller_lock);
+      scheduler.caller_td = td;
+      if (td->printf_buffer == NULL || td->local_mem == NULL)
+        POCL_ATOMIC_INC (scheduler.worker_out_of_memory);
+    }
+#endif
+
   for (i = 0; i < num_worker_threads; ++i)
     {
       scheduler.thread_pool[i].index = i;
@@ -172,6 +237,15 @@ pthread_scheduler_uninit (cl_device_id device)
   scheduler.thread_pool_shutdown_requested = 0;
   pocl_aligned_free (scheduler.thread_pool);
 
+  if (scheduler.caller_td != NULL)
+    {
+      pocl_aligned_free (scheduler.caller_td->printf_buffer);
+      pocl_aligned_free (scheduler.caller_td->local_mem);
+      pocl_aligned_free (scheduler.caller_td);
+      scheduler.caller_td = NULL;
+      POCL_DESTROY_LOCK (scheduler.caller_lock);
+    }
+
   POCL_FAST_DESTROY (scheduler.wq_lock_fast);
   POCL_DESTROY_COND (scheduler.wake_pool);
   PTHREAD_CHECK (pthread_barrier_destroy (&scheduler.init_barrier));
@@ -187,6 +261,121 @@ void pthread_scheduler_push_command (_cl_command_node *cmd)
   POCL_FAST_UNLOCK (scheduler.wq_lock_fast);
 }
 
+/* Number of polls between the clock reads while spinning. */
+#define POCL_SPIN_WAIT_POLLS 64
+
+/* Waits for short commands with a lower latency than the condition variables
+   allow: the futex wake-up round trip can be longer than the command itself.
+   First busy-polls with a pause in between, then polls yielding the CPU in
+   between, and gives up when the configured times have elapsed. */
+int
+pthread_scheduler_spin_wait (int (*done) (void *), void *arg)
+{
+  if (scheduler.wait_spin_ns == 0 && scheduler.wait_yield_ns == 0)
+    return 0;
+
+  uint64_t now = pocl_gettimemono_ns ();
+  uint64_t spin_end = now + scheduler.wait_spin_ns;
+  uint64_t yield_end = spin_end + scheduler.wait_yield_ns;
+
+  while (now < spin_end)
+    {
+      for (unsigned i = 0; i < POCL_SPIN_WAIT_POLLS; ++i)
+        {
+          if (done (arg))
+            return 1;
+          POCL_CPU_RELAX ();
+        }
+      now = pocl_gettimemono_ns ();
+    }
+
+  while (now < yield_end)
+    {
+      if (done (arg))
+        return 1;
+      sched_yield ();
+      now = pocl_gettimemono_ns ();
+    }
+
+  return done (arg);
+}
+
+#ifndef ENABLE_HOST_CPU_DEVICES_OPENMP
+/* Processes chunks of the job until all of its items have been handed out. */
+static void
+run_parallel_job (parallel_job *job)
+{
+  while (1)
+    {
+      size_t end = POCL_ATOMIC_ADD (job->items_dealt, job->chunk);
+      size_t begin = end - job->chunk;
+      if (begin >= job->num_items)
+        return;
+      job->func (job->arg, begin, min (end, job->num_items));
+    }
+}
+
+/* must be called with wq_lock_fast held */
+static parallel_job *
+check_job_queue (void)
+{
+  parallel_job *job;
+  DL_FOREACH (scheduler.job_queue, job)
+  {
+    if (POCL_ATOMIC_LOAD (job->items_dealt) < job->num_items)
+      return job;
+  }
+  return NULL;
+}
+#endif
+
+void
+pthread_scheduler_parallel_for (size_t num_items, size_t chunk,
+                                void (*func) (void *arg, size_t begin,
+                                              size_t end),
+                                void *arg)
+{
+  if (chunk == 0)
+    chunk = 1;
+
+#ifdef ENABLE_HOST_CPU_DEVICES_OPENMP
+  size_t i;
+#pragma omp parallel for schedule(dynamic)
+  for (i = 0; i < num_items; i += chunk)
+    func (arg, i, min (i + chunk, num_items));
+#else
+  if (num_items <= chunk || scheduler.num_threads < 2)
+    {
+      func (arg, 0, num_items);
+      return;
+    }
+
+  parallel_job job;
+  memset (&job, 0, sizeof (job));
+  job.func = func;
+  job.arg = arg;
+  job.num_items = num_items;
+  job.chunk = chunk;
+  POCL_INIT_COND (job.finished);
+
+  POCL_FAST_LOCK (scheduler.wq_lock_fast);
+  DL_APPEND (scheduler.job_queue, &job);
+  PTHREAD_CHECK (pthread_cond_broadcast (&scheduler.wake_pool));
+  POCL_FAST_UNLOCK (scheduler.wq_lock_fast);
+
+  run_parallel_job (&job);
+
+  /* all items have been handed out, wait for the chunks the other threads
+     are still processing */
+  POCL_FAST_LOCK (scheduler.wq_lock_fast);
+  DL_DELETE (scheduler.job_queue, &job);
+  while (job.ref_count > 0)
+    POCL_WAIT_COND (job.finished, scheduler.wq_lock_fast);
+  POCL_FAST_UNLOCK (scheduler.wq_lock_fast);
+  POCL_DESTROY_COND (job.finished);
+#endif
+}
+
 #ifndef ENABLE_HOST_CPU_DEVICES_OPENMP
 static void
 pthread_scheduler_push_kernel (kernel_run_command *run_cmd)
@@ -334,7 +523,8 @@ work_group_scheduler (kernel_run_command *k,
 
   if (position > 0)
     {
-      write (STDOUT_FILENO, pc.printf_buffer, position);
+      pocl_write_printf_buffer (k->device, (const char *)pc.printf_buffer,
+                                position);
     }
 
   pocl_free_kernel_arg_array_with_locals ((void **)&arguments, (void **)&arguments2,
@@ -365,16 +555,22 @@ work_group_scheduler (kernel_run_command *k,
                                         scheduler.local_mem_size);
     memcpy (&pc, &k->pc, sizeof (struct pocl_context));
 
-#ifndef ENABLE_PRINTF_IMMEDIATE_FLUSH
-    assert (pc.printf_buffer_capacity > 0);
-    pc.printf_buffer = malloc (pc.printf_buffer_capacity);
-    assert (pc.printf_buffer != NULL);
     uint32_t position = 0;
-    pc.printf_buffer_position = &position;
-#else
-    pc.printf_buffer = NULL;
-    pc.printf_buffer_position = NULL;
+#ifdef ENABLE_PRINTF_IMMEDIATE_FLUSH
+    /* the deferred printf records are always formatted afterwards */
+    if (!k->device->deferred_printf)
+      {
+        pc.printf_buffer = NULL;
+        pc.printf_buffer_position = NULL;
+      }
+    else
 #endif
+      {
+        assert (pc.printf_buffer_capacity > 0);
+        pc.printf_buffer = malloc (pc.printf_buffer_capacity);
+        assert (pc.printf_buffer != NULL);
+        pc.printf_buffer_position = &position;
+      }
 
     unsigned rm = pocl_save_rm ();
     pocl_set_default_rm ();
@@ -394,21 +590,18 @@ work_group_scheduler (kernel_run_command *k,
     pocl_restore_rm (rm);
     pocl_restore_ftz (ftz);
 
-#ifndef ENABLE_PRINTF_IMMEDIATE_FLUSH
     if (position > 0)
       {
-        write (STDOUT_FILENO, pc.printf_buffer, position);
+        pocl_write_printf_buffer (k->device, (const char *)pc.printf_buffer,
+                                  position);
         position = 0;
       }
-#endif
 
     pocl_free_kernel_arg_array_with_locals ((void **)&arguments,
                                        (void **)&arguments2, k);
 
     free (local_mem);
-#ifndef ENABLE_PRINTF_IMMEDIATE_FLUSH
     free (pc.printf_buffer);
-#endif
   } // #pragma omp parallel
 
   return 0;
@@ -428,6 +621,13 @@ finalize_kernel_command (struct pool_thread_data *thread_data,
 
   pocl_release_dlhandle_cache (k->cmd);
 
+  /* keep a running average of the kernel's run time for the scheduler */
+  pocl_kernel_metadata_t *meta = k->kernel->meta;
+  uint64_t run_time = pocl_gettimemono_ns () - k->start_time;
+  uint64_t est = POCL_ATOMIC_LOAD (meta->run_time_estimate_ns);
+  POCL_ATOMIC_STORE (meta->run_time_estimate_ns,
+                     est ? (est * 3 + run_time) / 4 : run_time);
+
   POCL_UPDATE_EVENT_COMPLETE_MSG (k->cmd->sync.event.event,
                                   "NDRange Kernel        ");
 
@@ -486,6 +686,7 @@ pocl_pthread_prepare_kernel (void *data, _cl_command_node *cmd)
   pocl_setup_kernel_arg_array (run_cmd);
 
   pocl_update_event_running (cmd->sync.event.event);
+  run_cmd->start_time = pocl_gettimemono_ns ();
 
 #ifndef ENABLE_HOST_CPU_DEVICES_OPENMP
   pthread_scheduler_push_kernel (run_cmd);
@@ -515,18 +716,37 @@ pocl_pthread_prepare_kernel (void *data, _cl_command_node *cmd)
   it's possible to workaround but it's cleaner to just check the whole queue.
  */
 
+/* Returns nonzero if the ready command a should be run before b: commands of
+   higher priority queues go first, then the ones heading a longer chain of
+   dependent commands, and otherwise the older one. */
+static int
+cmd_runs_before (_cl_command_node *a, _cl_command_node *b)
+{
+  cl_event ea = a->sync.event.event;
+  cl_event eb = b->sync.event.event;
+
+  if (!scheduler.priority_scheduling)
+    return 0;
+  if (ea->queue->priority != eb->queue->priority)
+    return ea->queue->priority < eb->queue->priority;
+  return POCL_ATOMIC_LOAD (ea->sched_path_ns)
+         > POCL_ATOMIC_LOAD (eb->sched_path_ns);
+}
+
 #ifdef ENABLE_HOST_CPU_DEVICES_OPENMP
 /* with OpenMP we don't support subdevices -> run every command */
 static _cl_command_node *
 check_cmd_queue_for_device (thread_data *td)
 {
-  _cl_command_node *cmd = scheduler.work_queue;
-  if (cmd)
+  _cl_command_node *cmd, *best = NULL;
+  DL_FOREACH (scheduler.work_queue, cmd)
   {
-    DL_DELETE (scheduler.work_queue, cmd);
-    return cmd;
+    if (best == NULL || cmd_runs_before (cmd, best))
+      best = cmd;
   }
-  return NULL;
+  if (best)
+    DL_DELETE (scheduler.work_queue, best);
+  return best;
 }
 
 #else
@@ -552,18 +772,22 @@ shall_we_run_this (thread_data *td, cl_device_id subd)
 static _cl_command_node *
 check_cmd_queue_for_device (thread_data *td)
 {
-  _cl_command_node *cmd;
+  _cl_command_node *cmd, *best = NULL;
   DL_FOREACH (scheduler.work_queue, cmd)
   {
     cl_device_id subd = cmd->device;
-    if (shall_we_run_this (td, subd))
+    if (shall_we_run_this (td, subd)
+        && (best == NULL || cmd_runs_before (cmd, best)))
       {
-        DL_DELETE (scheduler.work_queue, cmd);
-        return cmd;
+        best = cmd;
+        if (!scheduler.priority_scheduling)
+          break;
       }
   }
 
-  return NULL;
+  if (best)
+    DL_DELETE (scheduler.work_queue, best);
+  return best;
 }
 
 static kernel_run_command *
@@ -581,11 +805,25 @@ check_kernel_queue_for_device (thread_data *td)
 }
 #endif
 
+/* Checks without locking whether the worker threads have anything to do. */
+static int
+pthread_scheduler_has_work (void *arg)
+{
+  return POCL_ATOMIC_LOAD (scheduler.work_queue) != NULL
+#ifndef ENABLE_HOST_CPU_DEVICES_OPENMP
+         || POCL_ATOMIC_LOAD (scheduler.kernel_queue) != NULL
+         || POCL_ATOMIC_LOAD (scheduler.job_queue) != NULL
+#endif
+         || POCL_ATOMIC_LOAD (scheduler.thread_pool_shutdown_requested);
+}
+
 static int
 pthread_scheduler_get_work (thread_data *td)
 {
   _cl_command_node *cmd = NULL;
   kernel_run_command *run_cmd = NULL;
+  int ran_job = 0;
+  int spun = 0;
 
   /* execute kernel if available */
   POCL_FAST_LOCK (scheduler.wq_lock_fast);
@@ -595,6 +833,22 @@ RETRY:
   do_exit = scheduler.thread_pool_shutdown_requested;
 
 #ifndef ENABLE_HOST_CPU_DEVICES_OPENMP
+  /* help with the host-side jobs of the commands being executed first,
+     their threads are blocked until the jobs finish */
+  parallel_job *job = check_job_queue ();
+  ran_job = (job != NULL);
+  if (job)
+    {
+      ++job->ref_count;
+      POCL_FAST_UNLOCK (scheduler.wq_lock_fast);
+
+      run_parallel_job (job);
+
+      POCL_FAST_LOCK (scheduler.wq_lock_fast);
+      if ((--job->ref_count) == 0)
+        POCL_SIGNAL_COND (job->finished);
+    }
+
   run_cmd = check_kernel_queue_for_device (td);
   /* execute kernel if available */
   if (run_cmd)
@@ -642,9 +896,19 @@ RETRY:
       ++td->executed_commands;
     }
 
-  /* if neither a command nor a kernel was available, sleep */
-  if ((cmd == NULL) && (run_cmd == NULL) && (do_exit == 0))
+  /* if neither a command nor a kernel was available, poll for a while and
+     then sleep. The queues are rechecked under the lock after polling, as
+     the broadcasts are missed while not waiting on the condition. */
+  if ((cmd == NULL) && (run_cmd == NULL) && !ran_job && (do_exit == 0))
     {
+      if (!spun)
+        {
+          spun = 1;
+          POCL_FAST_UNLOCK (scheduler.wq_lock_fast);
+          pthread_scheduler_spin_wait (pthread_scheduler_has_work, NULL);
+          POCL_FAST_LOCK (scheduler.wq_lock_fast);
+          goto RETRY;
+        }
       PTHREAD_CHECK (
           pthread_cond_wait (&scheduler.wake_pool, &scheduler.wq_lock_fast));
       goto RETRY;
@@ -656,6 +920,108 @@ RETRY:
 }
 
 
+#ifndef ENABLE_HOST_CPU_DEVICES_OPENMP
+static kernel_run_command *
+find_kernel_of_queue (thread_data *td, cl_command_queue cq)
+{
+  kernel_run_command *cmd;
+  DL_FOREACH (scheduler.kernel_queue, cmd)
+  {
+    if (cmd->cmd->sync.event.event->queue == cq
+        && shall_we_run_this (td, cmd->device))
+      return cmd;
+  }
+  return NULL;
+}
+
+static _cl_command_node *
+take_command_of_queue (thread_data *td, cl_command_queue cq)
+{
+  _cl_command_node *cmd;
+  DL_FOREACH (scheduler.work_queue, cmd)
+  {
+    if (cmd->sync.event.event->queue == cq
+        && shall_we_run_this (td, cmd->device))
+      {
+        DL_DELETE (scheduler.work_queue, cmd);
+        return cmd;
+      }
+  }
+  return NULL;
+}
+#endif
+
+/* Runs the ready commands of the in-order queue cq on the calling thread
+   until done(arg) returns nonzero or there's nothing left to run, instead of
+   waiting for the worker threads to pick them up. The calling thread also
+   executes work-groups of the queue's kernels along with the workers. */
+void
+pthread_scheduler_run_inline (cl_command_queue cq, int (*done) (void *),
+                              void *arg)
+{
+#ifndef ENABLE_HOST_CPU_DEVICES_OPENMP
+  thread_data *td = scheduler.caller_td;
+  if (td == NULL || (cq->properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE))
+    return;
+  /* another user thread is already executing commands */
+  if (POCL_TRYLOCK (scheduler.caller_lock) != 0)
+    return;
+
+  /* the kernels change the FP environment of the thread */
+  unsigned rm = pocl_save_rm ();
+  unsigned ftz = pocl_save_ftz ();
+
+  POCL_FAST_LOCK (scheduler.wq_lock_fast);
+  while (!done (arg))
+    {
+      kernel_run_command *run_cmd = find_kernel_of_queue (td, cq);
+      if (run_cmd)
+        {
+          ++run_cmd->ref_count;
+          POCL_FAST_UNLOCK (scheduler.wq_lock_fast);
+
+          int ran_wgs = work_group_scheduler (run_cmd, td);
+
+          POCL_FAST_LOCK (scheduler.wq_lock_fast);
+          if ((--run_cmd->ref_count) == 0)
+            {
+              POCL_FAST_UNLOCK (scheduler.wq_lock_fast);
+              finalize_kernel_command (td, run_cmd);
+              POCL_FAST_LOCK (scheduler.wq_lock_fast);
+            }
+          /* The last work-groups were taken by a worker which has not yet
+             removed the kernel from the queue. Nothing of the in-order queue
+             can run before the kernel finishes, so sleep in the normal wait
+             instead of polling the queue. */
+          if (!ran_wgs)
+            break;
+          continue;
+        }
+
+      _cl_command_node *cmd = take_command_of_queue (td, cq);
+      if (cmd == NULL)
+        break;
+      POCL_FAST_UNLOCK (scheduler.wq_lock_fast);
+
+      assert (pocl_command_is_ready (cmd->sync.event.event));
+      /* kernels are pushed to the kernel queue and picked up above */
+      if (cmd->type == CL_COMMAND_NDRANGE_KERNEL)
+        pocl_pthread_prepare_kernel (cmd->device->data, cmd);
+      else
+        pocl_exec_command (cmd);
+
+      POCL_FAST_LOCK (scheduler.wq_lock_fast);
+      ++td->executed_commands;
+    }
+  POCL_FAST_UNLOCK (scheduler.wq_lock_fast);
+
+  pocl_restore_rm (rm);
+  pocl_restore_ftz (ftz);
+  td->current_ftz = 213;
+  POCL_UNLOCK (scheduler.caller_lock);
+#endif
+}
+
 static
 void*
 pocl_pthread_driver_thread (void *p)
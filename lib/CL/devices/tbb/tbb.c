@@ -69,6 +69,14 @@ void pocl_tbb_init_device_ops(struct pocl_device_ops *ops) {
 
   ops->submit = pocl_tbb_submit;
   ops->notify = pocl_tbb_notify;
+
+  ops->read = pocl_tbb_read;
+  ops->read_rect = pocl_tbb_read_rect;
+  ops->write = pocl_tbb_write;
+  ops->write_rect = pocl_tbb_write_rect;
+  ops->copy = pocl_tbb_copy;
+  ops->copy_rect = pocl_tbb_copy_rect;
+  ops->memfill = pocl_tbb_memfill;
 }
 
 static int one_device_per_numa_node = CL_FALSE;
@@ -120,6 +128,7 @@ cl_int pocl_tbb_init(unsigned j, cl_device_id device, const char *parameters) {
 
   pocl_tbb_scheduler_data *dd = calloc (1, sizeof (pocl_tbb_scheduler_data));
   device->data = (void *)dd;
+  dd->streaming_store_bytes = pocl_cpu_streaming_store_bytes (device);
   tbb_init_arena (dd, one_device_per_numa_node);
 
   device->max_compute_units = tbb_get_num_threads (dd);
@@ -298,3 +307,90 @@ void pocl_tbb_notify(cl_device_id device, cl_event event, cl_event finished) {
     }
   return;
 }
+
+/* The buffer commands split large copies and fills across the threads of
+   the arena they are executed in, see pocl_cpu_memcpy(). */
+static size_t
+stream_bytes (void *data)
+{
+  return ((pocl_tbb_scheduler_data *)data)->streaming_store_bytes;
+}
+
+void
+pocl_tbb_read (void *data, void *__restrict__ host_ptr,
+               pocl_mem_identifier *src_mem_id, cl_mem src_buf,
+               size_t offset, size_t size)
+{
+  pocl_cpu_memcpy (tbb_parallel_for, stream_bytes (data), host_ptr,
+                   (char *)src_mem_id->mem_ptr + offset, size);
+}
+
+void
+pocl_tbb_write (void *data, const void *__restrict__ host_ptr,
+                pocl_mem_identifier *dst_mem_id, cl_mem dst_buf,
+                size_t offset, size_t size)
+{
+  pocl_cpu_memcpy (tbb_parallel_for, stream_bytes (data),
+                   (char *)dst_mem_id->mem_ptr + offset, host_ptr, size);
+}
+
+void
+pocl_tbb_copy (void *data, pocl_mem_identifier *dst_mem_id, cl_mem dst_buf,
+               pocl_mem_identifier *src_mem_id, cl_mem src_buf,
+               size_t dst_offset, size_t src_offset, size_t size)
+{
+  pocl_cpu_memcpy (tbb_parallel_for, stream_bytes (data),
+                   (char *)dst_mem_id->mem_ptr + dst_offset,
+                   (char *)src_mem_id->mem_ptr + src_offset, size);
+}
+
+void
+pocl_tbb_read_rect (void *data, void *__restrict__ host_ptr,
+                    pocl_mem_identifier *src_mem_id, cl_mem src_buf,
+                    const size_t *buffer_origin, const size_t *host_origin,
+                    const size_t *region, size_t buffer_row_pitch,
+                    size_t buffer_slice_pitch, size_t host_row_pitch,
+                    size_t host_slice_pitch)
+{
+  pocl_cpu_memcpy_rect (tbb_parallel_for, stream_bytes (data), host_ptr,
+                        src_mem_id->mem_ptr, host_origin, buffer_origin,
+                        region, host_row_pitch, host_slice_pitch,
+                        buffer_row_pitch, buffer_slice_pitch);
+}
+
+void
+pocl_tbb_write_rect (void *data, const void *__restrict__ host_ptr,
+                     pocl_mem_identifier *dst_mem_id, cl_mem dst_buf,
+                     const size_t *buffer_origin, const size_t *host_origin,
+                     const size_t *region, size_t buffer_row_pitch,
+                     size_t buffer_slice_pitch, size_t host_row_pitch,
+                     size_t host_slice_pitch)
+{
+  pocl_cpu_memcpy_rect (tbb_parallel_for, stream_bytes (data),
+                        dst_mem_id->mem_ptr, host_ptr, buffer_origin,
+                        host_origin, region, buffer_row_pitch,
+                        buffer_slice_pitch, host_row_pitch, host_slice_pitch);
+}
+
+void
+pocl_tbb_copy_rect (void *data, pocl_mem_identifier *dst_mem_id,
+                    cl_mem dst_buf, pocl_mem_identifier *src_mem_id,
+                    cl_mem src_buf, const size_t *dst_origin,
+                    const size_t *src_origin, const size_t *region,
+                    size_t dst_row_pitch, size_t dst_slice_pitch,
+                    size_t src_row_pitch, size_t src_slice_pitch)
+{
+  pocl_cpu_memcpy_rect (tbb_parallel_for, stream_bytes (data),
+                        dst_mem_id->mem_ptr, src_mem_id->mem_ptr, dst_origin,
+                        src_origin, region, dst_row_pitch, dst_slice_pitch,
+                        src_row_pitch, src_slice_pitch);
+}
+
+void
+pocl_tbb_memfill (void *data, pocl_mem_identifier *dst_mem_id,
+                  cl_mem dst_buf, size_t size, size_t offset,
+                  const void *__restrict__ pattern, size_t pattern_size)
+{
+  pocl_cpu_memfill (tbb_parallel_for, stream_bytes (data),
+                    dst_mem_id->mem_ptr, offset, size, pattern, pattern_size);
+}
@@ -34,6 +34,7 @@
 // required for older versions of TBB
 #define TBB_PREVIEW_NUMA_SUPPORT 1
 
+#include <tbb/blocked_range.h>
 #include <tbb/blocked_range3d.h>
 #include <tbb/parallel_for.h>
 #include <tbb/partitioner.h>
@@ -47,6 +48,7 @@
 #include "pocl_mem_management.h"
 #include "pocl_runtime_config.h"
 #include "pocl_util.h"
+#include "printf_buffer.h"
 #include "tbb_scheduler.h"
 #include "utlist.h"
 
@@ -84,6 +86,15 @@ size_t tbb_get_num_threads(pocl_tbb_scheduler_data *SchedData) {
   TBBArena *TBBA = SchedData->tbb_arena;
   return TBBA->Arena.max_concurrency();
 }
+void tbb_parallel_for(size_t NumItems, size_t Chunk,
+                      void (*Func)(void *Arg, size_t Begin, size_t End),
+                      void *Arg) {
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, NumItems, Chunk),
+                    [Func, Arg](const tbb::blocked_range<size_t> &R) {
+                      Func(Arg, R.begin(), R.end());
+                    });
+}
+
 /* Internal functions */
 
 /* The sole purpose of this embedded class is to provide a function object that
@@ -111,18 +122,22 @@ public:
                                             SchedData->local_mem_size);
     memcpy(&PC, &K->pc, sizeof(struct pocl_context));
 
-#ifndef ENABLE_PRINTF_IMMEDIATE_FLUSH
-    // capacity and position already set up
-    PC.printf_buffer = PrintfBuffer;
     uint32_t Position = 0;
-    PC.printf_buffer_position = &Position;
-    assert(PC.printf_buffer != NULL);
-    assert(PC.printf_buffer_capacity > 0);
-    assert(PC.printf_buffer_position != NULL);
-#else
-    PC.printf_buffer = NULL;
-    PC.printf_buffer_position = NULL;
+#ifdef ENABLE_PRINTF_IMMEDIATE_FLUSH
+    // the deferred printf records are always formatted afterwards
+    if (!K->device->deferred_printf) {
+      PC.printf_buffer = NULL;
+      PC.printf_buffer_position = NULL;
+    } else
 #endif
+    {
+      // capacity and position already set up
+      PC.printf_buffer = PrintfBuffer;
+      PC.printf_buffer_position = &Position;
+      assert(PC.printf_buffer != NULL);
+      assert(PC.printf_buffer_capacity > 0);
+      assert(PC.printf_buffer_position != NULL);
+    }
 
     /* Flush to zero is only set once at the start of the kernel execution
      * because FTZ is a compilation option. */
@@ -140,11 +155,10 @@ public:
       }
     }
 
-#ifndef ENABLE_PRINTF_IMMEDIATE_FLUSH
     if (Position > 0) {
-      write(STDOUT_FILENO, PC.printf_buffer, Position);
+      pocl_write_printf_buffer(K->device, (const char *)PC.printf_buffer,
+                               Position);
     }
-#endif
 
     pocl_free_kernel_arg_array_with_locals((void **)&Arguments,
                                            (void **)&Arguments2, K);
@@ -63,6 +63,9 @@ extern "C"
     uchar *printf_buf_global_ptr;
     unsigned printf_buf_size;
 
+    /* see pocl_cpu_streaming_store_bytes () */
+    size_t streaming_store_bytes;
+
     unsigned grain_size;
     unsigned num_tbb_threads;
     pocl_tbb_partitioner selected_partitioner;
@@ -80,6 +83,11 @@ extern "C"
 
   void tbb_init_arena (pocl_tbb_scheduler_data *SchedData, int OnePerNode);
 
+  /* pocl_cpu_parallel_for_func for the commands executed in the arena */
+  void tbb_parallel_for (size_t num_items, size_t chunk,
+                         void (*func) (void *arg, size_t begin, size_t end),
+                         void *arg);
+
   void tbb_release_arena (pocl_tbb_scheduler_data *SchedData);
 
 #ifdef __cplusplus
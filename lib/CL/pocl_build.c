@@ -438,6 +438,11 @@ free_meta (cl_program program)
         }
       POCL_MEM_FREE (program->kernel_meta);
     }
+
+  for (i = 0; i < program->num_fused_kernels; i++)
+    pocl_free_fused_kernel_metadata (program, program->fused_kernel_meta[i]);
+  POCL_MEM_FREE (program->fused_kernel_meta);
+  program->num_fused_kernels = 0;
 }
 
 static void
@@ -163,6 +163,9 @@ pocl_hash_clipped_name (const char *str, size_t max_length, char *new_str)
    - if the global offset is zero (in all dimensions) or not
    - if the grid size in any dimension is smaller than a device
    specified limit ("smallgrid" specialization)
+   - the channel orders and data types of the image arguments and the
+   values of the sampler arguments
+   - the buffer arguments the stores to which may be non-temporal
 */
 void
 pocl_cache_kernel_cachedir_path (char *kernel_cachedir_path,
@@ -175,13 +178,22 @@ pocl_cache_kernel_cachedir_path (char *kernel_cachedir_path,
   char tempstring[POCL_MAX_PATHNAME_LENGTH];
   cl_device_id dev = command->device;
   size_t max_grid_width = pocl_cmd_max_grid_dim_width (run_cmd);
+  char image_key[POCL_IMAGE_ARG_KEY_LENGTH];
+  char streaming_store_key[POCL_STREAMING_STORE_KEY_LENGTH];
+  image_key[0] = 0;
+  streaming_store_key[0] = 0;
+  if (specialized)
+    {
+      pocl_cmd_image_arg_key (run_cmd, dev, image_key);
+      pocl_cmd_streaming_store_key (run_cmd, dev, streaming_store_key);
+    }
 
   char kernel_dir_name[POCL_MAX_DIRNAME_LENGTH + 1];
   pocl_hash_clipped_name (kernel->name, POCL_MAX_DIRNAME_LENGTH,
                           &kernel_dir_name[0]);
 
   bytes_written = snprintf (
-      tempstring, POCL_MAX_PATHNAME_LENGTH, "/%s/%zu-%zu-%zu%s%s%s",
+      tempstring, POCL_MAX_PATHNAME_LENGTH, "/%s/%zu-%zu-%zu%s%s%s%s%s%s%s",
       kernel_dir_name, !specialized ? 0 : run_cmd->pc.local_size[0],
       !specialized ? 0 : run_cmd->pc.local_size[1],
       !specialized ? 0 : run_cmd->pc.local_size[2],
@@ -194,7 +206,8 @@ pocl_cache_kernel_cachedir_path (char *kernel_cachedir_path,
               && max_grid_width < dev->grid_width_specialization_limit
           ? "-smallgrid"
           : "",
-      append_str);
+      image_key[0] ? "-img" : "", image_key,
+      streaming_store_key[0] ? "-nt" : "", streaming_store_key, append_str);
   assert (bytes_written > 0 && bytes_written < POCL_MAX_PATHNAME_LENGTH);
 
   program_device_dir (kernel_cachedir_path, program, program_device_i,
@@ -476,6 +489,18 @@ build_program_compute_hash (cl_program program, unsigned device_i,
         if (wg_method)
           pocl_SHA1_Update (&hash_ctx, (uint8_t *)wg_method,
                             strlen (wg_method));
+        /* printf() calls are lowered differently in the deferred mode */
+        if (device->deferred_printf)
+          pocl_SHA1_Update (&hash_ctx, (uint8_t *)"deferred_printf", 15);
+        /* math builtin calls are kept out of line for the vectorizer */
+        if (pocl_get_bool_option ("POCL_VECTORIZE_MATH_BUILTINS", 0))
+          pocl_SHA1_Update (&hash_ctx, (uint8_t *)"vector_math", 11);
+        /* the work-item loops get software prefetches */
+        int prefetch_distance
+            = pocl_get_int_option ("POCL_WI_PREFETCH_DISTANCE", 0);
+        if (prefetch_distance > 0)
+          pocl_SHA1_Update (&hash_ctx, (uint8_t *)&prefetch_distance,
+                            sizeof (prefetch_distance));
       }
 #endif
 
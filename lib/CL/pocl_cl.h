@@ -424,7 +424,9 @@ struct pocl_device_ops {
   /* Called from driver threads to notify every user thread waiting on
    * a specific event. See wait_event() for user counterpart.
    * Driver may chose to not implement this, which will result in
-   * undefined behaviour in multi-threaded user programs. */
+   * undefined behaviour in multi-threaded user programs.
+   * Not called for implicit events (those without a user handle) if the
+   * device sets skip_implicit_event_notify. */
   void (*notify_event_finished) (cl_event event);
 
   /* /New driver api extension */
@@ -854,6 +856,11 @@ struct _cl_device_id {
    * Currently the pthread/basic devices require this; other devices
    * implement printf their own way. */
   int device_side_printf;
+  /* with device_side_printf, printf() only stores the format string
+   * address and the raw argument bytes into the printf buffer, and
+   * the driver formats the records on the host after the work-groups
+   * have been executed (see pocl_write_printf_buffer). */
+  int deferred_printf;
   size_t max_work_item_sizes[3];
   size_t max_work_group_size;
   size_t preferred_wg_size_multiple;
@@ -878,6 +885,10 @@ struct _cl_device_id {
   cl_uint address_bits;
   cl_ulong max_mem_alloc_size;
   cl_bool image_support;
+  /* 2D and 3D images are stored tiled in the device memory; the tiling of
+   * an image is recorded to the 'extra' of its pocl_mem_identifier (see
+   * POCL_IMAGE_TILE_SHIFT). Only the CPU devices support this. */
+  int tiled_images;
   cl_uint max_read_image_args;
   cl_uint max_write_image_args;
   cl_uint max_read_write_image_args;
@@ -987,6 +998,16 @@ struct _cl_device_id {
    * the host's system time (pocl_gettimemono_ns). */
   int has_own_timer;
 
+  /* if nonzero, the events of this device complete only when ops->wait_event
+   * is called on them (it executes the commands in the calling thread), so
+   * clWaitForEvents() cannot wait for them passively. */
+  int wait_event_required;
+
+  /* if nonzero, notify_event_finished() only wakes up the threads blocked
+   * in wait_event(), so the driver keeps no wait state for implicit events
+   * and neither callback is called for them. */
+  int skip_implicit_event_notify;
+
   /* whether this device supports OpenGL / EGL interop */
   int has_gl_interop;
 
@@ -1298,6 +1319,8 @@ struct _cl_command_queue {
   cl_context context;
   cl_device_id device;
   cl_command_queue_properties properties;
+  /* CL_QUEUE_PRIORITY_KHR hint; HIGH < MED < LOW numerically */
+  cl_queue_priority_khr priority;
   /* implementation */
   cl_event events; /* events of the enqueued commands in enqueue order */
   struct _cl_event *barrier;
@@ -1435,6 +1458,8 @@ struct _cl_mem {
 
   cl_mem_properties properties[5];
   unsigned num_properties;
+  /* cl_mem_alloc_policy_pocl bits for allocating mem_host_ptr */
+  cl_bitfield alloc_policy;
 
   size_t size;
   /* for sub-buffers */
@@ -1540,6 +1565,33 @@ struct _cl_mem {
 
 typedef uint8_t SHA1_digest_t[SHA1_DIGEST_SIZE * 2 + 1];
 
+/* How a kernel accesses one of its pointer arguments. Filled in by the
+   kernel compiler for the kernel fusion legality checks. */
+#define POCL_FUSION_ARG_READ 1
+#define POCL_FUSION_ARG_WRITE 2
+/* Every access is to element get_global_id(0) of the argument. */
+#define POCL_FUSION_ARG_ELEMENTWISE 4
+
+typedef struct pocl_fusion_arg_info
+{
+  unsigned flags;
+  /* size of the accessed elements in bytes, if ELEMENTWISE is set */
+  unsigned elem_size;
+} pocl_fusion_arg_info;
+
+/* Describes a kernel created by fusing a producer kernel with the consumer
+   kernel launched right after it. The fused kernel takes the producer's
+   arguments followed by the consumer arguments which were not merged with
+   a producer argument. */
+typedef struct pocl_fused_kernel_info
+{
+  char *producer;
+  char *consumer;
+  cl_uint consumer_num_args;
+  /* index of each consumer argument in the fused kernel's argument list */
+  cl_uint *consumer_arg_map;
+} pocl_fused_kernel_info;
+
 typedef struct pocl_kernel_metadata_s
 {
   cl_uint num_args;
@@ -1587,6 +1639,13 @@ typedef struct pocl_kernel_metadata_s
 
   /* device-specific METAdata, void* array[program->num_devices] */
   void **data;
+
+  /* Set if this is a kernel created by kernel fusion, NULL otherwise. */
+  pocl_fused_kernel_info *fusion;
+
+  /* Running average of the kernel's execution time in nanoseconds, kept by
+     drivers which measure it. Zero if unknown. Used as a scheduling hint. */
+  uint64_t run_time_estimate_ns;
 } pocl_kernel_metadata_t;
 
 #define MAIN_PROGRAM_LOG_SIZE 6400
@@ -1636,6 +1695,11 @@ struct _cl_program {
   size_t num_kernels;
   pocl_kernel_metadata_t *kernel_meta;
 
+  /* Metadata of the kernels created by fusing kernels of this program.
+     These are not visible through the API. */
+  cl_uint num_fused_kernels;
+  pocl_kernel_metadata_t **fused_kernel_meta;
+
   /* list of attached cl_kernel instances */
   cl_kernel kernels;
   /* Per-device program hash after build */
@@ -1742,15 +1806,28 @@ struct event_node
   event_node *next;
 };
 
+/* A thread in clWaitForEvents() waiting for all of its events to complete,
+ * see pocl_wait_for_events(). */
+typedef struct pocl_event_waiter
+{
+  pocl_lock_t lock;
+  pocl_cond_t wakeup_cond;
+  /* number of the events yet to complete */
+  cl_uint remaining;
+} pocl_event_waiter;
+
+typedef struct pocl_event_waiter_node pocl_event_waiter_node;
+struct pocl_event_waiter_node
+{
+  pocl_event_waiter *waiter;
+  pocl_event_waiter_node *next;
+};
+
 #define MAX_EVENT_DEPS 60
 
 /* Optional metadata for events for improved profile data readability etc. */
 typedef struct _pocl_event_md
 {
-  /* The kernel executed by the NDRange command associated with the event,
-     if any. */
-  cl_kernel kernel;
-
   size_t num_deps;
   // event IDs on which this event depends
   uint64_t dep_ids[MAX_EVENT_DEPS];
@@ -1771,6 +1848,9 @@ struct _cl_event {
   /* list of callback functions */
   event_callback_item *callback_list;
 
+  /* threads waiting for the completion of this event */
+  pocl_event_waiter_node *waiters;
+
   /* list of devices needing completion notification of this event */
   event_node *notify_list;
   /* events this event is dependent on */
@@ -1786,6 +1866,12 @@ struct _cl_event {
   cl_ulong time_start;  /* the time the command actually started executing */
   cl_ulong time_end;    /* the finish time of the command */
 
+  /* Scheduling hints: the estimated run time of the command, and of the
+     longest chain of already enqueued commands depending on it, this one
+     included. See pocl_update_critical_path(). */
+  uint64_t sched_cost_ns;
+  uint64_t sched_path_ns;
+
   /* Device specific data */
   void *data;
 
@@ -1794,7 +1880,9 @@ struct _cl_event {
 
   /* The execution status of the command this event is monitoring. */
   cl_int status;
-  /* impicit event = an event for pocl's internal use, not visible to user */
+  /* impicit event = an event for pocl's internal use, not visible to user.
+   * They are allocated like the others, but on devices which set
+   * skip_implicit_event_notify the driver's wait callbacks are skipped. */
   short implicit_event;
   /* if set, at the completion of event, the mem_host_ptr_refcount should be
    * lowered and memory freed if it's 0 */
@@ -24,91 +24,350 @@
 
 #include "pocl_cq_profiling.h"
 #include "pocl_cl.h"
+#include "pocl_runtime_config.h"
+#include "pocl_timing.h"
 #include "pocl_util.h"
 
-/* for bzero */
-#include <strings.h>
+/* Number of distinct kernels, queues and command types tracked each. */
+#define POCL_CQ_PROFILING_MAX_ENTRIES 1024
+#define POCL_CQ_PROFILING_NAME_LEN 64
 
-/* Maximum number of events collected. */
-#define POCL_CQ_PROFILING_MAX_EVENTS 1000000
-#define POCL_CQ_PROFILING_MAX_KERNELS 1000
+/* The durations are counted in a log-linear histogram: each power of two
+   range is split in 2^HIST_SUB_BITS equally wide buckets, which bounds the
+   error of the reported percentiles to 1/2^(HIST_SUB_BITS+1) of the value. */
+#define HIST_SUB_BITS 3
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
 
 int pocl_cq_profiling_enabled = 0;
-static unsigned cq_events_collected = 0;
-static cl_event *profiled_cq_events = NULL;
 
-struct kernel_stats
+enum cq_stats_kind
 {
-  cl_kernel kernel;
-  unsigned long time;
-  unsigned long launches;
+  CQ_STATS_KERNEL,
+  CQ_STATS_QUEUE,
+  CQ_STATS_COMMAND,
+  CQ_STATS_KINDS
+};
+
+static const char *cq_stats_kind_names[CQ_STATS_KINDS]
+    = { "kernels", "queues", "commands" };
+
+struct cq_stats
+{
+  /* hash of the kernel name, queue id or command type */
+  uint64_t key;
+  char name[POCL_CQ_PROFILING_NAME_LEN];
+  uint64_t count;
+  uint64_t total;
+  uint64_t min;
+  uint64_t max;
+  uint32_t histogram[HIST_BUCKETS];
+};
+
+/* Open addressing hash tables, the entries are allocated on first use. */
+static struct cq_stats **cq_stats_tables[CQ_STATS_KINDS];
+static unsigned cq_stats_counts[CQ_STATS_KINDS];
+static uint64_t cq_stats_dropped = 0;
+static int cq_stats_closed = 0;
+static pocl_lock_t cq_stats_lock;
+
+/* Serializes the printouts and guards cq_stats_output. */
+static pocl_lock_t cq_stats_output_lock;
+static FILE *cq_stats_output = NULL;
+static int cq_stats_json = 0;
+static uint64_t cq_stats_interval_ns = 0;
+static uint64_t cq_stats_next_dump_ns = 0;
+
+static unsigned
+hist_bucket (uint64_t ns)
+{
+  if (ns < HIST_SUB_BUCKETS)
+    return (unsigned)ns;
+  unsigned msb = 63 - __builtin_clzll (ns);
+  unsigned sub = (ns >> (msb - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1);
+  return (msb - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS + sub;
+}
+
+static uint64_t
+hist_bucket_low (unsigned bucket)
+{
+  if (bucket < HIST_SUB_BUCKETS)
+    return bucket;
+  unsigned msb = bucket / HIST_SUB_BUCKETS + HIST_SUB_BITS - 1;
+  uint64_t sub = bucket % HIST_SUB_BUCKETS;
+  return (HIST_SUB_BUCKETS + sub) << (msb - HIST_SUB_BITS);
+}
+
+/* Returns the midpoint of the bucket holding the given percentile,
+   clamped to the observed range. */
+static uint64_t
+cq_stats_percentile (const struct cq_stats *st, unsigned percent)
+{
+  uint64_t target = (st->count * percent + 99) / 100;
+  uint64_t seen = 0;
+  unsigned b;
+  for (b = 0; b < HIST_BUCKETS; ++b)
+    {
+      seen += st->histogram[b];
+      if (seen >= target)
+        break;
+    }
+  if (b >= HIST_BUCKETS - 1)
+    return st->max;
+  uint64_t low = hist_bucket_low (b);
+  uint64_t mid = low + (hist_bucket_low (b + 1) - low) / 2;
+  if (mid < st->min)
+    return st->min;
+  if (mid > st->max)
+    return st->max;
+  return mid;
+}
+
+static uint64_t
+hash_name (const char *name)
+{
+  /* FNV-1a */
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (; *name; ++name)
+    h = (h ^ (unsigned char)*name) * 0x100000001b3ULL;
+  return h;
+}
+
+/* Finds or creates the entry for the key. Must be called with cq_stats_lock
+   held. Returns NULL if the table is full. */
+static struct cq_stats *
+cq_stats_lookup (enum cq_stats_kind kind, uint64_t key, const char *name)
+{
+  struct cq_stats **table = cq_stats_tables[kind];
+  unsigned i = (unsigned)(key ^ (key >> 32)) % POCL_CQ_PROFILING_MAX_ENTRIES;
+  unsigned probes;
+  for (probes = 0; probes < POCL_CQ_PROFILING_MAX_ENTRIES; ++probes)
+    {
+      struct cq_stats *st = table[i];
+      if (st == NULL)
+        break;
+      if (st->key == key
+          && (kind != CQ_STATS_KERNEL || strcmp (st->name, name) == 0))
+        return st;
+      i = (i + 1) % POCL_CQ_PROFILING_MAX_ENTRIES;
+    }
+  if (probes == POCL_CQ_PROFILING_MAX_ENTRIES)
+    return NULL;
+
+  struct cq_stats *st = (struct cq_stats *)calloc (1, sizeof (struct cq_stats));
+  if (st == NULL)
+    return NULL;
+  st->key = key;
+  st->min = UINT64_MAX;
+  strncpy (st->name, name, POCL_CQ_PROFILING_NAME_LEN - 1);
+  table[i] = st;
+  cq_stats_counts[kind]++;
+  return st;
+}
+
+static void
+cq_stats_add (enum cq_stats_kind kind, uint64_t key, const char *name,
+              uint64_t ns)
+{
+  struct cq_stats *st = cq_stats_lookup (kind, key, name);
+  if (st == NULL)
+    {
+      cq_stats_dropped++;
+      return;
+    }
+  st->count++;
+  st->total += ns;
+  if (ns < st->min)
+    st->min = ns;
+  if (ns > st->max)
+    st->max = ns;
+  st->histogram[hist_bucket (ns)]++;
+}
+
+/* A copy of the tables, printed without holding cq_stats_lock. */
+struct cq_stats_snapshot
+{
+  /* sorted by total time */
+  struct cq_stats *entries[CQ_STATS_KINDS];
+  unsigned counts[CQ_STATS_KINDS];
+  uint64_t total_time[CQ_STATS_KINDS];
+  uint64_t dropped;
 };
 
 static int
 order_by_time (const void *a, const void *b)
 {
-  if (((struct kernel_stats *)a)->time < ((struct kernel_stats *)b)->time)
+  const struct cq_stats *sa = (const struct cq_stats *)a;
+  const struct cq_stats *sb = (const struct cq_stats *)b;
+  if (sa->total < sb->total)
     return 1;
-  else if (((struct kernel_stats *)a)->time > ((struct kernel_stats *)b)->time)
+  else if (sa->total > sb->total)
     return -1;
   else
     return 0;
 }
 
+/* Copies the used entries of the tables. Must be called with cq_stats_lock
+   held. */
 static void
-pocl_atexit ()
+cq_stats_take_snapshot (struct cq_stats_snapshot *snap)
 {
-  unsigned long total_time = 0;
-  unsigned long total_commands = 0;
-  unsigned long different_kernels = 0;
+  snap->dropped = cq_stats_dropped;
+  for (unsigned kind = 0; kind < CQ_STATS_KINDS; ++kind)
+    {
+      unsigned n = 0;
+      snap->entries[kind] = (struct cq_stats *)malloc (
+          sizeof (struct cq_stats) * (cq_stats_counts[kind] + 1));
+      snap->total_time[kind] = 0;
+      if (snap->entries[kind] != NULL)
+        for (unsigned i = 0; i < POCL_CQ_PROFILING_MAX_ENTRIES; ++i)
+          {
+            struct cq_stats *st = cq_stats_tables[kind][i];
+            if (st == NULL)
+              continue;
+            snap->entries[kind][n++] = *st;
+            snap->total_time[kind] += st->total;
+          }
+      snap->counts[kind] = n;
+    }
+}
 
-  struct kernel_stats kernel_statistics[cq_events_collected];
-  bzero_s (&kernel_statistics, sizeof (kernel_statistics));
+static void
+cq_stats_free_snapshot (struct cq_stats_snapshot *snap)
+{
+  for (unsigned kind = 0; kind < CQ_STATS_KINDS; ++kind)
+    free (snap->entries[kind]);
+}
 
-  /* First statistics computation round. */
-  for (unsigned i = 0; i < cq_events_collected; ++i)
+static void
+cq_stats_print_text (FILE *f, const struct cq_stats_snapshot *snap,
+                     enum cq_stats_kind kind)
+{
+  static const char *headers[CQ_STATS_KINDS]
+      = { "kernel", "queue", "command" };
+  unsigned n = snap->counts[kind];
+  uint64_t total_time = snap->total_time[kind], total_count = 0;
+
+  fprintf (f, "\n");
+  fprintf (f, "     %-30s %10s %15s %4s %10s %10s %10s %10s %10s %10s\n",
+           headers[kind], "launches", "total us", "", "avg us", "min us",
+           "max us", "p50 us", "p95 us", "p99 us");
+  for (unsigned i = 0; i < n; ++i)
+    {
+      const struct cq_stats *st = &snap->entries[kind][i];
+      total_count += st->count;
+      fprintf (f,
+               "%3u) %-30s %10" PRIu64 " %15" PRIu64 " %3" PRIu64
+               "%% %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+               " %10" PRIu64 " %10" PRIu64 "\n",
+               i + 1, st->name, st->count, st->total / 1000,
+               st->total * 100 / (total_time + !total_time),
+               st->total / st->count / 1000, st->min / 1000, st->max / 1000,
+               cq_stats_percentile (st, 50) / 1000,
+               cq_stats_percentile (st, 95) / 1000,
+               cq_stats_percentile (st, 99) / 1000);
+    }
+  fprintf (f, "     %-30s %10s %15s %4s %10s\n", "", "==========",
+           "==========", "====", "==========");
+  /* Add !total_count to avoid a division by 0 if total_count is 0 */
+  fprintf (f, "     %-30s %10" PRIu64 " %15" PRIu64 " %4s %10" PRIu64 "\n",
+           "", total_count, total_time / 1000, "100%",
+           total_time / (total_count + !total_count) / 1000);
+}
+
+static void
+cq_stats_print_json_string (FILE *f, const char *str)
+{
+  fputc ('"', f);
+  for (; *str; ++str)
+    {
+      unsigned char c = (unsigned char)*str;
+      if (c == '"' || c == '\\')
+        fprintf (f, "\\%c", c);
+      else if (c < 0x20)
+        fprintf (f, "\\u%04x", c);
+      else
+        fputc (c, f);
+    }
+  fputc ('"', f);
+}
+
+/* Prints one JSON object per dump, on a single line. */
+static void
+cq_stats_print_json (FILE *f, const struct cq_stats_snapshot *snap,
+                     uint64_t now)
+{
+  fprintf (f, "{\"time_ns\":%" PRIu64 ",\"dropped\":%" PRIu64, now,
+           snap->dropped);
+  for (unsigned kind = 0; kind < CQ_STATS_KINDS; ++kind)
     {
-      cl_event e = profiled_cq_events[i];
-      cl_kernel kernel = e->meta_data->kernel;
-      unsigned long kernel_t = e->time_end - e->time_start;
-      total_time += kernel_t;
-      total_commands++;
-
-      unsigned k_i = 0;
-      while (k_i < different_kernels
-             && strcmp (kernel_statistics[k_i].kernel->name, kernel->name)
-                    != 0)
-        ++k_i;
-
-      if (kernel_statistics[k_i].kernel == NULL)
+      fprintf (f, ",\"%s\":[", cq_stats_kind_names[kind]);
+      for (unsigned i = 0; i < snap->counts[kind]; ++i)
         {
-          kernel_statistics[k_i].kernel = kernel;
-          different_kernels++;
+          const struct cq_stats *st = &snap->entries[kind][i];
+          fprintf (f, "%s{\"name\":", i ? "," : "");
+          cq_stats_print_json_string (f, st->name);
+          fprintf (f,
+                   ",\"count\":%" PRIu64 ",\"total_ns\":%" PRIu64
+                   ",\"avg_ns\":%" PRIu64 ",\"min_ns\":%" PRIu64
+                   ",\"max_ns\":%" PRIu64 ",\"p50_ns\":%" PRIu64
+                   ",\"p95_ns\":%" PRIu64 ",\"p99_ns\":%" PRIu64 "}",
+                   st->count, st->total, st->total / st->count, st->min,
+                   st->max, cq_stats_percentile (st, 50),
+                   cq_stats_percentile (st, 95),
+                   cq_stats_percentile (st, 99));
         }
-      kernel_statistics[k_i].time += kernel_t;
-      kernel_statistics[k_i].launches++;
+      fprintf (f, "]");
     }
+  fprintf (f, "}\n");
+}
 
-  printf ("\n");
-  printf ("     %-30s %10s %15s %3s  %10s\n", "kernel", "launches", "total us",
-          "", "avg us");
-  qsort (kernel_statistics, different_kernels, sizeof (struct kernel_stats),
-         order_by_time);
+/* Prints a snapshot taken at time now. Must be called with
+   cq_stats_output_lock held, and without cq_stats_lock so that the commands
+   finishing meanwhile are not held up. */
+static void
+cq_stats_dump (struct cq_stats_snapshot *snap, uint64_t now)
+{
+  FILE *f = cq_stats_output;
+  for (unsigned kind = 0; kind < CQ_STATS_KINDS; ++kind)
+    qsort (snap->entries[kind], snap->counts[kind], sizeof (struct cq_stats),
+           order_by_time);
 
-  for (unsigned long i = 0; i < different_kernels; ++i)
+  if (cq_stats_json)
+    cq_stats_print_json (f, snap, now);
+  else
     {
-      printf ("%3lu) %-30s %10lu %15lu %3lu%% %10lu\n", i + 1,
-              kernel_statistics[i].kernel->name, kernel_statistics[i].launches,
-              kernel_statistics[i].time,
-              kernel_statistics[i].time * 100 / total_time,
-              kernel_statistics[i].time / kernel_statistics[i].launches);
+      for (unsigned kind = 0; kind < CQ_STATS_KINDS; ++kind)
+        cq_stats_print_text (f, snap, kind);
+      if (snap->dropped > 0)
+        fprintf (f,
+                 "%" PRIu64 " commands were not counted in all tables, "
+                 "too many distinct kernels or queues\n",
+                 snap->dropped);
     }
-  printf ("     %-30s %10s %15s %3s %10s\n", "",
-          "==========", "==========", "====", "==========");
+  fflush (f);
+}
+
+static void
+pocl_atexit ()
+{
+  struct cq_stats_snapshot snap;
+  uint64_t now;
 
-  /* Add !total_commands to avoid a division by 0 if total_commands is 0 */
-  printf ("     %-30s %10lu %15lu %4s %10lu\n", "", total_commands, total_time,
-          "100%", total_time / (total_commands + !total_commands) );
+  POCL_LOCK (cq_stats_output_lock);
+  POCL_LOCK (cq_stats_lock);
+  now = pocl_gettimemono_ns ();
+  cq_stats_take_snapshot (&snap);
+  /* stops the collection */
+  cq_stats_closed = 1;
+  POCL_UNLOCK (cq_stats_lock);
+
+  cq_stats_dump (&snap, now);
+  cq_stats_free_snapshot (&snap);
+  if (cq_stats_output != stdout)
+    fclose (cq_stats_output);
+  cq_stats_output = NULL;
+  POCL_UNLOCK (cq_stats_output_lock);
 
   /* TODO: Critical path information of the task graph. */
 }
@@ -118,25 +377,90 @@ pocl_atexit ()
 void
 pocl_cq_profiling_init ()
 {
-  profiled_cq_events
-      = (cl_event *)malloc (sizeof (cl_event *) * POCL_CQ_PROFILING_MAX_EVENTS);
+  const char *output = pocl_get_string_option ("POCL_TRACING_OPT", NULL);
+  const char *format
+      = pocl_get_string_option ("POCL_CQ_PROFILING_FORMAT", "text");
+
+  cq_stats_output = stdout;
+  if (output != NULL)
+    {
+      cq_stats_output = fopen (output, "w");
+      if (cq_stats_output == NULL)
+        POCL_ABORT ("Failed to open the cq profiler output file\n");
+    }
+  cq_stats_json = (strcmp (format, "json") == 0);
+  cq_stats_interval_ns
+      = (uint64_t)pocl_get_int_option ("POCL_CQ_PROFILING_INTERVAL", 0)
+        * 1000000000ULL;
+  cq_stats_next_dump_ns = pocl_gettimemono_ns () + cq_stats_interval_ns;
+
+  for (unsigned kind = 0; kind < CQ_STATS_KINDS; ++kind)
+    cq_stats_tables[kind] = (struct cq_stats **)calloc (
+        POCL_CQ_PROFILING_MAX_ENTRIES, sizeof (struct cq_stats *));
+  POCL_INIT_LOCK (cq_stats_lock);
+  POCL_INIT_LOCK (cq_stats_output_lock);
   atexit (pocl_atexit);
   pocl_cq_profiling_enabled = 1;
 }
 
-/* Registers the event for profiling. Retains it to keep it alive until stats
-   have been collected.
-*/
+/* Adds the run time of a finished command to the statistics. */
 
 void
-pocl_cq_profiling_register_event (cl_event event)
+pocl_cq_profiling_event_updated (cl_event event, int status)
 {
-  POname(clRetainEvent) (event);
-  if (event->meta_data == NULL)
-    event->meta_data = (pocl_event_md *)calloc (1, sizeof (pocl_event_md));
+  char name[POCL_CQ_PROFILING_NAME_LEN];
+  if (status != CL_COMPLETE || event->command == NULL)
+    return;
 
-  unsigned cq_events_pos = POCL_ATOMIC_INC (cq_events_collected) - 1;
-  if (cq_events_pos >= POCL_CQ_PROFILING_MAX_EVENTS)
-    POCL_ABORT ("CQ profiler reached the limit on tracked events.");
-  profiled_cq_events[cq_events_pos] = event;
+  cl_command_queue cq = event->queue;
+  uint64_t ns = event->time_end > event->time_start
+                    ? event->time_end - event->time_start
+                    : 0;
+
+  POCL_LOCK (cq_stats_lock);
+  if (cq_stats_closed)
+    {
+      /* already dumped atexit() */
+      POCL_UNLOCK (cq_stats_lock);
+      return;
+    }
+
+  if (event->command_type == CL_COMMAND_NDRANGE_KERNEL
+      || event->command_type == CL_COMMAND_TASK)
+    {
+      const char *kname = event->command->command.run.kernel->name;
+      cq_stats_add (CQ_STATS_KERNEL, hash_name (kname), kname, ns);
+    }
+
+  snprintf (name, sizeof (name), "%" PRIu64 " (%s)", cq->id,
+            cq->device->short_name);
+  cq_stats_add (CQ_STATS_QUEUE, cq->id, name, ns);
+  cq_stats_add (CQ_STATS_COMMAND, event->command_type,
+                pocl_command_to_str (event->command_type), ns);
+
+  uint64_t now = 0;
+  if (cq_stats_interval_ns > 0)
+    {
+      now = pocl_gettimemono_ns ();
+      if (now >= cq_stats_next_dump_ns)
+        cq_stats_next_dump_ns = now + cq_stats_interval_ns;
+      else
+        now = 0;
+    }
+  POCL_UNLOCK (cq_stats_lock);
+
+  if (now > 0)
+    {
+      struct cq_stats_snapshot snap;
+      POCL_LOCK (cq_stats_output_lock);
+      if (cq_stats_output != NULL)
+        {
+          POCL_LOCK (cq_stats_lock);
+          cq_stats_take_snapshot (&snap);
+          POCL_UNLOCK (cq_stats_lock);
+          cq_stats_dump (&snap, now);
+          cq_stats_free_snapshot (&snap);
+        }
+      POCL_UNLOCK (cq_stats_output_lock);
+    }
 }
@@ -27,10 +27,10 @@
    profiling enabled) to the initialization (CQ creation time) with minimal impact
    at runtime. This is accomplished by enabling the basic profiling queue feature
    which is expected to be a minimally intrusive per-device specific way to
-   collect time stamps. The events with the profiling time stamps are just
-   accumulated until there is a "non-intrusive" spot to collect/analyze the data.
-   The default implementation just accumulates all the events and analyzes them
-   atexit() with a simple per kernel execution time printout.
+   collect time stamps. When a command finishes, its run time is only added
+   to fixed-size per-kernel, per-queue and per-command-type counters and
+   histograms, which are printed atexit() and optionally at a fixed interval,
+   so no events are retained and long-running programs are supported.
 
    One thing to keep in mind is that the command queue time stamps are per-device
    timer stamps, and there is no requirement (AFAIK) to have a synchronized
@@ -50,6 +50,6 @@
 extern int pocl_cq_profiling_enabled;
 
 void pocl_cq_profiling_init ();
-void pocl_cq_profiling_register_event (cl_event event);
+void pocl_cq_profiling_event_updated (cl_event event, int status);
 
 #endif
@@ -0,0 +1,624 @@
+/* pocl_kernel_fusion.c: fusion of consecutive NDRange commands recorded to
+   a command buffer
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+/* A producer kernel and the consumer kernel recorded right after it are
+ * replaced with a single kernel which runs the body of the producer followed
+ * by the body of the consumer in each work-item. This saves one launch and,
+ * more importantly, lets the intermediate values stay in registers or cache
+ * instead of making a round trip through memory between the launches.
+ *
+ * This is only legal if no work-item of the consumer reads data written by
+ * another work-item of the producer and vice versa. The kernel compiler
+ * analyzes the accesses of both kernels; the buffers shared by the kernels
+ * must be accessed only at element get_global_id(0) when either one writes
+ * to them. Thus only 1D launches with identical geometry are fused. */
+
+#include "pocl_cl.h"
+#include "pocl_mem_management.h"
+#include "pocl_shared.h"
+#include "pocl_util.h"
+
+#ifdef ENABLE_LLVM
+#include "common.h"
+#include "pocl_hash.h"
+#include "pocl_llvm.h"
+#endif
+
+#include <alloca.h>
+#include <assert.h>
+#include <string.h>
+
+#ifdef ENABLE_LLVM
+
+extern unsigned long kernel_c;
+
+/* Returns the buffer of a buffer argument, or NULL if the argument does not
+ * refer to a buffer. */
+static cl_mem
+arg_buffer (struct pocl_argument_info *ai, struct pocl_argument *a)
+{
+  if (ai->type != POCL_ARG_TYPE_POINTER || a->value == NULL)
+    return NULL;
+  return *(cl_mem *)a->value;
+}
+
+/* Checks the arguments of a kernel command are something the fused kernel
+ * can take as they are. */
+static int
+args_are_fusable (_cl_command_node *cmd)
+{
+  cl_kernel kernel = cmd->command.run.kernel;
+  if (kernel->indirect_raw_ptrs != NULL
+      || kernel->can_access_all_raw_buffers_indirectly)
+    return 0;
+
+  for (unsigned i = 0; i < kernel->meta->num_args; ++i)
+    {
+      struct pocl_argument_info *ai = &kernel->meta->arg_info[i];
+      struct pocl_argument *a = &cmd->command.run.arguments[i];
+      if (ai->type == POCL_ARG_TYPE_IMAGE || ai->type == POCL_ARG_TYPE_SAMPLER
+          || ai->type == POCL_ARG_TYPE_PIPE)
+        return 0;
+      if (ai->type == POCL_ARG_TYPE_POINTER
+          && (ARGP_IS_LOCAL (ai) || a->is_raw_ptr))
+        return 0;
+    }
+  return 1;
+}
+
+static int
+device_can_fuse (cl_program program, unsigned dev_i)
+{
+  cl_device_id dev = program->devices[dev_i];
+  return (dev->type & CL_DEVICE_TYPE_CPU) && dev->compiler_available
+         && dev->run_workgroup_pass && !dev->spmd
+         && dev->ops->compile_kernel != NULL
+         && program->binaries[dev_i] != NULL;
+}
+
+static int
+waits_on (_cl_command_node *cmd, cl_sync_point_khr sync_point)
+{
+  for (unsigned i = 0; i < cmd->sync.syncpoint.num_sync_points_in_wait_list;
+       ++i)
+    if (cmd->sync.syncpoint.sync_point_wait_list[i] == sync_point)
+      return 1;
+  return 0;
+}
+
+/* Computes the byte range [*start, *end) of the buffer ROOT the command
+ * CMD can access through the buffer argument I. Sub-buffers are stored as
+ * their parent buffer and the origin as the offset. An element-wise argument
+ * is accessed only at the global ids of the launch, anything else up to the
+ * end of the buffer. */
+static void
+arg_byte_range (_cl_command_node *cmd, pocl_fusion_arg_info *info, unsigned i,
+                cl_mem *root, uint64_t *start, uint64_t *end)
+{
+  struct pocl_argument *a = &cmd->command.run.arguments[i];
+  cl_mem mem = arg_buffer (&cmd->command.run.kernel->meta->arg_info[i], a);
+  uint64_t base = a->offset;
+  if (mem->parent != NULL)
+    {
+      base += mem->origin;
+      mem = mem->parent;
+    }
+  *root = mem;
+  *start = base;
+  *end = mem->size;
+
+  if (info[i].flags & POCL_FUSION_ARG_ELEMENTWISE)
+    {
+      struct pocl_context *pc = &cmd->command.run.pc;
+      uint64_t first = pc->global_offset[0];
+      uint64_t count = pc->local_size[0] * pc->num_groups[0];
+      *start = base + first * info[i].elem_size;
+      *end = base + (first + count) * info[i].elem_size;
+    }
+}
+
+/* Checks the accesses of the producer A and the consumer B to the buffers
+ * they share, and maps the arguments of B which refer to exactly the same
+ * buffer region as an argument of A to that argument. Any other overlap of
+ * the accessed regions prevents the fusion. The rest of the
+ * arguments of B are numbered after the arguments of A. Returns the number
+ * of arguments of the fused kernel, or 0 if the kernels cannot be fused. */
+static cl_uint
+map_consumer_args (_cl_command_node *a, pocl_fusion_arg_info *a_info,
+                   _cl_command_node *b, pocl_fusion_arg_info *b_info,
+                   cl_uint *arg_map)
+{
+  pocl_kernel_metadata_t *a_meta = a->command.run.kernel->meta;
+  pocl_kernel_metadata_t *b_meta = b->command.run.kernel->meta;
+  cl_uint num_args = a_meta->num_args;
+
+  for (unsigned j = 0; j < b_meta->num_args; ++j)
+    {
+      struct pocl_argument *bj = &b->command.run.arguments[j];
+      arg_map[j] = CL_UINT_MAX;
+      if (arg_buffer (&b_meta->arg_info[j], bj) == NULL)
+        {
+          arg_map[j] = num_args++;
+          continue;
+        }
+      cl_mem b_root;
+      uint64_t b_start, b_end;
+      arg_byte_range (b, b_info, j, &b_root, &b_start, &b_end);
+
+      for (unsigned i = 0; i < a_meta->num_args; ++i)
+        {
+          struct pocl_argument *ai = &a->command.run.arguments[i];
+          if (arg_buffer (&a_meta->arg_info[i], ai) == NULL)
+            continue;
+          cl_mem a_root;
+          uint64_t a_start, a_end;
+          arg_byte_range (a, a_info, i, &a_root, &a_start, &a_end);
+          if (a_root != b_root || a_end <= b_start || b_end <= a_start)
+            continue;
+
+          /* Partially overlapping arguments would alias in the fused
+           * kernel, which the argument analysis does not account for. */
+          if (ai->offset != bj->offset || a_start != b_start || a_end != b_end)
+            return 0;
+          if ((a_info[i].flags | b_info[j].flags) & POCL_FUSION_ARG_WRITE)
+            {
+              /* A work-item of the consumer must only see the data written
+               * by the same work-item of the producer. */
+              if (!(a_info[i].flags & POCL_FUSION_ARG_ELEMENTWISE)
+                  || !(b_info[j].flags & POCL_FUSION_ARG_ELEMENTWISE)
+                  || a_info[i].elem_size != b_info[j].elem_size)
+                return 0;
+            }
+          if (arg_map[j] == CL_UINT_MAX
+              && a_meta->arg_info[i].address_qualifier
+                     == b_meta->arg_info[j].address_qualifier)
+            arg_map[j] = i;
+        }
+
+      if (arg_map[j] == CL_UINT_MAX)
+        arg_map[j] = num_args++;
+    }
+  return num_args;
+}
+
+static void
+copy_arg_info (struct pocl_argument_info *dst, struct pocl_argument_info *src)
+{
+  memcpy (dst, src, sizeof (struct pocl_argument_info));
+  dst->name = src->name ? strdup (src->name) : NULL;
+  dst->type_name = src->type_name ? strdup (src->type_name) : NULL;
+}
+
+/* Creates the metadata of the kernel fusing the kernels of the commands A
+ * and B. */
+static pocl_kernel_metadata_t *
+create_fused_meta (cl_program program, const char *name, _cl_command_node *a,
+                   _cl_command_node *b, const cl_uint *arg_map,
+                   cl_uint num_args)
+{
+  pocl_kernel_metadata_t *a_meta = a->command.run.kernel->meta;
+  pocl_kernel_metadata_t *b_meta = b->command.run.kernel->meta;
+  unsigned num_devices = program->num_devices;
+
+  pocl_kernel_metadata_t *meta = calloc (1, sizeof (pocl_kernel_metadata_t));
+  if (meta == NULL)
+    return NULL;
+  meta->name = strdup (name);
+  meta->num_args = num_args;
+  meta->arg_info = calloc (num_args, sizeof (struct pocl_argument_info));
+  meta->has_arg_metadata = a_meta->has_arg_metadata & b_meta->has_arg_metadata;
+  memcpy (meta->reqd_wg_size, a_meta->reqd_wg_size,
+          sizeof (meta->reqd_wg_size));
+  memcpy (meta->wg_size_hint, a_meta->wg_size_hint,
+          sizeof (meta->wg_size_hint));
+  memcpy (meta->vectypehint, a_meta->vectypehint, sizeof (meta->vectypehint));
+
+  meta->max_subgroups = calloc (num_devices, sizeof (size_t));
+  meta->compile_subgroups = calloc (num_devices, sizeof (size_t));
+  meta->max_workgroup_size = calloc (num_devices, sizeof (size_t));
+  meta->preferred_wg_multiple = calloc (num_devices, sizeof (size_t));
+  meta->local_mem_size = calloc (num_devices, sizeof (cl_ulong));
+  meta->private_mem_size = calloc (num_devices, sizeof (cl_ulong));
+  meta->spill_mem_size = calloc (num_devices, sizeof (cl_ulong));
+  meta->build_hash = calloc (num_devices, sizeof (pocl_kernel_hash_t));
+  meta->data = calloc (num_devices, sizeof (void *));
+  meta->fusion = calloc (1, sizeof (pocl_fused_kernel_info));
+  if (meta->name == NULL || meta->arg_info == NULL
+      || meta->max_subgroups == NULL || meta->compile_subgroups == NULL
+      || meta->max_workgroup_size == NULL
+      || meta->preferred_wg_multiple == NULL || meta->local_mem_size == NULL
+      || meta->private_mem_size == NULL || meta->spill_mem_size == NULL
+      || meta->build_hash == NULL || meta->data == NULL
+      || meta->fusion == NULL)
+    goto ERROR;
+
+  for (unsigned i = 0; i < a_meta->num_args; ++i)
+    copy_arg_info (&meta->arg_info[i], &a_meta->arg_info[i]);
+  for (unsigned j = 0; j < b_meta->num_args; ++j)
+    if (arg_map[j] >= a_meta->num_args)
+      copy_arg_info (&meta->arg_info[arg_map[j]], &b_meta->arg_info[j]);
+
+  for (unsigned d = 0; d < num_devices; ++d)
+    {
+      meta->max_subgroups[d] = a_meta->max_subgroups[d];
+      meta->compile_subgroups[d] = a_meta->compile_subgroups[d];
+      meta->max_workgroup_size[d] = min (a_meta->max_workgroup_size[d],
+                                         b_meta->max_workgroup_size[d]);
+      meta->preferred_wg_multiple[d] = a_meta->preferred_wg_multiple[d];
+      meta->local_mem_size[d]
+          = max (a_meta->local_mem_size[d], b_meta->local_mem_size[d]);
+      meta->private_mem_size[d]
+          = a_meta->private_mem_size[d] + b_meta->private_mem_size[d];
+      meta->spill_mem_size[d]
+          = a_meta->spill_mem_size[d] + b_meta->spill_mem_size[d];
+
+      SHA1_CTX hash_ctx;
+      pocl_SHA1_Init (&hash_ctx);
+      pocl_SHA1_Update (&hash_ctx, (uint8_t *)program->build_hash[d],
+                        sizeof (SHA1_digest_t));
+      pocl_SHA1_Update (&hash_ctx, (uint8_t *)name, strlen (name));
+      pocl_SHA1_Final (&hash_ctx, meta->build_hash[d]);
+    }
+
+  meta->fusion->producer = strdup (a_meta->name);
+  meta->fusion->consumer = strdup (b_meta->name);
+  meta->fusion->consumer_num_args = b_meta->num_args;
+  meta->fusion->consumer_arg_map = malloc (sizeof (cl_uint) * b_meta->num_args);
+  if (meta->fusion->producer == NULL || meta->fusion->consumer == NULL
+      || (meta->fusion->consumer_arg_map == NULL && b_meta->num_args > 0))
+    goto ERROR;
+  memcpy (meta->fusion->consumer_arg_map, arg_map,
+          sizeof (cl_uint) * b_meta->num_args);
+  return meta;
+
+ERROR:
+  if (meta->arg_info == NULL)
+    meta->num_args = 0;
+  pocl_free_fused_kernel_metadata (program, meta);
+  return NULL;
+}
+
+/* Returns the metadata of the fused kernel for the given producer/consumer
+ * pair and argument mapping, creating it if needed. Call with the program
+ * locked. */
+static pocl_kernel_metadata_t *
+get_fused_meta (cl_program program, unsigned dev_i, _cl_command_node *a,
+                _cl_command_node *b, const cl_uint *arg_map, cl_uint num_args)
+{
+  pocl_kernel_metadata_t *a_meta = a->command.run.kernel->meta;
+  pocl_kernel_metadata_t *b_meta = b->command.run.kernel->meta;
+
+  /* The argument mapping affects the generated code, thus include it in the
+   * name which is also what the kernel compiler cache uses as the key. */
+  uint32_t map_hash = 2166136261u;
+  for (unsigned j = 0; j < b_meta->num_args; ++j)
+    map_hash = (map_hash ^ arg_map[j]) * 16777619u;
+  size_t name_len = strlen (a_meta->name) + strlen (b_meta->name) + 32;
+  char *name = alloca (name_len);
+  snprintf (name, name_len, "pocl_fused_%s_%s_%08x", a_meta->name,
+            b_meta->name, map_hash);
+
+  for (unsigned i = 0; i < program->num_fused_kernels; ++i)
+    if (strcmp (program->fused_kernel_meta[i]->name, name) == 0)
+      return program->fused_kernel_meta[i];
+
+  pocl_kernel_metadata_t *meta
+      = create_fused_meta (program, name, a, b, arg_map, num_args);
+  if (meta == NULL)
+    return NULL;
+
+  if (pocl_llvm_check_fused_kernel (program, dev_i, meta) != CL_SUCCESS)
+    {
+      POCL_MSG_PRINT_LLVM ("Could not generate fused kernel %s\n", name);
+      pocl_free_fused_kernel_metadata (program, meta);
+      return NULL;
+    }
+
+  pocl_kernel_metadata_t **metas
+      = realloc (program->fused_kernel_meta, sizeof (pocl_kernel_metadata_t *)
+                                                 * (program->num_fused_kernels
+                                                    + 1));
+  if (metas == NULL)
+    {
+      pocl_free_fused_kernel_metadata (program, meta);
+      return NULL;
+    }
+  metas[program->num_fused_kernels++] = meta;
+  program->fused_kernel_meta = metas;
+  return meta;
+}
+
+/* Creates a cl_kernel for the fused kernel metadata. The kernel is not
+ * visible through the API, but is in the kernel list of the program so the
+ * program cannot be rebuilt while commands refer to it. */
+static cl_kernel
+create_fused_kernel (cl_program program, pocl_kernel_metadata_t *meta)
+{
+  cl_kernel kernel = calloc (1, sizeof (struct _cl_kernel));
+  if (kernel == NULL)
+    return NULL;
+
+  POCL_INIT_OBJECT (kernel);
+  kernel->meta = meta;
+  kernel->name = meta->name;
+  kernel->context = program->context;
+  kernel->program = program;
+  kernel->data = (void **)calloc (program->num_devices, sizeof (void *));
+  kernel->dyn_arguments = (pocl_argument *)calloc (
+      meta->num_args, sizeof (struct pocl_argument));
+  if (kernel->data == NULL || kernel->dyn_arguments == NULL)
+    goto ERROR;
+
+  for (unsigned i = 0; i < program->num_devices; ++i)
+    {
+      cl_device_id device = program->devices[i];
+      if (device->ops->create_kernel && *(device->available) == CL_TRUE)
+        {
+          POCL_LOCK_OBJ (program);
+          int r = device->ops->create_kernel (device, program, kernel, i);
+          POCL_UNLOCK_OBJ (program);
+          if (r != CL_SUCCESS)
+            goto ERROR;
+        }
+    }
+
+  POCL_LOCK_OBJ (program);
+  LL_PREPEND (program->kernels, kernel);
+  POCL_RETAIN_OBJECT_UNLOCKED (program);
+  POCL_UNLOCK_OBJ (program);
+
+  POCL_ATOMIC_INC (kernel_c);
+  return kernel;
+
+ERROR:
+  POCL_MEM_FREE (kernel->data);
+  POCL_MEM_FREE (kernel->dyn_arguments);
+  POCL_DESTROY_OBJECT (kernel);
+  POCL_MEM_FREE (kernel);
+  return NULL;
+}
+
+/* Creates the command which replaces the recorded commands A (with sync
+ * point a_sync) and B. */
+static _cl_command_node *
+create_fused_command (cl_kernel kernel, unsigned dev_i, _cl_command_node *a,
+                      cl_sync_point_khr a_sync, _cl_command_node *b,
+                      const cl_uint *arg_map)
+{
+  cl_uint a_num_args = a->command.run.kernel->meta->num_args;
+  cl_uint b_num_args = b->command.run.kernel->meta->num_args;
+
+  _cl_command_node *node = pocl_mem_manager_new_command ();
+  if (node == NULL)
+    return NULL;
+  node->type = CL_COMMAND_NDRANGE_KERNEL;
+  node->buffered = 1;
+  node->queue_idx = a->queue_idx;
+  node->program_device_i = dev_i;
+  node->device = kernel->program->devices[dev_i];
+
+  /* Wait for everything either of the commands waits for, except for the
+   * producer itself. */
+  cl_uint num_deps = a->sync.syncpoint.num_sync_points_in_wait_list
+                     + b->sync.syncpoint.num_sync_points_in_wait_list;
+  cl_sync_point_khr *wait_list = NULL;
+  if (num_deps > 0)
+    {
+      wait_list = malloc (sizeof (cl_sync_point_khr) * num_deps);
+      if (wait_list == NULL)
+        goto ERROR;
+    }
+  node->sync.syncpoint.sync_point_wait_list = wait_list;
+  node->sync.syncpoint.num_sync_points_in_wait_list = 0;
+  _cl_command_node *srcs[2] = { a, b };
+  for (unsigned s = 0; s < 2; ++s)
+    for (unsigned i = 0;
+         i < srcs[s]->sync.syncpoint.num_sync_points_in_wait_list; ++i)
+      {
+        cl_sync_point_khr sp = srcs[s]->sync.syncpoint.sync_point_wait_list[i];
+        if (sp != a_sync && !waits_on (node, sp))
+          wait_list[node->sync.syncpoint.num_sync_points_in_wait_list++] = sp;
+      }
+
+  /* A buffer used by both commands is read-only only if both only read it. */
+  cl_uint num_mems = a->memobj_count + b->memobj_count;
+  if (num_mems > 0)
+    {
+      node->memobj_list = malloc (sizeof (cl_mem) * num_mems);
+      node->readonly_flag_list = malloc (num_mems);
+      if (node->memobj_list == NULL || node->readonly_flag_list == NULL)
+        goto ERROR;
+    }
+  for (unsigned s = 0; s < 2; ++s)
+    for (unsigned i = 0; i < srcs[s]->memobj_count; ++i)
+      {
+        cl_mem mem = srcs[s]->memobj_list[i];
+        unsigned k;
+        for (k = 0; k < node->memobj_count; ++k)
+          if (node->memobj_list[k] == mem)
+            break;
+        if (k == node->memobj_count)
+          {
+            node->memobj_list[k] = mem;
+            node->readonly_flag_list[k] = 1;
+            node->memobj_count++;
+            POname (clRetainMemObject) (mem);
+          }
+        node->readonly_flag_list[k] &= srcs[s]->readonly_flag_list[i];
+      }
+
+  struct pocl_argument *args
+      = alloca (sizeof (struct pocl_argument) * (kernel->meta->num_args + 1));
+  memcpy (args, a->command.run.arguments,
+          sizeof (struct pocl_argument) * a_num_args);
+  for (unsigned j = 0; j < b_num_args; ++j)
+    if (arg_map[j] >= a_num_args)
+      memcpy (&args[arg_map[j]], &b->command.run.arguments[j],
+              sizeof (struct pocl_argument));
+
+  node->command.run.kernel = kernel;
+  node->command.run.hash = kernel->meta->build_hash[dev_i];
+  node->command.run.pc = a->command.run.pc;
+  if (pocl_kernel_copy_args (kernel, args, &node->command.run) != CL_SUCCESS)
+    goto ERROR;
+
+  return node;
+
+ERROR:
+  for (unsigned i = 0; i < node->memobj_count; ++i)
+    POname (clReleaseMemObject) (node->memobj_list[i]);
+  pocl_mem_manager_free_command (node);
+  return NULL;
+}
+
+/* Frees a fused command which was not taken into use, along with the
+ * fused kernel it holds the only reference to. */
+static void
+free_fused_command (_cl_command_node *node)
+{
+  cl_kernel kernel = node->command.run.kernel;
+  for (unsigned i = 0; i < kernel->meta->num_args; ++i)
+    POCL_MEM_FREE (node->command.run.arguments[i].value);
+  POCL_MEM_FREE (node->command.run.arguments);
+  for (unsigned i = 0; i < node->memobj_count; ++i)
+    POname (clReleaseMemObject) (node->memobj_list[i]);
+  pocl_mem_manager_free_command (node);
+  POname (clReleaseKernel) (kernel);
+}
+
+/* Fuses the recorded commands A and B if possible and stores the fused
+ * command to A. */
+static void
+try_fuse_commands (cl_command_buffer_khr command_buffer, _cl_command_node *a,
+                   cl_sync_point_khr a_sync, _cl_command_node *b)
+{
+  if (a->type != CL_COMMAND_NDRANGE_KERNEL
+      || b->type != CL_COMMAND_NDRANGE_KERNEL || a->queue_idx != b->queue_idx
+      || a->program_device_i != b->program_device_i)
+    return;
+
+  cl_command_queue queue = command_buffer->queues[a->queue_idx];
+  if ((queue->properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)
+      && !waits_on (b, a_sync))
+    return;
+
+  cl_kernel a_kernel = a->command.run.kernel;
+  cl_kernel b_kernel = b->command.run.kernel;
+  cl_program program = a_kernel->program;
+  unsigned dev_i = a->program_device_i;
+  if (b_kernel->program != program || a_kernel->meta->fusion != NULL
+      || b_kernel->meta->fusion != NULL || !device_can_fuse (program, dev_i))
+    return;
+
+  struct pocl_context *a_pc = &a->command.run.pc;
+  struct pocl_context *b_pc = &b->command.run.pc;
+  if (a_pc->work_dim != 1 || b_pc->work_dim != 1
+      || a_pc->local_size[0] != b_pc->local_size[0]
+      || a_pc->num_groups[0] != b_pc->num_groups[0]
+      || a_pc->global_offset[0] != b_pc->global_offset[0]
+      || a_kernel->meta->num_locals != 0 || b_kernel->meta->num_locals != 0
+      || memcmp (a_kernel->meta->reqd_wg_size, b_kernel->meta->reqd_wg_size,
+                 sizeof (a_kernel->meta->reqd_wg_size))
+             != 0
+      || !args_are_fusable (a) || !args_are_fusable (b))
+    return;
+
+  if (pocl_llvm_read_program_llvm_irs (program, dev_i, NULL) != CL_SUCCESS)
+    return;
+
+  pocl_fusion_arg_info a_info[a_kernel->meta->num_args + 1];
+  pocl_fusion_arg_info b_info[b_kernel->meta->num_args + 1];
+  if (pocl_llvm_get_kernel_fusion_info (program, dev_i, a_kernel->name,
+                                        a_info)
+          != CL_SUCCESS
+      || pocl_llvm_get_kernel_fusion_info (program, dev_i, b_kernel->name,
+                                           b_info)
+             != CL_SUCCESS)
+    return;
+
+  cl_uint arg_map[b_kernel->meta->num_args + 1];
+  cl_uint num_args = map_consumer_args (a, a_info, b, b_info, arg_map);
+  if (num_args == 0)
+    return;
+
+  POCL_LOCK_OBJ (program);
+  pocl_kernel_metadata_t *meta
+      = get_fused_meta (program, dev_i, a, b, arg_map, num_args);
+  POCL_UNLOCK_OBJ (program);
+  if (meta == NULL)
+    return;
+
+  cl_kernel kernel = create_fused_kernel (program, meta);
+  if (kernel == NULL)
+    return;
+
+  _cl_command_node *node
+      = create_fused_command (kernel, dev_i, a, a_sync, b, arg_map);
+  if (node == NULL)
+    {
+      POname (clReleaseKernel) (kernel);
+      return;
+    }
+
+  /* Build the fused kernel now instead of at the first launch. The unfused
+   * commands are launched if that fails. */
+  if (pocl_build_kernel_disk_cache (node, 1) != CL_SUCCESS)
+    {
+      POCL_MSG_WARN ("Could not build fused kernel %s, launching %s and %s "
+                     "separately\n",
+                     kernel->name, a_kernel->name, b_kernel->name);
+      free_fused_command (node);
+      return;
+    }
+  cl_device_id dev = program->devices[dev_i];
+  dev->ops->compile_kernel (node, kernel, dev, 1);
+
+  POCL_MSG_PRINT_GENERAL ("Fused kernels %s and %s to %s\n", a_kernel->name,
+                          b_kernel->name, kernel->name);
+  a->fused = node;
+}
+
+#endif
+
+void
+pocl_cmdbuf_fuse_kernels (cl_command_buffer_khr command_buffer)
+{
+#ifdef ENABLE_LLVM
+  _cl_command_node *cmd = command_buffer->cmds;
+  /* sync point ids start at 1 */
+  cl_sync_point_khr sync_point = 1;
+  while (cmd != NULL && cmd->next != NULL)
+    {
+      try_fuse_commands (command_buffer, cmd, sync_point, cmd->next);
+      if (cmd->fused != NULL)
+        {
+          /* The consumer is a part of the fused command now. */
+          cmd = cmd->next;
+          ++sync_point;
+        }
+      cmd = cmd->next;
+      ++sync_point;
+    }
+#endif
+}
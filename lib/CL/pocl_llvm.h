@@ -35,6 +35,10 @@ extern "C" {
   void InitializeLLVM ();
   void UnInitializeLLVM ();
 
+  /* Prints the LLVM pass statistics totals of the kernel compilations
+   * since the previous call, if POCL_LLVM_PASS_STATS is enabled. */
+  void pocl_llvm_report_pass_stats ();
+
   /* Returns the cpu name as reported by LLVM. */
   POCL_EXPORT
   char *pocl_get_llvm_cpu_name ();
@@ -94,6 +98,19 @@ extern "C" {
       unsigned DeviceI, cl_device_id Device, cl_kernel Kernel,
       _cl_command_node *Command, void **output, int Specialize);
 
+  /* Summarizes the accesses of the given kernel to each of its arguments
+   * to ArgInfo for kernel fusion. Returns CL_SUCCESS if the kernel can be
+   * fused with another kernel.
+   */
+  int pocl_llvm_get_kernel_fusion_info (cl_program program, unsigned device_i,
+                                        const char *kernel_name,
+                                        pocl_fusion_arg_info *arg_info);
+
+  /* Checks that the fused kernel described by meta can be generated from
+   * the program IR. */
+  int pocl_llvm_check_fused_kernel (cl_program program, unsigned device_i,
+                                    pocl_kernel_metadata_t *meta);
+
   POCL_EXPORT
   int pocl_llvm_run_passes_on_program (cl_program Program, unsigned DeviceI);
   /**
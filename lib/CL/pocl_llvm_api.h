@@ -34,6 +34,10 @@
 #include <map>
 #include <string>
 
+namespace llvm {
+class PassInstrumentationCallbacks;
+}
+
 #ifdef __GNUC__
 #pragma GCC visibility push(hidden)
 #endif
@@ -100,9 +104,12 @@ POCL_EXPORT bool getModuleBoolMetadata (const llvm::Module &mod,
  * OptL - optimize for speed (0 to 3 are valid)
  * SizeL - optimize for size
  * Vectorize - whether to invoke the vectorizer (only used for legacy PM)
+ * PIC - optional. Instrumentation callbacks to run around the passes.
  */
 POCL_EXPORT void populateModulePM (void *Passes, void *Module, unsigned OptL,
-                                   unsigned SizeL, bool Vectorize = true);
+                                   unsigned SizeL, bool Vectorize = true,
+                                   llvm::PassInstrumentationCallbacks *PIC
+                                   = nullptr);
 
 extern std::string CurrentWgMethod;
 
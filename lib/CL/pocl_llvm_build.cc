@@ -187,8 +187,18 @@ static bool generateProgramBC(PoclLLVMContextData *Context, llvm::Module *Mod,
     Program->global_var_total_size[device_i] = TotalGVarBytes;
   }
 
+  // Let the loop vectorizer call the vector overloads of the math builtins
+  // for the widths the device handles natively.
+  unsigned MathVecWidthFloat = 0, MathVecWidthDouble = 0;
+  if (Device->spmd == CL_FALSE &&
+      pocl_get_bool_option("POCL_VECTORIZE_MATH_BUILTINS", 0)) {
+    MathVecWidthFloat = Device->native_vector_width_float;
+    MathVecWidthDouble = Device->native_vector_width_double;
+  }
+
   if (link(Mod, BuiltinLib, Log, Device->device_aux_functions,
-           Device->device_side_printf != CL_FALSE))
+           Device->device_side_printf != CL_FALSE, MathVecWidthFloat,
+           MathVecWidthDouble))
     return true;
 
   raw_string_ostream OS(Log);
@@ -336,6 +346,10 @@ int pocl_llvm_build_program(cl_program program,
                          "-cl-finite-math-only -cl-unsafe-math-optimizations");
 #endif
     ss << "-D__FAST_RELAXED_MATH__=1 ";
+    // switch to the lower precision builtins if the kernel library has them
+    llvm::Module *Lib = getKernelLibrary(device, llvm_ctx);
+    if (Lib != nullptr && Lib->getFunction("_Z12_cl_fast_expf") != nullptr)
+      ss << "-D__POCL_FAST_MATH_BUILTINS__=1 ";
     fp_contract = "fast";
   }
 
@@ -0,0 +1,302 @@
+/* pocl_llvm_pass_stats.cc: per-pass timing and statistics of the kernel
+   compiler pass pipelines.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "CompilerWarnings.h"
+IGNORE_COMPILER_WARNING("-Wunused-parameter")
+#include <llvm/Analysis/LazyCallGraph.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+POP_COMPILER_DIAGS
+
+#include "pocl_debug.h"
+#include "pocl_llvm.h"
+#include "pocl_llvm_pass_stats.h"
+#include "pocl_runtime_config.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <unistd.h>
+
+using namespace llvm;
+
+// Only the passes doing actual work are recorded, not the pass managers and
+// adaptors which merely run them.
+static bool isPassContainer(StringRef PassID) {
+  return PassID.contains("PassManager") || PassID.contains("PassAdaptor");
+}
+
+template <typename T> static const T *unwrapIR(const Any &IR) {
+#if LLVM_MAJOR < 16
+  return any_isa<const T *>(IR) ? any_cast<const T *>(IR) : nullptr;
+#else
+  const T *const *Ptr = any_cast<const T *>(&IR);
+  return Ptr != nullptr ? *Ptr : nullptr;
+#endif
+}
+
+static long countInstructions(const Any &IR) {
+  if (const Module *M = unwrapIR<Module>(IR))
+    return M->getInstructionCount();
+  if (const Function *F = unwrapIR<Function>(IR))
+    return F->getInstructionCount();
+  if (const Loop *L = unwrapIR<Loop>(IR)) {
+    long Count = 0;
+    for (const BasicBlock *BB : L->blocks())
+      Count += BB->size();
+    return Count;
+  }
+  if (const LazyCallGraph::SCC *C = unwrapIR<LazyCallGraph::SCC>(IR)) {
+    long Count = 0;
+    for (const LazyCallGraph::Node &N : *C)
+      Count += N.getFunction().getInstructionCount();
+    return Count;
+  }
+  return 0;
+}
+
+static void formatStats(std::string &Out,
+                        std::vector<PassStatsRecorder::PassStats> Stats,
+                        size_t MaxRows) {
+  std::sort(Stats.begin(), Stats.end(),
+            [](const PassStatsRecorder::PassStats &A,
+               const PassStatsRecorder::PassStats &B) {
+              return A.Seconds > B.Seconds;
+            });
+  char Line[512];
+  std::snprintf(Line, sizeof(Line), "%10s %7s %8s  %s\n", "ms", "runs",
+                "insts", "pass");
+  Out += Line;
+  for (size_t I = 0; I < Stats.size() && I < MaxRows; ++I) {
+    std::snprintf(Line, sizeof(Line), "%10.3f %7u %+8ld  %s\n",
+                  Stats[I].Seconds * 1000.0, Stats[I].Runs,
+                  Stats[I].InstDelta, Stats[I].Name.c_str());
+    Out += Line;
+  }
+  if (Stats.size() > MaxRows)
+    Out += "  ... " + std::to_string(Stats.size() - MaxRows) +
+           " more passes\n";
+}
+
+static std::string escapeJSON(StringRef Str) {
+  std::string Escaped;
+  for (char C : Str) {
+    if (C == '"' || C == '\\')
+      Escaped += '\\';
+    Escaped += C;
+  }
+  return Escaped;
+}
+
+namespace {
+
+// The statistics of all the compilations of the process, and the trace file
+// shared by them. Uses only the standard library so it does not depend on
+// LLVM still being loaded when the process exits.
+class ProcessPassStats {
+  std::mutex Lock;
+  std::map<std::string, PassStatsRecorder::PassStats> Totals;
+  unsigned Compilations = 0;
+  double TotalSeconds = 0.0;
+  std::FILE *Trace = nullptr;
+  bool TraceOpened = false;
+
+public:
+  const std::chrono::steady_clock::time_point Epoch =
+      std::chrono::steady_clock::now();
+
+  void addCompilation(const std::vector<PassStatsRecorder::PassStats> &Stats,
+                      double Seconds) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    ++Compilations;
+    TotalSeconds += Seconds;
+    for (const PassStatsRecorder::PassStats &S : Stats) {
+      PassStatsRecorder::PassStats &Total = Totals[S.Name];
+      Total.Name = S.Name;
+      Total.Runs += S.Runs;
+      Total.Seconds += S.Seconds;
+      Total.InstDelta += S.InstDelta;
+    }
+  }
+
+  // Writes a Chrome trace "complete" event. The trace is a JSON array which
+  // is left unterminated, as allowed by the trace event format, so it stays
+  // valid even if the process does not exit cleanly.
+  void addTraceEvent(const std::string &Event) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    if (!TraceOpened) {
+      TraceOpened = true;
+      const char *Path = pocl_get_string_option("POCL_LLVM_PASS_TRACE", NULL);
+      if (Path != NULL) {
+        Trace = std::fopen(Path, "w");
+        if (Trace != nullptr)
+          std::fputs("[\n", Trace);
+      }
+    }
+    if (Trace != nullptr)
+      std::fputs(Event.c_str(), Trace);
+  }
+
+  // Returns the totals of the compilations since the previous call, or an
+  // empty string if there were none.
+  std::string takeReport() {
+    std::lock_guard<std::mutex> Guard(Lock);
+    if (Compilations == 0)
+      return std::string();
+    std::vector<PassStatsRecorder::PassStats> Stats;
+    for (auto &Entry : Totals)
+      Stats.push_back(Entry.second);
+    char Header[128];
+    std::snprintf(Header, sizeof(Header),
+                  "LLVM pass statistics for %u compilations, %.3f s total:\n",
+                  Compilations, TotalSeconds);
+    std::string Out = Header;
+    formatStats(Out, Stats, 40);
+    Totals.clear();
+    Compilations = 0;
+    TotalSeconds = 0.0;
+    return Out;
+  }
+
+  ~ProcessPassStats() {
+    if (Trace != nullptr)
+      std::fclose(Trace);
+  }
+};
+
+} // namespace
+
+static ProcessPassStats &getProcessStats() {
+  static ProcessPassStats Stats;
+  return Stats;
+}
+
+PassStatsRecorder::PassStatsRecorder(const std::string &UnitName)
+    : UnitName(UnitName),
+      TraceEnabled(pocl_get_string_option("POCL_LLVM_PASS_TRACE", NULL) !=
+                   NULL) {
+  // Construct the process statistics before the first recorder so they are
+  // destroyed after it.
+  getProcessStats();
+}
+
+PassStatsRecorder::~PassStatsRecorder() {
+  getProcessStats().addCompilation(Stats, TotalSeconds);
+}
+
+bool PassStatsRecorder::isEnabled() {
+  return pocl_get_bool_option("POCL_LLVM_PASS_STATS", 0) != 0;
+}
+
+void PassStatsRecorder::registerCallbacks(PassInstrumentationCallbacks &PIC,
+                                          const char *Stage) {
+  PIC.registerBeforeNonSkippedPassCallback(
+      [this](StringRef PassID, Any IR) { beforePass(PassID, IR); });
+  PIC.registerAfterPassCallback(
+      [this, Stage](StringRef PassID, Any IR, const PreservedAnalyses &) {
+        if (!isPassContainer(PassID))
+          afterPass(PassID, countInstructions(IR), Stage);
+      });
+  PIC.registerAfterPassInvalidatedCallback(
+      [this, Stage](StringRef PassID, const PreservedAnalyses &) {
+        // The IR unit was deleted by the pass.
+        if (!isPassContainer(PassID))
+          afterPass(PassID, 0, Stage);
+      });
+}
+
+void PassStatsRecorder::beforePass(StringRef PassID, const Any &IR) {
+  if (isPassContainer(PassID))
+    return;
+  Stack.push_back(RunningPass{std::chrono::steady_clock::now(),
+                              countInstructions(IR), 0.0, 0});
+}
+
+void PassStatsRecorder::afterPass(StringRef PassID, long InstsAfter,
+                                  const char *Stage) {
+  if (Stack.empty())
+    return;
+  auto End = std::chrono::steady_clock::now();
+  RunningPass Pass = Stack.back();
+  Stack.pop_back();
+
+  double Seconds = std::chrono::duration<double>(End - Pass.Start).count();
+  long InstDelta = InstsAfter - Pass.InstsBefore;
+  if (!Stack.empty()) {
+    Stack.back().ChildSeconds += Seconds;
+    Stack.back().ChildInstDelta += InstDelta;
+  }
+
+  auto Inserted = StatsIndex.insert(std::make_pair(PassID, Stats.size()));
+  if (Inserted.second) {
+    Stats.emplace_back();
+    Stats.back().Name = PassID.str();
+  }
+  PassStats &S = Stats[Inserted.first->second];
+  double SelfSeconds = Seconds - Pass.ChildSeconds;
+  ++S.Runs;
+  S.Seconds += SelfSeconds;
+  S.InstDelta += InstDelta - Pass.ChildInstDelta;
+  TotalSeconds += SelfSeconds;
+
+  if (!TraceEnabled)
+    return;
+  ProcessPassStats &Process = getProcessStats();
+  double StartUs =
+      std::chrono::duration<double, std::micro>(Pass.Start - Process.Epoch)
+          .count();
+  char Event[1024];
+  std::snprintf(
+      Event, sizeof(Event),
+      "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,"
+      "\"dur\":%.3f,\"pid\":%d,\"tid\":%zu,\"args\":{\"unit\":\"%s\","
+      "\"insts_before\":%ld,\"insts_after\":%ld}},\n",
+      escapeJSON(PassID).c_str(), Stage, StartUs, Seconds * 1e6,
+      (int)getpid(), std::hash<std::thread::id>()(std::this_thread::get_id()),
+      escapeJSON(UnitName).c_str(), Pass.InstsBefore, InstsAfter);
+  Process.addTraceEvent(Event);
+}
+
+std::string PassStatsRecorder::getReport() const {
+  char Header[256];
+  std::snprintf(Header, sizeof(Header),
+                "LLVM pass statistics for '%s': %.3f ms in %zu passes\n",
+                UnitName.c_str(), TotalSeconds * 1000.0, Stats.size());
+  std::string Report = Header;
+  formatStats(Report, Stats, 20);
+  return Report;
+}
+
+void pocl_llvm_report_pass_stats() {
+  if (!PassStatsRecorder::isEnabled())
+    return;
+  std::string Report = getProcessStats().takeReport();
+  if (!Report.empty())
+    POCL_MSG_PRINT_LLVM("%s", Report.c_str());
+}
@@ -0,0 +1,100 @@
+/* pocl_llvm_pass_stats.h: per-pass timing and statistics of the kernel
+   compiler pass pipelines.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#ifndef POCL_LLVM_PASS_STATS_H
+#define POCL_LLVM_PASS_STATS_H
+
+#include "CompilerWarnings.h"
+IGNORE_COMPILER_WARNING("-Wunused-parameter")
+#include <llvm/ADT/StringMap.h>
+#include <llvm/IR/PassInstrumentation.h>
+POP_COMPILER_DIAGS
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifdef __GNUC__
+#pragma GCC visibility push(hidden)
+#endif
+
+/**
+ * Records the wall time and the instruction count change of each pass run
+ * by the pass managers it is registered to, for a single kernel compilation.
+ *
+ * Enabled with POCL_LLVM_PASS_STATS. The per-pass table is appended to the
+ * program build log, each pass run is written as a Chrome trace event to
+ * the file given in POCL_LLVM_PASS_TRACE, and the totals over the whole
+ * process are printed when the platform compiler is unloaded (see
+ * pocl_llvm_report_pass_stats()).
+ */
+class PassStatsRecorder {
+public:
+  struct PassStats {
+    std::string Name;
+    unsigned Runs = 0;
+    /* time spent in the pass excluding the nested passes, in seconds */
+    double Seconds = 0.0;
+    /* instruction count change excluding the nested passes */
+    long InstDelta = 0;
+  };
+
+  explicit PassStatsRecorder(const std::string &UnitName);
+  ~PassStatsRecorder();
+
+  /* Returns true if POCL_LLVM_PASS_STATS is enabled. */
+  static bool isEnabled();
+
+  /* Records the passes run through PIC, labeling them with Stage. */
+  void registerCallbacks(llvm::PassInstrumentationCallbacks &PIC,
+                         const char *Stage);
+
+  /* Returns the per-pass table of this compilation, slowest first. */
+  std::string getReport() const;
+
+private:
+  struct RunningPass {
+    std::chrono::steady_clock::time_point Start;
+    long InstsBefore;
+    double ChildSeconds;
+    long ChildInstDelta;
+  };
+
+  void beforePass(llvm::StringRef PassID, const llvm::Any &IR);
+  void afterPass(llvm::StringRef PassID, long InstsAfter, const char *Stage);
+
+  std::string UnitName;
+  std::vector<RunningPass> Stack;
+  std::vector<PassStats> Stats;
+  llvm::StringMap<unsigned> StatsIndex;
+  double TotalSeconds = 0.0;
+  /* POCL_LLVM_PASS_TRACE is set */
+  bool TraceEnabled;
+};
+
+#ifdef __GNUC__
+#pragma GCC visibility pop
+#endif
+
+#endif
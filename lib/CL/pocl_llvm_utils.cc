@@ -641,10 +641,11 @@ void pocl_append_to_buildlog(cl_program Program, cl_uint DeviceI, char *Log,
   if (Program->build_log[DeviceI] != nullptr) {
     ExistingLogSize = strlen(Program->build_log[DeviceI]);
     size_t TotalLogSize = LogSize + ExistingLogSize;
-    char *NewLog = (char *)malloc(TotalLogSize);
+    char *NewLog = (char *)malloc(TotalLogSize + 1);
     assert(NewLog);
     memcpy(NewLog, Program->build_log[DeviceI], ExistingLogSize);
     memcpy(NewLog + ExistingLogSize, Log, LogSize);
+    NewLog[TotalLogSize] = 0;
     free(Log);
     free(Program->build_log[DeviceI]);
     Program->build_log[DeviceI] = NewLog;
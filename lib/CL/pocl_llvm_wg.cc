@@ -65,8 +65,11 @@ IGNORE_COMPILER_WARNING("-Wunused-parameter")
 #include <llvm/Analysis/LoopAnalysisManager.h>
 #include <llvm/Passes/PassBuilder.h>
 #include <llvm/Passes/StandardInstrumentations.h>
+#include <llvm/Transforms/InstCombine/InstCombine.h>
 #include <llvm/Transforms/Scalar/LoopPassManager.h>
+#include <llvm/Transforms/Utils/Mem2Reg.h>
 
+#include "KernelFusion.h"
 #include "LLVMUtils.h"
 POP_COMPILER_DIAGS
 
@@ -86,6 +89,7 @@ POP_COMPILER_DIAGS
 #include <vector>
 
 #include "linker.h"
+#include "pocl_llvm_pass_stats.h"
 
 // Enable to get the LLVM pass execution timing report dumped to console after
 // each work-group IR function generation. Requires LLVM > 7.
@@ -145,15 +149,18 @@ class PoCLModulePassManager {
   CGSCCAnalysisManager CGAM;
   ModuleAnalysisManager MAM;
   ModulePassManager PM;
+  // the passes that run after the LLVM optimizations
+  ModulePassManager PostOptPM;
   PipelineTuningOptions PTO;
   std::unique_ptr<TargetLibraryInfoImpl> TLII;
   std::unique_ptr<StandardInstrumentations> SI;
 #ifdef PER_STAGE_TARGET_MACHINE
   std::unique_ptr<llvm::TargetMachine> Machine;
 #endif
+  // instrumentation of both the pocl and the optimization pipeline
+  PassInstrumentationCallbacks PIC;
 #ifdef DEBUG_NEW_PASS_MANAGER
   PrintPassOptions PrintPassOpts;
-  PassInstrumentationCallbacks PIC;
   llvm::LLVMContext Context; // for SI
 #endif
   std::unique_ptr<PassBuilder> PassB;
@@ -168,7 +175,9 @@ public:
 #ifndef PER_STAGE_TARGET_MACHINE
                     TargetMachine *TM,
 #endif
-                    cl_device_id Dev);
+                    cl_device_id Dev, PassStatsRecorder *Stats,
+                    const char *StageName,
+                    const std::string &PostOptPipeline = "");
   void run(llvm::Module &Bitcode);
 };
 
@@ -177,7 +186,10 @@ llvm::Error PoCLModulePassManager::build(std::string PoclPipeline,
 #ifndef PER_STAGE_TARGET_MACHINE
                                          TargetMachine *TM,
 #endif
-                                         cl_device_id Dev) {
+                                         cl_device_id Dev,
+                                         PassStatsRecorder *Stats,
+                                         const char *StageName,
+                                         const std::string &PostOptPipeline) {
 
 #ifdef PER_STAGE_TARGET_MACHINE
   Machine.reset(GetTargetMachine(Dev));
@@ -209,14 +221,16 @@ llvm::Error PoCLModulePassManager::build(std::string PoclPipeline,
                                         PrintPassOpts));
   SI->registerCallbacks(PIC, &MAM);
 #endif
+  if (Stats != nullptr)
+    Stats->registerCallbacks(PIC, StageName);
   // Create the new pass manager builder.
   // Take a look at the PassBuilder constructor parameters for more
   // customization, e.g. specifying a TargetMachine or various debugging
   // options.
-#ifdef DEBUG_NEW_PASS_MANAGER
-  PassB.reset(new PassBuilder(TM, PTO, std::nullopt, &PIC));
+#if LLVM_MAJOR < 16
+  PassB.reset(new PassBuilder(TM, PTO, None, &PIC));
 #else
-  PassB.reset(new PassBuilder(TM, PTO));
+  PassB.reset(new PassBuilder(TM, PTO, std::nullopt, &PIC));
 #endif
   PassBuilder &PB = *PassB.get();
 
@@ -297,6 +311,14 @@ llvm::Error PoCLModulePassManager::build(std::string PoclPipeline,
       break;
     }
   }
+  if (!PostOptPipeline.empty())
+    PoclPipeline += "," + PostOptPipeline;
+#else
+  if (!PostOptPipeline.empty()) {
+    llvm::Error E = PB.parsePassPipeline(PostOptPM, StringRef(PostOptPipeline));
+    if (E)
+      return E;
+  }
 #endif
 
   return PB.parsePassPipeline(PM, StringRef(PoclPipeline));
@@ -306,7 +328,12 @@ void PoCLModulePassManager::run(llvm::Module &Bitcode) {
   PM.run(Bitcode, MAM);
 #ifdef SEPARATE_OPTIMIZATION_FROM_POCL_PASSES
   populateModulePM(nullptr, (void *)&Bitcode, OptimizeLevel, SizeLevel,
-                   Vectorize);
+                   Vectorize, &PIC);
+  if (!PostOptPM.isEmpty()) {
+    // The optimizations ran with their own analysis managers.
+    MAM.clear();
+    PostOptPM.run(Bitcode, MAM);
+  }
 #endif
 }
 
@@ -336,13 +363,16 @@ public:
   llvm::Error build(cl_device_id Dev, const std::string &Stage1Pipeline,
                     unsigned Stage1OLevel, unsigned Stage1SLevel,
                     const std::string &Stage2Pipeline,
-                    unsigned Stage2OLevel, unsigned Stage2SLevel);
+                    unsigned Stage2OLevel, unsigned Stage2SLevel,
+                    const std::string &Stage2PostOptPipeline,
+                    PassStatsRecorder *Stats = nullptr);
   void run(llvm::Module &Bitcode);
 };
 
 llvm::Error TwoStagePoCLModulePassManager::build(cl_device_id Dev,
     const std::string &Stage1Pipeline, unsigned Stage1OLevel, unsigned Stage1SLevel,
-    const std::string &Stage2Pipeline, unsigned Stage2OLevel, unsigned Stage2SLevel) {
+    const std::string &Stage2Pipeline, unsigned Stage2OLevel, unsigned Stage2SLevel,
+    const std::string &Stage2PostOptPipeline, PassStatsRecorder *Stats) {
 
 #ifndef PER_STAGE_TARGET_MACHINE
   Machine.reset(GetTargetMachine(Dev));
@@ -353,7 +383,7 @@ llvm::Error TwoStagePoCLModulePassManager::build(cl_device_id Dev,
 #ifndef PER_STAGE_TARGET_MACHINE
                                 TMach,
 #endif
-                                Dev);
+                                Dev, Stats, "stage1");
   if (E1)
     return E1;
 
@@ -362,7 +392,7 @@ llvm::Error TwoStagePoCLModulePassManager::build(cl_device_id Dev,
 #ifndef PER_STAGE_TARGET_MACHINE
                       TMach,
 #endif
-                      Dev);
+                      Dev, Stats, "stage2", Stage2PostOptPipeline);
 }
 
 void TwoStagePoCLModulePassManager::run(llvm::Module &Bitcode) {
@@ -467,6 +497,10 @@ static void addStage1PassesToPipeline(cl_device_id Dev,
      threads will overwrite the static variable and produce garbage results.
 
      -optimize-wi-gvars after flatten-globals & always-inline passes
+
+     -lower-collectives after workitem-handler-chooser, as it lowers the
+     collectives only for the work-item loops, and before always-inline,
+     which inlines the library collectives to the kernel.
   */
 
   // NOTE: if you add a new PoCL pass here,
@@ -484,6 +518,8 @@ static void addStage1PassesToPipeline(cl_device_id Dev,
     addPass(Passes, "flatten-inline-all", PassType::Module);
     addPass(Passes, "always-inline", PassType::Module);
   } else {
+    // while the collectives still are calls to the library functions
+    addPass(Passes, "lower-collectives");
     addPass(Passes, "flatten-globals", PassType::Module);
     addPass(Passes, "flatten-barrier-subs", PassType::Module);
     addPass(Passes, "always-inline", PassType::Module);
@@ -491,6 +527,9 @@ static void addStage1PassesToPipeline(cl_device_id Dev,
   // this must be done AFTER inlining, see note above
   addPass(Passes, "automatic-locals", PassType::Module);
 
+  // after always-inline so the image builtins see the folded fields
+  addPass(Passes, "specialize-image-args");
+
   // must come AFTER flatten-globals & always-inline
   addPass(Passes, "optimize-wi-gvars");
 
@@ -598,6 +637,28 @@ static void addStage2PassesToPipeline(cl_device_id Dev,
   // addPass(Passes, "remove-barriers");
 }
 
+static void addStage2PostOptPassesToPipeline(cl_device_id Dev,
+                                             std::vector<std::string> &Passes) {
+  // Inline the math builtin calls the linker kept out of line for the loop
+  // vectorizer, and the vector overload calls it created.
+  if (!Dev->spmd)
+    addPass(Passes, "inline-vector-math", PassType::Module);
+
+  // Make the contiguous stores to the large write-only buffers
+  // non-temporal. This is done only after the loop vectorizer, which
+  // does not vectorize loops with non-temporal stores that are not
+  // aligned to the vector width.
+  if (Dev->run_workgroup_pass && !Dev->arg_buffer_launcher && !Dev->spmd)
+    addPass(Passes, "streaming-stores");
+
+  // Prefetch the strided loads of the later work-items. This is done only
+  // after the loop vectorizer, which does not vectorize loops with
+  // prefetch calls, in the vector and remainder loops it leaves.
+  if (Dev->run_workgroup_pass && !Dev->arg_buffer_launcher && !Dev->spmd &&
+      pocl_get_int_option("POCL_WI_PREFETCH_DISTANCE", 0) > 0)
+    addPass(Passes, "prefetch-wi-loads");
+}
+
 // old PM uses a vector of strings directly; new PM requires a single string
 // vector.join(",")
 static std::string convertPassesToPipelineString(const std::vector<std::string> &Passes) {
@@ -611,7 +672,8 @@ static std::string convertPassesToPipelineString(const std::vector<std::string>
   return Pipeline;
 }
 
-static bool runKernelCompilerPasses(cl_device_id Device, llvm::Module &Mod) {
+static bool runKernelCompilerPasses(cl_device_id Device, llvm::Module &Mod,
+                                    PassStatsRecorder *Stats) {
 
   TwoStagePoCLModulePassManager PM;
   std::vector<std::string> Passes1;
@@ -620,8 +682,11 @@ static bool runKernelCompilerPasses(cl_device_id Device, llvm::Module &Mod) {
   std::vector<std::string> Passes2;
   addStage2PassesToPipeline(Device, Passes2);
   std::string P2 = convertPassesToPipelineString(Passes2);
+  std::vector<std::string> Passes2PostOpt;
+  addStage2PostOptPassesToPipeline(Device, Passes2PostOpt);
+  std::string P2PostOpt = convertPassesToPipelineString(Passes2PostOpt);
 
-  Error E = PM.build(Device, P1, 2, 0, P2, 3, 0);
+  Error E = PM.build(Device, P1, 2, 0, P2, 3, 0, P2PostOpt, Stats);
   if (E) {
     std::cerr << "LLVM: failed to create compilation pipeline";
     return false;
@@ -1015,7 +1080,8 @@ static int pocl_llvm_run_pocl_passes(llvm::Module *Bitcode,
                                      llvm::LLVMContext *LLVMContext,
                                      PoclLLVMContextData *PoclCtx,
                                      cl_kernel Kernel, // optional
-                                     cl_device_id Device, int Specialize) {
+                                     cl_device_id Device, int Specialize,
+                                     PassStatsRecorder *Stats) { // optional
   // Set to true to generate a global offset 0 specialized WG function.
   bool WGAssumeZeroGlobalOffset;
   // If set to true, the next 3 parameters define the local size to specialize
@@ -1088,6 +1154,48 @@ static int pocl_llvm_run_pocl_passes(llvm::Module *Bitcode,
   setModuleBoolMetadata(Bitcode, "WGAssumeZeroGlobalOffset",
                         WGAssumeZeroGlobalOffset);
 
+  // Image formats and sampler values known at launch; see
+  // pocl_cmd_image_arg_key() and the specialize-image-args pass.
+  if (Specialize && Kernel != nullptr) {
+    char ImageKey[POCL_IMAGE_ARG_KEY_LENGTH];
+    pocl_cmd_image_arg_key(RunCommand, Device, ImageKey);
+    if (ImageKey[0] != 0) {
+      std::string ImageArgs;
+      pocl_kernel_metadata_t *Meta = Kernel->meta;
+      for (unsigned I = 0; I < Meta->num_args; ++I) {
+        struct pocl_argument *Arg = &RunCommand->arguments[I];
+        if (Meta->arg_info[I].type == POCL_ARG_TYPE_IMAGE) {
+          dev_image_t Image;
+          pocl_fill_dev_image_t(&Image, Arg, Device);
+          ImageArgs += "i" + std::to_string(I) + ":" +
+                       std::to_string(Image._order) + ":" +
+                       std::to_string(Image._data_type) + ":" +
+                       std::to_string(Image._num_channels) + ":" +
+                       std::to_string(Image._elem_size) + ";";
+        } else if (Meta->arg_info[I].type == POCL_ARG_TYPE_SAMPLER) {
+          dev_sampler_t Sampler;
+          pocl_fill_dev_sampler_t(&Sampler, Arg);
+          ImageArgs += "s" + std::to_string(I) + ":" +
+                       std::to_string((unsigned long)Sampler) + ";";
+        }
+      }
+      setModuleStringMetadata(Bitcode, "WGImageArgs", ImageArgs.c_str());
+    }
+
+    // The buffer arguments larger than the last level cache; see
+    // pocl_cmd_streaming_store_key() and the streaming-stores pass.
+    char StreamingKey[POCL_STREAMING_STORE_KEY_LENGTH];
+    pocl_cmd_streaming_store_key(RunCommand, Device, StreamingKey);
+    if (StreamingKey[0] != 0) {
+      std::string StreamingArgs;
+      for (const char *P = StreamingKey; *P != 0; P += 2)
+        StreamingArgs +=
+            std::to_string(std::stoul(std::string(P, 2), nullptr, 16)) + ";";
+      setModuleStringMetadata(Bitcode, "WGStreamingStoreArgs",
+                              StreamingArgs.c_str());
+    }
+  }
+
   setModuleIntMetadata(Bitcode, "device_global_as_id", Device->global_as_id);
   setModuleIntMetadata(Bitcode, "device_local_as_id", Device->local_as_id);
   setModuleIntMetadata(Bitcode, "device_constant_as_id",
@@ -1097,6 +1205,8 @@ static int pocl_llvm_run_pocl_passes(llvm::Module *Bitcode,
 
   setModuleBoolMetadata(Bitcode, "device_side_printf",
                         Device->device_side_printf);
+  setModuleBoolMetadata(Bitcode, "device_deferred_printf",
+                        Device->deferred_printf);
   setModuleBoolMetadata(Bitcode, "device_alloca_locals",
                         Device->device_alloca_locals);
   setModuleIntMetadata(Bitcode, "device_autolocals_to_args",
@@ -1115,7 +1225,7 @@ static int pocl_llvm_run_pocl_passes(llvm::Module *Bitcode,
   llvm::TimePassesIsEnabled = true;
 #endif
   POCL_MEASURE_START(llvm_workgroup_ir_func_gen);
-  runKernelCompilerPasses(Device, *Bitcode);
+  runKernelCompilerPasses(Device, *Bitcode, Stats);
   POCL_MEASURE_FINISH(llvm_workgroup_ir_func_gen);
 #ifdef DUMP_LLVM_PASS_TIMINGS
   llvm::reportAndResetTimings();
@@ -1129,6 +1239,221 @@ static int pocl_llvm_run_pocl_passes(llvm::Module *Bitcode,
   return 0;
 }
 
+// Appends the work-item context data footprint the work-item handler
+// recorded to the module metadata to the build log of the program. Kernels
+// without context data are not reported.
+static void reportContextFootprint(llvm::Module *Bitcode, cl_kernel Kernel,
+                                   cl_program Program, unsigned DeviceI) {
+  unsigned long Values, Arrays, BytesPerWI, Bytes;
+  if (!getModuleIntMetadata(*Bitcode, "WGContextArrays", Arrays) ||
+      Arrays == 0)
+    return;
+  getModuleIntMetadata(*Bitcode, "WGContextValues", Values);
+  getModuleIntMetadata(*Bitcode, "WGContextBytesPerWI", BytesPerWI);
+  getModuleIntMetadata(*Bitcode, "WGContextBytes", Bytes);
+
+  unsigned long LocalSize[3];
+  getModuleIntMetadata(*Bitcode, "WGLocalSizeX", LocalSize[0]);
+  getModuleIntMetadata(*Bitcode, "WGLocalSizeY", LocalSize[1]);
+  getModuleIntMetadata(*Bitcode, "WGLocalSizeZ", LocalSize[2]);
+
+  std::string Report = "kernel '" + std::string(Kernel->name) + "' ";
+  if (LocalSize[0] == 0)
+    Report += "(dynamic local size): ";
+  else
+    Report += "(local size " + std::to_string(LocalSize[0]) + "x" +
+              std::to_string(LocalSize[1]) + "x" +
+              std::to_string(LocalSize[2]) + "): ";
+  Report += std::to_string(Arrays) + " context arrays for " +
+            std::to_string(Values) + " values, " +
+            std::to_string(BytesPerWI) + " bytes per work-item";
+  if (LocalSize[0] != 0)
+    Report += ", " + std::to_string(Bytes) + " bytes total";
+  Report += "\n";
+
+  POCL_MSG_PRINT_LLVM("%s", Report.c_str());
+  pocl_append_to_buildlog(Program, DeviceI, strdup(Report.c_str()),
+                          Report.size());
+}
+
+// Appends the number of loads the prefetch-wi-loads pass prefetched to the
+// build log of the program. Kernels without prefetches are not reported.
+static void reportPrefetches(llvm::Module *Bitcode, cl_kernel Kernel,
+                             cl_program Program, unsigned DeviceI) {
+  unsigned long Loads, Distance = 0;
+  if (!getModuleIntMetadata(*Bitcode, "WGPrefetchedLoads", Loads) ||
+      Loads == 0)
+    return;
+  getModuleIntMetadata(*Bitcode, "WGPrefetchDistance", Distance);
+
+  std::string Report = "kernel '" + std::string(Kernel->name) + "': " +
+                       std::to_string(Loads) + " loads prefetched " +
+                       std::to_string(Distance) + " work-items ahead\n";
+
+  POCL_MSG_PRINT_LLVM("%s", Report.c_str());
+  pocl_append_to_buildlog(Program, DeviceI, strdup(Report.c_str()),
+                          Report.size());
+}
+
+// Appends the number of stores the streaming-stores pass made non-temporal
+// to the build log of the program. Kernels without them are not reported.
+static void reportNontemporalStores(llvm::Module *Bitcode, cl_kernel Kernel,
+                                    cl_program Program, unsigned DeviceI) {
+  unsigned long Stores, Buffers = 0;
+  if (!getModuleIntMetadata(*Bitcode, "WGNontemporalStores", Stores) ||
+      Stores == 0)
+    return;
+  getModuleIntMetadata(*Bitcode, "WGNontemporalBuffers", Buffers);
+
+  std::string Report = "kernel '" + std::string(Kernel->name) + "': " +
+                       std::to_string(Stores) + " non-temporal stores to " +
+                       std::to_string(Buffers) + " buffers\n";
+
+  POCL_MSG_PRINT_LLVM("%s", Report.c_str());
+  pocl_append_to_buildlog(Program, DeviceI, strdup(Report.c_str()),
+                          Report.size());
+}
+
+// Appends the number of calls to the vector math overloads the loop
+// vectorizer made to the build log of the program. Kernels without them are
+// not reported.
+static void reportVectorMathCalls(llvm::Module *Bitcode, cl_kernel Kernel,
+                                  cl_program Program, unsigned DeviceI) {
+  unsigned long Calls;
+  if (!getModuleIntMetadata(*Bitcode, "WGVectorMathCalls", Calls) ||
+      Calls == 0)
+    return;
+
+  std::string Report = "kernel '" + std::string(Kernel->name) + "': " +
+                       std::to_string(Calls) + " vector math calls\n";
+
+  POCL_MSG_PRINT_LLVM("%s", Report.c_str());
+  pocl_append_to_buildlog(Program, DeviceI, strdup(Report.c_str()),
+                          Report.size());
+}
+
+// Appends the number of collective function calls the lower-collectives pass
+// lowered to the build log of the program. Kernels without them are not
+// reported.
+static void reportLoweredCollectives(llvm::Module *Bitcode, cl_kernel Kernel,
+                                     cl_program Program, unsigned DeviceI) {
+  unsigned long Calls;
+  if (!getModuleIntMetadata(*Bitcode, "WGLoweredCollectives", Calls) ||
+      Calls == 0)
+    return;
+
+  std::string Report = "kernel '" + std::string(Kernel->name) + "': " +
+                       std::to_string(Calls) + " collectives lowered\n";
+
+  POCL_MSG_PRINT_LLVM("%s", Report.c_str());
+  pocl_append_to_buildlog(Program, DeviceI, strdup(Report.c_str()),
+                          Report.size());
+}
+
+// Appends the per-pass statistics of a kernel compilation to the build log
+// of the program.
+static void reportPassStats(const PassStatsRecorder *Stats, cl_program Program,
+                            unsigned DeviceI) {
+  if (Stats == nullptr)
+    return;
+  std::string Report = Stats->getReport();
+  POCL_MSG_PRINT_LLVM("%s", Report.c_str());
+  pocl_append_to_buildlog(Program, DeviceI, strdup(Report.c_str()),
+                          Report.size());
+}
+
+// Copies the producer and the consumer kernel of the fused kernel described
+// by Meta (with their callgraphs) from ProgramBC to Dst and replaces them
+// with the fused kernel.
+static llvm::Function *copyFusedKernelFromBitcode(llvm::Module *Dst,
+                                                  llvm::Module *ProgramBC,
+                                                  pocl_kernel_metadata_t *Meta,
+                                                  cl_device_id Device) {
+  pocl_fused_kernel_info *Fusion = Meta->fusion;
+
+  // copyKernelFromBitcode() copies all the global variables on each call,
+  // thus copy the consumer along with the producer as an "aux function".
+  std::vector<const char *> AuxFuncs;
+  AuxFuncs.push_back(Fusion->consumer);
+  if (Device->device_aux_functions != nullptr)
+    for (const char **F = Device->device_aux_functions; *F != nullptr; ++F)
+      AuxFuncs.push_back(*F);
+  AuxFuncs.push_back(nullptr);
+  copyKernelFromBitcode(Fusion->producer, Dst, ProgramBC, AuxFuncs.data());
+
+  llvm::Function *Producer = Dst->getFunction(Fusion->producer);
+  llvm::Function *Consumer = Dst->getFunction(Fusion->consumer);
+  if (Producer == nullptr || Consumer == nullptr)
+    return nullptr;
+  return pocl::createFusedKernel(*Dst, Producer, Consumer,
+                                 Fusion->consumer_arg_map, Meta->name);
+}
+
+int pocl_llvm_get_kernel_fusion_info(cl_program Program, unsigned DeviceI,
+                                     const char *KernelName,
+                                     pocl_fusion_arg_info *ArgInfo) {
+  cl_context ctx = Program->context;
+  PoclLLVMContextData *PoCLLLVMContext =
+      (PoclLLVMContextData *)ctx->llvm_context_data;
+  PoclCompilerMutexGuard lockHolder(&PoCLLLVMContext->Lock);
+
+  llvm::Module *ProgramBC = (llvm::Module *)Program->llvm_irs[DeviceI];
+  if (ProgramBC == nullptr)
+    return CL_INVALID_PROGRAM_EXECUTABLE;
+
+  std::unique_ptr<llvm::Module> KernelBC(
+      new llvm::Module(StringRef("fusion_bc"), *PoCLLLVMContext->Context));
+  KernelBC->setTargetTriple(ProgramBC->getTargetTriple());
+  KernelBC->setDataLayout(ProgramBC->getDataLayout());
+  copyKernelFromBitcode(KernelName, KernelBC.get(), ProgramBC, nullptr);
+  llvm::Function *K = KernelBC->getFunction(KernelName);
+  if (K == nullptr)
+    return CL_INVALID_KERNEL_NAME;
+
+  // The program IR has not been optimized: promote the allocas and
+  // canonicalize the address computations before looking at the accesses.
+  LoopAnalysisManager LAM;
+  FunctionAnalysisManager FAM;
+  CGSCCAnalysisManager CGAM;
+  ModuleAnalysisManager MAM;
+  PassBuilder PB;
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+  FunctionPassManager FPM;
+  FPM.addPass(PromotePass());
+  FPM.addPass(InstCombinePass());
+  FPM.run(*K, FAM);
+
+  return pocl::analyzeKernelForFusion(*K, ArgInfo) ? CL_SUCCESS
+                                                   : CL_INVALID_KERNEL;
+}
+
+int pocl_llvm_check_fused_kernel(cl_program Program, unsigned DeviceI,
+                                 pocl_kernel_metadata_t *Meta) {
+  cl_context ctx = Program->context;
+  cl_device_id Device = Program->devices[DeviceI];
+  PoclLLVMContextData *PoCLLLVMContext =
+      (PoclLLVMContextData *)ctx->llvm_context_data;
+  PoclCompilerMutexGuard lockHolder(&PoCLLLVMContext->Lock);
+
+  llvm::Module *ProgramBC = (llvm::Module *)Program->llvm_irs[DeviceI];
+  if (ProgramBC == nullptr)
+    return CL_INVALID_PROGRAM_EXECUTABLE;
+
+  std::unique_ptr<llvm::Module> FusedBC(
+      new llvm::Module(StringRef("fusion_bc"), *PoCLLLVMContext->Context));
+  FusedBC->setTargetTriple(ProgramBC->getTargetTriple());
+  FusedBC->setDataLayout(ProgramBC->getDataLayout());
+  if (copyFusedKernelFromBitcode(FusedBC.get(), ProgramBC, Meta, Device) ==
+          nullptr ||
+      llvm::verifyModule(*FusedBC, nullptr))
+    return CL_BUILD_PROGRAM_FAILURE;
+  return CL_SUCCESS;
+}
+
 int pocl_llvm_generate_workgroup_function_nowrite(
     unsigned DeviceI, cl_device_id Device, cl_kernel Kernel,
     _cl_command_node *Command, void **Output, int Specialize) {
@@ -1157,12 +1482,32 @@ int pocl_llvm_generate_workgroup_function_nowrite(
   ParallelBC->setTargetTriple(ProgramBC->getTargetTriple());
   ParallelBC->setDataLayout(ProgramBC->getDataLayout());
 
-  copyKernelFromBitcode(Kernel->name, ParallelBC, ProgramBC,
-                        Device->device_aux_functions);
+  if (Kernel->meta->fusion != nullptr) {
+    if (copyFusedKernelFromBitcode(ParallelBC, ProgramBC, Kernel->meta,
+                                   Device) == nullptr) {
+      delete ParallelBC;
+      *Output = nullptr;
+      return CL_BUILD_PROGRAM_FAILURE;
+    }
+  } else
+    copyKernelFromBitcode(Kernel->name, ParallelBC, ProgramBC,
+                          Device->device_aux_functions);
 
-  int res =
-      pocl_llvm_run_pocl_passes(ParallelBC, RunCommand, LLVMContext,
-                                PoCLLLVMContext, Kernel, Device, Specialize);
+  std::unique_ptr<PassStatsRecorder> Stats;
+  if (PassStatsRecorder::isEnabled())
+    Stats.reset(new PassStatsRecorder(Kernel->name));
+
+  int res = pocl_llvm_run_pocl_passes(ParallelBC, RunCommand, LLVMContext,
+                                      PoCLLLVMContext, Kernel, Device,
+                                      Specialize, Stats.get());
+  if (res == 0) {
+    reportContextFootprint(ParallelBC, Kernel, Program, DeviceI);
+    reportPrefetches(ParallelBC, Kernel, Program, DeviceI);
+    reportNontemporalStores(ParallelBC, Kernel, Program, DeviceI);
+    reportVectorMathCalls(ParallelBC, Kernel, Program, DeviceI);
+    reportLoweredCollectives(ParallelBC, Kernel, Program, DeviceI);
+    reportPassStats(Stats.get(), Program, DeviceI);
+  }
 
   std::string FinalizerCommand =
       pocl_get_string_option("POCL_BITCODE_FINALIZER", "");
@@ -1219,12 +1564,20 @@ int pocl_llvm_run_passes_on_program(cl_program Program, unsigned DeviceI) {
   llvm::LLVMContext *LLVMContext = PoCLLLVMContext->Context;
   PoclCompilerMutexGuard lockHolder(&PoCLLLVMContext->Lock);
 
-  return pocl_llvm_run_pocl_passes(ProgramBC,
-                                   nullptr, // RunCommand,
-                                   LLVMContext, PoCLLLVMContext,
-                                   nullptr, // Kernel,
-                                   Device,
-                                   0); // Specialize
+  std::unique_ptr<PassStatsRecorder> Stats;
+  if (PassStatsRecorder::isEnabled())
+    Stats.reset(new PassStatsRecorder("program"));
+
+  int res = pocl_llvm_run_pocl_passes(ProgramBC,
+                                      nullptr, // RunCommand,
+                                      LLVMContext, PoCLLLVMContext,
+                                      nullptr, // Kernel,
+                                      Device,
+                                      0, // Specialize
+                                      Stats.get());
+  if (res == 0)
+    reportPassStats(Stats.get(), Program, DeviceI);
+  return res;
 }
 
 int pocl_llvm_generate_workgroup_function(unsigned DeviceI, cl_device_id Device,
@@ -1427,7 +1780,7 @@ int pocl_llvm_codegen(cl_device_id Device, cl_program program, void *Modp,
 }
 
 void populateModulePM(void *Passes, void *Module, unsigned OptL, unsigned SizeL,
-                      bool Vectorize) {
+                      bool Vectorize, PassInstrumentationCallbacks *PIC) {
   // Create the analysis managers.
   LoopAnalysisManager LAM;
   FunctionAnalysisManager FAM;
@@ -1438,7 +1791,11 @@ void populateModulePM(void *Passes, void *Module, unsigned OptL, unsigned SizeL,
   // Take a look at the PassBuilder constructor parameters for more
   // customization, e.g. specifying a TargetMachine or various debugging
   // options.
-  PassBuilder PB;
+#if LLVM_MAJOR < 16
+  PassBuilder PB(nullptr, PipelineTuningOptions(), None, PIC);
+#else
+  PassBuilder PB(nullptr, PipelineTuningOptions(), std::nullopt, PIC);
+#endif
 
   // Register all the basic analyses with the managers.
   PB.registerModuleAnalyses(MAM);
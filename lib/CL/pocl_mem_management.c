@@ -23,9 +23,306 @@
 
 #include "pocl_mem_management.h"
 #include "pocl.h"
+#include "pocl_runtime_config.h"
+#include "pocl_util.h"
 #include "utlist.h"
 #include <string.h>
 
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include "vccompat.hpp"
+#endif
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+/* Pool of the host memory backing buffers (mem_host_ptr), which is also the
+   device memory of the CPU devices. Released blocks of 64 KiB to 16 MiB are
+   kept in per-size-class free lists and reused by later buffers, avoiding the
+   malloc, page fault and page zeroing costs of short-lived buffers. */
+
+#define HOST_BUFFER_MIN_SIZE (64 * 1024)
+#define HOST_BUFFER_MAX_SIZE (16 * 1024 * 1024)
+/* Block alignment, enough for any context's min_buffer_alignment. */
+#define HOST_BUFFER_ALIGN 4096
+/* Four size classes per power of two, 64 KiB ... 16 MiB. */
+#define HOST_BUFFER_CLASSES 33
+
+/* The allocation policies apply to buffers of at least this size. */
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+/* Each pre-faulting thread touches at least this much. */
+#define PREFAULT_MIN_SLICE (64 * 1024 * 1024)
+#define PREFAULT_MAX_THREADS 16
+
+typedef struct _host_buffer_block
+{
+  struct _host_buffer_block *next;
+} host_buffer_block;
+
+static struct
+{
+  pocl_lock_t lock;
+  int initialized;
+  size_t max_retained;
+  cl_bitfield default_policy;
+  size_t retained;
+  size_t max_ever_retained;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t trimmed;
+  host_buffer_block *free_lists[HOST_BUFFER_CLASSES];
+} host_buffer_pool = { POCL_LOCK_INITIALIZER };
+
+static size_t
+host_buffer_class_size (unsigned c)
+{
+  return (size_t)(4 + (c & 3)) << (14 + (c >> 2));
+}
+
+/* Returns the smallest size class that fits the size. */
+static unsigned
+host_buffer_class (size_t size)
+{
+  if (size <= HOST_BUFFER_MIN_SIZE)
+    return 0;
+  unsigned msb = 63 - __builtin_clzll ((unsigned long long)size - 1);
+  unsigned sub = ((size - 1) >> (msb - 2)) & 3;
+  return (msb - 16) * 4 + sub + 1;
+}
+
+/* Must be called with the pool lock held. */
+static void
+host_buffer_pool_init ()
+{
+  if (host_buffer_pool.initialized)
+    return;
+  host_buffer_pool.max_retained
+      = (size_t)pocl_get_int_option ("POCL_HOST_BUFFER_POOL_MB", 32) << 20;
+  if (pocl_get_bool_option ("POCL_HOST_BUFFER_HUGE_PAGES", 0))
+    host_buffer_pool.default_policy |= CL_MEM_ALLOC_HUGE_PAGES_POCL;
+  if (pocl_get_bool_option ("POCL_HOST_BUFFER_PREFAULT", 0))
+    host_buffer_pool.default_policy |= CL_MEM_ALLOC_PREFAULT_POCL;
+  host_buffer_pool.initialized = 1;
+}
+
+typedef struct
+{
+  char *start;
+  size_t size;
+} prefault_slice;
+
+static void *
+prefault_thread (void *arg)
+{
+  prefault_slice *slice = (prefault_slice *)arg;
+  for (size_t off = 0; off < slice->size; off += 4096)
+    ((volatile char *)slice->start)[off] = 0;
+  return NULL;
+}
+
+/* Touches every page of a new allocation. Large allocations are split
+   between threads running on different CPUs, which also spreads the pages
+   over the NUMA nodes the CPU devices' worker threads run on. */
+static void
+host_buffer_prefault (char *ptr, size_t size)
+{
+  pthread_t threads[PREFAULT_MAX_THREADS];
+  prefault_slice slices[PREFAULT_MAX_THREADS];
+  long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+  size_t num_threads = size / PREFAULT_MIN_SLICE;
+  if (num_threads > (size_t)cpus)
+    num_threads = cpus;
+  if (num_threads > PREFAULT_MAX_THREADS)
+    num_threads = PREFAULT_MAX_THREADS;
+  if (num_threads < 2)
+    {
+      prefault_slice all = { ptr, size };
+      prefault_thread (&all);
+      return;
+    }
+
+  /* page-aligned slices */
+  size_t slice_size = (size / num_threads + 4095) & ~(size_t)4095;
+  size_t started = 0;
+  for (size_t i = 0; i < num_threads; ++i)
+    {
+      size_t start = i * slice_size;
+      slices[i].start = ptr + start;
+      slices[i].size = (start + slice_size > size) ? size - start : slice_size;
+      /* the calling thread does the first slice */
+      if (i > 0
+          && pthread_create (&threads[i], NULL, prefault_thread, &slices[i])
+                 == 0)
+        started |= (size_t)1 << i;
+    }
+  prefault_thread (&slices[0]);
+  for (size_t i = 1; i < num_threads; ++i)
+    {
+      if (started & ((size_t)1 << i))
+        PTHREAD_CHECK (pthread_join (threads[i], NULL));
+      else
+        prefault_thread (&slices[i]);
+    }
+}
+
+/* Applies the allocation policy to a new allocation. */
+static void
+host_buffer_apply_policy (void *ptr, size_t size, cl_bitfield policy)
+{
+#ifdef MADV_HUGEPAGE
+  if (policy & CL_MEM_ALLOC_HUGE_PAGES_POCL)
+    madvise (ptr, size & ~(size_t)(HUGE_PAGE_SIZE - 1), MADV_HUGEPAGE);
+#endif
+  if (policy & CL_MEM_ALLOC_PREFAULT_POCL)
+    host_buffer_prefault ((char *)ptr, size);
+}
+
+cl_bitfield
+pocl_mem_manager_default_alloc_policy ()
+{
+  POCL_LOCK (host_buffer_pool.lock);
+  host_buffer_pool_init ();
+  cl_bitfield policy = host_buffer_pool.default_policy;
+  POCL_UNLOCK (host_buffer_pool.lock);
+  return policy;
+}
+
+/* Frees retained blocks, largest first, until at most keep bytes remain.
+   Must be called with the pool lock held. */
+static void
+host_buffer_pool_trim (size_t keep)
+{
+  int c;
+  for (c = HOST_BUFFER_CLASSES - 1;
+       c >= 0 && host_buffer_pool.retained > keep; --c)
+    {
+      while (host_buffer_pool.free_lists[c] != NULL
+             && host_buffer_pool.retained > keep)
+        {
+          host_buffer_block *b = host_buffer_pool.free_lists[c];
+          host_buffer_pool.free_lists[c] = b->next;
+          host_buffer_pool.retained -= host_buffer_class_size (c);
+          host_buffer_pool.trimmed++;
+          pocl_aligned_free (b);
+        }
+    }
+}
+
+void *
+pocl_mem_manager_alloc_host_buffer (size_t align, size_t size,
+                                    cl_bitfield policy)
+{
+  void *ptr = NULL;
+  if (size < HUGE_PAGE_SIZE)
+    policy = 0;
+  if ((policy & CL_MEM_ALLOC_HUGE_PAGES_POCL) && align < HUGE_PAGE_SIZE)
+    align = HUGE_PAGE_SIZE;
+
+  if (size < HOST_BUFFER_MIN_SIZE || size > HOST_BUFFER_MAX_SIZE)
+    {
+      ptr = pocl_aligned_malloc (align, size);
+      if (ptr != NULL)
+        host_buffer_apply_policy (ptr, size, policy);
+      return ptr;
+    }
+
+  /* Blocks in the pooled size range always have the full class size and at
+     least HOST_BUFFER_ALIGN alignment, so any of them can be put back. */
+  unsigned c = host_buffer_class (size);
+  POCL_LOCK (host_buffer_pool.lock);
+  host_buffer_pool_init ();
+  /* reused blocks have been faulted in already, but might lack the
+     huge page alignment */
+  if (align <= HOST_BUFFER_ALIGN && host_buffer_pool.free_lists[c] != NULL)
+    {
+      host_buffer_block *b = host_buffer_pool.free_lists[c];
+      host_buffer_pool.free_lists[c] = b->next;
+      host_buffer_pool.retained -= host_buffer_class_size (c);
+      host_buffer_pool.hits++;
+      ptr = b;
+    }
+  else
+    host_buffer_pool.misses++;
+  POCL_UNLOCK (host_buffer_pool.lock);
+  if (ptr != NULL)
+    return ptr;
+
+  if (align < HOST_BUFFER_ALIGN)
+    align = HOST_BUFFER_ALIGN;
+  ptr = pocl_aligned_malloc (align, host_buffer_class_size (c));
+  if (ptr == NULL)
+    {
+      /* give the retained memory back and retry */
+      POCL_LOCK (host_buffer_pool.lock);
+      host_buffer_pool_trim (0);
+      POCL_UNLOCK (host_buffer_pool.lock);
+      ptr = pocl_aligned_malloc (align, host_buffer_class_size (c));
+    }
+  if (ptr != NULL)
+    host_buffer_apply_policy (ptr, host_buffer_class_size (c), policy);
+  return ptr;
+}
+
+void
+pocl_mem_manager_free_host_buffer (void *ptr, size_t size)
+{
+  if (ptr == NULL)
+    return;
+  if (size < HOST_BUFFER_MIN_SIZE || size > HOST_BUFFER_MAX_SIZE)
+    {
+      pocl_aligned_free (ptr);
+      return;
+    }
+
+  unsigned c = host_buffer_class (size);
+  size_t class_size = host_buffer_class_size (c);
+  POCL_LOCK (host_buffer_pool.lock);
+  host_buffer_pool_init ();
+  /* The most recently released blocks are the likeliest to be reused, so
+     make room for this one by giving back older ones. */
+  if (class_size <= host_buffer_pool.max_retained
+      && host_buffer_pool.retained + class_size
+             > host_buffer_pool.max_retained)
+    host_buffer_pool_trim (host_buffer_pool.max_retained - class_size);
+  if (host_buffer_pool.retained + class_size <= host_buffer_pool.max_retained)
+    {
+      host_buffer_block *b = (host_buffer_block *)ptr;
+      b->next = host_buffer_pool.free_lists[c];
+      host_buffer_pool.free_lists[c] = b;
+      host_buffer_pool.retained += class_size;
+      if (host_buffer_pool.max_ever_retained < host_buffer_pool.retained)
+        host_buffer_pool.max_ever_retained = host_buffer_pool.retained;
+      ptr = NULL;
+    }
+  else
+    host_buffer_pool.trimmed++;
+  POCL_UNLOCK (host_buffer_pool.lock);
+  pocl_aligned_free (ptr);
+}
+
+void
+pocl_mem_manager_trim_host_buffers (size_t keep)
+{
+  POCL_LOCK (host_buffer_pool.lock);
+  host_buffer_pool_trim (keep);
+  POCL_UNLOCK (host_buffer_pool.lock);
+}
+
+void
+pocl_mem_manager_host_buffer_stats (pocl_host_buffer_stats *stats)
+{
+  POCL_LOCK (host_buffer_pool.lock);
+  stats->retained = host_buffer_pool.retained;
+  stats->max_ever_retained = host_buffer_pool.max_ever_retained;
+  stats->max_retained = host_buffer_pool.max_retained;
+  stats->hits = host_buffer_pool.hits;
+  stats->misses = host_buffer_pool.misses;
+  stats->trimmed = host_buffer_pool.trimmed;
+  POCL_UNLOCK (host_buffer_pool.lock);
+}
+
 #ifndef USE_POCL_MEMMANAGER
 
 cl_event pocl_mem_manager_new_event ()
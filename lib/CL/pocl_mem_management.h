@@ -27,6 +27,38 @@
 #pragma GCC visibility push(hidden)
 #endif
 
+typedef struct
+{
+  size_t retained;
+  size_t max_ever_retained;
+  size_t max_retained;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t trimmed;
+} pocl_host_buffer_stats;
+
+/* Allocates host memory for buffer contents, reusing a released block
+   of a similar size if one is available. policy is a bitfield of
+   cl_mem_alloc_policy_pocl flags, applied to new allocations of at
+   least 2 MiB. */
+void *pocl_mem_manager_alloc_host_buffer (size_t align, size_t size,
+                                          cl_bitfield policy);
+
+/* Releases memory allocated with pocl_mem_manager_alloc_host_buffer();
+   size must be the size it was allocated with. */
+void pocl_mem_manager_free_host_buffer (void *ptr, size_t size);
+
+/* The allocation policy for buffers created without CL_MEM_ALLOC_POLICY_POCL,
+   from the POCL_HOST_BUFFER_HUGE_PAGES and POCL_HOST_BUFFER_PREFAULT
+   options. */
+cl_bitfield pocl_mem_manager_default_alloc_policy ();
+
+/* Frees the released blocks kept for reuse until at most keep bytes
+   remain. */
+void pocl_mem_manager_trim_host_buffers (size_t keep);
+
+void pocl_mem_manager_host_buffer_stats (pocl_host_buffer_stats *stats);
+
 #ifdef USE_POCL_MEMMANAGER
 
 void pocl_init_mem_manager (void);
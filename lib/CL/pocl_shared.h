@@ -75,7 +75,9 @@ compile_and_link_program(int compile_program,
 int context_set_properties (cl_context context,
                             const cl_context_properties *properties);
 
-cl_mem pocl_create_memobject (cl_context context, cl_mem_flags flags,
+cl_mem pocl_create_memobject (cl_context context,
+                              const cl_mem_properties *properties,
+                              cl_mem_flags flags,
                               size_t size, cl_mem_object_type type,
                               int *device_image_support, void *host_ptr,
                               int host_ptr_is_svm, cl_int *errcode_ret);
@@ -115,6 +117,10 @@ cl_int pocl_record_ndrange_kernel (
   const cl_sync_point_khr *sync_point_wait_list,
   cl_sync_point_khr *sync_point_p);
 
+/* Replaces pairs of consecutive kernel commands in a command buffer with a
+ * fused kernel where the kernel compiler can prove it safe. */
+void pocl_cmdbuf_fuse_kernels (cl_command_buffer_khr command_buffer);
+
 cl_int pocl_rect_copy (cl_command_buffer_khr command_buffer,
                        cl_command_queue command_queue,
                        cl_command_type command_type,
@@ -64,6 +64,19 @@ typedef pthread_t pocl_thread_t;
 #error Need atomic_inc() builtin for this compiler
 #endif
 
+/* Hints the CPU that the thread is busy-waiting. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define POCL_CPU_RELAX() __builtin_ia32_pause ()
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define POCL_CPU_RELAX() __asm__ __volatile__ ("yield")
+#else
+#define POCL_CPU_RELAX()                                                      \
+  do                                                                          \
+    {                                                                         \
+    }                                                                         \
+  while (0)
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -98,6 +111,8 @@ extern "C"
    OpenCL (host) objects. */
 
 #define POCL_LOCK(__LOCK__) PTHREAD_CHECK (pthread_mutex_lock (&(__LOCK__)))
+/* Returns 0 if the lock was taken, nonzero if it is held by someone else. */
+#define POCL_TRYLOCK(__LOCK__) pthread_mutex_trylock (&(__LOCK__))
 #define POCL_UNLOCK(__LOCK__)                                                 \
   PTHREAD_CHECK (pthread_mutex_unlock (&(__LOCK__)))
 #define POCL_INIT_LOCK(__LOCK__)                                              \
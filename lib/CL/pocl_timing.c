@@ -49,6 +49,14 @@
 
 #include "pocl_timing.h"
 
+#if defined(HAVE_CLOCK_GETTIME) && defined(__GNUC__) && defined(__x86_64__)
+#  define POCL_TSC_CLOCK
+#  include <cpuid.h>
+#  include <stdlib.h>
+#  include <string.h>
+#  include <x86intrin.h>
+#endif
+
 #ifdef HAVE_CLOCK_GETTIME
 // clock_gettime is (at best) nanosec res
 const unsigned pocl_timer_resolution = 1;
@@ -63,8 +71,9 @@ const unsigned pocl_timer_resolution = 1000;
 #endif
 
 
-uint64_t pocl_gettimemono_ns() {
-
+static uint64_t
+pocl_gettimemono_os_ns ()
+{
 #ifdef HAVE_CLOCK_GETTIME
   struct timespec timespec;
 # ifdef CLOCK_MONOTONIC_RAW /* Linux */
@@ -107,6 +116,188 @@ uint64_t pocl_gettimemono_ns() {
 #endif
 }
 
+#ifdef POCL_TSC_CLOCK
+
+/* A monotonic clock computed from the invariant time stamp counter, which
+   is much cheaper to read than clock_gettime(), which may end up in a
+   syscall. The TSC frequency is first measured against the OS clock over
+   POCL_TSC_CALIBRATION_NS nanoseconds, during which the OS clock is used.
+   After that the frequency is re-measured over the whole time since the
+   start whenever that has doubled (up to POCL_TSC_MAX_RECALIBRATION_NS
+   apart), making it more accurate. The time is always extrapolated from the
+   previous parameters' value at the switch, so the clock never jumps. */
+
+#define POCL_TSC_CALIBRATION_NS 20000000
+#define POCL_TSC_MAX_RECALIBRATION_NS 20000000000ULL
+
+enum
+{
+  TSC_UNINITIALIZED = 0,
+  TSC_INITIALIZING,
+  TSC_CALIBRATING,
+  TSC_READY,
+  TSC_UNAVAILABLE
+};
+
+static struct
+{
+  int state;
+  /* set while a thread is recalibrating */
+  int recalibrating;
+  /* odd while the parameters below are being updated */
+  unsigned seq;
+  uint64_t start_tsc, start_ns;
+  uint64_t base_tsc, base_ns;
+  /* nanoseconds per tick, fixed point with 32 fractional bits */
+  uint64_t mult;
+  /* the TSC value at which to measure the frequency again */
+  uint64_t next_tsc;
+} tsc_clock;
+
+static int
+tsc_is_invariant ()
+{
+  unsigned eax, ebx, ecx, edx;
+  /* pocld also uses this file, so the pocl option parser isn't available */
+  const char *env = getenv ("POCL_TSC_CLOCK");
+  if (env != NULL && (strcmp (env, "0") == 0 || strcmp (env, "false") == 0))
+    return 0;
+  if (!__get_cpuid (0x80000007, &eax, &ebx, &ecx, &edx))
+    return 0;
+  return (edx & (1u << 8)) != 0;
+}
+
+/* Samples the TSC and the OS clock at (nearly) the same time. */
+static void
+tsc_sample (uint64_t *tsc, uint64_t *ns)
+{
+  uint64_t before = __rdtsc ();
+  *ns = pocl_gettimemono_os_ns ();
+  uint64_t after = __rdtsc ();
+  *tsc = before + (after - before) / 2;
+}
+
+#define TSC_LOAD(x) __atomic_load_n (&tsc_clock.x, __ATOMIC_RELAXED)
+#define TSC_STORE(x, v) __atomic_store_n (&tsc_clock.x, v, __ATOMIC_RELAXED)
+
+/* Converts a TSC value to nanoseconds with the current parameters. */
+static uint64_t
+tsc_to_ns (uint64_t tsc, uint64_t *next_tsc)
+{
+  unsigned seq;
+  uint64_t ns;
+  do
+    {
+      seq = __atomic_load_n (&tsc_clock.seq, __ATOMIC_ACQUIRE);
+      uint64_t base_tsc = TSC_LOAD (base_tsc);
+      uint64_t ticks = tsc > base_tsc ? tsc - base_tsc : 0;
+      ns = TSC_LOAD (base_ns)
+           + (uint64_t)(((unsigned __int128)ticks * TSC_LOAD (mult)) >> 32);
+      *next_tsc = TSC_LOAD (next_tsc);
+      __atomic_thread_fence (__ATOMIC_ACQUIRE);
+    }
+  while ((seq & 1) || seq != __atomic_load_n (&tsc_clock.seq, __ATOMIC_RELAXED));
+  return ns;
+}
+
+/* Measures the TSC frequency over the time since the first sample, and
+   continues the clock from the value the old parameters give at tsc. */
+static uint64_t
+tsc_calibrate (uint64_t tsc, uint64_t ns, uint64_t base_ns)
+{
+  unsigned __int128 elapsed_ns = ns - tsc_clock.start_ns;
+  uint64_t elapsed_ticks = tsc - tsc_clock.start_tsc;
+  uint64_t mult = (uint64_t)((elapsed_ns << 32) / elapsed_ticks);
+  uint64_t max_ticks
+      = (uint64_t)(((unsigned __int128)POCL_TSC_MAX_RECALIBRATION_NS << 32)
+                   / mult);
+
+  __atomic_fetch_add (&tsc_clock.seq, 1, __ATOMIC_ACQ_REL);
+  TSC_STORE (base_tsc, tsc);
+  TSC_STORE (base_ns, base_ns);
+  TSC_STORE (mult, mult);
+  TSC_STORE (next_tsc,
+             tsc + (elapsed_ticks < max_ticks ? elapsed_ticks : max_ticks));
+  __atomic_fetch_add (&tsc_clock.seq, 1, __ATOMIC_RELEASE);
+  return base_ns;
+}
+
+static uint64_t
+tsc_clock_ns ()
+{
+  uint64_t tsc, ns, next_tsc;
+  int state = __atomic_load_n (&tsc_clock.state, __ATOMIC_ACQUIRE);
+  int expected;
+
+  if (state == TSC_READY)
+    {
+      tsc = __rdtsc ();
+      ns = tsc_to_ns (tsc, &next_tsc);
+      expected = 0;
+      if (tsc >= next_tsc
+          && __atomic_compare_exchange_n (&tsc_clock.recalibrating,
+                                          &expected, 1, 0, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED))
+        {
+          uint64_t os_ns;
+          tsc_sample (&tsc, &os_ns);
+          ns = tsc_calibrate (tsc, os_ns, tsc_to_ns (tsc, &next_tsc));
+          __atomic_store_n (&tsc_clock.recalibrating, 0, __ATOMIC_RELEASE);
+        }
+      return ns;
+    }
+  if (state == TSC_UNAVAILABLE)
+    return pocl_gettimemono_os_ns ();
+
+  expected = TSC_UNINITIALIZED;
+  if (state == TSC_UNINITIALIZED
+      && __atomic_compare_exchange_n (&tsc_clock.state, &expected,
+                                      TSC_INITIALIZING, 0, __ATOMIC_ACQ_REL,
+                                      __ATOMIC_ACQUIRE))
+    {
+      if (!tsc_is_invariant ())
+        {
+          __atomic_store_n (&tsc_clock.state, TSC_UNAVAILABLE,
+                            __ATOMIC_RELEASE);
+          return pocl_gettimemono_os_ns ();
+        }
+      tsc_sample (&tsc_clock.start_tsc, &tsc_clock.start_ns);
+      __atomic_store_n (&tsc_clock.state, TSC_CALIBRATING, __ATOMIC_RELEASE);
+      return tsc_clock.start_ns;
+    }
+
+  tsc_sample (&tsc, &ns);
+  expected = 0;
+  if (state == TSC_CALIBRATING
+      && ns - tsc_clock.start_ns >= POCL_TSC_CALIBRATION_NS
+      && __atomic_compare_exchange_n (&tsc_clock.recalibrating, &expected, 1,
+                                      0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    {
+      if (tsc > tsc_clock.start_tsc)
+        {
+          tsc_calibrate (tsc, ns, ns);
+          __atomic_store_n (&tsc_clock.state, TSC_READY, __ATOMIC_RELEASE);
+        }
+      else
+        __atomic_store_n (&tsc_clock.state, TSC_UNAVAILABLE,
+                          __ATOMIC_RELEASE);
+      __atomic_store_n (&tsc_clock.recalibrating, 0, __ATOMIC_RELEASE);
+    }
+  return ns;
+}
+
+#endif
+
+uint64_t
+pocl_gettimemono_ns ()
+{
+#ifdef POCL_TSC_CLOCK
+  return tsc_clock_ns ();
+#else
+  return pocl_gettimemono_os_ns ();
+#endif
+}
+
 int pocl_gettimereal(int *year, int *mon, int *day, int *hour, int *min, int *sec, int* nanosec)
 {
 #if defined(HAVE_CLOCK_GETTIME) || defined(__APPLE__) || defined(HAVE_GETTIMEOFDAY)
@@ -353,12 +353,305 @@ static const struct pocl_event_tracer text_logger = {
   text_tracer_event_updated,
 };
 
+//#################################################################
+/* Binary tracer: fixed-size records are written to per-thread ring buffers
+ * without locking, and a background thread writes them to the output file.
+ * Records are dropped (and counted) if a ring fills up between flushes.
+ *
+ * The file starts with the 8-byte magic "POCLTRC1" followed by the uint32
+ * record size, then contains struct bin_trace_record's in host byte order.
+ * tools/scripts/bintrace_to_json.py converts it to Chrome trace JSON.
+ */
+
+#define BIN_TRACER_MAGIC "POCLTRC1"
+/* records per ring, must be a power of two */
+#define BIN_TRACER_RING_SIZE 2048
+#define BIN_TRACER_FLUSH_INTERVAL_US 10000
+#define BIN_TRACER_MAX_DEVICES 64
+#define BIN_TRACER_NAME_LEN 48
+
+enum
+{
+  BIN_RECORD_EVENT = 1,
+  BIN_RECORD_DEVICE = 2
+};
+
+/* 128 bytes. For device records only device_id and name are set. */
+struct bin_trace_record
+{
+  uint32_t type;
+  uint32_t command_type;
+  uint64_t event_id;
+  uint64_t queue_id;
+  uint64_t device_id;
+  uint64_t time_queue;
+  uint64_t time_submit;
+  uint64_t time_start;
+  uint64_t time_end;
+  /* bytes accessed by buffer commands, work-items of kernel commands */
+  uint64_t size;
+  int32_t status;
+  uint32_t reserved;
+  /* kernel name for kernel commands, device name for device records */
+  char name[BIN_TRACER_NAME_LEN];
+};
+
+struct bin_trace_ring
+{
+  struct bin_trace_record records[BIN_TRACER_RING_SIZE];
+  /* advanced by the owning thread */
+  uint64_t head;
+  /* advanced by the flushing thread */
+  uint64_t tail;
+  uint64_t dropped;
+  struct bin_trace_ring *next;
+};
+
+static FILE *bin_tracer_file = NULL;
+static pthread_key_t bin_tracer_ring_key;
+static struct bin_trace_ring *bin_tracer_rings = NULL;
+static pthread_t bin_tracer_thread;
+static int bin_tracer_active = 0;
+static uint64_t bin_tracer_devices[BIN_TRACER_MAX_DEVICES];
+static uint64_t bin_tracer_devices_full = 0;
+
+/* Writes the pending records of all rings to the file. Only one thread at a
+   time may call this. */
+static void
+bin_tracer_drain ()
+{
+  struct bin_trace_ring *ring;
+  for (ring = POCL_ATOMIC_LOAD (bin_tracer_rings); ring; ring = ring->next)
+    {
+      uint64_t head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+      uint64_t tail = ring->tail;
+      while (tail != head)
+        {
+          uint64_t first = tail & (BIN_TRACER_RING_SIZE - 1);
+          uint64_t count = head - tail;
+          if (first + count > BIN_TRACER_RING_SIZE)
+            count = BIN_TRACER_RING_SIZE - first;
+          fwrite (&ring->records[first], sizeof (struct bin_trace_record),
+                  count, bin_tracer_file);
+          tail += count;
+        }
+      __atomic_store_n (&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+static void *
+bin_tracer_flush_thread (void *arg)
+{
+  while (POCL_ATOMIC_LOAD (bin_tracer_active))
+    {
+      bin_tracer_drain ();
+      usleep (BIN_TRACER_FLUSH_INTERVAL_US);
+    }
+  return NULL;
+}
+
+static void
+bin_tracer_destroy ()
+{
+  struct bin_trace_ring *ring;
+  uint64_t dropped = 0;
+
+  if (!POCL_ATOMIC_LOAD (bin_tracer_active))
+    return;
+  POCL_ATOMIC_STORE (bin_tracer_active, 0);
+  PTHREAD_CHECK (pthread_join (bin_tracer_thread, NULL));
+
+  bin_tracer_drain ();
+  for (ring = bin_tracer_rings; ring; ring = ring->next)
+    dropped += POCL_ATOMIC_LOAD (ring->dropped);
+  if (dropped > 0)
+    POCL_MSG_WARN ("BIN TRACER: %" PRIu64 " records were dropped because "
+                   "the ring buffers were full\n",
+                   dropped);
+  fclose (bin_tracer_file);
+  bin_tracer_file = NULL;
+  /* the rings are not freed, threads may still be tracing events */
+}
+
+static void
+bin_tracer_init ()
+{
+  uint32_t record_size = sizeof (struct bin_trace_record);
+  const char *output = pocl_get_string_option ("POCL_TRACING_OPT",
+                                               "pocl_trace_event.bin");
+  bin_tracer_file = fopen (output, "wb");
+  if (!bin_tracer_file)
+    POCL_ABORT ("Failed to open binary tracer output\n");
+  fwrite (BIN_TRACER_MAGIC, 1, 8, bin_tracer_file);
+  fwrite (&record_size, sizeof (record_size), 1, bin_tracer_file);
+
+  PTHREAD_CHECK (pthread_key_create (&bin_tracer_ring_key, NULL));
+  bin_tracer_active = 1;
+  PTHREAD_CHECK (pthread_create (&bin_tracer_thread, NULL,
+                                 bin_tracer_flush_thread, NULL));
+  atexit (bin_tracer_destroy);
+}
+
+static struct bin_trace_ring *
+bin_tracer_get_ring ()
+{
+  struct bin_trace_ring *ring = pthread_getspecific (bin_tracer_ring_key);
+  if (ring != NULL)
+    return ring;
+
+  ring = (struct bin_trace_ring *)calloc (1, sizeof (struct bin_trace_ring));
+  if (ring == NULL)
+    return NULL;
+  do
+    ring->next = POCL_ATOMIC_LOAD (bin_tracer_rings);
+  while (POCL_ATOMIC_CAS (&bin_tracer_rings, ring->next, ring) != ring->next);
+  PTHREAD_CHECK (pthread_setspecific (bin_tracer_ring_key, ring));
+  return ring;
+}
+
+/* Returns the ring slot for the next record, or NULL if the ring is full. */
+static struct bin_trace_record *
+bin_tracer_reserve (struct bin_trace_ring *ring)
+{
+  uint64_t head = ring->head;
+  if (head - __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE)
+      >= BIN_TRACER_RING_SIZE)
+    {
+      POCL_ATOMIC_INC (ring->dropped);
+      return NULL;
+    }
+  return &ring->records[head & (BIN_TRACER_RING_SIZE - 1)];
+}
+
+static void
+bin_tracer_commit (struct bin_trace_ring *ring)
+{
+  __atomic_store_n (&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+/* Emits a device record the first time an event of the device is seen.
+   Devices past the first BIN_TRACER_MAX_DEVICES get no record. */
+static void
+bin_tracer_note_device (struct bin_trace_ring *ring, cl_device_id dev)
+{
+  unsigned i;
+  for (i = 0; i < BIN_TRACER_MAX_DEVICES; ++i)
+    {
+      uint64_t id = POCL_ATOMIC_LOAD (bin_tracer_devices[i]);
+      if (id == dev->id)
+        return;
+      if (id == 0
+          && POCL_ATOMIC_CAS (&bin_tracer_devices[i], 0, dev->id) == 0)
+        break;
+    }
+  if (i == BIN_TRACER_MAX_DEVICES)
+    {
+      if (POCL_ATOMIC_CAS (&bin_tracer_devices_full, 0, 1) == 0)
+        POCL_MSG_WARN ("BIN TRACER: more than %d devices, the rest are "
+                       "traced without device records\n",
+                       BIN_TRACER_MAX_DEVICES);
+      return;
+    }
+
+  struct bin_trace_record *rec = bin_tracer_reserve (ring);
+  if (rec == NULL)
+    return;
+  memset (rec, 0, sizeof (*rec));
+  rec->type = BIN_RECORD_DEVICE;
+  rec->device_id = dev->id;
+  strncpy (rec->name, dev->long_name ? dev->long_name : dev->short_name,
+           BIN_TRACER_NAME_LEN - 1);
+  bin_tracer_commit (ring);
+}
+
+static uint64_t
+bin_tracer_command_size (cl_event event, _cl_command_node *node)
+{
+  _cl_command_t *cmd = &node->command;
+  switch (event->command_type)
+    {
+    case CL_COMMAND_NDRANGE_KERNEL:
+    case CL_COMMAND_TASK:
+      return cmd->run.pc.num_groups[0] * cmd->run.pc.local_size[0]
+             * cmd->run.pc.num_groups[1] * cmd->run.pc.local_size[1]
+             * cmd->run.pc.num_groups[2] * cmd->run.pc.local_size[2];
+    case CL_COMMAND_READ_BUFFER:
+      return cmd->read.size;
+    case CL_COMMAND_WRITE_BUFFER:
+      return cmd->write.size;
+    case CL_COMMAND_COPY_BUFFER:
+      return cmd->copy.size;
+    case CL_COMMAND_FILL_BUFFER:
+      return cmd->memfill.size;
+    case CL_COMMAND_READ_BUFFER_RECT:
+      return cmd->read_rect.region[0] * cmd->read_rect.region[1]
+             * cmd->read_rect.region[2];
+    case CL_COMMAND_WRITE_BUFFER_RECT:
+      return cmd->write_rect.region[0] * cmd->write_rect.region[1]
+             * cmd->write_rect.region[2];
+    case CL_COMMAND_COPY_BUFFER_RECT:
+      return cmd->copy_rect.region[0] * cmd->copy_rect.region[1]
+             * cmd->copy_rect.region[2];
+    case CL_COMMAND_MAP_BUFFER:
+      return cmd->map.mapping->size;
+    case CL_COMMAND_MIGRATE_MEM_OBJECTS:
+      return event->num_buffers > 0 ? event->mem_objs[0]->size : 0;
+    default:
+      return 0;
+    }
+}
+
+static void
+bin_tracer_event_updated (cl_event event, int status)
+{
+  /* the timestamps are complete only when the event has finished */
+  if (status > CL_COMPLETE || !POCL_ATOMIC_LOAD (bin_tracer_active))
+    return;
+
+  _cl_command_node *node = event->command;
+  if (node == NULL)
+    return;
+
+  struct bin_trace_ring *ring = bin_tracer_get_ring ();
+  if (ring == NULL)
+    return;
+  cl_device_id dev = event->queue->device;
+  bin_tracer_note_device (ring, dev);
+
+  struct bin_trace_record *rec = bin_tracer_reserve (ring);
+  if (rec == NULL)
+    return;
+  rec->type = BIN_RECORD_EVENT;
+  rec->command_type = event->command_type;
+  rec->event_id = event->id;
+  rec->queue_id = event->queue->id;
+  rec->device_id = dev->id;
+  rec->time_queue = event->time_queue;
+  rec->time_submit = event->time_submit;
+  rec->time_start = event->time_start;
+  rec->time_end = event->time_end;
+  rec->size = bin_tracer_command_size (event, node);
+  rec->status = status;
+  rec->reserved = 0;
+  memset (rec->name, 0, BIN_TRACER_NAME_LEN);
+  if (event->command_type == CL_COMMAND_NDRANGE_KERNEL
+      || event->command_type == CL_COMMAND_TASK)
+    strncpy (rec->name, node->command.run.kernel->name,
+             BIN_TRACER_NAME_LEN - 1);
+  bin_tracer_commit (ring);
+}
+
+static const struct pocl_event_tracer bin_tracer = {
+  "bin",
+  bin_tracer_init,
+  bin_tracer_destroy,
+  bin_tracer_event_updated,
+};
+
 static const struct pocl_event_tracer cq_profiler
     = { "cq", pocl_cq_profiling_init,
-        /* Avoid a callback after every event change to minimize impact to the
-           profiling run. Instead just store the event timestamps with as
-           little impact as possible for later collection/analysis. */
-        NULL, NULL };
+        /* the statistics are printed atexit() */
+        NULL, pocl_cq_profiling_event_updated };
 
 //#################################################################
 
@@ -531,6 +824,7 @@ static const struct pocl_event_tracer lttng_tracer = {
  */
 static const struct pocl_event_tracer *pocl_event_tracers[]
     = { &text_logger,
+        &bin_tracer,
 #ifdef HAVE_LTTNG_UST
         &lttng_tracer,
 #endif
@@ -74,6 +74,10 @@
 #include <x86intrin.h>
 #endif
 
+#if defined(__aarch64__) && defined(__GNUC__)
+#include <arm_neon.h>
+#endif
+
 struct list_item;
 
 typedef struct list_item
@@ -931,7 +935,9 @@ FINISH_VER_SETUP:
           size_t align = max (mem->context->min_buffer_alignment, 16);
           /* Always allocate mem_host_ptr for the full size of the buffer to
            * guard against applications forgetting to check content size */
-          mem->mem_host_ptr = pocl_aligned_malloc (align, mem->size);
+          mem->mem_host_ptr
+              = pocl_mem_manager_alloc_host_buffer (align, mem->size,
+                                                    mem->alloc_policy);
           assert ((mem->mem_host_ptr != NULL)
                   && "Cannot allocate backing memory for mem_host_ptr!\n");
         }
@@ -1371,6 +1377,60 @@ pocl_command_record (cl_command_buffer_khr command_buffer,
   return CL_SUCCESS;
 }
 
+/* Run time estimates for commands without a measured history. */
+#define POCL_SCHED_KERNEL_COST_NS 10000
+#define POCL_SCHED_COMMAND_COST_NS 1000
+/* How many levels of predecessors pocl_update_critical_path() visits. */
+#define POCL_SCHED_PATH_DEPTH 8
+
+static uint64_t
+pocl_command_cost_estimate (_cl_command_node *node)
+{
+  uint64_t est;
+  switch (node->type)
+    {
+    case CL_COMMAND_NDRANGE_KERNEL:
+    case CL_COMMAND_TASK:
+      est = POCL_ATOMIC_LOAD (
+          node->command.run.kernel->meta->run_time_estimate_ns);
+      return est ? est : POCL_SCHED_KERNEL_COST_NS;
+    case CL_COMMAND_BARRIER:
+    case CL_COMMAND_MARKER:
+      return 0;
+    default:
+      return POCL_SCHED_COMMAND_COST_NS;
+    }
+}
+
+/* Extends the critical path of the predecessors of the (locked) event to
+   cover the event's own path, and recursively theirs. The predecessors have
+   smaller ids so they must not be waited for while holding the event's lock;
+   the ones that happen to be locked are skipped, as the paths are only
+   scheduling hints. */
+static void
+pocl_update_critical_path (cl_event event, unsigned depth)
+{
+  event_node *item;
+  uint64_t path = event->sched_path_ns;
+
+  if (depth == 0)
+    return;
+
+  LL_FOREACH (event->wait_list, item)
+    {
+      cl_event pred = item->event;
+      if (POCL_TRYLOCK (pred->pocl_lock) != 0)
+        continue;
+      if (pred->status > CL_COMPLETE
+          && pred->sched_cost_ns + path > pred->sched_path_ns)
+        {
+          POCL_ATOMIC_STORE (pred->sched_path_ns, pred->sched_cost_ns + path);
+          pocl_update_critical_path (pred, depth - 1);
+        }
+      POCL_UNLOCK_OBJ (pred);
+    }
+}
+
 /* call with node->sync.event.event UNLOCKED */
 void pocl_command_enqueue (cl_command_queue command_queue,
                           _cl_command_node *node)
@@ -1426,6 +1486,12 @@ void pocl_command_enqueue (cl_command_queue command_queue,
   POCL_LOCK_OBJ (node->sync.event.event);
   assert (node->sync.event.event->status == CL_QUEUED);
   assert (command_queue == node->sync.event.event->queue);
+  event = node->sync.event.event;
+  event->sched_cost_ns = pocl_command_cost_estimate (node);
+  event->sched_path_ns = event->sched_cost_ns;
+  /* in-order queues run their commands in a chain anyway */
+  if (command_queue->properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)
+    pocl_update_critical_path (event, POCL_SCHED_PATH_DEPTH);
   pocl_update_event_queued (node->sync.event.event);
   command_queue->device->ops->submit(node, command_queue);
   /* node->sync.event.event is unlocked by device_ops->submit */
@@ -1437,7 +1503,9 @@ pocl_alloc_or_retain_mem_host_ptr (cl_mem mem)
   if (mem->mem_host_ptr == NULL)
     {
       size_t align = max (mem->context->min_buffer_alignment, 16);
-      mem->mem_host_ptr = pocl_aligned_malloc (align, mem->size);
+      mem->mem_host_ptr
+          = pocl_mem_manager_alloc_host_buffer (align, mem->size,
+                                                mem->alloc_policy);
       if (mem->mem_host_ptr == NULL)
         return -1;
       mem->mem_host_ptr_version = 0;
@@ -1454,7 +1522,7 @@ pocl_release_mem_host_ptr (cl_mem mem)
   --mem->mem_host_ptr_refcount;
   if (mem->mem_host_ptr_refcount == 0 && mem->mem_host_ptr != NULL)
     {
-      pocl_aligned_free (mem->mem_host_ptr);
+      pocl_mem_manager_free_host_buffer (mem->mem_host_ptr, mem->size);
       mem->mem_host_ptr = NULL;
       mem->mem_host_ptr_version = 0;
     }
@@ -2456,6 +2524,7 @@ pocl_update_event_finished (cl_int status, const char *func, unsigned line,
   assert (event->queue != NULL);
   assert (event->status > CL_COMPLETE);
   int notify_cmdq = CL_FALSE;
+  int has_wait_list;
 
   cl_command_queue cq = event->queue;
   POCL_LOCK_OBJ (cq);
@@ -2493,6 +2562,10 @@ pocl_update_event_finished (cl_int status, const char *func, unsigned line,
    * because it calls event callbacks, which can have calls to
    * clEnqueueSomething() */
   pocl_event_updated (event, status);
+  pocl_notify_event_waiters (event);
+  /* nothing is added to the wait list after the event has been submitted,
+   * so an empty list stays empty and needs no teardown below */
+  has_wait_list = (event->wait_list != NULL);
   POCL_UNLOCK_OBJ (event);
   ops->broadcast (event);
 
@@ -2502,35 +2575,38 @@ pocl_update_event_finished (cl_int status, const char *func, unsigned line,
    *
    * Mind the acrobatics of trying to avoid races with pocl_broadcast and
    * pocl_create_event_sync. */
-  event_node *tmp;
-  POCL_LOCK_OBJ (event);
-  while ((tmp = event->wait_list))
+  if (has_wait_list)
     {
-      cl_event notifier = tmp->event;
-      POCL_UNLOCK_OBJ (event);
-      pocl_lock_events_inorder (notifier, event);
-      if (tmp != event->wait_list)
+      event_node *tmp;
+      POCL_LOCK_OBJ (event);
+      while ((tmp = event->wait_list))
         {
+          cl_event notifier = tmp->event;
+          POCL_UNLOCK_OBJ (event);
+          pocl_lock_events_inorder (notifier, event);
+          if (tmp != event->wait_list)
+            {
+              pocl_unlock_events_inorder (notifier, event);
+              POCL_LOCK_OBJ (event);
+              continue;
+            }
+          event_node *tmp2;
+          LL_FOREACH (notifier->notify_list, tmp2)
+          {
+            if (tmp2->event == event)
+              {
+                LL_DELETE (notifier->notify_list, tmp2);
+                pocl_mem_manager_free_event_node (tmp2);
+                break;
+              }
+          }
+          LL_DELETE (event->wait_list, tmp);
           pocl_unlock_events_inorder (notifier, event);
+          pocl_mem_manager_free_event_node (tmp);
           POCL_LOCK_OBJ (event);
-          continue;
         }
-      event_node *tmp2;
-      LL_FOREACH (notifier->notify_list, tmp2)
-      {
-        if (tmp2->event == event)
-          {
-            LL_DELETE (notifier->notify_list, tmp2);
-            pocl_mem_manager_free_event_node (tmp2);
-            break;
-          }
-      }
-      LL_DELETE (event->wait_list, tmp);
-      pocl_unlock_events_inorder (notifier, event);
-      pocl_mem_manager_free_event_node (tmp);
-      POCL_LOCK_OBJ (event);
+      POCL_UNLOCK_OBJ (event);
     }
-  POCL_UNLOCK_OBJ (event);
 
 #ifdef POCL_DEBUG_MESSAGES
   if (msg != NULL)
@@ -2543,10 +2619,14 @@ pocl_update_event_finished (cl_int status, const char *func, unsigned line,
   pocl_free_event_node (event);
   pocl_free_event_memobjs (event);
 
-  POCL_LOCK_OBJ (event);
-  if (ops->notify_event_finished)
-    ops->notify_event_finished (event);
-  POCL_UNLOCK_OBJ (event);
+  /* nobody can be blocked in wait_event() on an implicit event */
+  if (ops->notify_event_finished
+      && !(event->implicit_event && cq->device->skip_implicit_event_notify))
+    {
+      POCL_LOCK_OBJ (event);
+      ops->notify_event_finished (event);
+      POCL_UNLOCK_OBJ (event);
+    }
   POname (clReleaseEvent) (event);
 
   if (notify_cmdq) {
@@ -2557,6 +2637,68 @@ pocl_update_event_finished (cl_int status, const char *func, unsigned line,
 }
 
 
+void
+pocl_notify_event_waiters (cl_event event)
+{
+  pocl_event_waiter_node *node;
+  while ((node = event->waiters))
+    {
+      pocl_event_waiter *waiter = node->waiter;
+      /* the node is owned by the waiting thread, don't touch it after the
+       * waiter has been counted down */
+      LL_DELETE (event->waiters, node);
+      POCL_LOCK (waiter->lock);
+      assert (waiter->remaining > 0);
+      if (--waiter->remaining == 0)
+        POCL_BROADCAST_COND (waiter->wakeup_cond);
+      POCL_UNLOCK (waiter->lock);
+    }
+}
+
+int
+pocl_wait_for_events (cl_uint num_events, const cl_event *events)
+{
+  pocl_event_waiter waiter;
+  pocl_event_waiter_node *nodes
+      = (pocl_event_waiter_node *)malloc (num_events * sizeof (*nodes));
+  cl_uint i;
+
+  if (nodes == NULL)
+    return CL_OUT_OF_HOST_MEMORY;
+
+  POCL_INIT_LOCK (waiter.lock);
+  POCL_INIT_COND (waiter.wakeup_cond);
+  waiter.remaining = num_events;
+
+  for (i = 0; i < num_events; ++i)
+    {
+      cl_event e = events[i];
+      POCL_LOCK_OBJ (e);
+      if (e->status > CL_COMPLETE)
+        {
+          nodes[i].waiter = &waiter;
+          LL_PREPEND (e->waiters, &nodes[i]);
+        }
+      else
+        {
+          POCL_LOCK (waiter.lock);
+          --waiter.remaining;
+          POCL_UNLOCK (waiter.lock);
+        }
+      POCL_UNLOCK_OBJ (e);
+    }
+
+  POCL_LOCK (waiter.lock);
+  while (waiter.remaining > 0)
+    POCL_WAIT_COND (waiter.wakeup_cond, waiter.lock);
+  POCL_UNLOCK (waiter.lock);
+
+  POCL_DESTROY_COND (waiter.wakeup_cond);
+  POCL_DESTROY_LOCK (waiter.lock);
+  free (nodes);
+  return CL_SUCCESS;
+}
+
 void
 pocl_update_event_failed (cl_event event)
 {
@@ -2917,11 +3059,9 @@ pocl_str_append (const char **dst, const char *src)
   return old_dst;
 }
 
-int
-pocl_fill_aligned_buf_with_pattern (void *__restrict__ ptr, size_t offset,
-                                    size_t size,
-                                    const void *__restrict__ pattern,
-                                    size_t pattern_size)
+static int
+fill_pattern_scalar (void *__restrict__ ptr, size_t offset, size_t size,
+                     const void *__restrict__ pattern, size_t pattern_size)
 {
   size_t i;
   unsigned j;
@@ -2999,10 +3139,214 @@ pocl_fill_aligned_buf_with_pattern (void *__restrict__ ptr, size_t offset,
   return 0;
 }
 
+/* The vectorized fills store a block of the pattern replicated to at least
+   POCL_FILL_BLOCK_SIZE bytes with unaligned vector stores, which works for
+   any start address aligned to the pattern size. */
+#define POCL_FILL_BLOCK_SIZE 32
+/* smaller fills are not worth setting up the block for */
+#define POCL_FILL_VECTOR_MIN_SIZE 256
+
+typedef void (*fill_blocks_func) (char *__restrict__ dst,
+                                  const char *__restrict__ block,
+                                  size_t block_size, size_t num_blocks);
+
+static void
+fill_blocks_generic (char *__restrict__ dst, const char *__restrict__ block,
+                     size_t block_size, size_t num_blocks)
+{
+  size_t i;
+  for (i = 0; i < num_blocks; ++i)
+    memcpy (dst + i * block_size, block, block_size);
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+static void
+fill_blocks_sse2 (char *__restrict__ dst, const char *__restrict__ block,
+                  size_t block_size, size_t num_blocks)
+{
+  __m128i v[8];
+  size_t i, j, n = block_size / 16;
+  for (j = 0; j < n; ++j)
+    v[j] = _mm_loadu_si128 ((const __m128i *)block + j);
+  for (i = 0; i < num_blocks; ++i, dst += block_size)
+    for (j = 0; j < n; ++j)
+      _mm_storeu_si128 ((__m128i *)dst + j, v[j]);
+}
+
+__attribute__ ((target ("avx2"))) static void
+fill_blocks_avx2 (char *__restrict__ dst, const char *__restrict__ block,
+                  size_t block_size, size_t num_blocks)
+{
+  __m256i v[4];
+  size_t i, j, n = block_size / 32;
+  for (j = 0; j < n; ++j)
+    v[j] = _mm256_loadu_si256 ((const __m256i *)block + j);
+  for (i = 0; i < num_blocks; ++i, dst += block_size)
+    for (j = 0; j < n; ++j)
+      _mm256_storeu_si256 ((__m256i *)dst + j, v[j]);
+}
+#endif
+
+#if defined(__aarch64__) && defined(__GNUC__)
+static void
+fill_blocks_neon (char *__restrict__ dst, const char *__restrict__ block,
+                  size_t block_size, size_t num_blocks)
+{
+  uint8x16_t v[8];
+  size_t i, j, n = block_size / 16;
+  for (j = 0; j < n; ++j)
+    v[j] = vld1q_u8 ((const uint8_t *)block + j * 16);
+  for (i = 0; i < num_blocks; ++i, dst += block_size)
+    for (j = 0; j < n; ++j)
+      vst1q_u8 ((uint8_t *)dst + j * 16, v[j]);
+}
+#endif
+
+/* Picks the widest block fill the CPU supports. */
+static fill_blocks_func
+select_fill_blocks (void)
+{
+  static fill_blocks_func selected = NULL;
+  fill_blocks_func f = POCL_ATOMIC_LOAD (selected);
+  if (f != NULL)
+    return f;
+
+  f = fill_blocks_generic;
+#if defined(__x86_64__) && defined(__GNUC__)
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+    f = fill_blocks_avx2;
+  else
+    f = fill_blocks_sse2;
+#elif defined(__aarch64__) && defined(__GNUC__)
+  f = fill_blocks_neon;
+#endif
+  POCL_ATOMIC_STORE (selected, f);
+  return f;
+}
+
+int
+pocl_fill_aligned_buf_with_pattern (void *__restrict__ ptr, size_t offset,
+                                    size_t size,
+                                    const void *__restrict__ pattern,
+                                    size_t pattern_size)
+{
+  if (size < POCL_FILL_VECTOR_MIN_SIZE || pattern_size > 128
+      || (pattern_size & (pattern_size - 1)) != 0)
+    return fill_pattern_scalar (ptr, offset, size, pattern, pattern_size);
+
+  char block[128];
+  size_t block_size = max (pattern_size, POCL_FILL_BLOCK_SIZE);
+  size_t i;
+  for (i = 0; i < block_size; i += pattern_size)
+    memcpy (block + i, pattern, pattern_size);
+
+  size_t num_blocks = size / block_size;
+  select_fill_blocks () ((char *)ptr + offset, block, block_size, num_blocks);
+
+  size_t done = num_blocks * block_size;
+  if (done == size)
+    return 0;
+  return fill_pattern_scalar (ptr, offset + done, size - done, pattern,
+                              pattern_size);
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/* Stores num_blocks copies of the block (a multiple of 16 bytes) to the
+   16-byte aligned dst with non-temporal stores. */
+static void
+stream_blocks_sse2 (char *__restrict__ dst, const char *__restrict__ block,
+                    size_t block_size, size_t num_blocks)
+{
+  __m128i v[8];
+  size_t i, j, n = block_size / 16;
+  for (j = 0; j < n; ++j)
+    v[j] = _mm_loadu_si128 ((const __m128i *)block + j);
+  for (i = 0; i < num_blocks; ++i, dst += block_size)
+    for (j = 0; j < n; ++j)
+      _mm_stream_si128 ((__m128i *)dst + j, v[j]);
+  _mm_sfence ();
+}
+#endif
+
+int
+pocl_stream_fill_aligned_buf_with_pattern (void *__restrict__ ptr,
+                                           size_t offset, size_t size,
+                                           const void *__restrict__ pattern,
+                                           size_t pattern_size)
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+  char *dst = (char *)ptr + offset;
+  /* the bytes up to the first 16-byte aligned pattern boundary */
+  size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+  if (size < POCL_FILL_VECTOR_MIN_SIZE + head || pattern_size > 128
+      || (pattern_size & (pattern_size - 1)) != 0
+      || (head % pattern_size) != 0)
+    return pocl_fill_aligned_buf_with_pattern (ptr, offset, size, pattern,
+                                               pattern_size);
+
+  char block[128];
+  size_t block_size = max (pattern_size, POCL_FILL_BLOCK_SIZE);
+  size_t i;
+  for (i = 0; i < block_size; i += pattern_size)
+    memcpy (block + i, pattern, pattern_size);
+
+  if (head)
+    fill_pattern_scalar (ptr, offset, head, pattern, pattern_size);
+  size_t num_blocks = (size - head) / block_size;
+  stream_blocks_sse2 (dst + head, block, block_size, num_blocks);
+
+  size_t done = head + num_blocks * block_size;
+  if (done == size)
+    return 0;
+  return fill_pattern_scalar (ptr, offset + done, size - done, pattern,
+                              pattern_size);
+#else
+  return pocl_fill_aligned_buf_with_pattern (ptr, offset, size, pattern,
+                                             pattern_size);
+#endif
+}
+
 void
-pocl_free_kernel_metadata (cl_program program, unsigned kernel_i)
+pocl_stream_memcpy (void *__restrict__ dst, const void *__restrict__ src,
+                    size_t size)
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+  char *d = (char *)dst;
+  const char *s = (const char *)src;
+  size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+  if (size < head + 64)
+    {
+      memcpy (dst, src, size);
+      return;
+    }
+  memcpy (d, s, head);
+  d += head;
+  s += head;
+  size -= head;
+
+  size_t i, n = size / 64;
+  for (i = 0; i < n; ++i, d += 64, s += 64)
+    {
+      __m128i a = _mm_loadu_si128 ((const __m128i *)s);
+      __m128i b = _mm_loadu_si128 ((const __m128i *)s + 1);
+      __m128i c = _mm_loadu_si128 ((const __m128i *)s + 2);
+      __m128i e = _mm_loadu_si128 ((const __m128i *)s + 3);
+      _mm_stream_si128 ((__m128i *)d, a);
+      _mm_stream_si128 ((__m128i *)d + 1, b);
+      _mm_stream_si128 ((__m128i *)d + 2, c);
+      _mm_stream_si128 ((__m128i *)d + 3, e);
+    }
+  _mm_sfence ();
+  memcpy (d, s, size - n * 64);
+#else
+  memcpy (dst, src, size);
+#endif
+}
+
+static void
+free_kernel_metadata (cl_program program, pocl_kernel_metadata_t *meta)
 {
-  pocl_kernel_metadata_t *meta = &program->kernel_meta[kernel_i];
   unsigned j;
   POCL_MEM_FREE (meta->attributes);
   POCL_MEM_FREE (meta->name);
@@ -3029,6 +3373,27 @@ pocl_free_kernel_metadata (cl_program program, unsigned kernel_i)
   POCL_MEM_FREE (meta->data);
   POCL_MEM_FREE (meta->local_sizes);
   POCL_MEM_FREE (meta->build_hash);
+  if (meta->fusion != NULL)
+    {
+      POCL_MEM_FREE (meta->fusion->producer);
+      POCL_MEM_FREE (meta->fusion->consumer);
+      POCL_MEM_FREE (meta->fusion->consumer_arg_map);
+      POCL_MEM_FREE (meta->fusion);
+    }
+}
+
+void
+pocl_free_kernel_metadata (cl_program program, unsigned kernel_i)
+{
+  free_kernel_metadata (program, &program->kernel_meta[kernel_i]);
+}
+
+void
+pocl_free_fused_kernel_metadata (cl_program program,
+                                 pocl_kernel_metadata_t *meta)
+{
+  free_kernel_metadata (program, meta);
+  POCL_MEM_FREE (meta);
 }
 
 int
@@ -280,6 +280,15 @@ void pocl_update_event_failed (cl_event event);
 POCL_EXPORT
 void pocl_update_event_device_lost (cl_event event);
 
+/* Blocks until all the events have completed, registering a single waiter
+ * on all of them which is woken up once, by the last one to complete.
+ * Returns CL_OUT_OF_HOST_MEMORY if the waiter could not be allocated. */
+int pocl_wait_for_events (cl_uint num_events, const cl_event *events);
+
+/* Counts down the waiters of a completed event. Must be called with the
+ * event locked. */
+void pocl_notify_event_waiters (cl_event event);
+
 const char*
 pocl_status_to_str (int status);
 
@@ -302,6 +311,11 @@ float half_to_float (uint16_t value);
 
 void pocl_free_kernel_metadata (cl_program program, unsigned kernel_i);
 
+/* Frees a kernel metadata created by kernel fusion, including the struct
+ * itself. */
+void pocl_free_fused_kernel_metadata (cl_program program,
+                                      pocl_kernel_metadata_t *meta);
+
 POCL_EXPORT
 int pocl_svm_check_pointer (cl_context context, const void *svm_ptr,
                             size_t size, size_t *buffer_size);
@@ -331,6 +345,18 @@ int pocl_fill_aligned_buf_with_pattern (void *__restrict__ ptr, size_t offset,
                                         const void *__restrict__ pattern,
                                         size_t pattern_size);
 
+/* Like pocl_fill_aligned_buf_with_pattern() and memcpy(), but with
+ * non-temporal stores that bypass the caches where supported. For
+ * writing buffers larger than the last level cache. */
+POCL_EXPORT
+int pocl_stream_fill_aligned_buf_with_pattern (
+    void *__restrict__ ptr, size_t offset, size_t size,
+    const void *__restrict__ pattern, size_t pattern_size);
+
+POCL_EXPORT
+void pocl_stream_memcpy (void *__restrict__ dst, const void *__restrict__ src,
+                         size_t size);
+
 POCL_EXPORT
 int pocl_get_private_datadir (char* private_datadir);
 
@@ -0,0 +1,376 @@
+/* OpenCL built-in library: lower precision math for the CPU devices
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+/* The _cl_fast_* functions implement the float math builtins with short
+ * polynomials and a single-step range reduction, without branches so the
+ * work-item loops calling them vectorize. They are used for the native_
+ * and half_ builtins, and for the standard ones when the program is built
+ * with -cl-fast-relaxed-math (see _builtin_renames.h). The accuracy is
+ * within the -cl-fast-relaxed-math limits of the OpenCL C specification:
+ * exp, exp2, exp10, log, log2 and log10 stay within 3 ulp (absolute error
+ * below 2^-21 for the logarithms in [0.5, 2]), and rsqrt and recip within
+ * 4 ulp. The absolute error of sin and cos is below 2^-23 for |x| <= pi and
+ * below 2^-19 for |x| < 2^17; the reduction by pi/2 is exact only up to
+ * there, and the results are meaningless for larger |x|. Denormal results
+ * are flushed to zero. The half and double overloads forward to the full
+ * precision builtins. */
+
+#include "templates.h"
+
+/* Estimates of 1/sqrt(x) and 1/x, refined by one Newton-Raphson step in
+ * _cl_fast_rsqrt and _cl_fast_recip. On x86 the 12-bit hardware estimates
+ * are used, elsewhere the exact values. */
+
+#ifdef __SSE__
+
+static _CL_OVERLOADABLE float
+_cl_fast_rsqrt_est (float x)
+{
+  float4 r = __builtin_ia32_rsqrtss ((float4)(x));
+  return r.s0;
+}
+
+static _CL_OVERLOADABLE float4
+_cl_fast_rsqrt_est (float4 x)
+{
+  return __builtin_ia32_rsqrtps (x);
+}
+
+static _CL_OVERLOADABLE float
+_cl_fast_recip_est (float x)
+{
+  float4 r = __builtin_ia32_rcpss ((float4)(x));
+  return r.s0;
+}
+
+static _CL_OVERLOADABLE float4
+_cl_fast_recip_est (float4 x)
+{
+  return __builtin_ia32_rcpps (x);
+}
+
+#define IMPLEMENT_FAST_EST_NARROW(NAME)                                       \
+  static _CL_OVERLOADABLE float2 NAME (float2 x)                              \
+  {                                                                           \
+    return NAME ((float4)(x, x)).lo;                                          \
+  }                                                                           \
+  static _CL_OVERLOADABLE float3 NAME (float3 x)                              \
+  {                                                                           \
+    return NAME ((float4)(x, x.s0)).xyz;                                      \
+  }
+
+IMPLEMENT_FAST_EST_NARROW (_cl_fast_rsqrt_est)
+IMPLEMENT_FAST_EST_NARROW (_cl_fast_recip_est)
+
+#ifdef __AVX__
+
+static _CL_OVERLOADABLE float8
+_cl_fast_rsqrt_est (float8 x)
+{
+  return __builtin_ia32_rsqrtps256 (x);
+}
+
+static _CL_OVERLOADABLE float8
+_cl_fast_recip_est (float8 x)
+{
+  return __builtin_ia32_rcpps256 (x);
+}
+
+#else
+
+static _CL_OVERLOADABLE float8
+_cl_fast_rsqrt_est (float8 x)
+{
+  return (float8)(_cl_fast_rsqrt_est (x.lo), _cl_fast_rsqrt_est (x.hi));
+}
+
+static _CL_OVERLOADABLE float8
+_cl_fast_recip_est (float8 x)
+{
+  return (float8)(_cl_fast_recip_est (x.lo), _cl_fast_recip_est (x.hi));
+}
+
+#endif
+
+static _CL_OVERLOADABLE float16
+_cl_fast_rsqrt_est (float16 x)
+{
+  return (float16)(_cl_fast_rsqrt_est (x.lo), _cl_fast_rsqrt_est (x.hi));
+}
+
+static _CL_OVERLOADABLE float16
+_cl_fast_recip_est (float16 x)
+{
+  return (float16)(_cl_fast_recip_est (x.lo), _cl_fast_recip_est (x.hi));
+}
+
+#else
+
+#define IMPLEMENT_FAST_EST(VTYPE)                                             \
+  static _CL_OVERLOADABLE VTYPE _cl_fast_rsqrt_est (VTYPE x)                  \
+  {                                                                           \
+    return 1.0f / sqrt (x);                                                   \
+  }                                                                           \
+  static _CL_OVERLOADABLE VTYPE _cl_fast_recip_est (VTYPE x)                  \
+  {                                                                           \
+    return 1.0f / x;                                                          \
+  }
+
+IMPLEMENT_FAST_EST (float)
+IMPLEMENT_FAST_EST (float2)
+IMPLEMENT_FAST_EST (float3)
+IMPLEMENT_FAST_EST (float4)
+IMPLEMENT_FAST_EST (float8)
+IMPLEMENT_FAST_EST (float16)
+
+#endif
+
+#define IMPLEMENT_FAST_MATH(VTYPE, ITYPE, UTYPE)                              \
+  /* e^r * 2^k for |r| <= ln(2)/2 and integral k in [-150, 128]. 2^k is       \
+     applied in two steps so that neither factor leaves the normal range. */  \
+  static _CL_OVERLOADABLE VTYPE _cl_fast_expk (VTYPE r, VTYPE k)              \
+  {                                                                           \
+    VTYPE p = 1.9875691500e-4f;                                               \
+    p = p * r + 1.3981999507e-3f;                                             \
+    p = p * r + 8.3334519073e-3f;                                             \
+    p = p * r + 4.1665795894e-2f;                                             \
+    p = p * r + 1.6666665459e-1f;                                             \
+    p = p * r + 5.0000001201e-1f;                                             \
+    p = r * r * p + r + 1.0f;                                                 \
+    ITYPE ki = convert_##ITYPE (k);                                           \
+    ITYPE k1 = ki >> 1;                                                       \
+    return p * as_##VTYPE ((k1 + 127) << 23)                                  \
+           * as_##VTYPE ((ki - k1 + 127) << 23);                              \
+  }                                                                           \
+                                                                              \
+  _CL_OVERLOADABLE VTYPE _cl_fast_exp (VTYPE x)                               \
+  {                                                                           \
+    x = clamp (x, -104.0f, 89.0f);                                            \
+    VTYPE k = rint (x * 1.44269504089f);                                      \
+    /* x - k * ln(2) with ln(2) split in two for an exact first product */    \
+    VTYPE r = x - k * 0.693359375f;                                           \
+    r = r - k * -2.12194440e-4f;                                              \
+    return _cl_fast_expk (r, k);                                              \
+  }                                                                           \
+                                                                              \
+  _CL_OVERLOADABLE VTYPE _cl_fast_exp2 (VTYPE x)                              \
+  {                                                                           \
+    x = clamp (x, -150.0f, 128.0f);                                           \
+    VTYPE k = rint (x);                                                       \
+    return _cl_fast_expk ((x - k) * 0.693147181f, k);                         \
+  }                                                                           \
+                                                                              \
+  _CL_OVERLOADABLE VTYPE _cl_fast_exp10 (VTYPE x)                             \
+  {                                                                           \
+    x = clamp (x, -45.0f, 39.0f);                                             \
+    VTYPE k = rint (x * 3.321928095f);                                        \
+    VTYPE r = x - k * 0.30078125f;                                            \
+    r = r - k * 2.48745663981195213739e-4f;                                   \
+    return _cl_fast_expk (r * 2.302585093f, k);                               \
+  }                                                                           \
+                                                                              \
+  /* ln(m) for x = m * 2^e with m in [sqrt(2)/2, sqrt(2)) */                  \
+  static _CL_OVERLOADABLE VTYPE _cl_fast_logm (VTYPE x, VTYPE *e)             \
+  {                                                                           \
+    ITYPE bits = as_##ITYPE (x);                                              \
+    ITYPE exponent = ((bits >> 23) & 0xff) - 127;                             \
+    VTYPE m = as_##VTYPE ((bits & 0x7fffff) | 0x3f800000);                    \
+    ITYPE big = m > 1.41421356f;                                              \
+    m = select (m, m * 0.5f, big);                                            \
+    *e = convert_##VTYPE (select (exponent, exponent + 1, big));              \
+    VTYPE t = (m - 1.0f) / (m + 1.0f);                                        \
+    VTYPE t2 = t * t;                                                         \
+    VTYPE u = 2.0f * t;                                                       \
+    return u                                                                  \
+           + u * t2                                                           \
+                 * (0.333333333f                                              \
+                    + t2 * (0.2f + t2 * (0.142857143f + t2 * 0.111111111f))); \
+  }                                                                           \
+                                                                              \
+  static _CL_OVERLOADABLE VTYPE _cl_fast_log_special (VTYPE r, VTYPE x)       \
+  {                                                                           \
+    /* denormals are treated as zero */                                       \
+    r = select (r, (VTYPE)(-INFINITY), x < FLT_MIN);                          \
+    r = select (r, (VTYPE)NAN, x < 0.0f);                                     \
+    return select (r, x, (x == INFINITY) | isnan (x));                        \
+  }                                                                           \
+                                                                              \
+  _CL_OVERLOADABLE VTYPE _cl_fast_log (VTYPE x)                               \
+  {                                                                           \
+    VTYPE e;                                                                  \
+    VTYPE l = _cl_fast_logm (x, &e);                                          \
+    return _cl_fast_log_special (                                             \
+        e * 0.693359375f + (l + e * -2.12194440e-4f), x);                     \
+  }                                                                           \
+                                                                              \
+  _CL_OVERLOADABLE VTYPE _cl_fast_log2 (VTYPE x)                              \
+  {                                                                           \
+    VTYPE e;                                                                  \
+    VTYPE l = _cl_fast_logm (x, &e);                                          \
+    return _cl_fast_log_special (l * 1.44269504089f + e, x);                  \
+  }                                                                           \
+                                                                              \
+  _CL_OVERLOADABLE VTYPE _cl_fast_log10 (VTYPE x)                             \
+  {                                                                           \
+    return _cl_fast_log (x) * 0.434294482f;                                   \
+  }                                                                           \
+                                                                              \
+  /* sin(r) and cos(r) for x = r + q * pi/2, |r| <= pi/4; returns q. The      \
+     products of q with the first two parts of pi/2 are exact for |q| < 2^13  \
+     and the first one for |q| < 2^16. */                                     \
+  static _CL_OVERLOADABLE ITYPE _cl_fast_sincos_reduced (VTYPE x, VTYPE *s,   \
+                                                         VTYPE *c)            \
+  {                                                                           \
+    VTYPE q = rint (x * 0.636619772f);                                        \
+    VTYPE r = x - q * 1.5703125f;                                             \
+    r = r - q * 4.837512969970703125e-4f;                                     \
+    r = r - q * 7.54978995489188216e-8f;                                      \
+    VTYPE r2 = r * r;                                                         \
+    *s = r                                                                    \
+         + r * r2                                                             \
+               * (-1.6666654611e-1f                                           \
+                  + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));        \
+    *c = 1.0f - 0.5f * r2                                                     \
+         + r2 * r2                                                            \
+               * (4.166664568298827e-2f                                       \
+                  + r2                                                        \
+                        * (-1.388731625493765e-3f                             \
+                           + r2 * 2.443315711809948e-5f));                    \
+    return convert_##ITYPE (q);                                               \
+  }                                                                           \
+                                                                              \
+  static _CL_OVERLOADABLE VTYPE _cl_fast_sin_quadrant (VTYPE s, VTYPE c,      \
+                                                       ITYPE q)               \
+  {                                                                           \
+    VTYPE r = select (s, c, (q & 1) != 0);                                    \
+    return as_##VTYPE (as_##UTYPE (r) ^ (convert_##UTYPE (q & 2) << 30));     \
+  }                                                                           \
+                                                                              \
+  _CL_OVERLOADABLE VTYPE _cl_fast_sin (VTYPE x)                               \
+  {                                                                           \
+    VTYPE s, c;                                                               \
+    ITYPE q = _cl_fast_sincos_reduced (x, &s, &c);                            \
+    return _cl_fast_sin_quadrant (s, c, q);                                   \
+  }                                                                           \
+                                                                              \
+  _CL_OVERLOADABLE VTYPE _cl_fast_cos (VTYPE x)                               \
+  {                                                                           \
+    VTYPE s, c;                                                               \
+    ITYPE q = _cl_fast_sincos_reduced (x, &s, &c);                            \
+    return _cl_fast_sin_quadrant (s, c, q + 1);                               \
+  }                                                                           \
+                                                                              \
+  _CL_OVERLOADABLE VTYPE _cl_fast_tan (VTYPE x)                               \
+  {                                                                           \
+    VTYPE s, c;                                                               \
+    ITYPE odd = (_cl_fast_sincos_reduced (x, &s, &c) & 1) != 0;               \
+    return select (s, c, odd) / select (c, -s, odd);                          \
+  }                                                                           \
+                                                                              \
+  _CL_OVERLOADABLE VTYPE _cl_fast_powr (VTYPE x, VTYPE y)                     \
+  {                                                                           \
+    VTYPE r = _cl_fast_exp2 (y * _cl_fast_log2 (x));                          \
+    return select (r, (VTYPE)NAN, x < 0.0f);                                  \
+  }                                                                           \
+                                                                              \
+  _CL_OVERLOADABLE VTYPE _cl_fast_rsqrt (VTYPE x)                             \
+  {                                                                           \
+    VTYPE e = _cl_fast_rsqrt_est (x);                                         \
+    VTYPE h = x * e;                                                          \
+    VTYPE r = e + e * (0.5f - 0.5f * h * e);                                  \
+    /* the step turns the exact results for 0 and inf into NaNs */            \
+    return select (r, e, (e == 0.0f) | isinf (e));                            \
+  }                                                                           \
+                                                                              \
+  _CL_OVERLOADABLE VTYPE _cl_fast_recip (VTYPE x)                             \
+  {                                                                           \
+    VTYPE e = _cl_fast_recip_est (x);                                         \
+    VTYPE r = e + e * (1.0f - x * e);                                         \
+    return select (r, e, (e == 0.0f) | isinf (e));                            \
+  }
+
+IMPLEMENT_FAST_MATH (float, int, uint)
+IMPLEMENT_FAST_MATH (float2, int2, uint2)
+IMPLEMENT_FAST_MATH (float3, int3, uint3)
+IMPLEMENT_FAST_MATH (float4, int4, uint4)
+IMPLEMENT_FAST_MATH (float8, int8, uint8)
+IMPLEMENT_FAST_MATH (float16, int16, uint16)
+
+#define IMPLEMENT_PRECISE_MATH(VTYPE)                                         \
+  _CL_OVERLOADABLE VTYPE _cl_fast_exp (VTYPE x) { return exp (x); }           \
+  _CL_OVERLOADABLE VTYPE _cl_fast_exp2 (VTYPE x) { return exp2 (x); }         \
+  _CL_OVERLOADABLE VTYPE _cl_fast_exp10 (VTYPE x) { return exp10 (x); }       \
+  _CL_OVERLOADABLE VTYPE _cl_fast_log (VTYPE x) { return log (x); }           \
+  _CL_OVERLOADABLE VTYPE _cl_fast_log2 (VTYPE x) { return log2 (x); }         \
+  _CL_OVERLOADABLE VTYPE _cl_fast_log10 (VTYPE x) { return log10 (x); }       \
+  _CL_OVERLOADABLE VTYPE _cl_fast_sin (VTYPE x) { return sin (x); }           \
+  _CL_OVERLOADABLE VTYPE _cl_fast_cos (VTYPE x) { return cos (x); }           \
+  _CL_OVERLOADABLE VTYPE _cl_fast_tan (VTYPE x) { return tan (x); }           \
+  _CL_OVERLOADABLE VTYPE _cl_fast_powr (VTYPE x, VTYPE y)                     \
+  {                                                                           \
+    return powr (x, y);                                                       \
+  }                                                                           \
+  _CL_OVERLOADABLE VTYPE _cl_fast_rsqrt (VTYPE x) { return rsqrt (x); }       \
+  _CL_OVERLOADABLE VTYPE _cl_fast_recip (VTYPE x) { return (VTYPE)1 / x; }
+
+__IF_FP16 (
+IMPLEMENT_PRECISE_MATH (half)
+IMPLEMENT_PRECISE_MATH (half2)
+IMPLEMENT_PRECISE_MATH (half3)
+IMPLEMENT_PRECISE_MATH (half4)
+IMPLEMENT_PRECISE_MATH (half8)
+IMPLEMENT_PRECISE_MATH (half16))
+
+__IF_FP64 (
+IMPLEMENT_PRECISE_MATH (double)
+IMPLEMENT_PRECISE_MATH (double2)
+IMPLEMENT_PRECISE_MATH (double3)
+IMPLEMENT_PRECISE_MATH (double4)
+IMPLEMENT_PRECISE_MATH (double8)
+IMPLEMENT_PRECISE_MATH (double16))
+
+DEFINE_EXPR_F_F (native_cos, _cl_fast_cos (a))
+DEFINE_EXPR_F_F (native_exp, _cl_fast_exp (a))
+DEFINE_EXPR_F_F (native_exp10, _cl_fast_exp10 (a))
+DEFINE_EXPR_F_F (native_exp2, _cl_fast_exp2 (a))
+DEFINE_EXPR_F_F (native_log, _cl_fast_log (a))
+DEFINE_EXPR_F_F (native_log10, _cl_fast_log10 (a))
+DEFINE_EXPR_F_F (native_log2, _cl_fast_log2 (a))
+DEFINE_EXPR_F_FF (native_powr, _cl_fast_powr (a, b))
+DEFINE_EXPR_F_F (native_recip, _cl_fast_recip (a))
+DEFINE_EXPR_F_F (native_rsqrt, _cl_fast_rsqrt (a))
+DEFINE_EXPR_F_F (native_sin, _cl_fast_sin (a))
+DEFINE_EXPR_F_F (native_tan, _cl_fast_tan (a))
+
+DEFINE_EXPR_F_F (half_cos, _cl_fast_cos (a))
+DEFINE_EXPR_F_F (half_exp, _cl_fast_exp (a))
+DEFINE_EXPR_F_F (half_exp10, _cl_fast_exp10 (a))
+DEFINE_EXPR_F_F (half_exp2, _cl_fast_exp2 (a))
+DEFINE_EXPR_F_F (half_log, _cl_fast_log (a))
+DEFINE_EXPR_F_F (half_log10, _cl_fast_log10 (a))
+DEFINE_EXPR_F_F (half_log2, _cl_fast_log2 (a))
+DEFINE_EXPR_F_FF (half_powr, _cl_fast_powr (a, b))
+DEFINE_EXPR_F_F (half_recip, _cl_fast_recip (a))
+DEFINE_EXPR_F_F (half_rsqrt, _cl_fast_rsqrt (a))
+DEFINE_EXPR_F_F (half_sin, _cl_fast_sin (a))
+DEFINE_EXPR_F_F (half_tan, _cl_fast_tan (a))
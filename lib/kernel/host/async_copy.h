@@ -0,0 +1,71 @@
+/* OpenCL built-in library: async copy helpers for CPU devices
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+#ifndef POCL_HOST_ASYNC_COPY_H
+#define POCL_HOST_ASYNC_COPY_H
+
+/* The CPU device async copies are distributed to the work-items of the
+   work-group. Each work-item copies a contiguous chunk of the elements so
+   the work-item loops execute the chunks back to back and the copy loop of
+   a single work-item vectorizes like a memcpy. The copy is completed by
+   wait_group_events() which is a work-group barrier on the CPU devices. */
+
+/* How many cache lines of the next work-item's chunk of the source data
+   to prefetch while copying. Define to 0 to disable the prefetching. */
+#ifndef POCL_ASYNC_COPY_PREFETCH_LINES
+#define POCL_ASYNC_COPY_PREFETCH_LINES 8
+#endif
+
+#define POCL_ASYNC_COPY_CACHE_LINE 64
+
+static inline __attribute__ ((always_inline)) void
+__pocl_async_copy_chunk (size_t num_elements, size_t *start, size_t *end)
+{
+  size_t lid = get_local_id (0)
+               + (get_local_id (1) + get_local_id (2) * get_local_size (1))
+                     * get_local_size (0);
+  size_t lsz = get_local_size (0) * get_local_size (1) * get_local_size (2);
+  size_t chunk = (num_elements + lsz - 1) / lsz;
+  *start = lid * chunk;
+  *end = *start + chunk;
+  if (*start > num_elements)
+    *start = num_elements;
+  if (*end > num_elements)
+    *end = num_elements;
+}
+
+/* Prefetch the beginning of the source chunk the next work-item copies. */
+#define POCL_ASYNC_COPY_PREFETCH(PTR, BYTES)                                  \
+  do                                                                          \
+    {                                                                         \
+      size_t __bytes = (BYTES);                                               \
+      if (__bytes > POCL_ASYNC_COPY_PREFETCH_LINES                            \
+                        * POCL_ASYNC_COPY_CACHE_LINE)                         \
+        __bytes = POCL_ASYNC_COPY_PREFETCH_LINES * POCL_ASYNC_COPY_CACHE_LINE;\
+      for (size_t __off = 0; __off < __bytes;                                 \
+           __off += POCL_ASYNC_COPY_CACHE_LINE)                               \
+        __builtin_prefetch ((const __global char *)(PTR) + __off, 0, 3);      \
+    }                                                                         \
+  while (0)
+
+#endif
@@ -69,4 +69,35 @@
     dest.w = source.w;                                                        \
   }
 
+/* Pixel index offsets of the x, y and z coordinates of an image with the
+   given row and slice pitches (in pixels) and tiling; the index of a pixel
+   is the sum of the three. See POCL_IMAGE_TILE_SHIFT. */
+static inline size_t
+pocl_image_x_offset (int x, int tiling)
+{
+  if (tiling == 0)
+    return x;
+  return (x & POCL_IMAGE_TILE_MASK)
+         + ((size_t)(x >> POCL_IMAGE_TILE_SHIFT)
+            << (POCL_IMAGE_TILE_SHIFT * tiling));
+}
+
+static inline size_t
+pocl_image_y_offset (int y, size_t row_pitch, int tiling)
+{
+  if (tiling == 0)
+    return y * row_pitch;
+  return ((y & POCL_IMAGE_TILE_MASK) << POCL_IMAGE_TILE_SHIFT)
+         + (y >> POCL_IMAGE_TILE_SHIFT) * row_pitch;
+}
+
+static inline size_t
+pocl_image_z_offset (int z, size_t slice_pitch, int tiling)
+{
+  if (tiling < 3)
+    return z * slice_pitch;
+  return ((z & POCL_IMAGE_TILE_MASK) << (2 * POCL_IMAGE_TILE_SHIFT))
+         + (z >> POCL_IMAGE_TILE_SHIFT) * slice_pitch;
+}
+
 #endif
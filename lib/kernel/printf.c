@@ -748,6 +748,256 @@ __pocl_printf (char *restrict __buffer, uint32_t *__buffer_index,
 
 /**************************************************************************/
 
+/* Deferred printf: instead of formatting in the work-item, a record with
+ * the address of the format string and the raw argument bytes is appended
+ * to the printf buffer, and the CPU drivers format the records on the host
+ * after the work-groups have finished (see pocl_write_printf_buffer()).
+ * The layout must match lib/CL/devices/printf_buffer.c:
+ *
+ *   uint32_t size     total size of the record, a multiple of 8
+ *   uint32_t flags    DEFERRED_FLAG_*
+ *   uint64_t format   address of the format string
+ *   ...               the arguments, unaligned, in the order of the format
+ *
+ * Scalar integers are stored as promoted to 4 or 8 bytes, scalar floats as
+ * doubles (floats without cl_khr_fp64), 3-element vectors as 4 elements,
+ * pointers as 8 bytes and strings as a 4-byte length followed by the
+ * characters (DEFERRED_NULL_STRING as the length for NULL). The format
+ * string is only scanned for the argument types; on a format error the
+ * arguments collected so far are stored and the host prints the error.
+ * Records that do not fit are dropped. */
+
+#define DEFERRED_HEADER_SIZE 16
+#define DEFERRED_FLAG_FLOAT_ARGS 1
+#define DEFERRED_NULL_STRING 0xffffffffU
+
+static void
+__pocl_printf_deferred_put (param_t *p, const void *src, uint32_t n)
+{
+  /* an index past the capacity marks the record as overflowed */
+  if (p->printf_buffer_index + n > p->printf_buffer_capacity)
+    {
+      p->printf_buffer_index = p->printf_buffer_capacity + 1;
+      return;
+    }
+  const char *s = (const char *)src;
+  for (uint32_t i = 0; i < n; ++i)
+    p->printf_buffer[p->printf_buffer_index++] = s[i];
+}
+
+int
+__pocl_printf_deferred (char *restrict __buffer, uint32_t *__buffer_index,
+                        uint32_t __buffer_capacity,
+                        const PRINTF_FMT_STR_AS char *restrict fmt, ...)
+{
+  param_t p = { 0 };
+  uint32_t start = *(PRINTF_BUFFER_AS uint32_t *)__buffer_index;
+
+  p.printf_buffer = (PRINTF_BUFFER_AS char *)__buffer;
+  p.printf_buffer_capacity = __buffer_capacity;
+  p.printf_buffer_index = start + DEFERRED_HEADER_SIZE;
+  if (p.printf_buffer_index > p.printf_buffer_capacity)
+    return -1;
+
+  const PRINTF_FMT_STR_AS char *format = fmt;
+  char ch;
+  va_list ap;
+  va_start (ap, fmt);
+
+  while ((ch = *format++))
+    {
+      if (ch != '%')
+        continue;
+      ch = *format++;
+      if (ch == '%')
+        continue;
+      while (ch == '-' || ch == '+' || ch == ' ' || ch == '#' || ch == '0')
+        ch = *format++;
+      while (ch >= '0' && ch <= '9')
+        ch = *format++;
+      if (ch == '.')
+        {
+          ch = *format++;
+          while (ch >= '0' && ch <= '9')
+            ch = *format++;
+        }
+      unsigned vector_length = 0;
+      if (ch == 'v')
+        {
+          ch = *format++;
+          while (ch >= '0' && ch <= '9' && vector_length < 100)
+            {
+              vector_length = 10 * vector_length + (ch - '0');
+              ch = *format++;
+            }
+          if (!(vector_length == 2 || vector_length == 3
+                || vector_length == 4 || vector_length == 8
+                || vector_length == 16))
+            break;
+        }
+      unsigned length = 0;
+      if (ch == 'h')
+        {
+          ch = *format++;
+          if (ch == 'h')
+            {
+              ch = *format++;
+              length = 1;
+            }
+          else if (ch == 'l')
+            {
+              ch = *format++;
+              length = 4;
+            }
+          else
+            length = 2;
+        }
+      else if (ch == 'l')
+        {
+          ch = *format++;
+          length = 8;
+        }
+      if ((vector_length > 0 && length == 0)
+          || (vector_length == 0 && length == 4))
+        break;
+      if (vector_length == 0)
+        vector_length = 1;
+
+#define PUT_VECTOR_ARG(WIDTH, PROMOTED_WIDTH)                                 \
+  switch (vector_length)                                                      \
+    {                                                                         \
+    default:                                                                  \
+      __builtin_unreachable ();                                               \
+    case 1:                                                                   \
+      {                                                                       \
+        PROMOTED_WIDTH val = va_arg (ap, PROMOTED_WIDTH);                     \
+        __pocl_printf_deferred_put (&p, &val, sizeof (val));                  \
+        break;                                                                \
+      }                                                                       \
+    case 2:                                                                   \
+      {                                                                       \
+        WIDTH##2 val = va_arg (ap, WIDTH##2);                                 \
+        __pocl_printf_deferred_put (&p, &val, sizeof (val));                  \
+        break;                                                                \
+      }                                                                       \
+    case 3:                                                                   \
+    case 4:                                                                   \
+      {                                                                       \
+        WIDTH##4 val = va_arg (ap, WIDTH##4);                                 \
+        __pocl_printf_deferred_put (&p, &val, sizeof (val));                  \
+        break;                                                                \
+      }                                                                       \
+    case 8:                                                                   \
+      {                                                                       \
+        WIDTH##8 val = va_arg (ap, WIDTH##8);                                 \
+        __pocl_printf_deferred_put (&p, &val, sizeof (val));                  \
+        break;                                                                \
+      }                                                                       \
+    case 16:                                                                  \
+      {                                                                       \
+        WIDTH##16 val = va_arg (ap, WIDTH##16);                               \
+        __pocl_printf_deferred_put (&p, &val, sizeof (val));                  \
+        break;                                                                \
+      }                                                                       \
+    }
+
+      if (ch == 'd' || ch == 'i' || ch == 'o' || ch == 'u' || ch == 'x'
+          || ch == 'X')
+        {
+          if (length == 1)
+            PUT_VECTOR_ARG (uchar, uint)
+          else if (length == 2)
+            PUT_VECTOR_ARG (ushort, uint)
+          else if (length == 0 || length == 4)
+            PUT_VECTOR_ARG (uint, uint)
+#ifdef cl_khr_int64
+          else
+            PUT_VECTOR_ARG (ulong, ulong)
+#else
+          else
+            break;
+#endif
+        }
+      else if (ch == 'f' || ch == 'F' || ch == 'e' || ch == 'E' || ch == 'g'
+               || ch == 'G' || ch == 'a' || ch == 'A')
+        {
+#ifdef cl_khr_fp64
+          if (length == 0 || length == 4)
+            PUT_VECTOR_ARG (float, double)
+          else if (length == 8)
+            PUT_VECTOR_ARG (double, double)
+          else
+            break;
+#else
+          if (length == 0 || length == 4)
+            PUT_VECTOR_ARG (float, float)
+          else
+            break;
+#endif
+        }
+      else if (ch == 'c' || ch == 's' || ch == 'p')
+        {
+          if (vector_length != 1 || length != 0)
+            break;
+          if (ch == 'c')
+            {
+              int val = va_arg (ap, int);
+              __pocl_printf_deferred_put (&p, &val, sizeof (val));
+            }
+          else if (ch == 'p')
+            {
+              uint64_t val = (uintptr_t)va_arg (ap, OCL_C_AS const void *);
+              __pocl_printf_deferred_put (&p, &val, sizeof (val));
+            }
+          else
+            {
+              OCL_C_AS const char *val = va_arg (ap, OCL_C_AS const char *);
+              uint32_t len = 0;
+              if (val == NULL)
+                len = DEFERRED_NULL_STRING;
+              else
+                while (val[len])
+                  ++len;
+              __pocl_printf_deferred_put (&p, &len, sizeof (len));
+              if (val != NULL)
+                __pocl_printf_deferred_put (&p, val, len);
+            }
+        }
+      else
+        break;
+
+#undef PUT_VECTOR_ARG
+    }
+
+  va_end (ap);
+
+  uint32_t size = (p.printf_buffer_index - start + 7) & ~7U;
+  if (start + size > p.printf_buffer_capacity)
+    return -1;
+
+  struct
+  {
+    uint32_t size;
+    uint32_t flags;
+    uint64_t format;
+  } header;
+  header.size = size;
+#ifdef cl_khr_fp64
+  header.flags = 0;
+#else
+  header.flags = DEFERRED_FLAG_FLOAT_ARGS;
+#endif
+  header.format = (uintptr_t)fmt;
+
+  p.printf_buffer_index = start;
+  __pocl_printf_deferred_put (&p, &header, DEFERRED_HEADER_SIZE);
+
+  *(PRINTF_BUFFER_AS uint32_t *)__buffer_index = start + size;
+  return 0;
+}
+
+/**************************************************************************/
+
 extern char *_printf_buffer;
 extern uint32_t *_printf_buffer_position;
 extern uint32_t _printf_buffer_capacity;
@@ -755,7 +1005,8 @@ extern uint32_t _printf_buffer_capacity;
 /* This is a placeholder printf function that will be replaced by calls
  * to __pocl_printf(), after an LLVM pass handles the hidden arguments.
  * both __pocl_printf and __pocl_printf_format_simple must be referenced
- * here, so that the kernel library linker pulls them in. */
+ * here, so that the kernel library linker pulls them in; likewise
+ * __pocl_printf_deferred for the deferred printf mode. */
 
 int
 printf (const PRINTF_FMT_STR_AS char *restrict fmt, ...)
@@ -774,6 +1025,8 @@ printf (const PRINTF_FMT_STR_AS char *restrict fmt, ...)
 
   __pocl_printf (_printf_buffer, _printf_buffer_position,
                  _printf_buffer_capacity, NULL);
+  __pocl_printf_deferred (_printf_buffer, _printf_buffer_position,
+                          _printf_buffer_capacity, NULL);
 
   *(PRINTF_BUFFER_AS uint32_t *)_printf_buffer_position
       = p.printf_buffer_index;
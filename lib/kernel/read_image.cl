@@ -433,8 +433,10 @@ pocl_read_pixel (global dev_image_t *img, int4 coord)
         return as_uint4 (BORDER_COLOR_F);
     }
 
-  size_t base_index
-      = coord.x + (coord.y * row_pitch) + (coord.z * slice_pitch);
+  size_t base_index = pocl_image_x_offset (coord.x, img->_tiling)
+                      + pocl_image_y_offset (coord.y, row_pitch, img->_tiling)
+                      + pocl_image_z_offset (coord.z, slice_pitch,
+                                             img->_tiling);
 
   if ((channel_type == CLK_SIGNED_INT8) || (channel_type == CLK_SIGNED_INT16)
       || (channel_type == CLK_SIGNED_INT32))
@@ -479,8 +481,8 @@ pocl_address_mode (global dev_image_t *img, int4 input_coord,
 _CL_READONLY static float4
 read_pixel_linear_3d_float (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
                             int width, int height, int depth, int channel_type,
-                            size_t row_pitch, size_t slice_pitch, int order,
-                            void *data)
+                            size_t row_pitch, size_t slice_pitch, int tiling,
+                            int order, void *data)
 {
   size_t base_index = 0;
   int ijk0_y_OK = (ijk0.y >= 0 && ijk0.y < height);
@@ -493,123 +495,123 @@ read_pixel_linear_3d_float (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
 
   if (ijk0.z >= 0 && ijk0.z < depth)
     {
-      base_index += (ijk0.z * slice_pitch);
+      base_index += pocl_image_z_offset (ijk0.z, slice_pitch, tiling);
 
       if (ijk0_y_OK)
         {
-          base_index += (ijk0.y * row_pitch);
+          base_index += pocl_image_y_offset (ijk0.y, row_pitch, tiling);
 
           if (ijk0_x_OK)
             {
-              base_index += ijk0.x;
+              base_index += pocl_image_x_offset (ijk0.x, tiling);
               sum += (one_m.x * one_m.y * one_m.z
                       * pocl_read_pixel_fast_f (base_index, channel_type,
                                                 order, data));
-              base_index -= ijk0.x;
+              base_index -= pocl_image_x_offset (ijk0.x, tiling);
             }
 
           // + a * (1 – b) * (1 – c) * Ti1j0k0
           if (ijk1_x_OK)
             {
-              base_index += ijk1.x;
+              base_index += pocl_image_x_offset (ijk1.x, tiling);
               sum += (abc.x * one_m.y * one_m.z
                       * pocl_read_pixel_fast_f (base_index, channel_type,
                                                 order, data));
-              base_index -= ijk1.x;
+              base_index -= pocl_image_x_offset (ijk1.x, tiling);
             }
 
-          base_index -= (ijk0.y * row_pitch);
+          base_index -= pocl_image_y_offset (ijk0.y, row_pitch, tiling);
         }
 
       if (ijk1_y_OK)
         {
-          base_index += (ijk1.y * row_pitch);
+          base_index += pocl_image_y_offset (ijk1.y, row_pitch, tiling);
 
           // + (1 – a) * b * (1 – c) * Ti0j1k0
           if (ijk0_x_OK)
             {
-              base_index += ijk0.x;
+              base_index += pocl_image_x_offset (ijk0.x, tiling);
               sum += (one_m.x * abc.y * one_m.z
                       * pocl_read_pixel_fast_f (base_index, channel_type,
                                                 order, data));
-              base_index -= ijk0.x;
+              base_index -= pocl_image_x_offset (ijk0.x, tiling);
             }
 
           // + a * b * (1 – c) * Ti1j1k0
           if (ijk1_x_OK)
             {
-              base_index += ijk1.x;
+              base_index += pocl_image_x_offset (ijk1.x, tiling);
               sum += (abc.x * abc.y * one_m.z
                       * pocl_read_pixel_fast_f (base_index, channel_type,
                                                 order, data));
-              base_index -= ijk1.x;
+              base_index -= pocl_image_x_offset (ijk1.x, tiling);
             }
 
-          base_index -= (ijk1.y * row_pitch);
+          base_index -= pocl_image_y_offset (ijk1.y, row_pitch, tiling);
         }
 
-      base_index -= (ijk0.z * slice_pitch);
+      base_index -= pocl_image_z_offset (ijk0.z, slice_pitch, tiling);
     }
 
   if (ijk1.z >= 0 && ijk1.z < depth)
     {
-      base_index += (ijk1.z * slice_pitch);
+      base_index += pocl_image_z_offset (ijk1.z, slice_pitch, tiling);
 
       if (ijk0_y_OK)
         {
-          base_index += (ijk0.y * row_pitch);
+          base_index += pocl_image_y_offset (ijk0.y, row_pitch, tiling);
 
           // + (1 – a) * (1 – b) * c * Ti0j0k1
           if (ijk0_x_OK)
             {
-              base_index += ijk0.x;
+              base_index += pocl_image_x_offset (ijk0.x, tiling);
               sum += (one_m.x * one_m.y * abc.z
                       * pocl_read_pixel_fast_f (base_index, channel_type,
                                                 order, data));
-              base_index -= ijk0.x;
+              base_index -= pocl_image_x_offset (ijk0.x, tiling);
             }
 
           // + a * (1 – b) * (1 – c) * Ti1j0k0
           if (ijk1_x_OK)
             {
-              base_index += ijk1.x;
+              base_index += pocl_image_x_offset (ijk1.x, tiling);
               sum += (abc.x * one_m.y * abc.z
                       * pocl_read_pixel_fast_f (base_index, channel_type,
                                                 order, data));
-              base_index -= ijk1.x;
+              base_index -= pocl_image_x_offset (ijk1.x, tiling);
             }
 
-          base_index -= (ijk0.y * row_pitch);
+          base_index -= pocl_image_y_offset (ijk0.y, row_pitch, tiling);
         }
 
       if (ijk1_y_OK)
         {
-          base_index += (ijk1.y * row_pitch);
+          base_index += pocl_image_y_offset (ijk1.y, row_pitch, tiling);
 
           // + (1 – a) * b * (1 – c) * Ti0j1k0
           if (ijk0_x_OK)
             {
-              base_index += ijk0.x;
+              base_index += pocl_image_x_offset (ijk0.x, tiling);
               sum += (one_m.x * abc.y * abc.z
                       * pocl_read_pixel_fast_f (base_index, channel_type,
                                                 order, data));
-              base_index -= ijk0.x;
+              base_index -= pocl_image_x_offset (ijk0.x, tiling);
             }
 
           // + a * b * (1 – c) * Ti1j1k0
           if (ijk1_x_OK)
             {
-              base_index += ijk1.x;
+              base_index += pocl_image_x_offset (ijk1.x, tiling);
               sum += (abc.x * abc.y * abc.z
                       * pocl_read_pixel_fast_f (base_index, channel_type,
                                                 order, data));
-              base_index -= ijk1.x;
+              base_index -= pocl_image_x_offset (ijk1.x, tiling);
             }
 
-          base_index -= (ijk1.y * row_pitch);
+          base_index -= pocl_image_y_offset (ijk1.y, row_pitch, tiling);
         }
 
-      base_index -= (ijk1.z * slice_pitch);
+      base_index -= pocl_image_z_offset (ijk1.z, slice_pitch, tiling);
     }
 
   return sum;
@@ -622,8 +624,8 @@ read_pixel_linear_3d_float (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
 _CL_READONLY static uint4
 read_pixel_linear_3d_uint (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
                            int width, int height, int depth, size_t row_pitch,
-                           size_t slice_pitch, int order, int elem_size,
-                           void *data)
+                           size_t slice_pitch, int tiling, int order,
+                           int elem_size, void *data)
 {
   size_t base_index = 0;
   int ijk0_y_OK = (ijk0.y >= 0 && ijk0.y < height);
@@ -636,123 +638,123 @@ read_pixel_linear_3d_uint (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
 
   if (ijk0.z >= 0 && ijk0.z < depth)
     {
-      base_index += (ijk0.z * slice_pitch);
+      base_index += pocl_image_z_offset (ijk0.z, slice_pitch, tiling);
 
       if (ijk0_y_OK)
         {
-          base_index += (ijk0.y * row_pitch);
+          base_index += pocl_image_y_offset (ijk0.y, row_pitch, tiling);
 
           if (ijk0_x_OK)
             {
-              base_index += ijk0.x;
+              base_index += pocl_image_x_offset (ijk0.x, tiling);
               sum += (one_m.x * one_m.y * one_m.z
                       * convert_float4 (pocl_read_pixel_fast_ui (
                             base_index, order, elem_size, data)));
-              base_index -= ijk0.x;
+              base_index -= pocl_image_x_offset (ijk0.x, tiling);
             }
 
           // + a * (1 – b) * (1 – c) * Ti1j0k0
           if (ijk1_x_OK)
             {
-              base_index += ijk1.x;
+              base_index += pocl_image_x_offset (ijk1.x, tiling);
               sum += (abc.x * one_m.y * one_m.z
                       * convert_float4 (pocl_read_pixel_fast_ui (
                             base_index, order, elem_size, data)));
-              base_index -= ijk1.x;
+              base_index -= pocl_image_x_offset (ijk1.x, tiling);
             }
 
-          base_index -= (ijk0.y * row_pitch);
+          base_index -= pocl_image_y_offset (ijk0.y, row_pitch, tiling);
         }
 
       if (ijk1_y_OK)
         {
-          base_index += (ijk1.y * row_pitch);
+          base_index += pocl_image_y_offset (ijk1.y, row_pitch, tiling);
 
           // + (1 – a) * b * (1 – c) * Ti0j1k0
           if (ijk0_x_OK)
             {
-              base_index += ijk0.x;
+              base_index += pocl_image_x_offset (ijk0.x, tiling);
               sum += (one_m.x * abc.y * one_m.z
                       * convert_float4 (pocl_read_pixel_fast_ui (
                             base_index, order, elem_size, data)));
-              base_index -= ijk0.x;
+              base_index -= pocl_image_x_offset (ijk0.x, tiling);
             }
 
           // + a * b * (1 – c) * Ti1j1k0
           if (ijk1_x_OK)
             {
-              base_index += ijk1.x;
+              base_index += pocl_image_x_offset (ijk1.x, tiling);
               sum += (abc.x * abc.y * one_m.z
                       * convert_float4 (pocl_read_pixel_fast_ui (
                             base_index, order, elem_size, data)));
-              base_index -= ijk1.x;
+              base_index -= pocl_image_x_offset (ijk1.x, tiling);
             }
 
-          base_index -= (ijk1.y * row_pitch);
+          base_index -= pocl_image_y_offset (ijk1.y, row_pitch, tiling);
         }
 
-      base_index -= (ijk0.z * slice_pitch);
+      base_index -= pocl_image_z_offset (ijk0.z, slice_pitch, tiling);
     }
 
   if (ijk1.z >= 0 && ijk1.z < depth)
     {
-      base_index += (ijk1.z * slice_pitch);
+      base_index += pocl_image_z_offset (ijk1.z, slice_pitch, tiling);
 
       if (ijk0_y_OK)
         {
-          base_index += (ijk0.y * row_pitch);
+          base_index += pocl_image_y_offset (ijk0.y, row_pitch, tiling);
 
           // + (1 – a) * (1 – b) * c * Ti0j0k1
           if (ijk0_x_OK)
             {
-              base_index += ijk0.x;
+              base_index += pocl_image_x_offset (ijk0.x, tiling);
               sum += (one_m.x * one_m.y * abc.z
                       * convert_float4 (pocl_read_pixel_fast_ui (
                             base_index, order, elem_size, data)));
-              base_index -= ijk0.x;
+              base_index -= pocl_image_x_offset (ijk0.x, tiling);
             }
 
           // + a * (1 – b) * (1 – c) * Ti1j0k0
           if (ijk1_x_OK)
             {
-              base_index += ijk1.x;
+              base_index += pocl_image_x_offset (ijk1.x, tiling);
               sum += (abc.x * one_m.y * abc.z
                       * convert_float4 (pocl_read_pixel_fast_ui (
                             base_index, order, elem_size, data)));
-              base_index -= ijk1.x;
+              base_index -= pocl_image_x_offset (ijk1.x, tiling);
             }
 
-          base_index -= (ijk0.y * row_pitch);
+          base_index -= pocl_image_y_offset (ijk0.y, row_pitch, tiling);
         }
 
       if (ijk1_y_OK)
         {
-          base_index += (ijk1.y * row_pitch);
+          base_index += pocl_image_y_offset (ijk1.y, row_pitch, tiling);
 
           // + (1 – a) * b * (1 – c) * Ti0j1k0
           if (ijk0_x_OK)
             {
-              base_index += ijk0.x;
+              base_index += pocl_image_x_offset (ijk0.x, tiling);
               sum += (one_m.x * abc.y * abc.z
                       * convert_float4 (pocl_read_pixel_fast_ui (
                             base_index, order, elem_size, data)));
-              base_index -= ijk0.x;
+              base_index -= pocl_image_x_offset (ijk0.x, tiling);
             }
 
           // + a * b * (1 – c) * Ti1j1k0
           if (ijk1_x_OK)
             {
-              base_index += ijk1.x;
+              base_index += pocl_image_x_offset (ijk1.x, tiling);
               sum += (abc.x * abc.y * abc.z
                       * convert_float4 (pocl_read_pixel_fast_ui (
                             base_index, order, elem_size, data)));
-              base_index -= ijk1.x;
+              base_index -= pocl_image_x_offset (ijk1.x, tiling);
             }
 
-          base_index -= (ijk1.y * row_pitch);
+          base_index -= pocl_image_y_offset (ijk1.y, row_pitch, tiling);
         }
 
-      base_index -= (ijk1.z * slice_pitch);
+      base_index -= pocl_image_z_offset (ijk1.z, slice_pitch, tiling);
     }
 
   return convert_uint4 (sum);
@@ -761,8 +763,8 @@ read_pixel_linear_3d_uint (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
 _CL_READONLY static int4
 read_pixel_linear_3d_int (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
                           int width, int height, int depth, size_t row_pitch,
-                          size_t slice_pitch, int order, int elem_size,
-                          void *data)
+                          size_t slice_pitch, int tiling, int order,
+                          int elem_size, void *data)
 {
   size_t base_index = 0;
   int ijk0_y_OK = (ijk0.y >= 0 && ijk0.y < height);
@@ -775,123 +777,123 @@ read_pixel_linear_3d_int (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
 
   if (ijk0.z >= 0 && ijk0.z < depth)
     {
-      base_index += (ijk0.z * slice_pitch);
+      base_index += pocl_image_z_offset (ijk0.z, slice_pitch, tiling);
 
       if (ijk0_y_OK)
         {
-          base_index += (ijk0.y * row_pitch);
+          base_index += pocl_image_y_offset (ijk0.y, row_pitch, tiling);
 
           if (ijk0_x_OK)
             {
-              base_index += ijk0.x;
+              base_index += pocl_image_x_offset (ijk0.x, tiling);
               sum += (one_m.x * one_m.y * one_m.z
                       * convert_float4 (pocl_read_pixel_fast_i (
                             base_index, order, elem_size, data)));
-              base_index -= ijk0.x;
+              base_index -= pocl_image_x_offset (ijk0.x, tiling);
             }
 
           // + a * (1 – b) * (1 – c) * Ti1j0k0
           if (ijk1_x_OK)
             {
-              base_index += ijk1.x;
+              base_index += pocl_image_x_offset (ijk1.x, tiling);
               sum += (abc.x * one_m.y * one_m.z
                       * convert_float4 (pocl_read_pixel_fast_i (
                             base_index, order, elem_size, data)));
-              base_index -= ijk1.x;
+              base_index -= pocl_image_x_offset (ijk1.x, tiling);
             }
 
-          base_index -= (ijk0.y * row_pitch);
+          base_index -= pocl_image_y_offset (ijk0.y, row_pitch, tiling);
         }
 
       if (ijk1_y_OK)
         {
-          base_index += (ijk1.y * row_pitch);
+          base_index += pocl_image_y_offset (ijk1.y, row_pitch, tiling);
 
           // + (1 – a) * b * (1 – c) * Ti0j1k0
           if (ijk0_x_OK)
             {
-              base_index += ijk0.x;
+              base_index += pocl_image_x_offset (ijk0.x, tiling);
               sum += (one_m.x * abc.y * one_m.z
                       * convert_float4 (pocl_read_pixel_fast_i (
                             base_index, order, elem_size, data)));
-              base_index -= ijk0.x;
+              base_index -= pocl_image_x_offset (ijk0.x, tiling);
             }
 
           // + a * b * (1 – c) * Ti1j1k0
           if (ijk1_x_OK)
             {
-              base_index += ijk1.x;
+              base_index += pocl_image_x_offset (ijk1.x, tiling);
               sum += (abc.x * abc.y * one_m.z
                       * convert_float4 (pocl_read_pixel_fast_i (
                             base_index, order, elem_size, data)));
-              base_index -= ijk1.x;
+              base_index -= pocl_image_x_offset (ijk1.x, tiling);
             }
 
-          base_index -= (ijk1.y * row_pitch);
+          base_index -= pocl_image_y_offset (ijk1.y, row_pitch, tiling);
         }
 
-      base_index -= (ijk0.z * slice_pitch);
+      base_index -= pocl_image_z_offset (ijk0.z, slice_pitch, tiling);
     }
 
   if (ijk1.z >= 0 && ijk1.z < depth)
     {
-      base_index += (ijk1.z * slice_pitch);
+      base_index += pocl_image_z_offset (ijk1.z, slice_pitch, tiling);
 
       if (ijk0_y_OK)
         {
-          base_index += (ijk0.y * row_pitch);
+          base_index += pocl_image_y_offset (ijk0.y, row_pitch, tiling);
 
           // + (1 – a) * (1 – b) * c * Ti0j0k1
           if (ijk0_x_OK)
             {
-              base_index += ijk0.x;
+              base_index += pocl_image_x_offset (ijk0.x, tiling);
               sum += (one_m.x * one_m.y * abc.z
                       * convert_float4 (pocl_read_pixel_fast_i (
                             base_index, order, elem_size, data)));
-              base_index -= ijk0.x;
+              base_index -= pocl_image_x_offset (ijk0.x, tiling);
             }
 
           // + a * (1 – b) * (1 – c) * Ti1j0k0
           if (ijk1_x_OK)
             {
-              base_index += ijk1.x;
+              base_index += pocl_image_x_offset (ijk1.x, tiling);
               sum += (abc.x * one_m.y * abc.z
                       * convert_float4 (pocl_read_pixel_fast_i (
                             base_index, order, elem_size, data)));
-              base_index -= ijk1.x;
+              base_index -= pocl_image_x_offset (ijk1.x, tiling);
             }
 
-          base_index -= (ijk0.y * row_pitch);
+          base_index -= pocl_image_y_offset (ijk0.y, row_pitch, tiling);
         }
 
       if (ijk1_y_OK)
         {
-          base_index += (ijk1.y * row_pitch);
+          base_index += pocl_image_y_offset (ijk1.y, row_pitch, tiling);
 
           // + (1 – a) * b * (1 – c) * Ti0j1k0
           if (ijk0_x_OK)
             {
-              base_index += ijk0.x;
+              base_index += pocl_image_x_offset (ijk0.x, tiling);
               sum += (one_m.x * abc.y * abc.z
                       * convert_float4 (pocl_read_pixel_fast_i (
                             base_index, order, elem_size, data)));
-              base_index -= ijk0.x;
+              base_index -= pocl_image_x_offset (ijk0.x, tiling);
             }
 
           // + a * b * (1 – c) * Ti1j1k0
           if (ijk1_x_OK)
             {
-              base_index += ijk1.x;
+              base_index += pocl_image_x_offset (ijk1.x, tiling);
               sum += (abc.x * abc.y * abc.z
                       * convert_float4 (pocl_read_pixel_fast_i (
                             base_index, order, elem_size, data)));
-              base_index -= ijk1.x;
+              base_index -= pocl_image_x_offset (ijk1.x, tiling);
             }
 
-          base_index -= (ijk1.y * row_pitch);
+          base_index -= pocl_image_y_offset (ijk1.y, row_pitch, tiling);
         }
 
-      base_index -= (ijk1.z * slice_pitch);
+      base_index -= pocl_image_z_offset (ijk1.z, slice_pitch, tiling);
     }
 
   return convert_int4 (sum);
@@ -900,23 +902,23 @@ read_pixel_linear_3d_int (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
 _CL_READONLY static uint4
 read_pixel_linear_3d (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
                       int width, int height, int depth, int channel_type,
-                      size_t row_pitch, size_t slice_pitch, int order,
-                      int elem_size, void *data)
+                      size_t row_pitch, size_t slice_pitch, int tiling,
+                      int order, int elem_size, void *data)
 {
   // TODO unsupported channel types
   if ((channel_type == CLK_SIGNED_INT8) || (channel_type == CLK_SIGNED_INT16)
       || (channel_type == CLK_SIGNED_INT32))
     return as_uint4 (read_pixel_linear_3d_int (
         abc, one_m, ijk0, ijk1, width, height, depth, row_pitch, slice_pitch,
-        order, elem_size, data));
+        tiling, order, elem_size, data));
   if ((channel_type == CLK_UNSIGNED_INT8) || (channel_type == CLK_UNSIGNED_INT16)
       || (channel_type == CLK_UNSIGNED_INT32))
     return read_pixel_linear_3d_uint (abc, one_m, ijk0, ijk1, width, height,
-                                      depth, row_pitch, slice_pitch, order,
-                                      elem_size, data);
+                                      depth, row_pitch, slice_pitch, tiling,
+                                      order, elem_size, data);
   return as_uint4 (read_pixel_linear_3d_float (
       abc, one_m, ijk0, ijk1, width, height, depth, channel_type, row_pitch,
-      slice_pitch, order, data));
+      slice_pitch, tiling, order, data));
 }
 
 /*************************************************************************/
@@ -925,7 +927,8 @@ _CL_READONLY static float4
 read_pixel_linear_2d_float (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
                             int array_coord, int width, int height,
                             int channel_type, size_t row_pitch,
-                            size_t slice_pitch, int order, void *data)
+                            size_t slice_pitch, int tiling, int order,
+                            void *data)
 {
   // 2D image
   size_t base_index = 0;
@@ -938,55 +941,55 @@ read_pixel_linear_2d_float (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
 
   if (ijk0.y >= 0 && ijk0.y < height)
     {
-      base_index += (ijk0.y * row_pitch);
+      base_index += pocl_image_y_offset (ijk0.y, row_pitch, tiling);
 
       // T = (1 – a) * (1 – b) * Ti0j0
       if (ijk0_x_OK)
         {
-          base_index += ijk0.x;
+          base_index += pocl_image_x_offset (ijk0.x, tiling);
           sum += (one_m.x * one_m.y * pocl_read_pixel_fast_f (base_index,
                                                               channel_type,
                                                               order, data));
-          base_index -= ijk0.x;
+          base_index -= pocl_image_x_offset (ijk0.x, tiling);
         }
 
       // + a * (1 – b) * Ti1j0
       if (ijk1_x_OK)
         {
-          base_index += ijk1.x;
+          base_index += pocl_image_x_offset (ijk1.x, tiling);
           sum += (abc.x * one_m.y * pocl_read_pixel_fast_f (base_index,
                                                             channel_type,
                                                             order, data));
-          base_index -= ijk1.x;
+          base_index -= pocl_image_x_offset (ijk1.x, tiling);
         }
 
-      base_index -= (ijk0.y * row_pitch);
+      base_index -= pocl_image_y_offset (ijk0.y, row_pitch, tiling);
     }
 
   if (ijk1.y >= 0 && ijk1.y < height)
     {
-      base_index += (ijk1.y * row_pitch);
+      base_index += pocl_image_y_offset (ijk1.y, row_pitch, tiling);
 
       // + (1 – a) * b * Ti0j1
       if (ijk0_x_OK)
         {
-          base_index += ijk0.x;
+          base_index += pocl_image_x_offset (ijk0.x, tiling);
           sum += (one_m.x * abc.y * pocl_read_pixel_fast_f (base_index,
                                                             channel_type,
                                                             order, data));
-          base_index -= ijk0.x;
+          base_index -= pocl_image_x_offset (ijk0.x, tiling);
         }
 
       // + a * b * Ti1j1
       if (ijk1_x_OK)
         {
-          base_index += ijk1.x;
+          base_index += pocl_image_x_offset (ijk1.x, tiling);
           sum += (abc.x * abc.y * pocl_read_pixel_fast_f (
                                       base_index, channel_type, order, data));
-          base_index -= ijk1.x;
+          base_index -= pocl_image_x_offset (ijk1.x, tiling);
         }
 
-      base_index -= (ijk1.y * row_pitch);
+      base_index -= pocl_image_y_offset (ijk1.y, row_pitch, tiling);
     }
 
   return sum;
@@ -999,8 +1002,8 @@ read_pixel_linear_2d_float (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
 _CL_READONLY static uint4
 read_pixel_linear_2d_uint (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
                            int array_coord, int width, int height,
-                           size_t row_pitch, size_t slice_pitch, int order,
-                           int elem_size, void *data)
+                           size_t row_pitch, size_t slice_pitch, int tiling,
+                           int order, int elem_size, void *data)
 {
   // 2D image
   size_t base_index = 0;
@@ -1013,53 +1016,53 @@ read_pixel_linear_2d_uint (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
 
   if (ijk0.y >= 0 && ijk0.y < height)
     {
-      base_index += (ijk0.y * row_pitch);
+      base_index += pocl_image_y_offset (ijk0.y, row_pitch, tiling);
 
       // T = (1 – a) * (1 – b) * Ti0j0
       if (ijk0_x_OK)
         {
-          base_index += ijk0.x;
+          base_index += pocl_image_x_offset (ijk0.x, tiling);
           sum += (one_m.x * one_m.y
                   * convert_float4 (pocl_read_pixel_fast_ui (
                         base_index, order, elem_size, data)));
-          base_index -= ijk0.x;
+          base_index -= pocl_image_x_offset (ijk0.x, tiling);
         }
 
       // + a * (1 – b) * Ti1j0
       if (ijk1_x_OK)
         {
-          base_index += ijk1.x;
+          base_index += pocl_image_x_offset (ijk1.x, tiling);
           sum += (abc.x * one_m.y * convert_float4 (pocl_read_pixel_fast_ui (
                                         base_index, order, elem_size, data)));
-          base_index -= ijk1.x;
+          base_index -= pocl_image_x_offset (ijk1.x, tiling);
         }
 
-      base_index -= (ijk0.y * row_pitch);
+      base_index -= pocl_image_y_offset (ijk0.y, row_pitch, tiling);
     }
 
   if (ijk1.y >= 0 && ijk1.y < height)
     {
-      base_index += (ijk1.y * row_pitch);
+      base_index += pocl_image_y_offset (ijk1.y, row_pitch, tiling);
 
       // + (1 – a) * b * Ti0j1
       if (ijk0_x_OK)
         {
-          base_index += ijk0.x;
+          base_index += pocl_image_x_offset (ijk0.x, tiling);
           sum += (one_m.x * abc.y * convert_float4 (pocl_read_pixel_fast_ui (
                                         base_index, order, elem_size, data)));
-          base_index -= ijk0.x;
+          base_index -= pocl_image_x_offset (ijk0.x, tiling);
         }
 
       // + a * b * Ti1j1
       if (ijk1_x_OK)
         {
-          base_index += ijk1.x;
+          base_index += pocl_image_x_offset (ijk1.x, tiling);
           sum += (abc.x * abc.y * convert_float4 (pocl_read_pixel_fast_ui (
                                       base_index, order, elem_size, data)));
-          base_index -= ijk1.x;
+          base_index -= pocl_image_x_offset (ijk1.x, tiling);
         }
 
-      base_index -= (ijk1.y * row_pitch);
+      base_index -= pocl_image_y_offset (ijk1.y, row_pitch, tiling);
     }
 
   return convert_uint4 (sum);
@@ -1068,8 +1071,8 @@ read_pixel_linear_2d_uint (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
 _CL_READONLY static int4
 read_pixel_linear_2d_int (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
                           int array_coord, int width, int height,
-                          size_t row_pitch, size_t slice_pitch, int order,
-                          int elem_size, void *data)
+                          size_t row_pitch, size_t slice_pitch, int tiling,
+                          int order, int elem_size, void *data)
 {
   // 2D image
   size_t base_index = 0;
@@ -1082,53 +1085,53 @@ read_pixel_linear_2d_int (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
 
   if (ijk0.y >= 0 && ijk0.y < height)
     {
-      base_index += (ijk0.y * row_pitch);
+      base_index += pocl_image_y_offset (ijk0.y, row_pitch, tiling);
 
       // T = (1 – a) * (1 – b) * Ti0j0
       if (ijk0_x_OK)
         {
-          base_index += ijk0.x;
+          base_index += pocl_image_x_offset (ijk0.x, tiling);
           sum += (one_m.x * one_m.y
                   * convert_float4 (pocl_read_pixel_fast_i (base_index, order,
                                                             elem_size, data)));
-          base_index -= ijk0.x;
+          base_index -= pocl_image_x_offset (ijk0.x, tiling);
         }
 
       // + a * (1 – b) * Ti1j0
       if (ijk1_x_OK)
         {
-          base_index += ijk1.x;
+          base_index += pocl_image_x_offset (ijk1.x, tiling);
           sum += (abc.x * one_m.y * convert_float4 (pocl_read_pixel_fast_i (
                                         base_index, order, elem_size, data)));
-          base_index -= ijk1.x;
+          base_index -= pocl_image_x_offset (ijk1.x, tiling);
         }
 
-      base_index -= (ijk0.y * row_pitch);
+      base_index -= pocl_image_y_offset (ijk0.y, row_pitch, tiling);
     }
 
   if (ijk1.y >= 0 && ijk1.y < height)
     {
-      base_index += (ijk1.y * row_pitch);
+      base_index += pocl_image_y_offset (ijk1.y, row_pitch, tiling);
 
       // + (1 – a) * b * Ti0j1
       if (ijk0_x_OK)
         {
-          base_index += ijk0.x;
+          base_index += pocl_image_x_offset (ijk0.x, tiling);
           sum += (one_m.x * abc.y * convert_float4 (pocl_read_pixel_fast_i (
                                         base_index, order, elem_size, data)));
-          base_index -= ijk0.x;
+          base_index -= pocl_image_x_offset (ijk0.x, tiling);
         }
 
       // + a * b * Ti1j1
       if (ijk1_x_OK)
         {
-          base_index += ijk1.x;
+          base_index += pocl_image_x_offset (ijk1.x, tiling);
           sum += (abc.x * abc.y * convert_float4 (pocl_read_pixel_fast_i (
                                       base_index, order, elem_size, data)));
-          base_index -= ijk1.x;
+          base_index -= pocl_image_x_offset (ijk1.x, tiling);
         }
 
-      base_index -= (ijk1.y * row_pitch);
+      base_index -= pocl_image_y_offset (ijk1.y, row_pitch, tiling);
     }
 
   return convert_int4 (sum);
@@ -1137,23 +1140,23 @@ read_pixel_linear_2d_int (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
 _CL_READONLY static uint4
 read_pixel_linear_2d (float4 abc, float4 one_m, int4 ijk0, int4 ijk1,
                       int array_coord, int width, int height, int channel_type,
-                      size_t row_pitch, size_t slice_pitch, int order,
-                      int elem_size, void *data)
+                      size_t row_pitch, size_t slice_pitch, int tiling,
+                      int order, int elem_size, void *data)
 {
   // TODO unsupported channel types
   if ((channel_type == CLK_SIGNED_INT8) || (channel_type == CLK_SIGNED_INT16)
       || (channel_type == CLK_SIGNED_INT32))
     return as_uint4 (read_pixel_linear_2d_int (
         abc, one_m, ijk0, ijk1, array_coord, width, height, row_pitch,
-        slice_pitch, order, elem_size, data));
+        slice_pitch, tiling, order, elem_size, data));
   if ((channel_type == CLK_UNSIGNED_INT8) || (channel_type == CLK_UNSIGNED_INT16)
       || (channel_type == CLK_UNSIGNED_INT32))
     return read_pixel_linear_2d_uint (abc, one_m, ijk0, ijk1, array_coord,
                                       width, height, row_pitch, slice_pitch,
-                                      order, elem_size, data);
+                                      tiling, order, elem_size, data);
   return as_uint4 (read_pixel_linear_2d_float (
       abc, one_m, ijk0, ijk1, array_coord, width, height, channel_type,
-      row_pitch, slice_pitch, order, data));
+      row_pitch, slice_pitch, tiling, order, data));
 }
 
 /*************************************************************************/
@@ -1330,8 +1333,8 @@ nonrepeat_filter (global dev_image_t *img, float4 orig_coord,
         {
           res = read_pixel_linear_3d (
               abc, one_m, ijk0, ijk1, img->_width, img->_height, img->_depth,
-              img->_data_type, row_pitch, slice_pitch, img->_order,
-              img->_elem_size, img->_data);
+              img->_data_type, row_pitch, slice_pitch, img->_tiling,
+              img->_order, img->_elem_size, img->_data);
         }
       else if (img->_height != 0)
         {
@@ -1340,8 +1343,8 @@ nonrepeat_filter (global dev_image_t *img, float4 orig_coord,
                              (int)(img->_image_array_size - 1));
           res = read_pixel_linear_2d (
               abc, one_m, ijk0, ijk1, a_index, img->_width, img->_height,
-              img->_data_type, row_pitch, slice_pitch, img->_order,
-              img->_elem_size, img->_data);
+              img->_data_type, row_pitch, slice_pitch, img->_tiling,
+              img->_order, img->_elem_size, img->_data);
         }
       else
         {
@@ -1418,8 +1421,8 @@ repeat_filter (global dev_image_t *img, float4 coord, const dev_sampler_t samp)
         {
           res = read_pixel_linear_3d (
               abc, one_m, ijk0, ijk1, img->_width, img->_height, img->_depth,
-              img->_data_type, row_pitch, slice_pitch, img->_order,
-              img->_elem_size, img->_data);
+              img->_data_type, row_pitch, slice_pitch, img->_tiling,
+              img->_order, img->_elem_size, img->_data);
         }
       else if (img->_height != 0)
         {
@@ -1429,8 +1432,8 @@ repeat_filter (global dev_image_t *img, float4 coord, const dev_sampler_t samp)
                          0, (array_size - 1));
           res = read_pixel_linear_2d (
               abc, one_m, ijk0, ijk1, a_index, img->_width, img->_height,
-              img->_data_type, row_pitch, slice_pitch, img->_order,
-              img->_elem_size, img->_data);
+              img->_data_type, row_pitch, slice_pitch, img->_tiling,
+              img->_order, img->_elem_size, img->_data);
         }
       else
         {
@@ -1512,8 +1515,8 @@ mirrored_repeat_filter (global dev_image_t *img, float4 coord,
         {
           res = read_pixel_linear_3d (
               abc, one_m, ijk0, ijk1, img->_width, img->_height, img->_depth,
-              img->_data_type, row_pitch, slice_pitch, img->_order,
-              img->_elem_size, img->_data);
+              img->_data_type, row_pitch, slice_pitch, img->_tiling,
+              img->_order, img->_elem_size, img->_data);
         }
       else if (img->_height != 0)
         {
@@ -1523,8 +1526,8 @@ mirrored_repeat_filter (global dev_image_t *img, float4 coord,
                          0, (array_size - 1));
           res = read_pixel_linear_2d (
               abc, one_m, ijk0, ijk1, a_index, img->_width, img->_height,
-              img->_data_type, row_pitch, slice_pitch, img->_order,
-              img->_elem_size, img->_data);
+              img->_data_type, row_pitch, slice_pitch, img->_tiling,
+              img->_order, img->_elem_size, img->_data);
         }
       else
         {
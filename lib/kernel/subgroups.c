@@ -83,6 +83,10 @@ get_first_llid (void)
 
 void _CL_OVERLOADABLE sub_group_barrier (cl_mem_fence_flags flags);
 
+/* The collectives are computed by the first work-item of the sub-group
+   similarly to the work-group collectives (see work_group.c) with loops
+   the loop vectorizer can convert to SIMD reductions. */
+
 #define SUB_GROUP_SHUFFLE_PT(PREFIX, TYPE)                                    \
   __attribute__ ((always_inline))                                             \
   TYPE _CL_OVERLOADABLE PREFIX##sub_group_shuffle (TYPE val, uint index)      \
@@ -173,12 +177,15 @@ SUB_GROUP_BROADCAST_T (double)
     sub_group_barrier (CLK_LOCAL_MEM_FENCE);                                  \
     if (get_sub_group_local_id () == 0)                                       \
       {                                                                       \
-        for (uint i = 1; i < get_sub_group_size (); ++i)                      \
+        const TYPE *values = (const TYPE *)temp_storage + get_first_llid ();  \
+        const uint n = get_sub_group_size ();                                 \
+        TYPE a = values[0];                                                   \
+        for (uint i = 1; i < n; ++i)                                          \
           {                                                                   \
-            TYPE a = temp_storage[get_first_llid ()],                         \
-                 b = temp_storage[get_first_llid () + i];                     \
-            temp_storage[get_first_llid ()] = OPERATION;                      \
+            TYPE b = values[i];                                               \
+            a = OPERATION;                                                    \
           }                                                                   \
+        temp_storage[get_first_llid ()] = a;                                  \
       }                                                                       \
     sub_group_barrier (CLK_LOCAL_MEM_FENCE);                                  \
     return temp_storage[get_first_llid ()];                                   \
@@ -223,11 +230,14 @@ _Z20sub_group_reduce_addDh (half val)
     sub_group_barrier (CLK_LOCAL_MEM_FENCE);                                  \
     if (get_sub_group_local_id () == 0)                                       \
       {                                                                       \
-        for (uint i = 1; i < get_sub_group_size (); ++i)                      \
+        TYPE *values = (TYPE *)data + get_first_llid ();                      \
+        const uint n = get_sub_group_size ();                                 \
+        TYPE a = values[0];                                                   \
+        for (uint i = 1; i < n; ++i)                                          \
           {                                                                   \
-            TYPE a = data[get_first_llid () + i - 1],                         \
-                 b = data[get_first_llid () + i];                             \
-            data[get_first_llid () + i] = OPERATION;                          \
+            TYPE b = values[i];                                               \
+            a = OPERATION;                                                    \
+            values[i] = a;                                                    \
           }                                                                   \
       }                                                                       \
     sub_group_barrier (CLK_LOCAL_MEM_FENCE);                                  \
@@ -257,11 +267,14 @@ SUB_GROUP_SCAN_INCLUSIVE_T (max, a > b ? a : b)
     sub_group_barrier (CLK_LOCAL_MEM_FENCE);                                  \
     if (get_sub_group_local_id () == 0)                                       \
       {                                                                       \
-        for (uint i = 1; i < get_sub_group_size (); ++i)                      \
+        TYPE *values = (TYPE *)data + get_first_llid ();                      \
+        const uint n = get_sub_group_size ();                                 \
+        TYPE a = values[0];                                                   \
+        for (uint i = 1; i < n; ++i)                                          \
           {                                                                   \
-            TYPE a = data[get_first_llid () + i - 1],                         \
-                 b = data[get_first_llid () + i];                             \
-            data[get_first_llid () + i] = OPERATION;                          \
+            TYPE b = values[i];                                               \
+            a = OPERATION;                                                    \
+            values[i] = a;                                                    \
           }                                                                   \
       }                                                                       \
     sub_group_barrier (CLK_LOCAL_MEM_FENCE);                                  \
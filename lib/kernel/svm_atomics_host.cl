@@ -28,6 +28,37 @@
 #define _SVM_ATOMICS_H
 #endif
 
+#ifndef NARROW_ORDER
+
+/* An atomic with work_item scope needs no ordering. With
+ * ENABLE_SERIAL_WORK_GROUPS, the device runs the work-items of a work-group
+ * one after another in a single thread (the work-item loops), so orderings
+ * that are only visible to the sub-group or the work-group are implied by
+ * the program order.
+ *
+ * The atomics on __local memory are not lowered to plain loads and stores,
+ * even though no other thread accesses it. The work-item loops are marked
+ * with llvm.loop.parallel_accesses, which tells the loop vectorizer that
+ * their iterations do not depend on each other through memory. A plain
+ * read-modify-write of the same location in every work-item breaks that
+ * promise, and the vectorized loop would lose all but one update of each
+ * vector iteration. The library is compiled before the work-group method
+ * of a kernel is known, so the plain operations would need a per-kernel
+ * check in the work-item loop passes, which is out of scope here. */
+#ifdef ENABLE_SERIAL_WORK_GROUPS
+#define NARROW_ORDER(order, scope)                                            \
+  (((scope) == __OPENCL_MEMORY_SCOPE_WORK_ITEM                                \
+    || (scope) == __OPENCL_MEMORY_SCOPE_SUB_GROUP                             \
+    || (scope) == __OPENCL_MEMORY_SCOPE_WORK_GROUP)                           \
+       ? memory_order_relaxed                                                 \
+       : (order))
+#else
+#define NARROW_ORDER(order, scope)                                            \
+  ((scope) == __OPENCL_MEMORY_SCOPE_WORK_ITEM ? memory_order_relaxed : (order))
+#endif
+
+#endif
+
 
 
 
@@ -68,14 +99,14 @@ bool _CL_OVERLOADABLE QUAL(__pocl_atomic_flag_test_and_set) ( volatile Q atomic_
   memory_order order,
   memory_scope scope)
 {
-  return __opencl_atomic_exchange(object, 1, order, scope);
+  return __opencl_atomic_exchange(object, 1, NARROW_ORDER(order, scope), scope);
 }
 
 void _CL_OVERLOADABLE QUAL(__pocl_atomic_flag_clear) ( volatile Q atomic_int  *object ,
   memory_order order,
   memory_scope scope)
 {
-  __opencl_atomic_store(object, 0, order, scope);
+  __opencl_atomic_store(object, 0, NARROW_ORDER(order, scope), scope);
 }
 
 #  define ATOMIC_TYPE atomic_int
@@ -175,14 +206,14 @@ _CL_OVERLOADABLE void QUAL(__pocl_atomic_store)( volatile Q ATOMIC_TYPE  *object
                               memory_order order,
                               memory_scope scope)
 {
-  __opencl_atomic_store(object, desired, order, scope);
+  __opencl_atomic_store(object, desired, NARROW_ORDER(order, scope), scope);
 }
 
 _CL_OVERLOADABLE NONATOMIC_TYPE QUAL(__pocl_atomic_load) ( volatile Q ATOMIC_TYPE  *object,
                                         memory_order order,
                                         memory_scope scope)
 {
-  return __opencl_atomic_load(object, order, scope);
+  return __opencl_atomic_load(object, NARROW_ORDER(order, scope), scope);
 }
 
 
@@ -191,7 +222,7 @@ _CL_OVERLOADABLE NONATOMIC_TYPE QUAL(__pocl_atomic_exchange) ( volatile Q ATOMIC
                                             memory_order order,
                                             memory_scope scope)
 {
-  return __opencl_atomic_exchange(object, desired, order, scope);
+  return __opencl_atomic_exchange(object, desired, NARROW_ORDER(order, scope), scope);
 }
 
 bool _CL_OVERLOADABLE QUAL(__pocl_atomic_compare_exchange_strong) ( volatile Q ATOMIC_TYPE  *object,
@@ -201,7 +232,10 @@ bool _CL_OVERLOADABLE QUAL(__pocl_atomic_compare_exchange_strong) ( volatile Q A
   memory_order failure,
   memory_scope scope)
 {
-  return __opencl_atomic_compare_exchange_strong(object,  expected, desired, success, failure, scope);
+  return __opencl_atomic_compare_exchange_strong(object,  expected, desired,
+                                                 NARROW_ORDER(success, scope),
+                                                 NARROW_ORDER(failure, scope),
+                                                 scope);
 }
 
 bool _CL_OVERLOADABLE QUAL(__pocl_atomic_compare_exchange_weak) ( volatile Q ATOMIC_TYPE  *object,
@@ -211,7 +245,10 @@ bool _CL_OVERLOADABLE QUAL(__pocl_atomic_compare_exchange_weak) ( volatile Q ATO
   memory_order failure,
   memory_scope scope)
 {
-  return __opencl_atomic_compare_exchange_weak(object,  expected, desired, success, failure, scope);
+  return __opencl_atomic_compare_exchange_weak(object,  expected, desired,
+                                               NARROW_ORDER(success, scope),
+                                               NARROW_ORDER(failure, scope),
+                                               scope);
 }
 
 /* available on integers, but also floats with cl_ext_float_atomics;
@@ -228,7 +265,7 @@ NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_add) ( volatile Q ATOMI
   memory_order order,
   memory_scope scope)
 {
-  return __opencl_atomic_fetch_add(object, operand, order, scope);
+  return __opencl_atomic_fetch_add(object, operand, NARROW_ORDER(order, scope), scope);
 }
 
 NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_sub) ( volatile Q ATOMIC_TYPE  *object,
@@ -236,7 +273,7 @@ NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_sub) ( volatile Q ATOMI
   memory_order order,
   memory_scope scope)
 {
-  return __opencl_atomic_fetch_sub(object, operand, order, scope);
+  return __opencl_atomic_fetch_sub(object, operand, NARROW_ORDER(order, scope), scope);
 }
 
 NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_min) ( volatile Q ATOMIC_TYPE  *object,
@@ -245,9 +282,9 @@ NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_min) ( volatile Q ATOMI
   memory_scope scope)
 {
 #if (__clang_major__ >= 17)
-  return __opencl_atomic_fetch_min(object, operand, order, scope);
+  return __opencl_atomic_fetch_min(object, operand, NARROW_ORDER(order, scope), scope);
 #else
-  ATOMIC_LOOP(fmin, object, operand, order, scope);
+  ATOMIC_LOOP(fmin, object, operand, NARROW_ORDER(order, scope), scope);
 #endif
 }
 
@@ -257,9 +294,9 @@ NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_max) ( volatile Q ATOMI
   memory_scope scope)
 {
 #if (__clang_major__ >= 17)
-  return __opencl_atomic_fetch_max(object, operand, order, scope);
+  return __opencl_atomic_fetch_max(object, operand, NARROW_ORDER(order, scope), scope);
 #else
-  ATOMIC_LOOP(fmax, object, operand, order, scope);
+  ATOMIC_LOOP(fmax, object, operand, NARROW_ORDER(order, scope), scope);
 #endif
 }
 
@@ -272,7 +309,7 @@ NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_add) ( volatile Q ATOMI
   memory_order order,
   memory_scope scope)
 {
-  return __opencl_atomic_fetch_add(object, operand, order, scope);
+  return __opencl_atomic_fetch_add(object, operand, NARROW_ORDER(order, scope), scope);
 }
 
 NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_sub) ( volatile Q ATOMIC_TYPE  *object,
@@ -280,7 +317,7 @@ NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_sub) ( volatile Q ATOMI
   memory_order order,
   memory_scope scope)
 {
-  return __opencl_atomic_fetch_sub(object, operand, order, scope);
+  return __opencl_atomic_fetch_sub(object, operand, NARROW_ORDER(order, scope), scope);
 }
 
 NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_or) ( volatile Q ATOMIC_TYPE  *object,
@@ -288,7 +325,7 @@ NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_or) ( volatile Q ATOMIC
   memory_order order,
   memory_scope scope)
 {
-  return __opencl_atomic_fetch_or(object, operand, order, scope);
+  return __opencl_atomic_fetch_or(object, operand, NARROW_ORDER(order, scope), scope);
 }
 
 NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_xor) ( volatile Q ATOMIC_TYPE  *object,
@@ -296,7 +333,7 @@ NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_xor) ( volatile Q ATOMI
   memory_order order,
   memory_scope scope)
 {
-  return __opencl_atomic_fetch_xor(object, operand, order, scope);
+  return __opencl_atomic_fetch_xor(object, operand, NARROW_ORDER(order, scope), scope);
 }
 
 NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_and) ( volatile Q ATOMIC_TYPE  *object,
@@ -304,7 +341,7 @@ NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_and) ( volatile Q ATOMI
   memory_order order,
   memory_scope scope)
 {
-  return __opencl_atomic_fetch_and(object, operand, order, scope);
+  return __opencl_atomic_fetch_and(object, operand, NARROW_ORDER(order, scope), scope);
 }
 
 NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_min) ( volatile Q ATOMIC_TYPE  *object,
@@ -312,7 +349,7 @@ NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_min) ( volatile Q ATOMI
   memory_order order,
   memory_scope scope)
 {
-  return __opencl_atomic_fetch_min(object, operand, order, scope);
+  return __opencl_atomic_fetch_min(object, operand, NARROW_ORDER(order, scope), scope);
 }
 
 NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_max) ( volatile Q ATOMIC_TYPE  *object,
@@ -320,7 +357,7 @@ NONATOMIC_TYPE _CL_OVERLOADABLE QUAL(__pocl_atomic_fetch_max) ( volatile Q ATOMI
   memory_order order,
   memory_scope scope)
 {
-  return __opencl_atomic_fetch_max(object, operand, order, scope);
+  return __opencl_atomic_fetch_max(object, operand, NARROW_ORDER(order, scope), scope);
 }
 
 #endif
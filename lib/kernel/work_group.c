@@ -37,6 +37,15 @@ void _CL_OVERLOADABLE
    vectorization. */
 #define ALIGN_ELEMENT_MULTIPLE 32
 
+/* The collectives are computed by the first work-item over the temporary
+   storage after all the work-items have stored their values. The loops
+   doing it keep the running result in a register and read the storage via
+   a non-volatile pointer so the loop vectorizer can turn the reductions
+   into SIMD reductions over the work-item dimension. With the work-item
+   loops, the kernel compiler replaces the reduce, scan, broadcast, any and
+   all calls of the kernels before these are reached (LowerCollectives.cc).
+   */
+
 static size_t
 get_total_local_size ()
 {
@@ -104,11 +113,15 @@ WORK_GROUP_BROADCAST_T (double)
     work_group_barrier (CLK_LOCAL_MEM_FENCE);                                 \
     if (get_local_linear_id () == 0)                                          \
       {                                                                       \
-        for (uint i = 1; i < get_total_local_size (); ++i)                    \
+        const TYPE *values = (const TYPE *)temp_storage;                      \
+        const uint n = get_total_local_size ();                               \
+        TYPE a = values[0];                                                   \
+        for (uint i = 1; i < n; ++i)                                          \
           {                                                                   \
-            TYPE a = temp_storage[0], b = temp_storage[i];                    \
-            temp_storage[0] = OPERATION;                                      \
+            TYPE b = values[i];                                               \
+            a = OPERATION;                                                    \
           }                                                                   \
+        temp_storage[0] = a;                                                  \
       }                                                                       \
     work_group_barrier (CLK_LOCAL_MEM_FENCE);                                 \
     return temp_storage[0];                                                   \
@@ -136,10 +149,14 @@ WORK_GROUP_REDUCE_T (max, a > b ? a : b)
     work_group_barrier (CLK_LOCAL_MEM_FENCE);                                 \
     if (get_local_linear_id () == 0)                                          \
       {                                                                       \
-        for (uint i = 1; i < get_total_local_size (); ++i)                    \
+        TYPE *values = (TYPE *)data;                                          \
+        const uint n = get_total_local_size ();                               \
+        TYPE a = values[0];                                                   \
+        for (uint i = 1; i < n; ++i)                                          \
           {                                                                   \
-            TYPE a = data[i - 1], b = data[i];                                \
-            data[i] = OPERATION;                                              \
+            TYPE b = values[i];                                               \
+            a = OPERATION;                                                    \
+            values[i] = a;                                                    \
           }                                                                   \
       }                                                                       \
     work_group_barrier (CLK_LOCAL_MEM_FENCE);                                 \
@@ -170,10 +187,14 @@ WORK_GROUP_SCAN_INCLUSIVE_T (max, a > b ? a : b)
     work_group_barrier (CLK_LOCAL_MEM_FENCE);                                 \
     if (get_local_linear_id () == 0)                                          \
       {                                                                       \
-        for (uint i = 1; i < get_total_local_size (); ++i)                    \
+        TYPE *values = (TYPE *)data;                                          \
+        const uint n = get_total_local_size ();                               \
+        TYPE a = values[0];                                                   \
+        for (uint i = 1; i < n; ++i)                                          \
           {                                                                   \
-            TYPE a = data[i - 1], b = data[i];                                \
-            data[i] = OPERATION;                                              \
+            TYPE b = values[i];                                               \
+            a = OPERATION;                                                    \
+            values[i] = a;                                                    \
           }                                                                   \
       }                                                                       \
     work_group_barrier (CLK_LOCAL_MEM_FENCE);                                 \
@@ -213,9 +234,11 @@ work_group_any (int predicate)
   work_group_barrier (CLK_LOCAL_MEM_FENCE);
   if (get_local_linear_id () == 0)
     {
-      *result = 0;
-      for (uint i = 0; i < get_total_local_size (); ++i)
-        *result |= flags[i];
+      int any = 0;
+      const uint n = get_total_local_size ();
+      for (uint i = 0; i < n; ++i)
+        any |= flags[i];
+      *result = any;
     }
   work_group_barrier (CLK_LOCAL_MEM_FENCE);
   return *result;
@@ -224,5 +247,5 @@ work_group_any (int predicate)
 __attribute__ ((always_inline)) int _CL_OVERLOADABLE
 work_group_all (int predicate)
 {
-  return !work_group_any (!!predicate);
+  return !work_group_any (!predicate);
 }
@@ -367,8 +367,10 @@ pocl_write_pixel (uint4 color, global dev_image_t *img, int4 coord,
       return;
     }
 
-  size_t base_index = array_offset_pixels + coord.x + (coord.y * row_pitch)
-                      + (coord.z * slice_pitch);
+  size_t base_index
+      = array_offset_pixels + pocl_image_x_offset (coord.x, img->_tiling)
+        + pocl_image_y_offset (coord.y, row_pitch, img->_tiling)
+        + pocl_image_z_offset (coord.z, slice_pitch, img->_tiling);
 
   color = map_channels (color, order);
 
@@ -0,0 +1,190 @@
+// LLVM function pass that specializes a kernel for the image formats and
+// sampler values known at launch.
+//
+// Copyright (c) 2024 pocl developers
+//
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "CompilerWarnings.h"
+IGNORE_COMPILER_WARNING("-Wmaybe-uninitialized")
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Operator.h>
+
+#include "ImageArgSpecialization.h"
+#include "LLVMUtils.h"
+#include "VariableUniformityAnalysis.h"
+#include "WorkitemHandlerChooser.h"
+POP_COMPILER_DIAGS
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include "pocl_image_types.h"
+#include "pocl_llvm_api.h"
+
+#define PASS_NAME "specialize-image-args"
+#define PASS_CLASS pocl::ImageArgSpecialization
+#define PASS_DESC "Specializes image and sampler arguments known at launch."
+
+namespace pocl {
+
+using namespace llvm;
+
+// The format of an image argument as stored to its dev_image_t.
+struct ImageArgFormat {
+  int Order;
+  int DataType;
+  int NumChannels;
+  int ElemSize;
+};
+
+// Parses the "WGImageArgs" module metadata set by the kernel compiler:
+// "i<arg>:<order>:<type>:<channels>:<elem size>;" for images and
+// "s<arg>:<value>;" for samplers.
+static bool parseImageArgs(const std::string &Str,
+                           std::map<unsigned, ImageArgFormat> &Images,
+                           std::map<unsigned, unsigned long> &Samplers) {
+  std::stringstream SS(Str);
+  std::string Entry;
+  while (std::getline(SS, Entry, ';')) {
+    unsigned Idx;
+    if (Entry.empty())
+      continue;
+    if (Entry[0] == 'i') {
+      ImageArgFormat F;
+      if (std::sscanf(Entry.c_str(), "i%u:%d:%d:%d:%d", &Idx, &F.Order,
+                      &F.DataType, &F.NumChannels, &F.ElemSize) != 5)
+        return false;
+      Images[Idx] = F;
+    } else if (Entry[0] == 's') {
+      unsigned long Value;
+      if (std::sscanf(Entry.c_str(), "s%u:%lu", &Idx, &Value) != 2)
+        return false;
+      Samplers[Idx] = Value;
+    } else
+      return false;
+  }
+  return true;
+}
+
+// Collects the loads of the format fields of the dev_image_t pointed to by
+// Ptr + Offset, looking through casts and constant offset GEPs.
+static void
+collectFieldLoads(Value *Ptr, int64_t Offset, const DataLayout &DL,
+                  const ImageArgFormat &Format,
+                  std::vector<std::pair<LoadInst *, int>> &Loads) {
+  // The int fields follow the data pointer of the target.
+  const int64_t FieldBase = DL.getPointerSize();
+
+  for (User *U : Ptr->users()) {
+    if (isa<BitCastInst>(U) || isa<AddrSpaceCastInst>(U)) {
+      collectFieldLoads(U, Offset, DL, Format, Loads);
+    } else if (GEPOperator *GEP = dyn_cast<GEPOperator>(U)) {
+      if (GEP->getPointerOperand() != Ptr)
+        continue;
+      APInt GEPOffset(DL.getIndexTypeSizeInBits(GEP->getType()), 0);
+      if (GEP->accumulateConstantOffset(DL, GEPOffset))
+        collectFieldLoads(GEP, Offset + GEPOffset.getSExtValue(), DL, Format,
+                          Loads);
+    } else if (LoadInst *Load = dyn_cast<LoadInst>(U)) {
+      if (Load->isVolatile() || !Load->getType()->isIntegerTy(32))
+        continue;
+      int64_t Field = Offset - FieldBase;
+      if (Field == POCL_IMAGE_INT_FIELD_OFFSET(_order))
+        Loads.push_back(std::make_pair(Load, Format.Order));
+      else if (Field == POCL_IMAGE_INT_FIELD_OFFSET(_data_type))
+        Loads.push_back(std::make_pair(Load, Format.DataType));
+      else if (Field == POCL_IMAGE_INT_FIELD_OFFSET(_num_channels))
+        Loads.push_back(std::make_pair(Load, Format.NumChannels));
+      else if (Field == POCL_IMAGE_INT_FIELD_OFFSET(_elem_size))
+        Loads.push_back(std::make_pair(Load, Format.ElemSize));
+    }
+  }
+}
+
+static bool specializeImageArgs(Function &F) {
+
+  Module *M = F.getParent();
+  std::string KernelName, ImageArgs;
+  if (!getModuleStringMetadata(*M, "WGImageArgs", ImageArgs) ||
+      !getModuleStringMetadata(*M, "KernelName", KernelName) ||
+      F.getName() != KernelName || !isKernelToProcess(F))
+    return false;
+
+  std::map<unsigned, ImageArgFormat> Images;
+  std::map<unsigned, unsigned long> Samplers;
+  if (!parseImageArgs(ImageArgs, Images, Samplers))
+    return false;
+
+  const DataLayout &DL = M->getDataLayout();
+  bool Changed = false;
+
+  std::vector<std::pair<LoadInst *, int>> Loads;
+  for (auto &I : Images) {
+    if (I.first >= F.arg_size())
+      continue;
+    Argument *Arg = F.getArg(I.first);
+    if (Arg->getType()->isPointerTy())
+      collectFieldLoads(Arg, 0, DL, I.second, Loads);
+  }
+  for (auto &L : Loads) {
+    L.first->replaceAllUsesWith(
+        ConstantInt::get(L.first->getType(), L.second, true));
+    L.first->eraseFromParent();
+    Changed = true;
+  }
+
+  for (auto &S : Samplers) {
+    if (S.first >= F.arg_size())
+      continue;
+    Argument *Arg = F.getArg(S.first);
+    if (Arg->use_empty() || !(Arg->getType()->isPointerTy() ||
+                              Arg->getType()->isIntegerTy()))
+      continue;
+    IRBuilder<> Builder(&*F.getEntryBlock().getFirstInsertionPt());
+    // the sampler is passed as an intptr_t, see pocl_fill_dev_sampler_t()
+    Constant *Sampler =
+        ConstantInt::get(DL.getIntPtrType(M->getContext()), S.second);
+    Value *Val = Builder.CreateBitOrPointerCast(Sampler, Arg->getType());
+    Arg->replaceAllUsesWith(Val);
+    Changed = true;
+  }
+
+  return Changed;
+}
+
+llvm::PreservedAnalyses
+ImageArgSpecialization::run(llvm::Function &F,
+                            llvm::FunctionAnalysisManager &AM) {
+  PreservedAnalyses PAChanged = PreservedAnalyses::none();
+  PAChanged.preserve<WorkitemHandlerChooser>();
+  PAChanged.preserve<VariableUniformityAnalysis>();
+  return specializeImageArgs(F) ? PAChanged : PreservedAnalyses::all();
+}
+
+REGISTER_NEW_FPASS(PASS_NAME, PASS_CLASS, PASS_DESC);
+
+} // namespace pocl
@@ -0,0 +1,156 @@
+// LLVM module pass that inlines the math builtin calls that were kept out of
+// line for the loop vectorizer.
+//
+// Copyright (c) 2024 pocl developers
+//
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "CompilerWarnings.h"
+IGNORE_COMPILER_WARNING("-Wmaybe-uninitialized")
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Analysis/VectorUtils.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+
+#include "InlineVectorMath.h"
+#include "LLVMUtils.h"
+POP_COMPILER_DIAGS
+
+#include "pocl_llvm_api.h"
+
+#define PASS_NAME "inline-vector-math"
+#define PASS_CLASS pocl::InlineVectorMath
+#define PASS_DESC                                                              \
+  "Inlines the math builtin calls kept out of line for the loop vectorizer."
+
+namespace pocl {
+
+using namespace llvm;
+
+// Removes the functions in Remove from llvm.compiler.used, where the linker
+// put the vector overloads to keep them for the vectorizer.
+static void removeFromCompilerUsed(Module &M,
+                                   const SmallPtrSetImpl<Function *> &Remove) {
+  GlobalVariable *Used = M.getGlobalVariable("llvm.compiler.used");
+  if (Used == nullptr || !Used->hasInitializer())
+    return;
+  ConstantArray *Init = dyn_cast<ConstantArray>(Used->getInitializer());
+  if (Init == nullptr)
+    return;
+  SmallVector<GlobalValue *, 16> Kept;
+  for (Use &U : Init->operands()) {
+    GlobalValue *GV = cast<GlobalValue>(U->stripPointerCasts());
+    Function *F = dyn_cast<Function>(GV);
+    if (F == nullptr || Remove.count(F) == 0)
+      Kept.push_back(GV);
+  }
+  if (Kept.size() == Init->getNumOperands())
+    return;
+  Used->eraseFromParent();
+  if (!Kept.empty())
+    appendToCompilerUsed(M, Kept);
+}
+
+static bool inlineVectorMath(Module &M) {
+
+  // The scalar calls the linker mapped to vector overloads, and the names
+  // of the overloads, to which the vectorizer may have created calls. The
+  // linker lists the overloads it kept for the vectorizer in the
+  // pocl.vector_math_variants metadata.
+  SmallVector<CallInst *, 16> Calls;
+  StringSet<> VectorNames;
+  if (NamedMDNode *Names = M.getNamedMetadata("pocl.vector_math_variants")) {
+    for (MDNode *N : Names->operands())
+      VectorNames.insert(cast<MDString>(N->getOperand(0))->getString());
+    M.eraseNamedMetadata(Names);
+  }
+  for (Function &F : M) {
+    for (Instruction &I : instructions(F)) {
+      CallInst *CI = dyn_cast<CallInst>(&I);
+      if (CI == nullptr || !CI->hasFnAttr(VFABI::MappingsAttrName))
+        continue;
+      SmallVector<StringRef, 4> Variants;
+      CI->getFnAttr(VFABI::MappingsAttrName)
+          .getValueAsString()
+          .split(Variants, ',');
+      for (StringRef V : Variants)
+        VectorNames.insert(V.split('(').second.split(')').first);
+      Calls.push_back(CI);
+    }
+  }
+  if (Calls.empty() && VectorNames.empty())
+    return false;
+
+  for (Function &F : M) {
+    if (F.isDeclaration())
+      continue;
+    for (Instruction &I : instructions(F)) {
+      CallInst *CI = dyn_cast<CallInst>(&I);
+      Function *Callee = CI ? CI->getCalledFunction() : nullptr;
+      if (Callee != nullptr && VectorNames.count(Callee->getName()) > 0)
+        Calls.push_back(CI);
+    }
+  }
+
+  SmallPtrSet<Function *, 16> Callees;
+  unsigned long VectorCalls = 0;
+  for (CallInst *CI : Calls) {
+    Function *Callee = CI->getCalledFunction();
+    if (Callee == nullptr || Callee->isDeclaration())
+      continue;
+    if (VectorNames.count(Callee->getName()) > 0)
+      ++VectorCalls;
+    InlineFunctionInfo IFI;
+    if (InlineFunction(*CI, IFI).isSuccess())
+      Callees.insert(Callee);
+  }
+  // picked from the module metadata to the build log
+  setModuleIntMetadata(&M, "WGVectorMathCalls", VectorCalls);
+
+  // Drop the functions and the overloads that are not called anymore.
+  SmallPtrSet<Function *, 16> Overloads;
+  for (const auto &Name : VectorNames)
+    if (Function *F = M.getFunction(Name.getKey()))
+      Overloads.insert(F);
+  removeFromCompilerUsed(M, Overloads);
+  Callees.insert(Overloads.begin(), Overloads.end());
+  for (Function *F : Callees) {
+    // the casts of the removed llvm.compiler.used entries
+    F->removeDeadConstantUsers();
+    if (F->hasLocalLinkage() && F->use_empty())
+      F->eraseFromParent();
+  }
+  return true;
+}
+
+llvm::PreservedAnalyses InlineVectorMath::run(llvm::Module &M,
+                                              llvm::ModuleAnalysisManager &AM) {
+  return inlineVectorMath(M) ? PreservedAnalyses::none()
+                             : PreservedAnalyses::all();
+}
+
+REGISTER_NEW_MPASS(PASS_NAME, PASS_CLASS, PASS_DESC);
+
+} // namespace pocl
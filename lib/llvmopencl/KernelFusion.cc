@@ -0,0 +1,320 @@
+// Implementation of KernelFusion, helpers for fusing a kernel with the
+// kernel launched right after it.
+//
+// Copyright (c) 2024 pocl developers
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "CompilerWarnings.h"
+IGNORE_COMPILER_WARNING("-Wunused-parameter")
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DebugInfo.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+#include "Barrier.h"
+#include "KernelFusion.h"
+POP_COMPILER_DIAGS
+
+namespace pocl {
+
+using namespace llvm;
+
+// The kernel argument metadata which must be extended to cover the
+// arguments of the fused kernel.
+static const char *KernelArgMDNames[] = {
+    "kernel_arg_addr_space", "kernel_arg_access_qual", "kernel_arg_type",
+    "kernel_arg_base_type",  "kernel_arg_type_qual",   "kernel_arg_name"};
+
+// Returns true if V is get_global_id(0), possibly behind integer casts.
+static bool isGlobalIdX(Value *V) {
+  while (CastInst *Cast = dyn_cast<CastInst>(V)) {
+    if (!Cast->isIntegerCast())
+      return false;
+    V = Cast->getOperand(0);
+  }
+  CallInst *Call = dyn_cast<CallInst>(V);
+  if (Call == nullptr || Call->getCalledFunction() == nullptr ||
+      Call->getCalledFunction()->getName() != "_Z13get_global_idj")
+    return false;
+  ConstantInt *Dim = dyn_cast<ConstantInt>(Call->getArgOperand(0));
+  return Dim != nullptr && Dim->isZero();
+}
+
+// Accumulates the accesses through Ptr, which is derived from a kernel
+// argument, to Info. Anything the accesses of which cannot be followed is
+// assumed to both read and write.
+static void classifyPointerUses(Value *Ptr, pocl_fusion_arg_info &Info,
+                                SmallPtrSetImpl<Value *> &Visited) {
+  if (!Visited.insert(Ptr).second)
+    return;
+  for (User *U : Ptr->users()) {
+    if (isa<LoadInst>(U)) {
+      Info.flags |= POCL_FUSION_ARG_READ;
+    } else if (StoreInst *Store = dyn_cast<StoreInst>(U)) {
+      if (Store->getPointerOperand() == Ptr)
+        Info.flags |= POCL_FUSION_ARG_WRITE;
+      else
+        Info.flags |= POCL_FUSION_ARG_READ | POCL_FUSION_ARG_WRITE;
+    } else if (isa<GetElementPtrInst>(U) || isa<BitCastInst>(U) ||
+               isa<AddrSpaceCastInst>(U) || isa<PHINode>(U) ||
+               isa<SelectInst>(U)) {
+      classifyPointerUses(U, Info, Visited);
+    } else if (!isa<ICmpInst>(U)) {
+      // Calls, atomics, pointer to integer conversions etc.
+      Info.flags |= POCL_FUSION_ARG_READ | POCL_FUSION_ARG_WRITE;
+    }
+  }
+}
+
+// Analyzes the accesses through a kernel argument. The argument is marked
+// element-wise if it is only loaded from and stored to at index
+// get_global_id(0) using a single element size.
+static void analyzeArgument(Argument &Arg, const DataLayout &DL,
+                            pocl_fusion_arg_info &Info) {
+  Info.flags = 0;
+  Info.elem_size = 0;
+  if (!Arg.getType()->isPointerTy())
+    return;
+
+  bool Elementwise = true;
+  SmallPtrSet<Value *, 16> Visited;
+  Visited.insert(&Arg);
+  for (User *U : Arg.users()) {
+    GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(U);
+    if (GEP == nullptr || GEP->getPointerOperand() != &Arg ||
+        GEP->getNumIndices() != 1 || !isGlobalIdX(GEP->getOperand(1))) {
+      Elementwise = false;
+      Visited.erase(&Arg);
+      classifyPointerUses(&Arg, Info, Visited);
+      continue;
+    }
+
+    uint64_t ElemSize = DL.getTypeAllocSize(GEP->getSourceElementType());
+    for (User *GU : GEP->users()) {
+      Type *AccessType = nullptr;
+      if (LoadInst *Load = dyn_cast<LoadInst>(GU)) {
+        AccessType = Load->getType();
+        Info.flags |= POCL_FUSION_ARG_READ;
+      } else if (StoreInst *Store = dyn_cast<StoreInst>(GU)) {
+        if (Store->getPointerOperand() == GEP) {
+          AccessType = Store->getValueOperand()->getType();
+          Info.flags |= POCL_FUSION_ARG_WRITE;
+        }
+      }
+      if (AccessType == nullptr ||
+          DL.getTypeStoreSize(AccessType) != ElemSize ||
+          (Info.elem_size != 0 && Info.elem_size != ElemSize)) {
+        Elementwise = false;
+        if (AccessType == nullptr)
+          classifyPointerUses(GEP, Info, Visited);
+        continue;
+      }
+      Info.elem_size = ElemSize;
+    }
+  }
+
+  if (Elementwise)
+    Info.flags |= POCL_FUSION_ARG_ELEMENTWISE;
+  else
+    Info.elem_size = 0;
+}
+
+// Returns false if K or any function it calls synchronizes the work-items,
+// prints, writes to a global variable or calls something unknown. Fusing
+// such kernels would change the order of the side effects visible to the
+// other work-items.
+static bool isFusableCallGraph(Function &K) {
+  SmallPtrSet<Function *, 16> Visited;
+  SmallVector<Function *, 16> Worklist;
+  Worklist.push_back(&K);
+  while (!Worklist.empty()) {
+    Function *F = Worklist.pop_back_val();
+    if (!Visited.insert(F).second)
+      continue;
+
+    StringRef Name = F->getName();
+    if (Name == BARRIER_FUNCTION_NAME || Name == "printf" ||
+        Name == "_cl_printf" || Name.startswith("__pocl_print"))
+      return false;
+
+    // The kernel library is linked in, so a declaration is an intrinsic or
+    // something whose side effects are not known. Accept only the ones
+    // which cannot synchronize and do not write to memory not seen by the
+    // argument analysis.
+    if (F->isDeclaration()) {
+      if (F->isConvergent())
+        return false;
+      if (!F->isIntrinsic() && !F->onlyReadsMemory())
+        return false;
+      continue;
+    }
+
+    for (Instruction &I : instructions(F)) {
+      if (CallBase *Call = dyn_cast<CallBase>(&I)) {
+        Function *Callee = Call->getCalledFunction();
+        if (Callee == nullptr)
+          return false;
+        // Intrinsics such as memcpy can write to global variables.
+        if (Callee->isDeclaration() && !Call->onlyReadsMemory())
+          for (Value *Arg : Call->args())
+            if (Arg->getType()->isPointerTy()) {
+              GlobalVariable *GV =
+                  dyn_cast<GlobalVariable>(getUnderlyingObject(Arg));
+              if (GV != nullptr && !GV->isConstant())
+                return false;
+            }
+        Worklist.push_back(Callee);
+        continue;
+      }
+      Value *Ptr = nullptr;
+      if (StoreInst *Store = dyn_cast<StoreInst>(&I))
+        Ptr = Store->getPointerOperand();
+      else if (AtomicRMWInst *RMW = dyn_cast<AtomicRMWInst>(&I))
+        Ptr = RMW->getPointerOperand();
+      else if (AtomicCmpXchgInst *CmpXchg = dyn_cast<AtomicCmpXchgInst>(&I))
+        Ptr = CmpXchg->getPointerOperand();
+      if (Ptr != nullptr && isa<GlobalVariable>(getUnderlyingObject(Ptr)))
+        return false;
+    }
+  }
+  return true;
+}
+
+bool analyzeKernelForFusion(Function &K, pocl_fusion_arg_info *ArgInfo) {
+  const DataLayout &DL = K.getParent()->getDataLayout();
+  for (Argument &Arg : K.args())
+    analyzeArgument(Arg, DL, ArgInfo[Arg.getArgNo()]);
+  return isFusableCallGraph(K);
+}
+
+// Turns a kernel which was inlined to the fused kernel to a regular
+// function so the kernel compiler passes do not process it on its own.
+static void demoteKernel(Function *F) {
+  for (const char *MDName : KernelArgMDNames)
+    F->setMetadata(MDName, nullptr);
+  F->setCallingConv(CallingConv::SPIR_FUNC);
+  F->setLinkage(GlobalValue::InternalLinkage);
+}
+
+Function *createFusedKernel(Module &M, Function *Producer, Function *Consumer,
+                            const cl_uint *ConsumerArgMap, StringRef Name) {
+  LLVMContext &C = M.getContext();
+  FunctionType *ProducerType = Producer->getFunctionType();
+  FunctionType *ConsumerType = Consumer->getFunctionType();
+  const unsigned NumProducerArgs = ProducerType->getNumParams();
+  const unsigned NumConsumerArgs = ConsumerType->getNumParams();
+
+  SmallVector<Type *, 16> ArgTypes(ProducerType->param_begin(),
+                                   ProducerType->param_end());
+  for (unsigned I = 0; I < NumConsumerArgs; ++I) {
+    if (ConsumerArgMap[I] < NumProducerArgs)
+      continue;
+    if (ConsumerArgMap[I] >= ArgTypes.size())
+      ArgTypes.resize(ConsumerArgMap[I] + 1, nullptr);
+    ArgTypes[ConsumerArgMap[I]] = ConsumerType->getParamType(I);
+  }
+  for (Type *T : ArgTypes)
+    if (T == nullptr)
+      return nullptr;
+
+  // Extend the kernel argument metadata of the producer with the metadata
+  // of the consumer arguments which were not merged.
+  SmallVector<std::pair<const char *, MDNode *>, 6> ArgMDs;
+  for (const char *MDName : KernelArgMDNames) {
+    MDNode *ProducerMD = Producer->getMetadata(MDName);
+    MDNode *ConsumerMD = Consumer->getMetadata(MDName);
+    if (ProducerMD == nullptr)
+      continue;
+    if (ConsumerMD == nullptr ||
+        ProducerMD->getNumOperands() != NumProducerArgs ||
+        ConsumerMD->getNumOperands() != NumConsumerArgs)
+      return nullptr;
+    SmallVector<Metadata *, 16> Ops(ProducerMD->op_begin(),
+                                    ProducerMD->op_end());
+    Ops.resize(ArgTypes.size(), nullptr);
+    for (unsigned I = 0; I < NumConsumerArgs; ++I)
+      if (ConsumerArgMap[I] >= NumProducerArgs)
+        Ops[ConsumerArgMap[I]] = ConsumerMD->getOperand(I);
+    ArgMDs.push_back(std::make_pair(MDName, MDNode::get(C, Ops)));
+  }
+
+  Function *Fused = Function::Create(
+      FunctionType::get(Type::getVoidTy(C), ArgTypes, false),
+      Producer->getLinkage(), Name, &M);
+  Fused->setCallingConv(Producer->getCallingConv());
+  for (Attribute A : Producer->getAttributes().getFnAttrs())
+    Fused->addFnAttr(A);
+  for (auto &ArgMD : ArgMDs)
+    Fused->setMetadata(ArgMD.first, ArgMD.second);
+  for (const char *MDName :
+       {"reqd_work_group_size", "work_group_size_hint", "vec_type_hint"})
+    if (MDNode *MD = Producer->getMetadata(MDName))
+      Fused->setMetadata(MDName, MD);
+
+  IRBuilder<> Builder(BasicBlock::Create(C, "entry", Fused));
+  SmallVector<Value *, 16> ProducerArgs;
+  for (unsigned I = 0; I < NumProducerArgs; ++I) {
+    Fused->getArg(I)->setName(Producer->getArg(I)->getName());
+    ProducerArgs.push_back(Fused->getArg(I));
+  }
+  SmallVector<Value *, 16> ConsumerArgs;
+  for (unsigned I = 0; I < NumConsumerArgs; ++I) {
+    Value *Arg = Fused->getArg(ConsumerArgMap[I]);
+    Type *ParamType = ConsumerType->getParamType(I);
+    if (ConsumerArgMap[I] >= NumProducerArgs)
+      Arg->setName(Consumer->getArg(I)->getName());
+    if (Arg->getType() != ParamType) {
+      // A merged buffer argument with a different pointee type.
+      if (!Arg->getType()->isPointerTy() || !ParamType->isPointerTy()) {
+        Fused->eraseFromParent();
+        return nullptr;
+      }
+      Arg = Builder.CreatePointerBitCastOrAddrSpaceCast(Arg, ParamType);
+    }
+    ConsumerArgs.push_back(Arg);
+  }
+
+  CallInst *ProducerCall = Builder.CreateCall(Producer, ProducerArgs);
+  ProducerCall->setCallingConv(Producer->getCallingConv());
+  CallInst *ConsumerCall = Builder.CreateCall(Consumer, ConsumerArgs);
+  ConsumerCall->setCallingConv(Consumer->getCallingConv());
+  Builder.CreateRetVoid();
+
+  InlineFunctionInfo IFI;
+  if (!InlineFunction(*ProducerCall, IFI).isSuccess() ||
+      !InlineFunction(*ConsumerCall, IFI).isSuccess()) {
+    Fused->eraseFromParent();
+    return nullptr;
+  }
+  // The inlined instructions refer to the debug info scopes of the
+  // original kernels which the fused kernel does not have.
+  stripDebugInfo(*Fused);
+
+  demoteKernel(Producer);
+  demoteKernel(Consumer);
+  return Fused;
+}
+
+} // namespace pocl
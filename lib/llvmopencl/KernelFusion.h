@@ -0,0 +1,57 @@
+// Header for KernelFusion, helpers for fusing a kernel with the kernel
+// launched right after it.
+//
+// Copyright (c) 2024 pocl developers
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef POCL_KERNEL_FUSION_H
+#define POCL_KERNEL_FUSION_H
+
+#include "CompilerWarnings.h"
+IGNORE_COMPILER_WARNING("-Wunused-parameter")
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+POP_COMPILER_DIAGS
+
+#include "pocl_cl.h"
+
+namespace pocl {
+
+// Summarizes how the kernel K accesses each of its arguments to ArgInfo
+// (which must have room for all arguments of K). Returns false if the kernel
+// cannot be fused at all, e.g. because it synchronizes the work-items of a
+// work-group, prints or writes to program-scope variables. Expects the
+// allocas of the kernel to have been promoted to registers.
+bool analyzeKernelForFusion(llvm::Function &K, pocl_fusion_arg_info *ArgInfo);
+
+// Creates a kernel called Name to M which runs the body of the Producer
+// kernel followed by the body of the Consumer kernel in each work-item.
+// ConsumerArgMap gives the index of each consumer argument in the
+// argument list of the fused kernel, the producer arguments being first.
+// Both kernels are inlined to the fused kernel and turned to internal
+// functions. Returns nullptr on failure.
+llvm::Function *createFusedKernel(llvm::Module &M, llvm::Function *Producer,
+                                  llvm::Function *Consumer,
+                                  const cl_uint *ConsumerArgMap,
+                                  llvm::StringRef Name);
+
+} // namespace pocl
+
+#endif
@@ -26,12 +26,14 @@ IGNORE_COMPILER_WARNING("-Wmaybe-uninitialized")
 #include <llvm/ADT/Twine.h>
 POP_COMPILER_DIAGS
 IGNORE_COMPILER_WARNING("-Wunused-parameter")
+#include <llvm/Analysis/ValueTracking.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
 #include <llvm/ADT/SmallSet.h>
+#include <llvm/Support/KnownBits.h>
 
 // include all passes & analysis
 #include "AllocasToEntry.h"
@@ -44,22 +46,27 @@ IGNORE_COMPILER_WARNING("-Wunused-parameter")
 #include "FlattenBarrierSubs.hh"
 #include "FlattenGlobals.hh"
 #include "HandleSamplerInitialization.h"
+#include "ImageArgSpecialization.h"
 #include "ImplicitConditionalBarriers.h"
 #include "ImplicitLoopBarriers.h"
 #include "InlineKernels.hh"
+#include "InlineVectorMath.h"
 #include "IsolateRegions.h"
 #include "LoopBarriers.h"
+#include "LowerCollectives.h"
 #include "MinLegalVecSize.hh"
 #include "OptimizeWorkItemFuncCalls.h"
 #include "OptimizeWorkItemGVars.h"
 #include "PHIsToAllocas.h"
 #include "ParallelRegion.h"
 #include "RemoveBarrierCalls.h"
+#include "StreamingStores.h"
 #include "SubCFGFormation.h"
 #include "VariableUniformityAnalysis.h"
 #include "WorkItemAliasAnalysis.h"
 #include "Workgroup.h"
 #include "WorkitemHandlerChooser.h"
+#include "WorkitemLoadPrefetch.h"
 #include "WorkitemLoops.h"
 #include "WorkitemReplication.h"
 
@@ -316,6 +323,16 @@ bool isLocalMemFunctionArg(llvm::Function *F, unsigned ArgIndex) {
            SPIR_ADDRESS_SPACE_LOCAL;
 }
 
+bool isGlobalMemFunctionArg(llvm::Function *F, unsigned ArgIndex) {
+
+  MDNode *MD = F->getMetadata("kernel_arg_addr_space");
+
+  if (MD == nullptr || MD->getNumOperands() <= ArgIndex)
+    return false;
+  int AS = getConstantIntMDValue(MD->getOperand(ArgIndex));
+  return AS == SPIR_ADDRESS_SPACE_GLOBAL || AS == SPIR_ADDRESS_SPACE_CONSTANT;
+}
+
 bool isProgramScopeVariable(GlobalVariable &GVar, unsigned DeviceLocalAS) {
 
   bool retval = false;
@@ -532,6 +549,33 @@ bool hasWorkgroupBarriers(const llvm::Function &F) {
   return false;
 }
 
+llvm::IntegerType *getNarrowestIntType(llvm::Instruction *I, bool &IsSigned) {
+
+  llvm::IntegerType *IntTy = dyn_cast<llvm::IntegerType>(I->getType());
+  if (IntTy == nullptr || IntTy->getBitWidth() <= 8)
+    return nullptr;
+
+  const llvm::DataLayout &DL = I->getModule()->getDataLayout();
+  unsigned Width = IntTy->getBitWidth();
+
+  // The number of bits needed to restore the value with a zero extension
+  // vs. with a sign extension.
+  llvm::KnownBits Known = llvm::computeKnownBits(I, DL);
+  unsigned UnsignedBits = Width - Known.countMinLeadingZeros();
+  unsigned SignedBits = Width - llvm::ComputeNumSignBits(I, DL) + 1;
+
+  IsSigned = SignedBits < UnsignedBits;
+  unsigned NeededBits = IsSigned ? SignedBits : UnsignedBits;
+
+  unsigned NewWidth = 8;
+  while (NewWidth < NeededBits)
+    NewWidth *= 2;
+
+  if (NewWidth >= Width)
+    return nullptr;
+  return llvm::IntegerType::get(I->getContext(), NewWidth);
+}
+
 const char *WorkgroupVariablesArray[NumWorkgroupVariables+1] = {"_local_id_x",
                                     "_local_id_y",
                                     "_local_id_z",
@@ -583,18 +627,23 @@ void registerPassBuilderPasses(llvm::PassBuilder &PB) {
   FlattenBarrierSubs::registerWithPB(PB);
   FlattenGlobals::registerWithPB(PB);
   HandleSamplerInitialization::registerWithPB(PB);
+  ImageArgSpecialization::registerWithPB(PB);
   ImplicitConditionalBarriers::registerWithPB(PB);
   ImplicitLoopBarriers::registerWithPB(PB);
   InlineKernels::registerWithPB(PB);
+  InlineVectorMath::registerWithPB(PB);
   IsolateRegions::registerWithPB(PB);
   LoopBarriers::registerWithPB(PB);
+  LowerCollectives::registerWithPB(PB);
   FixMinVecSize::registerWithPB(PB);
   OptimizeWorkItemFuncCalls::registerWithPB(PB);
   OptimizeWorkItemGVars::registerWithPB(PB);
   PHIsToAllocas::registerWithPB(PB);
   RemoveBarrierCalls::registerWithPB(PB);
+  StreamingStores::registerWithPB(PB);
   SubCFGFormation::registerWithPB(PB);
   Workgroup::registerWithPB(PB);
+  WorkitemLoadPrefetch::registerWithPB(PB);
   WorkitemLoops::registerWithPB(PB);
   WorkitemReplication::registerWithPB(PB);
   PoCLCFGPrinter::registerWithPB(PB);
@@ -78,6 +78,9 @@ bool isGVarUsedByFunction(llvm::GlobalVariable *GVar, llvm::Function *F);
 // Checks if the given argument of Func is a local buffer.
 bool isLocalMemFunctionArg(llvm::Function *Func, unsigned ArgIndex);
 
+// Checks if the given argument of Func is a global or constant buffer.
+bool isGlobalMemFunctionArg(llvm::Function *Func, unsigned ArgIndex);
+
 // determines if GVar is OpenCL program-scope variable
 // if it has empty name, sets it to __anonymous_global_as.XYZ
 bool isProgramScopeVariable(llvm::GlobalVariable &GVar, unsigned DeviceLocalAS);
@@ -120,6 +123,13 @@ llvm::DISubprogram *mimicDISubprogram(llvm::DISubprogram *Old,
                                       const llvm::StringRef &NewFuncName,
                                       llvm::DIScope *Scope = nullptr);
 
+// Returns the narrowest integer type (of at least 8 bits) which can hold all
+// the values the given integer typed instruction can produce according to
+// its known bits, or nullptr if the value cannot be narrowed. IsSigned is set
+// to true if the narrowed value must be sign extended to restore it.
+// Used for reducing the size of the per work-item context data.
+llvm::IntegerType *getNarrowestIntType(llvm::Instruction *I, bool &IsSigned);
+
 void registerPassBuilderPasses(llvm::PassBuilder &PB);
 
 void registerFunctionAnalyses(llvm::PassBuilder &PB);
@@ -0,0 +1,430 @@
+// LLVM function pass that lowers the work-group and sub-group collective
+// function calls of a kernel to accumulations over the work-items.
+//
+// Copyright (c) 2024 pocl developers
+//
+// The library implementations of the collectives (work_group.c,
+// subgroups.c) store the value of each work-item to a temporary array,
+// which the first work-item reduces or scans between two barriers. The
+// work-item loops run the work-items of a region in the order of their
+// linear ids, which lets a collective instead be computed by each
+// work-item folding its value into a work-group shared accumulator:
+//
+//   acc = identity
+//   barrier
+//   old = acc; acc = op(old, value)      (scan result: acc or old)
+//   barrier
+//   result = acc                         (reduce, broadcast, any, all)
+//
+// The region between the barriers runs only the fold, which LICM turns
+// into a register recurrence over the work-item loop that the loop
+// vectorizer converts to a SIMD reduction. No temporary array is needed
+// and no single work-item does the work of the others.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "CompilerWarnings.h"
+IGNORE_COMPILER_WARNING("-Wmaybe-uninitialized")
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+
+#include "Barrier.h"
+#include "LLVMUtils.h"
+#include "LowerCollectives.h"
+#include "ParallelRegion.h"
+#include "WorkitemHandlerChooser.h"
+POP_COMPILER_DIAGS
+
+#include "pocl_llvm_api.h"
+
+#include <vector>
+
+#define PASS_NAME "lower-collectives"
+#define PASS_CLASS pocl::LowerCollectives
+#define PASS_DESC "Lowers the work-group collectives to work-item folds."
+
+namespace pocl {
+
+using namespace llvm;
+
+enum class CollectiveKind {
+  Reduce,
+  ScanInclusive,
+  ScanExclusive,
+  Broadcast,
+  Any,
+  All
+};
+
+enum class CollectiveOp { None, Add, Min, Max };
+
+struct Collective {
+  CallInst *Call;
+  bool SubGroup;
+  CollectiveKind Kind;
+  CollectiveOp Op;
+  // The value type is a signed integer.
+  bool Signed;
+};
+
+// Splits a mangled OpenCL C builtin name "_Z<length><name><parameters>".
+static bool demangleBuiltin(StringRef Mangled, StringRef &Name,
+                            StringRef &Params) {
+  unsigned Length;
+  if (!Mangled.consume_front("_Z") || Mangled.consumeInteger(10, Length) ||
+      Length > Mangled.size())
+    return false;
+  Name = Mangled.take_front(Length);
+  Params = Mangled.drop_front(Length);
+  return true;
+}
+
+static CollectiveOp parseOp(StringRef Name) {
+  if (Name == "add")
+    return CollectiveOp::Add;
+  if (Name == "min")
+    return CollectiveOp::Min;
+  if (Name == "max")
+    return CollectiveOp::Max;
+  return CollectiveOp::None;
+}
+
+// Recognizes the calls to the collectives of the scalar types the kernel
+// library implements them for. The half variants, the shuffles and the
+// non-uniform sub-group functions are left to the library.
+static bool parseCollective(CallInst *Call, Collective &C) {
+  Function *Callee = Call->getCalledFunction();
+  StringRef Name, Params;
+  if (Callee == nullptr || Call->arg_size() == 0 ||
+      !demangleBuiltin(Callee->getName(), Name, Params) || Params.empty())
+    return false;
+
+  if (Name.consume_front("work_group_"))
+    C.SubGroup = false;
+  else if (Name.consume_front("sub_group_"))
+    C.SubGroup = true;
+  else
+    return false;
+
+  char ValueType = Params.front();
+  StringRef IndexParams = Params.drop_front();
+  C.Call = Call;
+  C.Op = CollectiveOp::None;
+  C.Signed = ValueType == 'i' || ValueType == 'l';
+
+  if (Name == "any" || Name == "all") {
+    C.Kind = Name == "any" ? CollectiveKind::Any : CollectiveKind::All;
+    return Params == "i";
+  }
+
+  if (StringRef("ijlmfd").find(ValueType) == StringRef::npos)
+    return false;
+
+  if (Name == "broadcast") {
+    C.Kind = CollectiveKind::Broadcast;
+    // (value, uint) for sub-groups, (value, size_t x[, y[, z]]) for
+    // work-groups
+    if (C.SubGroup)
+      return IndexParams == "j";
+    return (IndexParams.size() >= 1 && IndexParams.size() <= 3) &&
+           (IndexParams.find_first_not_of('m') == StringRef::npos ||
+            IndexParams.find_first_not_of('j') == StringRef::npos);
+  }
+
+  if (!IndexParams.empty())
+    return false;
+  if (Name.consume_front("reduce_"))
+    C.Kind = CollectiveKind::Reduce;
+  else if (Name.consume_front("scan_inclusive_"))
+    C.Kind = CollectiveKind::ScanInclusive;
+  else if (Name.consume_front("scan_exclusive_"))
+    C.Kind = CollectiveKind::ScanExclusive;
+  else
+    return false;
+  C.Op = parseOp(Name);
+  return C.Op != CollectiveOp::None;
+}
+
+// Returns the value the accumulator of the collective starts from. The
+// exclusive scans return it to the first work-item, as the library does.
+static Constant *getIdentity(const Collective &C, Type *T) {
+  switch (C.Kind) {
+  case CollectiveKind::Any:
+    return ConstantInt::get(T, 0);
+  case CollectiveKind::All:
+    return ConstantInt::get(T, 1);
+  default:
+    break;
+  }
+
+  unsigned Bits = T->getScalarSizeInBits();
+  switch (C.Op) {
+  case CollectiveOp::Add:
+    // -0.0 + x is x for every x, also for x = -0.0
+    if (T->isFloatingPointTy())
+      return C.Kind == CollectiveKind::ScanExclusive
+                 ? ConstantFP::get(T, 0.0)
+                 : ConstantFP::getNegativeZero(T);
+    return ConstantInt::get(T, 0);
+  case CollectiveOp::Min:
+    if (T->isFloatingPointTy())
+      return ConstantFP::getInfinity(T, false);
+    return ConstantInt::get(T, C.Signed ? APInt::getSignedMaxValue(Bits)
+                                        : APInt::getMaxValue(Bits));
+  case CollectiveOp::Max:
+    if (T->isFloatingPointTy())
+      return ConstantFP::getInfinity(T, true);
+    return ConstantInt::get(T, C.Signed ? APInt::getSignedMinValue(Bits)
+                                        : APInt::getMinValue(Bits));
+  default:
+    return nullptr;
+  }
+}
+
+// Folds the value of a work-item into the accumulator. The min and max
+// select like the library: min(a, b) = a > b ? b : a.
+static Value *createFold(IRBuilder<> &Builder, const Collective &C, Value *Acc,
+                         Value *V) {
+  switch (C.Kind) {
+  case CollectiveKind::Any:
+    return Builder.CreateOr(Acc, V);
+  case CollectiveKind::All:
+    return Builder.CreateAnd(Acc, V);
+  default:
+    break;
+  }
+
+  bool FP = V->getType()->isFloatingPointTy();
+  if (C.Op == CollectiveOp::Add)
+    return FP ? Builder.CreateFAdd(Acc, V) : Builder.CreateAdd(Acc, V);
+
+  Value *Greater = FP         ? Builder.CreateFCmpOGT(Acc, V)
+                   : C.Signed ? Builder.CreateICmpSGT(Acc, V)
+                              : Builder.CreateICmpUGT(Acc, V);
+  return C.Op == CollectiveOp::Min ? Builder.CreateSelect(Greater, V, Acc)
+                                   : Builder.CreateSelect(Greater, Acc, V);
+}
+
+// Emits the linear local id of the work-item from the work-item variables,
+// which the work-item loops set for each work-item.
+static Value *createLocalLinearId(IRBuilder<> &Builder, Type *SizeT) {
+  Module *M = Builder.GetInsertBlock()->getModule();
+  auto LoadVar = [&](const char *VarName) -> Value * {
+    return Builder.CreateLoad(SizeT, M->getOrInsertGlobal(VarName, SizeT));
+  };
+  Value *X = LoadVar(POCL_LOCAL_ID_X_GLOBAL);
+  Value *Y = LoadVar(POCL_LOCAL_ID_Y_GLOBAL);
+  Value *Z = LoadVar(POCL_LOCAL_ID_Z_GLOBAL);
+  Value *SizeX = LoadVar("_local_size_x");
+  Value *SizeY = LoadVar("_local_size_y");
+  return Builder.CreateAdd(
+      Builder.CreateMul(
+          Builder.CreateAdd(Builder.CreateMul(Z, SizeY), Y), SizeX),
+      X);
+}
+
+static Value *createSubGroupSize(IRBuilder<> &Builder, Type *SizeT) {
+  Module *M = Builder.GetInsertBlock()->getModule();
+  Type *UInt = Builder.getInt32Ty();
+  return Builder.CreateZExt(
+      Builder.CreateLoad(UInt,
+                         M->getOrInsertGlobal("_pocl_sub_group_size", UInt)),
+      SizeT);
+}
+
+// Returns the accumulator of the work-item's group at the builder's
+// insertion point: the shared variable itself for a work-group
+// collective, the element of the work-item's sub-group in the shared array
+// for a sub-group collective.
+static Value *createAccumulatorPtr(IRBuilder<> &Builder, const Collective &C,
+                                   Value *Storage, Type *T, Type *SizeT) {
+  if (!C.SubGroup)
+    return Storage;
+  Value *SubGroupId = Builder.CreateUDiv(createLocalLinearId(Builder, SizeT),
+                                         createSubGroupSize(Builder, SizeT));
+  return Builder.CreateInBoundsGEP(T, Storage, SubGroupId);
+}
+
+static void markCollectiveAccess(Instruction *I) {
+  I->setMetadata(POCL_COLLECTIVE_MD_NAME, MDNode::get(I->getContext(), {}));
+}
+
+// Allocates the work-group shared storage of the accumulator(s) of the
+// collective via the pseudo functions the work-item loops expand to
+// allocas in the work-group function: one variable for a work-group
+// collective, an element per work-item (and thus at least one per
+// sub-group) for a sub-group collective.
+static Value *createStorage(Function &K, const Collective &C, Type *T,
+                            Type *SizeT) {
+  Module *M = K.getParent();
+  LLVMContext &Ctx = M->getContext();
+  const char *AllocaName =
+      C.SubGroup ? "__pocl_work_group_alloca" : "__pocl_local_mem_alloca";
+  unsigned NumParams = C.SubGroup ? 3 : 2;
+
+  Function *Alloca = M->getFunction(AllocaName);
+  if (Alloca == nullptr) {
+    SmallVector<Type *, 3> Params(NumParams, SizeT);
+    Alloca = Function::Create(
+        FunctionType::get(PointerType::get(Type::getInt8Ty(Ctx), 0), Params,
+                          false),
+        GlobalValue::ExternalLinkage, AllocaName, M);
+  }
+  FunctionType *FT = Alloca->getFunctionType();
+  uint64_t Size = M->getDataLayout().getTypeAllocSize(T);
+
+  SmallVector<Value *, 3> Args;
+  Args.push_back(ConstantInt::get(FT->getParamType(0), Size));
+  Args.push_back(ConstantInt::get(FT->getParamType(1), Size));
+  if (C.SubGroup)
+    Args.push_back(ConstantInt::get(FT->getParamType(2), 0));
+
+  BasicBlock::iterator InsertPt = K.getEntryBlock().getFirstInsertionPt();
+  while (isa<AllocaInst>(InsertPt))
+    ++InsertPt;
+  IRBuilder<> Builder(&*InsertPt);
+  Value *Storage = Builder.CreateCall(Alloca, Args, "collective_storage");
+  unsigned AS = Storage->getType()->getPointerAddressSpace();
+  return Builder.CreatePointerCast(Storage, PointerType::get(T, AS));
+}
+
+static void lowerCollective(Function &K, const Collective &C, Type *SizeT) {
+  CallInst *Call = C.Call;
+  IRBuilder<> Builder(Call);
+
+  Value *V = Call->getArgOperand(0);
+  if (C.Kind == CollectiveKind::Any || C.Kind == CollectiveKind::All)
+    V = Builder.CreateZExt(
+        Builder.CreateICmpNE(V, Constant::getNullValue(V->getType())),
+        Call->getType());
+  Type *T = Call->getType();
+  Value *Storage = createStorage(K, C, T, SizeT);
+
+  // Before the first barrier, all the work-items reset the accumulator. A
+  // broadcast overwrites it with the value of a single work-item instead.
+  if (C.Kind != CollectiveKind::Broadcast) {
+    Value *Acc = createAccumulatorPtr(Builder, C, Storage, T, SizeT);
+    markCollectiveAccess(Builder.CreateStore(getIdentity(C, T), Acc));
+  }
+  Barrier::Create(Call);
+
+  // Between the barriers, each work-item folds its value in. The ids are
+  // loaded again in each region so that they need not be context saved.
+  Builder.SetInsertPoint(Call);
+  Value *Acc = createAccumulatorPtr(Builder, C, Storage, T, SizeT);
+  LoadInst *Old = Builder.CreateLoad(T, Acc);
+  markCollectiveAccess(Old);
+  Value *New;
+  if (C.Kind == CollectiveKind::Broadcast) {
+    Value *Id = createLocalLinearId(Builder, SizeT);
+    Value *Source;
+    if (C.SubGroup) {
+      Id = Builder.CreateURem(Id, createSubGroupSize(Builder, SizeT));
+      Source = Builder.CreateZExtOrTrunc(Call->getArgOperand(1), SizeT);
+    } else {
+      // linear id of (x, y, z): (z * size_y + y) * size_x + x
+      Module *M = K.getParent();
+      auto Coord = [&](unsigned D) {
+        return Builder.CreateZExtOrTrunc(Call->getArgOperand(D), SizeT);
+      };
+      auto Size = [&](const char *VarName) -> Value * {
+        return Builder.CreateLoad(SizeT, M->getOrInsertGlobal(VarName, SizeT));
+      };
+      unsigned Dims = Call->arg_size() - 1;
+      Source = Coord(Dims);
+      if (Dims == 3)
+        Source = Builder.CreateAdd(
+            Builder.CreateMul(Source, Size("_local_size_y")), Coord(2));
+      if (Dims >= 2)
+        Source = Builder.CreateAdd(
+            Builder.CreateMul(Source, Size("_local_size_x")), Coord(1));
+    }
+    New = Builder.CreateSelect(Builder.CreateICmpEQ(Id, Source), V, Old);
+  } else {
+    New = createFold(Builder, C, Old, V);
+  }
+  markCollectiveAccess(Builder.CreateStore(New, Acc));
+  Barrier::Create(Call);
+
+  Value *Result;
+  Builder.SetInsertPoint(Call);
+  if (C.Kind == CollectiveKind::ScanInclusive)
+    Result = New;
+  else if (C.Kind == CollectiveKind::ScanExclusive)
+    Result = Old;
+  else {
+    LoadInst *Final = Builder.CreateLoad(
+        T, createAccumulatorPtr(Builder, C, Storage, T, SizeT));
+    markCollectiveAccess(Final);
+    Result = Final;
+  }
+  Call->replaceAllUsesWith(Result);
+  Call->eraseFromParent();
+}
+
+static bool lowerCollectives(Function &K) {
+  std::vector<Collective> Collectives;
+  for (Instruction &I : instructions(K)) {
+    CallInst *Call = dyn_cast<CallInst>(&I);
+    Collective C;
+    if (Call != nullptr && parseCollective(Call, C))
+      Collectives.push_back(C);
+  }
+
+  Module *M = K.getParent();
+  if (Collectives.empty()) {
+    setModuleIntMetadata(M, "WGLoweredCollectives", 0);
+    return false;
+  }
+
+  unsigned long AddressBits = 64;
+  getModuleIntMetadata(*M, "device_address_bits", AddressBits);
+  Type *SizeT = IntegerType::get(M->getContext(), AddressBits);
+
+  for (const Collective &C : Collectives)
+    lowerCollective(K, C, SizeT);
+
+  // picked from the module metadata to the build log
+  setModuleIntMetadata(M, "WGLoweredCollectives", Collectives.size());
+  return true;
+}
+
+llvm::PreservedAnalyses
+LowerCollectives::run(llvm::Function &F, llvm::FunctionAnalysisManager &AM) {
+  if (!isKernelToProcess(F))
+    return PreservedAnalyses::all();
+
+  // The other work-item handlers do not expand the allocation pseudo
+  // functions nor run the work-items of a region in order.
+  WorkitemHandlerType WIH = AM.getResult<WorkitemHandlerChooser>(F).WIH;
+  if (WIH != WorkitemHandlerType::LOOPS)
+    return PreservedAnalyses::all();
+
+  PreservedAnalyses PAChanged = PreservedAnalyses::none();
+  PAChanged.preserve<WorkitemHandlerChooser>();
+  return lowerCollectives(F) ? PAChanged : PreservedAnalyses::all();
+}
+
+REGISTER_NEW_FPASS(PASS_NAME, PASS_CLASS, PASS_DESC);
+
+} // namespace pocl
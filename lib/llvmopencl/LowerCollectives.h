@@ -0,0 +1,58 @@
+// Header for LowerCollectives, an LLVM function pass that lowers the
+// work-group and sub-group collective function calls of a kernel.
+//
+// Copyright (c) 2024 pocl developers
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef POCL_LOWER_COLLECTIVES_H
+#define POCL_LOWER_COLLECTIVES_H
+
+#include "config.h"
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Pass.h>
+#include <llvm/Passes/PassBuilder.h>
+
+// Marks the accesses to the work-group shared accumulator of a lowered
+// collective. They carry a dependence from a work-item to the next one, so
+// the work-item loops must not mark them parallel.
+#define POCL_COLLECTIVE_MD_NAME "pocl.collective"
+
+namespace pocl {
+
+// Replaces the calls to the reduce, scan, broadcast, any and all
+// work-group and sub-group functions in a kernel that the work-item loops
+// handle with an accumulation into a work-group shared variable, which the
+// work-items update in the order of their linear ids. Meant to be run
+// before the barriers of the kernel are flattened, while the collectives
+// still are calls.
+
+class LowerCollectives : public llvm::PassInfoMixin<LowerCollectives> {
+public:
+  static void registerWithPB(llvm::PassBuilder &B);
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &AM);
+  static bool isRequired() { return true; }
+};
+
+} // namespace pocl
+
+#endif
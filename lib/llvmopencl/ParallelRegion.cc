@@ -36,6 +36,7 @@ IGNORE_COMPILER_WARNING("-Wunused-parameter")
 #include "Barrier.h"
 #include "Kernel.h"
 #include "DebugHelpers.h"
+#include "LowerCollectives.h"
 POP_COMPILER_DIAGS
 
 #include <algorithm>
@@ -504,6 +505,11 @@ ParallelRegion::AddParallelLoopMetadata(
       if (!ii->mayReadOrWriteMemory()) {
         continue;
       }
+      // The accumulators of the lowered collectives are read and written
+      // by every work-item in turn.
+      if (ii->getMetadata(POCL_COLLECTIVE_MD_NAME) != nullptr) {
+        continue;
+      }
 
       MDNode *NewMD = MDNode::get(bb->getContext(), Identifier);
       MDNode *OldMD = ii->getMetadata(PARALLEL_MD_NAME);
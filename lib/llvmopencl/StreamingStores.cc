@@ -0,0 +1,261 @@
+// LLVM function pass that makes the contiguous stores to large write-only
+// buffers non-temporal.
+//
+// Copyright (c) 2024 pocl developers
+//
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "CompilerWarnings.h"
+IGNORE_COMPILER_WARNING("-Wmaybe-uninitialized")
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+#include <llvm/Analysis/ScalarEvolutionExpressions.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+
+#include "LLVMUtils.h"
+#include "StreamingStores.h"
+POP_COMPILER_DIAGS
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include "pocl_llvm_api.h"
+
+#define PASS_NAME "streaming-stores"
+#define PASS_CLASS pocl::StreamingStores
+#define PASS_DESC "Makes the stores to large write-only buffers non-temporal."
+
+namespace pocl {
+
+using namespace llvm;
+
+// A store to a streamed buffer and the offset of its address from the
+// first store of its group.
+struct StreamedStore {
+  StoreInst *Store;
+  int64_t Offset;
+  uint64_t Size;
+};
+
+// The stores whose address advances by the same constant stride in the
+// same loop and differ from each other by constant offsets. A group covers
+// one output stream, e.g. the interleaved vector stores of a vectorized
+// work-item loop.
+struct StoreGroup {
+  const Loop *L;
+  const SCEV *Start;
+  int64_t Stride;
+  std::vector<StreamedStore> Stores;
+};
+
+// Returns the index of the kernel argument the default work-group launcher
+// loads with the given instruction, or -1 if it is not such a load. The
+// launcher gets an array of pointers to the argument values.
+static int getLauncherArgIndex(Function &WG, Instruction &I) {
+  LoadInst *ArgValue = dyn_cast<LoadInst>(&I);
+  if (ArgValue == nullptr || !ArgValue->getType()->isPointerTy())
+    return -1;
+  LoadInst *ValuePtr =
+      dyn_cast<LoadInst>(ArgValue->getPointerOperand()->stripPointerCasts());
+  if (ValuePtr == nullptr)
+    return -1;
+  const DataLayout &DL = WG.getParent()->getDataLayout();
+  int64_t Offset = 0;
+  Value *Base = GetPointerBaseWithConstantOffset(
+      ValuePtr->getPointerOperand(), Offset, DL);
+  unsigned PtrSize = DL.getPointerSize(ValuePtr->getPointerAddressSpace());
+  if (Base != WG.getArg(0) || Offset < 0 || Offset % PtrSize != 0)
+    return -1;
+  return Offset / PtrSize;
+}
+
+// Collects the stores through the given buffer pointer. Returns false if
+// the buffer might be read or its pointer escapes. The pointer comparisons
+// of the vectorizer's runtime alias checks do not read the buffer.
+static bool collectBufferStores(Value *Buffer,
+                                std::vector<StoreInst *> &Stores) {
+  SmallVector<Value *, 8> Worklist{Buffer};
+  SmallPtrSet<Value *, 16> Visited;
+  while (!Worklist.empty()) {
+    Value *V = Worklist.pop_back_val();
+    if (!Visited.insert(V).second)
+      continue;
+    for (User *U : V->users()) {
+      if (StoreInst *Store = dyn_cast<StoreInst>(U)) {
+        if (Store->getValueOperand() == V || !Store->isSimple())
+          return false;
+        Stores.push_back(Store);
+      } else if (isa<GetElementPtrInst>(U) || isa<BitCastInst>(U) ||
+                 isa<AddrSpaceCastInst>(U) || isa<PHINode>(U) ||
+                 isa<SelectInst>(U)) {
+        Worklist.push_back(U);
+      } else if (!isa<ICmpInst>(U) && !isa<PtrToIntInst>(U)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Returns true if the stores of the group, which have the same stride in
+// the same loop, together write each stride worth of bytes completely,
+// so no cache line is left partially written.
+static bool writesContiguously(StoreGroup &Group) {
+  std::vector<StreamedStore> &Stores = Group.Stores;
+  std::sort(Stores.begin(), Stores.end(),
+            [](const StreamedStore &A, const StreamedStore &B) {
+              return A.Offset < B.Offset;
+            });
+  int64_t End = Stores.front().Offset;
+  for (const StreamedStore &S : Stores) {
+    if (S.Offset > End)
+      return false;
+    End = std::max(End, S.Offset + (int64_t)S.Size);
+  }
+  return End - Stores.front().Offset >= Group.Stride;
+}
+
+static bool makeStoresNonTemporal(Function &F, ScalarEvolution &SE,
+                                  LoopInfo &LI) {
+
+  Module *M = F.getParent();
+  std::string KernelName, StreamingArgs;
+  if (!getModuleStringMetadata(*M, "WGStreamingStoreArgs", StreamingArgs) ||
+      !getModuleStringMetadata(*M, "KernelName", KernelName) ||
+      F.getName() != "_pocl_kernel_" + KernelName + "_workgroup" ||
+      F.arg_size() == 0)
+    return false;
+
+  std::set<int> ArgIndices;
+  std::stringstream SS(StreamingArgs);
+  std::string Entry;
+  while (std::getline(SS, Entry, ';'))
+    if (!Entry.empty())
+      ArgIndices.insert(std::stoi(Entry));
+
+  const DataLayout &DL = M->getDataLayout();
+  std::vector<StoreInst *> NonTemporal;
+  unsigned long Buffers = 0;
+  for (Instruction &I : instructions(F)) {
+    if (ArgIndices.count(getLauncherArgIndex(F, I)) == 0)
+      continue;
+    std::vector<StoreInst *> Stores;
+    if (!collectBufferStores(&I, Stores))
+      continue;
+
+    std::vector<StoreGroup> Groups;
+    for (StoreInst *Store : Stores) {
+      const SCEVAddRecExpr *Addr =
+          dyn_cast<SCEVAddRecExpr>(SE.getSCEV(Store->getPointerOperand()));
+      if (Addr == nullptr || !Addr->isAffine() ||
+          Addr->getLoop() != LI.getLoopFor(Store->getParent()))
+        continue;
+      const SCEVConstant *Step =
+          dyn_cast<SCEVConstant>(Addr->getStepRecurrence(SE));
+      if (Step == nullptr || Step->getAPInt().getSExtValue() <= 0)
+        continue;
+      int64_t Stride = Step->getAPInt().getSExtValue();
+      uint64_t Size = DL.getTypeStoreSize(Store->getValueOperand()->getType());
+
+      auto G =
+          std::find_if(Groups.begin(), Groups.end(), [&](StoreGroup &Other) {
+            return Other.L == Addr->getLoop() && Other.Stride == Stride &&
+                   isa<SCEVConstant>(
+                       SE.getMinusSCEV(Addr->getStart(), Other.Start));
+          });
+      if (G == Groups.end()) {
+        Groups.push_back({Addr->getLoop(), Addr->getStart(), Stride, {}});
+        G = Groups.end() - 1;
+      }
+      const SCEVConstant *Offset =
+          cast<SCEVConstant>(SE.getMinusSCEV(Addr->getStart(), G->Start));
+      G->Stores.push_back({Store, Offset->getAPInt().getSExtValue(), Size});
+    }
+
+    size_t Marked = NonTemporal.size();
+    for (StoreGroup &G : Groups) {
+      if (!writesContiguously(G))
+        continue;
+      for (const StreamedStore &S : G.Stores) {
+        NonTemporal.push_back(S.Store);
+        // The runtime streams only buffers aligned to MAX_EXTENDED_ALIGNMENT.
+        // The x86-64 backend splits the non-temporal vector stores it cannot
+        // prove aligned to their size into scalar ones.
+        const SCEV *Offset =
+            SE.getMinusSCEV(SE.getSCEV(S.Store->getPointerOperand()),
+                            SE.getSCEV(&I));
+        if (isa<SCEVCouldNotCompute>(Offset))
+          continue;
+#if LLVM_MAJOR < 17
+        uint32_t Zeros = std::min(SE.GetMinTrailingZeros(Offset), 31u);
+#else
+        uint32_t Zeros = std::min(SE.getMinTrailingZeros(Offset), 31u);
+#endif
+        Align Known(std::min<uint64_t>(1ULL << Zeros, MAX_EXTENDED_ALIGNMENT));
+        if (Known > S.Store->getAlign())
+          S.Store->setAlignment(Known);
+      }
+    }
+    if (NonTemporal.size() > Marked)
+      ++Buffers;
+  }
+
+  if (NonTemporal.empty())
+    return false;
+
+  LLVMContext &C = F.getContext();
+  MDNode *One = MDNode::get(
+      C, ConstantAsMetadata::get(ConstantInt::get(Type::getInt32Ty(C), 1)));
+  for (StoreInst *Store : NonTemporal)
+    Store->setMetadata(LLVMContext::MD_nontemporal, One);
+
+  // The non-temporal stores are weakly ordered on e.g. x86-64, where a
+  // release fence does not order them. Order them before the completion of
+  // the work-group with a full fence.
+  for (BasicBlock &BB : F)
+    if (ReturnInst *Ret = dyn_cast<ReturnInst>(BB.getTerminator()))
+      new FenceInst(C, AtomicOrdering::SequentiallyConsistent,
+                    SyncScope::System, Ret);
+
+  // picked from the module metadata to the build log
+  setModuleIntMetadata(M, "WGNontemporalStores", NonTemporal.size());
+  setModuleIntMetadata(M, "WGNontemporalBuffers", Buffers);
+  return true;
+}
+
+llvm::PreservedAnalyses
+StreamingStores::run(llvm::Function &F, llvm::FunctionAnalysisManager &AM) {
+  ScalarEvolution &SE = AM.getResult<ScalarEvolutionAnalysis>(F);
+  LoopInfo &LI = AM.getResult<LoopAnalysis>(F);
+  PreservedAnalyses PAChanged = PreservedAnalyses::none();
+  PAChanged.preserveSet<CFGAnalyses>();
+  return makeStoresNonTemporal(F, SE, LI) ? PAChanged
+                                          : PreservedAnalyses::all();
+}
+
+REGISTER_NEW_FPASS(PASS_NAME, PASS_CLASS, PASS_DESC);
+
+} // namespace pocl
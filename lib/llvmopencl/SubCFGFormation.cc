@@ -54,6 +54,7 @@ POP_COMPILER_DIAGS
 #include "VariableUniformityAnalysis.h"
 #include "VariableUniformityAnalysisResult.hh"
 #include "Workgroup.h"
+#include "WorkitemHandler.h"
 #include "WorkitemHandlerChooser.h"
 
 #include "pocl_llvm_api.h"
@@ -80,6 +81,7 @@ static constexpr const char LoopStateMD[] = "poclLoopState";
 
 namespace PoclMDKind {
   static constexpr const char Arrayified[] = "pocl.arrayified";
+  static constexpr const char Narrowed[] = "pocl.arrayified.narrowed";
   static constexpr const char InnerLoop[] = "pocl.loop.inner";
   static constexpr const char WorkItemLoop[] = "pocl.loop.workitem";
 };
@@ -150,17 +152,38 @@ llvm::AllocaInst *arrayifyValue(llvm::Instruction *IPAllocas,
 }
 
 // see arrayifyValue. The store is inserted after the \a ToArrayify instruction
+// If \a Narrow is set, an integer value known to fit in a narrower type is
+// truncated before storing, and the alloca is marked with the extension
+// required to restore the value (see restoreFromAlloca).
 llvm::AllocaInst *arrayifyInstruction(llvm::Instruction *IPAllocas,
                                       llvm::Instruction *ToArrayify,
                                       llvm::Value *Idx,
                                       llvm::Value *NumElements,
-                                      llvm::MDTuple *MDAlloca = nullptr) {
+                                      llvm::MDTuple *MDAlloca = nullptr,
+                                      bool Narrow = false) {
   llvm::Instruction *InsertionPoint = &*(++ToArrayify->getIterator());
   if (llvm::isa<llvm::PHINode>(ToArrayify))
     InsertionPoint = ToArrayify->getParent()->getFirstNonPHI();
 
-  return arrayifyValue(IPAllocas, ToArrayify, InsertionPoint, Idx, NumElements,
-                       MDAlloca);
+  bool NarrowedSigned = false;
+  llvm::IntegerType *NarrowedType =
+      Narrow ? getNarrowestIntType(ToArrayify, NarrowedSigned) : nullptr;
+  if (NarrowedType == nullptr)
+    return arrayifyValue(IPAllocas, ToArrayify, InsertionPoint, Idx,
+                         NumElements, MDAlloca);
+
+  llvm::IRBuilder<> TruncBuilder{InsertionPoint};
+  llvm::Value *Narrowed = TruncBuilder.CreateTrunc(
+      ToArrayify, NarrowedType, ToArrayify->getName() + ".narrowed");
+  auto *Alloca = arrayifyValue(IPAllocas, Narrowed, InsertionPoint, Idx,
+                               NumElements, MDAlloca);
+  Alloca->setMetadata(
+      PoclMDKind::Narrowed,
+      llvm::MDNode::get(IPAllocas->getContext(),
+                        {llvm::MDString::get(IPAllocas->getContext(),
+                                             NarrowedSigned ? "sext"
+                                                            : "zext")}));
+  return Alloca;
 }
 
 // load from the \a Alloca at \a Idx, if array alloca, otherwise just load the
@@ -185,6 +208,26 @@ llvm::LoadInst *loadFromAlloca(llvm::AllocaInst *Alloca, llvm::Value *Idx,
   return Load;
 }
 
+// load the value of \a Orig from the \a Alloca at \a Idx, extending it back
+// to the original type in case it was stored narrowed
+llvm::Instruction *restoreFromAlloca(llvm::AllocaInst *Alloca, llvm::Value *Idx,
+                                     llvm::Instruction *InsertBefore,
+                                     llvm::Instruction *Orig) {
+  auto *Load = loadFromAlloca(Alloca, Idx, InsertBefore, Orig->getName());
+  if (Load->getType() == Orig->getType())
+    return Load;
+
+  auto *MDNarrowed = Alloca->getMetadata(PoclMDKind::Narrowed);
+  assert(MDNarrowed && "Type mismatch in a non-narrowed loop state alloca");
+  llvm::IRBuilder<> ExtBuilder{InsertBefore};
+  auto *Kind = llvm::cast<llvm::MDString>(MDNarrowed->getOperand(0));
+  if (Kind->getString() == "sext")
+    return llvm::cast<llvm::Instruction>(
+        ExtBuilder.CreateSExt(Load, Orig->getType(), Orig->getName() + "_ext"));
+  return llvm::cast<llvm::Instruction>(
+      ExtBuilder.CreateZExt(Load, Orig->getType(), Orig->getName() + "_ext"));
+}
+
 // get the work-item state alloca a load reads from (through GEPs..)
 llvm::AllocaInst *getLoopStateAllocaForLoad(llvm::LoadInst &LInst) {
   llvm::AllocaInst *Alloca = nullptr;
@@ -792,8 +835,9 @@ void SubCFG::arrayifyMultiSubCfgValues(
         }
 #endif
         // create wide alloca and store the value
-        auto *Alloca =
-            arrayifyInstruction(AllocaIP, &I, ContIdx_, ReqdArrayElements);
+        auto *Alloca = arrayifyInstruction(AllocaIP, &I, ContIdx_,
+                                           ReqdArrayElements, nullptr,
+                                           NarrowContextArrays);
         InstAllocaMap.insert({&I, Alloca});
       }
     }
@@ -854,8 +898,8 @@ void SubCFG::loadMultiSubCfgValues(
         llvm::errs() << "[SubCFG] Load from Alloca " << *InstAllocaPair.second
                      << " in " << IP->getParent()->getName() << "\n";
 #endif
-        auto *Load = loadFromAlloca(InstAllocaPair.second, NewContIdx, IP,
-                                    InstAllocaPair.first->getName());
+        auto *Load = restoreFromAlloca(InstAllocaPair.second, NewContIdx, IP,
+                                       InstAllocaPair.first);
         copyDgbValues(InstAllocaPair.first, Load, IP);
         VMap[InstAllocaPair.first] = Load;
       }
@@ -1090,7 +1134,7 @@ void SubCFG::fixSingleSubCfgValues(
             NewIP = UniLoadIP;
 #endif
 
-          auto *Load = loadFromAlloca(Alloca, ContIdx_, NewIP, OPI->getName());
+          auto *Load = restoreFromAlloca(Alloca, ContIdx_, NewIP, OPI);
           copyDgbValues(OPI, Load, NewIP);
 
 #ifdef CBS_NO_PHIS_IN_SPLIT
@@ -1358,6 +1402,36 @@ getBarrierIds(llvm::BasicBlock *Entry,
       Barriers.insert({BB, BarrierId++});
   return Barriers;
 }
+// Stores the loop state footprint of the kernel to the module metadata from
+// where it is picked to the build log. \a NumMultiValues values spanning
+// multiple subcfgs are stored in \a NumMultiArrays of the arrays, the rest
+// of the arrays hold a single (private variable or loop state) value each.
+void recordLoopStateFootprint(llvm::Function &F, bool WGDynamicLocalSize,
+                              size_t NumElements, size_t NumMultiValues,
+                              size_t NumMultiArrays) {
+  const llvm::DataLayout &DL = F.getParent()->getDataLayout();
+  size_t NumArrays = 0, BytesPerWI = 0, BytesTotal = 0;
+  for (auto &I : F.getEntryBlock()) {
+    auto *Alloca = llvm::dyn_cast<llvm::AllocaInst>(&I);
+    if (!Alloca || !Alloca->hasMetadata(PoclMDKind::Arrayified) ||
+        !Alloca->isArrayAllocation())
+      continue;
+    size_t Size = DL.getTypeAllocSize(Alloca->getAllocatedType());
+    ++NumArrays;
+    BytesPerWI += Size;
+    if (!WGDynamicLocalSize)
+      BytesTotal += llvm::alignTo(Size * NumElements, DefaultAlignment);
+  }
+  llvm::Module *M = F.getParent();
+  size_t NumValues = NumMultiValues;
+  if (NumArrays > NumMultiArrays)
+    NumValues += NumArrays - NumMultiArrays;
+  setModuleIntMetadata(M, "WGContextValues", NumValues);
+  setModuleIntMetadata(M, "WGContextArrays", NumArrays);
+  setModuleIntMetadata(M, "WGContextBytesPerWI", BytesPerWI);
+  setModuleIntMetadata(M, "WGContextBytes", BytesTotal);
+}
+
 void formSubCfgs(llvm::Function &F, llvm::LoopInfo &LI, llvm::DominatorTree &DT,
                  llvm::PostDominatorTree &PDT,
                  pocl::VariableUniformityAnalysisResult &VUA) {
@@ -1461,6 +1535,18 @@ void formSubCfgs(llvm::Function &F, llvm::LoopInfo &LI, llvm::DominatorTree &DT,
         InstAllocaMap, BaseInstAllocaMap, InstContReplicaMap, SubCFGs,
         F.getEntryBlock().getTerminator(), ReqdArrayElements, VUA);
 
+  // Count the values spanning multiple subcfgs for the footprint report
+  // before the replication drops the original instructions. Loads from
+  // and GEPs into already arrayified allocas share the array.
+  size_t NumMultiValues = 0;
+  llvm::SmallPtrSet<llvm::AllocaInst *, 16> MultiArrays;
+  for (auto &InstAllocaPair : InstAllocaMap) {
+    if (!InstAllocaPair.second->isArrayAllocation())
+      continue;
+    ++NumMultiValues;
+    MultiArrays.insert(InstAllocaPair.second);
+  }
+
   llvm::DenseMap<llvm::Instruction *, llvm::AllocaInst *> RemappedInstAllocaMap;
   for (auto &Cfg : SubCFGs) {
     Cfg.print();
@@ -1486,6 +1572,10 @@ void formSubCfgs(llvm::Function &F, llvm::LoopInfo &LI, llvm::DominatorTree &DT,
 
   IndVar->eraseFromParent();
 
+  recordLoopStateFootprint(F, WGDynamicLocalSize,
+                           LocalSizes[0] * LocalSizes[1] * LocalSizes[2],
+                           NumMultiValues, MultiArrays.size());
+
 #ifdef DEBUG_SUBCFG_FORMATION
   F.viewCFG();
 #endif
@@ -414,6 +414,18 @@ bool VariableUniformityAnalysisResult::isUniform(llvm::Function *F,
     return false;
   }
 
+  // The work-group shared memory pseudo allocations return the same pointer
+  // to all the work-items (see WorkitemLoops.cc).
+  if (llvm::CallInst *Call = dyn_cast<llvm::CallInst>(V)) {
+    llvm::Function *Callee = Call->getCalledFunction();
+    if (Callee != nullptr &&
+        (Callee->getName() == "__pocl_local_mem_alloca" ||
+         Callee->getName() == "__pocl_work_group_alloca")) {
+      setUniform(F, V, true);
+      return true;
+    }
+  }
+
   llvm::Instruction *instr = dyn_cast<llvm::Instruction>(V);
   if (instr == NULL) {
     setUniform(F, V, false);
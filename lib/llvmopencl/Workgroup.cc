@@ -178,6 +178,7 @@ private:
   unsigned long DeviceContextASid;
   unsigned long DeviceArgsASid;
   bool DeviceSidePrintf;
+  bool DeviceDeferredPrintf;
   bool DeviceAllocaLocals;
   unsigned long DeviceMaxWItemDim;
   unsigned long DeviceMaxWItemSizes[3];
@@ -211,6 +212,8 @@ bool WorkgroupImpl::runOnModule(Module &M, FunctionVec &OldKernels) {
   getModuleIntMetadata(M, "device_context_as_id", DeviceContextASid);
 
   getModuleBoolMetadata(M, "device_side_printf", DeviceSidePrintf);
+  DeviceDeferredPrintf = false;
+  getModuleBoolMetadata(M, "device_deferred_printf", DeviceDeferredPrintf);
   getModuleBoolMetadata(M, "device_alloca_locals", DeviceAllocaLocals);
 
   getModuleIntMetadata(M, "device_max_witem_dim", DeviceMaxWItemDim);
@@ -473,6 +476,8 @@ static bool callsPrintf(Function *F) {
         return true;
       if (callee->getName().equals("__pocl_printf"))
         return true;
+      if (callee->getName().equals("__pocl_printf_deferred"))
+        return true;
       if (callsPrintf(callee))
         return true;
     }
@@ -772,7 +777,10 @@ Function *WorkgroupImpl::createWrapper(Function *F,
   InlineFunction(*CI, IFI);
 
   if (DeviceSidePrintf) {
-    Function *FoclPrintfFun = M->getFunction("__pocl_printf");
+    // In the deferred mode printf() only appends the format string address
+    // and the raw arguments to the buffer, and the host does the formatting.
+    Function *FoclPrintfFun = M->getFunction(
+        DeviceDeferredPrintf ? "__pocl_printf_deferred" : "__pocl_printf");
     replacePrintfCalls(PrintfBuf, PrintfBufPos, PrintfBufCapa,
                        true, FoclPrintfFun, *M, L, PrintfCache);
   }
@@ -55,6 +55,11 @@ cl::opt<bool> AddWIMetadata(
     cl::desc("Adds a work item identifier to each of the instruction in "
              "work items."));
 
+cl::opt<bool> NarrowContextArrays(
+    "pocl-narrow-context-arrays", cl::init(true), cl::Hidden,
+    cl::desc("Store the context saved integer values using the narrowest "
+             "type that can hold their known value range."));
+
 void
 WorkitemHandler::Initialize(Kernel *K) {
 
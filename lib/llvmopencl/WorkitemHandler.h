@@ -69,6 +69,7 @@ protected:
 
   extern llvm::cl::opt<bool> AddWIMetadata;
   extern llvm::cl::opt<int> LockStepSIMDWidth;
+  extern llvm::cl::opt<bool> NarrowContextArrays;
 }
 
 #endif
@@ -0,0 +1,280 @@
+// LLVM function pass that prefetches the global buffer loads of the
+// work-items that run later in the work-item loops of the vectorized
+// work-group function.
+//
+// Copyright (c) 2024 pocl developers
+//
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "CompilerWarnings.h"
+IGNORE_COMPILER_WARNING("-Wmaybe-uninitialized")
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+#include <llvm/Analysis/ScalarEvolutionExpressions.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Transforms/Utils/ScalarEvolutionExpander.h>
+
+#include "LLVMUtils.h"
+#include "WorkitemLoadPrefetch.h"
+POP_COMPILER_DIAGS
+
+#include "pocl_llvm_api.h"
+#include "pocl_runtime_config.h"
+
+#include <vector>
+
+#define PASS_NAME "prefetch-wi-loads"
+#define PASS_CLASS pocl::WorkitemLoadPrefetch
+#define PASS_DESC "Prefetches the loads of the later work-items in WI loops."
+
+namespace pocl {
+
+using namespace llvm;
+
+// Accesses with a smaller stride between consecutive work-items are left
+// to the hardware prefetchers, which follow them well.
+static const int64_t MinPrefetchStride = 64;
+
+// Returns the work-item loop the block runs in: the innermost loop around
+// it that is marked parallel. The loop vectorizer copies the marking of a
+// work-item loop to the vector loop and to the remainder loop it creates.
+static Loop *getWorkitemLoop(LoopInfo &LI, BasicBlock *BB) {
+  for (Loop *L = LI.getLoopFor(BB); L != nullptr; L = L->getParentLoop())
+    if (findOptionMDForLoop(L, "llvm.loop.parallel_accesses") != nullptr)
+      return L;
+  return nullptr;
+}
+
+// Returns the number of work-items an iteration of the work-item loop
+// runs, the step of the induction its latch compares: e.g. the vector width
+// times the interleave count in a vector loop. Returns 0 if it is not
+// known.
+static int64_t getWorkitemsPerIteration(Loop *L, ScalarEvolution &SE) {
+  BasicBlock *Latch = L->getLoopLatch();
+  ICmpInst *Cmp = L->getLatchCmpInst();
+  if (Latch == nullptr || Cmp == nullptr)
+    return 0;
+  for (PHINode &Phi : L->getHeader()->phis()) {
+    Value *Next = Phi.getIncomingValueForBlock(Latch);
+    if (!is_contained(Cmp->operands(), &Phi) &&
+        !is_contained(Cmp->operands(), Next))
+      continue;
+    const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(&Phi));
+    if (AR == nullptr || !AR->isAffine() || AR->getLoop() != L)
+      continue;
+    const SCEVConstant *Step =
+        dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+    if (Step != nullptr && Step->getAPInt().getSExtValue() > 0)
+      return Step->getAPInt().getSExtValue();
+  }
+  return 0;
+}
+
+// Rewrites an address SCEV as if the integer arithmetic on the work-item
+// loop induction could not overflow: the truncations and extensions of
+// the expressions containing it are pushed to their leaves. This makes the
+// addresses indexed with e.g. "int i = get_global_id(0)" affine.
+class WorkitemLinearizer {
+public:
+  WorkitemLinearizer(ScalarEvolution &SE, const Loop *L) : SE(SE), L(L) {}
+
+  const SCEV *linearize(const SCEV *S) {
+    if (S->getType()->isIntegerTy())
+      return widen(S, S->getType());
+    if (const SCEVAddExpr *Add = dyn_cast<SCEVAddExpr>(S)) {
+      SmallVector<const SCEV *, 4> Ops;
+      for (const SCEV *Op : Add->operands())
+        Ops.push_back(linearize(Op));
+      return SE.getAddExpr(Ops);
+    }
+    if (const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+      if (AR->isAffine())
+        return SE.getAddRecExpr(linearize(AR->getStart()),
+                                linearize(AR->getStepRecurrence(SE)),
+                                AR->getLoop(), SCEV::FlagAnyWrap);
+    }
+    return S;
+  }
+
+  bool containsWorkitem(const SCEV *S) const {
+    return SCEVExprContains(S, [this](const SCEV *E) {
+      const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(E);
+      return AR != nullptr && AR->getLoop() == L;
+    });
+  }
+
+private:
+  const SCEV *widen(const SCEV *S, Type *Ty) {
+    if (!containsWorkitem(S))
+      return SE.getTruncateOrSignExtend(S, Ty);
+    if (const SCEVCastExpr *Cast = dyn_cast<SCEVCastExpr>(S)) {
+      if (Cast->getOperand()->getType()->isIntegerTy())
+        return widen(Cast->getOperand(), Ty);
+    } else if (const SCEVAddExpr *Add = dyn_cast<SCEVAddExpr>(S)) {
+      SmallVector<const SCEV *, 4> Ops;
+      for (const SCEV *Op : Add->operands())
+        Ops.push_back(widen(Op, Ty));
+      return SE.getAddExpr(Ops);
+    } else if (const SCEVMulExpr *Mul = dyn_cast<SCEVMulExpr>(S)) {
+      SmallVector<const SCEV *, 4> Ops;
+      for (const SCEV *Op : Mul->operands())
+        Ops.push_back(widen(Op, Ty));
+      return SE.getMulExpr(Ops);
+    } else if (const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+      if (AR->isAffine())
+        return SE.getAddRecExpr(widen(AR->getStart(), Ty),
+                                widen(AR->getStepRecurrence(SE), Ty),
+                                AR->getLoop(), SCEV::FlagAnyWrap);
+    }
+    return SE.getTruncateOrSignExtend(S, Ty);
+  }
+
+  ScalarEvolution &SE;
+  const Loop *L;
+};
+
+// Rewrites an address SCEV to the address the given number of iterations
+// later in the work-item loop.
+class WorkitemAdvancer : public SCEVRewriteVisitor<WorkitemAdvancer> {
+public:
+  WorkitemAdvancer(ScalarEvolution &SE, const Loop *L, int64_t Iterations)
+      : SCEVRewriteVisitor(SE), L(L), Iterations(Iterations) {}
+
+  const SCEV *visitAddRecExpr(const SCEVAddRecExpr *Expr) {
+    if (!Expr->isAffine())
+      return Expr;
+    const SCEV *Start = visit(Expr->getStart());
+    const SCEV *Step = visit(Expr->getStepRecurrence(SE));
+    if (Expr->getLoop() == L)
+      Start = SE.getAddExpr(
+          Start,
+          SE.getMulExpr(Step, SE.getConstant(Step->getType(), Iterations)));
+    return SE.getAddRecExpr(Start, Step, Expr->getLoop(), SCEV::FlagAnyWrap);
+  }
+
+private:
+  const Loop *L;
+  int64_t Iterations;
+};
+
+static bool insertPrefetches(Function &F, ScalarEvolution &SE, LoopInfo &LI) {
+
+  int Distance = pocl_get_int_option("POCL_WI_PREFETCH_DISTANCE", 0);
+  if (Distance <= 0)
+    return false;
+
+  Module *M = F.getParent();
+  std::string KernelName;
+  if (!getModuleStringMetadata(*M, "KernelName", KernelName) ||
+      F.getName() != "_pocl_kernel_" + KernelName + "_workgroup")
+    return false;
+
+  std::vector<std::pair<LoadInst *, const SCEV *>> Prefetches;
+  SmallPtrSet<const SCEV *, 16> Prefetched;
+
+  for (Instruction &I : instructions(F)) {
+    LoadInst *Load = dyn_cast<LoadInst>(&I);
+    if (Load == nullptr || Load->isVolatile())
+      continue;
+    Loop *L = getWorkitemLoop(LI, Load->getParent());
+    if (L == nullptr)
+      continue;
+    Value *Ptr = Load->getPointerOperand();
+    if (!SE.isSCEVable(Ptr->getType()))
+      continue;
+    WorkitemLinearizer Linearizer(SE, L);
+    const SCEV *Addr = SE.getSCEV(Ptr);
+    // The private data of the work-items is in the cache already.
+    const SCEVUnknown *Base = dyn_cast<SCEVUnknown>(SE.getPointerBase(Addr));
+    if (Base == nullptr || isa<AllocaInst>(Base->getValue()) ||
+        !Linearizer.containsWorkitem(Addr))
+      continue;
+    int64_t WIsPerIteration = getWorkitemsPerIteration(L, SE);
+    if (WIsPerIteration == 0)
+      continue;
+
+    // Fetch for the work-item at least Distance work-items later, in the
+    // iteration of the work-item loop that runs it.
+    int64_t Iterations = (Distance + WIsPerIteration - 1) / WIsPerIteration;
+    Addr = Linearizer.linearize(Addr);
+    WorkitemAdvancer Advancer(SE, L, Iterations);
+    const SCEV *LaterAddr = Advancer.visit(Addr);
+    const SCEV *Delta = SE.getMinusSCEV(LaterAddr, Addr);
+    // Only affine addresses have a distance that is the same for all
+    // the work-items.
+    if (isa<SCEVCouldNotCompute>(Delta) || Linearizer.containsWorkitem(Delta))
+      continue;
+    if (const SCEVConstant *C = dyn_cast<SCEVConstant>(Delta)) {
+      int64_t Stride =
+          C->getAPInt().getSExtValue() / (Iterations * WIsPerIteration);
+      if (Stride < MinPrefetchStride && Stride > -MinPrefetchStride)
+        continue;
+    }
+    if (!Prefetched.insert(LaterAddr).second)
+      continue;
+    Prefetches.push_back(std::make_pair(Load, Delta));
+  }
+
+  if (Prefetches.empty())
+    return false;
+
+  const DataLayout &DL = M->getDataLayout();
+  SCEVExpander Expander(SE, DL, "prefetch");
+  for (auto &P : Prefetches) {
+    LoadInst *Load = P.first;
+    Value *Delta =
+        Expander.expandCodeFor(P.second, P.second->getType(), Load);
+    IRBuilder<> Builder(Load);
+    unsigned AS = Load->getPointerAddressSpace();
+    Type *Int8PtrTy = PointerType::get(Builder.getInt8Ty(), AS);
+    Value *Ptr =
+        Builder.CreatePointerCast(Load->getPointerOperand(), Int8PtrTy);
+    Value *LaterPtr =
+        Builder.CreateGEP(Builder.getInt8Ty(), Ptr, Delta, "prefetch.addr");
+    Function *Prefetch =
+        Intrinsic::getDeclaration(M, Intrinsic::prefetch, {Int8PtrTy});
+    // a read prefetch to all the cache levels
+    Builder.CreateCall(Prefetch, {LaterPtr, Builder.getInt32(0),
+                                  Builder.getInt32(3), Builder.getInt32(1)});
+  }
+  // picked from the module metadata to the build log
+  setModuleIntMetadata(M, "WGPrefetchedLoads", Prefetches.size());
+  setModuleIntMetadata(M, "WGPrefetchDistance", Distance);
+  return true;
+}
+
+llvm::PreservedAnalyses
+WorkitemLoadPrefetch::run(llvm::Function &F,
+                          llvm::FunctionAnalysisManager &AM) {
+  ScalarEvolution &SE = AM.getResult<ScalarEvolutionAnalysis>(F);
+  LoopInfo &LI = AM.getResult<LoopAnalysis>(F);
+  PreservedAnalyses PAChanged = PreservedAnalyses::none();
+  PAChanged.preserveSet<CFGAnalyses>();
+  return insertPrefetches(F, SE, LI) ? PAChanged : PreservedAnalyses::all();
+}
+
+REGISTER_NEW_FPASS(PASS_NAME, PASS_CLASS, PASS_DESC);
+
+} // namespace pocl
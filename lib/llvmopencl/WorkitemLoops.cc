@@ -54,8 +54,11 @@ IGNORE_COMPILER_WARNING("-Wunused-parameter")
 #include "WorkitemLoops.h"
 POP_COMPILER_DIAGS
 
+#include "pocl_llvm_api.h"
+
 #include <iostream>
 #include <map>
+#include <set>
 #include <sstream>
 #include <vector>
 
@@ -74,6 +77,11 @@ namespace pocl {
 
 using namespace llvm;
 
+static cl::opt<bool> ShareContextArrays(
+    "pocl-share-context-arrays", cl::init(true), cl::Hidden,
+    cl::desc("Let the work-item loop context arrays of values with "
+             "non-overlapping live ranges share the same storage."));
+
 // Magic function used to allocate "local memory" dynamically. Used with SG/WG
 // shuffles as temporary storage.
 static const char *POCL_LOCAL_MEM_ALLOCA_FUNC_NAME = "__pocl_local_mem_alloca";
@@ -105,6 +113,27 @@ private:
 
   StrInstructionMap ContextArrays;
 
+  using ParallelRegionSet = std::set<ParallelRegion *>;
+
+  // A context array which can be shared by multiple context saved values
+  // of the same type in case their live ranges do not overlap.
+  struct ContextArraySlot {
+    llvm::AllocaInst *Alloca;
+    llvm::Type *ElementType;
+    // The parallel regions in which one of the values stored to the array
+    // is live.
+    ParallelRegionSet LiveRegions;
+  };
+  std::vector<ContextArraySlot> ContextArraySlots;
+
+  // The basic blocks reachable from each of the original parallel regions.
+  std::map<ParallelRegion *, std::set<llvm::BasicBlock *>> ReachableBlocks;
+
+  // Context data footprint statistics, reported to the build log.
+  size_t NumContextSavedValues;
+  size_t ContextBytesPerWI;
+  size_t ContextBytesTotal;
+
   // Points to the __pocl_local_mem_alloca pseudo function declaration, if
   // it's been referred to in the processed module.
   llvm::Function *LocalMemAllocaFuncDecl;
@@ -132,13 +161,24 @@ private:
   llvm::Value *getLinearWiIndex(llvm::IRBuilder<> &Builder, llvm::Module *M,
                                 ParallelRegion *Region);
   llvm::Instruction *addContextSave(llvm::Instruction *Instruction,
-                                    llvm::AllocaInst *AllocaI);
-  llvm::Instruction *
+                                    llvm::AllocaInst *AllocaI,
+                                    llvm::Type *NarrowedType = nullptr);
+  llvm::Value *
   addContextRestore(llvm::Value *Val, llvm::AllocaInst *AllocaI,
                     llvm::Type *InstType, bool PoclWrapperStructAdded,
-                    llvm::Instruction *Before = nullptr, bool isAlloca = false);
+                    llvm::Instruction *Before = nullptr, bool isAlloca = false,
+                    llvm::Type *NarrowedType = nullptr,
+                    bool NarrowedSigned = false);
   llvm::AllocaInst *getContextArray(llvm::Instruction *Inst,
-                                    bool &PoclWrapperStructAdded);
+                                    bool &PoclWrapperStructAdded,
+                                    llvm::Type *NarrowedType = nullptr);
+
+  void computeRegionReachability(llvm::Function &F);
+  bool isRegionReachable(ParallelRegion *From, ParallelRegion *To);
+  bool getLiveRegions(llvm::Instruction *Inst, ParallelRegionSet &LiveRegions);
+  llvm::AllocaInst *findSharableContextArray(llvm::Type *ElementType,
+                                             const ParallelRegionSet &Live);
+  void recordContextFootprint(llvm::Function &F);
 
   std::pair<llvm::BasicBlock *, llvm::BasicBlock *>
   createLoopAround(ParallelRegion &Region, llvm::BasicBlock *EntryBB,
@@ -171,6 +211,9 @@ bool WorkitemLoopsImpl::runOnFunction(Function &F) {
   WGSizeInstr = nullptr;
 
   TempInstructionIndex = 0;
+  NumContextSavedValues = 0;
+  ContextBytesPerWI = 0;
+  ContextBytesTotal = 0;
 
   LocalMemAllocaFuncDecl =
       F.getParent()->getFunction(POCL_LOCAL_MEM_ALLOCA_FUNC_NAME);
@@ -194,7 +237,12 @@ bool WorkitemLoopsImpl::runOnFunction(Function &F) {
   Changed |= chopBBs(F, *this);
   F.viewCFG();
 #endif
+  if (Changed)
+    recordContextFootprint(F);
+
   ContextArrays.clear();
+  ContextArraySlots.clear();
+  ReachableBlocks.clear();
   TempInstructionIds.clear();
 
   releaseParallelRegions();
@@ -436,6 +484,8 @@ bool WorkitemLoopsImpl::processFunction(Function &F) {
 
   K->getParallelRegions(LI, &OriginalParallelRegions);
 
+  computeRegionReachability(F);
+
 #ifdef DUMP_CFGS
   F.dump();
   dumpCFG(F, F.getName().str() + "_before_wiloops.dot",
@@ -767,11 +817,12 @@ bool WorkitemLoopsImpl::handleLocalMemAllocas(Kernel &K) {
     Value *Size = Call->getArgOperand(0);
     Align Alignment =
       cast<ConstantInt>(Call->getArgOperand(1))->getAlignValue();
-    Value *ExtraSize = Call->getArgOperand(2);
 
     IRBuilder<> Builder(K.getEntryBlock().getTerminator());
 
     if (Call->getCalledFunction() == WorkGroupAllocaFuncDecl) {
+          // only the work-group variant has the extra bytes argument
+          Value *ExtraSize = Call->getArgOperand(2);
           Instruction *WGSize = getWorkGroupSizeInstr(K);
           Size = Builder.CreateBinOp(Instruction::Mul, WGSize, Size);
           Size = Builder.CreateBinOp(Instruction::Add, Size, ExtraSize);
@@ -833,7 +884,8 @@ llvm::Value *WorkitemLoopsImpl::getLinearWiIndex(llvm::IRBuilder<> &Builder,
 
 llvm::Instruction *
 WorkitemLoopsImpl::addContextSave(llvm::Instruction *Inst,
-                                  llvm::AllocaInst *AllocaI) {
+                                  llvm::AllocaInst *AllocaI,
+                                  llvm::Type *NarrowedType) {
 
   if (isa<AllocaInst>(Inst)) {
     // If the variable to be context saved is itself an alloca, we have created
@@ -870,8 +922,15 @@ WorkitemLoopsImpl::addContextSave(llvm::Instruction *Inst,
       gepArgs.push_back(region->LocalIDXLoad());
     }
 
+    // The context array stores the value with a narrower type in case the
+    // value is known to fit in it.
+    llvm::Value *SavedValue = Inst;
+    if (NarrowedType != nullptr)
+      SavedValue = builder.CreateTrunc(Inst, NarrowedType,
+                                       Inst->getName() + ".narrowed");
+
     return builder.CreateStore(
-        Inst,
+        SavedValue,
 #if LLVM_MAJOR < 15
         builder.CreateGEP(AllocaI->getType()->getPointerElementType(), AllocaI,
                           gepArgs));
@@ -880,9 +939,10 @@ WorkitemLoopsImpl::addContextSave(llvm::Instruction *Inst,
 #endif
 }
 
-llvm::Instruction *WorkitemLoopsImpl::addContextRestore(llvm::Value *Val,
+llvm::Value *WorkitemLoopsImpl::addContextRestore(llvm::Value *Val,
     llvm::AllocaInst *AllocaI, llvm::Type *InstType,
-    bool PoclWrapperStructAdded, llvm::Instruction *Before, bool isAlloca) {
+    bool PoclWrapperStructAdded, llvm::Instruction *Before, bool isAlloca,
+    llvm::Type *NarrowedType, bool NarrowedSigned) {
 
   assert(Val != NULL);
   assert(AllocaI != NULL);
@@ -938,7 +998,13 @@ llvm::Instruction *WorkitemLoopsImpl::addContextRestore(llvm::Value *Val,
        pointer to the elements to emulate the original alloca. */
     return gep;
   }
-  return builder.CreateLoad(InstType, gep);
+  if (NarrowedType == nullptr)
+    return builder.CreateLoad(InstType, gep);
+
+  llvm::Value *Narrowed = builder.CreateLoad(NarrowedType, gep);
+  if (NarrowedSigned)
+    return builder.CreateSExt(Narrowed, InstType);
+  return builder.CreateZExt(Narrowed, InstType);
 }
 
 // Returns the context array (alloca) for the given Value, creates it if not
@@ -948,7 +1014,8 @@ llvm::Instruction *WorkitemLoopsImpl::addContextRestore(llvm::Value *Val,
 // added to enforce proper alignment to the elements of the array.
 llvm::AllocaInst *
 WorkitemLoopsImpl::getContextArray(llvm::Instruction *Inst,
-                                   bool &PoclWrapperStructAdded) {
+                                   bool &PoclWrapperStructAdded,
+                                   llvm::Type *NarrowedType) {
   PoclWrapperStructAdded = false;
   /*
    * Unnamed temp instructions need a generated name for the
@@ -1036,11 +1103,35 @@ WorkitemLoopsImpl::getContextArray(llvm::Instruction *Inst,
       elementType = 
         dyn_cast<AllocaInst>(Inst)->getAllocatedType();
     } 
-  else 
+  else if (NarrowedType != nullptr)
+    {
+      elementType = NarrowedType;
+    }
+  else
     {
       elementType = Inst->getType();
     }
 
+  // Reuse a context array of a value whose live range does not overlap
+  // with this one's. Allocas are excluded as their storage is referred to
+  // via pointers, and values with debug info to keep it intact.
+  ParallelRegionSet LiveRegions;
+  bool Sharable = ShareContextArrays && !isa<AllocaInst>(Inst) &&
+                  DebugCall == nullptr;
+  if (Sharable)
+    Sharable = getLiveRegions(Inst, LiveRegions);
+  if (Sharable) {
+    if (AllocaInst *Shared =
+            findSharableContextArray(elementType, LiveRegions)) {
+#ifdef DEBUG_WORK_ITEM_LOOPS
+      std::cerr << "### sharing the context array " << Shared->getName().str()
+                << " with " << varName << std::endl;
+#endif
+      ContextArrays[varName] = Shared;
+      return Shared;
+    }
+  }
+
   /* 3D context array. In case the elementType itself is an array or struct,
    * we must take into account it could be alloca-ed with alignment and loads
    * or stores might use vectorized instructions expecting proper alignment.
@@ -1203,9 +1294,145 @@ WorkitemLoopsImpl::getContextArray(llvm::Instruction *Inst,
     }
 
     ContextArrays[varName] = Alloca;
+    if (Sharable)
+      ContextArraySlots.push_back({Alloca, elementType, LiveRegions});
+
+    uint64_t BytesPerWI = Layout.getTypeAllocSize(AllocType);
+    ContextBytesPerWI += BytesPerWI;
+    if (!WGDynamicLocalSize)
+      ContextBytesTotal +=
+          alignTo(BytesPerWI * WGLocalSizeX * WGLocalSizeY * WGLocalSizeZ,
+                  CONTEXT_ARRAY_ALIGN);
     return Alloca;
 }
 
+// Collects the blocks reachable from each of the original parallel regions
+// to be able to figure out the possible execution orders of the regions.
+void WorkitemLoopsImpl::computeRegionReachability(llvm::Function &F) {
+  ReachableBlocks.clear();
+  for (ParallelRegion *Region : OriginalParallelRegions) {
+    std::set<llvm::BasicBlock *> &Reachable = ReachableBlocks[Region];
+    std::vector<llvm::BasicBlock *> WorkList;
+    for (llvm::BasicBlock *BB : *Region)
+      for (llvm::BasicBlock *Succ : successors(BB))
+        WorkList.push_back(Succ);
+    while (!WorkList.empty()) {
+      llvm::BasicBlock *BB = WorkList.back();
+      WorkList.pop_back();
+      if (!Reachable.insert(BB).second)
+        continue;
+      for (llvm::BasicBlock *Succ : successors(BB))
+        WorkList.push_back(Succ);
+    }
+  }
+}
+
+// Returns true in case the region To can be executed after the region From
+// (without an intervening function exit).
+bool WorkitemLoopsImpl::isRegionReachable(ParallelRegion *From,
+                                          ParallelRegion *To) {
+  const std::set<llvm::BasicBlock *> &Reachable = ReachableBlocks[From];
+  for (llvm::BasicBlock *BB : *To)
+    if (Reachable.find(BB) != Reachable.end())
+      return true;
+  return false;
+}
+
+// Computes the set of parallel regions during which the context saved value
+// of Inst must be kept intact: the regions defining and using it, and all the
+// regions that can be executed in between. Returns false in case the value
+// is defined or used outside the parallel regions, in which case its live
+// range cannot be determined this way.
+bool WorkitemLoopsImpl::getLiveRegions(llvm::Instruction *Inst,
+                                       ParallelRegionSet &LiveRegions) {
+  ParallelRegionSet DefRegions, UseRegions;
+  for (ParallelRegion *Region : OriginalParallelRegions) {
+    if (Region->HasBlock(Inst->getParent()))
+      DefRegions.insert(Region);
+  }
+  if (DefRegions.empty())
+    return false;
+
+  for (llvm::User *U : Inst->users()) {
+    llvm::Instruction *UserI = dyn_cast<Instruction>(U);
+    if (UserI == nullptr)
+      return false;
+    // A PHI uses the value at the end of the incoming block, not in the
+    // block of the PHI itself.
+    llvm::SmallVector<llvm::BasicBlock *, 2> UseBlocks;
+    if (PHINode *Phi = dyn_cast<PHINode>(UserI)) {
+      for (unsigned I = 0; I < Phi->getNumIncomingValues(); ++I)
+        if (Phi->getIncomingValue(I) == Inst)
+          UseBlocks.push_back(Phi->getIncomingBlock(I));
+    } else {
+      UseBlocks.push_back(UserI->getParent());
+    }
+    for (llvm::BasicBlock *UseBB : UseBlocks) {
+      bool InRegion = false;
+      for (ParallelRegion *Region : OriginalParallelRegions) {
+        if (Region->HasBlock(UseBB)) {
+          UseRegions.insert(Region);
+          InRegion = true;
+        }
+      }
+      if (!InRegion)
+        return false;
+    }
+  }
+  LiveRegions.insert(DefRegions.begin(), DefRegions.end());
+  LiveRegions.insert(UseRegions.begin(), UseRegions.end());
+
+  for (ParallelRegion *Region : OriginalParallelRegions) {
+    if (LiveRegions.find(Region) != LiveRegions.end())
+      continue;
+    bool AfterDef = false, BeforeUse = false;
+    for (ParallelRegion *Def : DefRegions)
+      AfterDef |= isRegionReachable(Def, Region);
+    for (ParallelRegion *Use : UseRegions)
+      BeforeUse |= isRegionReachable(Region, Use);
+    if (AfterDef && BeforeUse)
+      LiveRegions.insert(Region);
+  }
+  return true;
+}
+
+// Returns a previously created context array with the given element type
+// that has no live values in the given regions, and marks the regions live
+// for it. Returns nullptr if there is no such array.
+llvm::AllocaInst *
+WorkitemLoopsImpl::findSharableContextArray(llvm::Type *ElementType,
+                                            const ParallelRegionSet &Live) {
+  for (ContextArraySlot &Slot : ContextArraySlots) {
+    if (Slot.ElementType != ElementType)
+      continue;
+    bool Overlaps = false;
+    for (ParallelRegion *Region : Live) {
+      if (Slot.LiveRegions.find(Region) != Slot.LiveRegions.end()) {
+        Overlaps = true;
+        break;
+      }
+    }
+    if (Overlaps)
+      continue;
+    Slot.LiveRegions.insert(Live.begin(), Live.end());
+    return Slot.Alloca;
+  }
+  return nullptr;
+}
+
+// Stores the context data footprint of the kernel to the module metadata
+// from where it is picked to the build log.
+void WorkitemLoopsImpl::recordContextFootprint(llvm::Function &F) {
+  llvm::Module *M = F.getParent();
+  std::set<llvm::AllocaInst *> Arrays;
+  for (auto &Entry : ContextArrays)
+    Arrays.insert(Entry.second);
+  setModuleIntMetadata(M, "WGContextValues", NumContextSavedValues);
+  setModuleIntMetadata(M, "WGContextArrays", Arrays.size());
+  setModuleIntMetadata(M, "WGContextBytesPerWI", ContextBytesPerWI);
+  setModuleIntMetadata(M, "WGContextBytes", ContextBytesTotal);
+}
+
 // Adds context save/restore code for the value produced by the
 // given instruction.
 //
@@ -1223,10 +1450,25 @@ void WorkitemLoopsImpl::addContextSaveRestore(llvm::Instruction *Instr) {
 
   //
 
+  // Integer values which are known to fit in a narrower type are stored
+  // to the context array truncated to save stack space and bandwidth.
+  bool NarrowedSigned = false;
+  llvm::IntegerType *NarrowedType = nullptr;
+  if (NarrowContextArrays && !isa<AllocaInst>(Instr))
+    NarrowedType = getNarrowestIntType(Instr, NarrowedSigned);
+
   // Allocate the context data array for the variable.
   bool PoclWrapperStructAdded = false;
-  llvm::AllocaInst *Alloca = getContextArray(Instr, PoclWrapperStructAdded);
-  llvm::Instruction *TheStore = addContextSave(Instr, Alloca);
+  llvm::AllocaInst *Alloca =
+      getContextArray(Instr, PoclWrapperStructAdded, NarrowedType);
+  llvm::Instruction *TheStore = addContextSave(Instr, Alloca, NarrowedType);
+  ++NumContextSavedValues;
+
+  // The truncation of the narrowed value is a user of the instruction
+  // which must not be replaced with a context restore.
+  llvm::Value *TheTrunc = nullptr;
+  if (NarrowedType != nullptr && TheStore != nullptr)
+    TheTrunc = cast<StoreInst>(TheStore)->getValueOperand();
 
   InstructionVec Uses;
   // Restore the produced variable before each use to ensure the correct
@@ -1244,7 +1486,7 @@ void WorkitemLoopsImpl::addContextSaveRestore(llvm::Instruction *Instr) {
   for (Instruction::use_iterator UI = Instr->use_begin(),
          UE = Instr->use_end(); UI != UE; ++UI) {
     llvm::Instruction *User = cast<Instruction>(UI->getUser());
-    if (User == NULL || User == TheStore) continue;
+    if (User == NULL || User == TheStore || User == TheTrunc) continue;
     Uses.push_back(User);
   }
 
@@ -1293,7 +1535,7 @@ void WorkitemLoopsImpl::addContextSaveRestore(llvm::Instruction *Instr) {
     llvm::Value *LoadedValue = addContextRestore(
       UserI, Alloca, Instr->getType(),
       PoclWrapperStructAdded, ContextRestoreLocation,
-      isa<AllocaInst>(Instr));
+      isa<AllocaInst>(Instr), NarrowedType, NarrowedSigned);
     UserI->replaceUsesOfWith(Instr, LoadedValue);
 
 #ifdef DEBUG_WORK_ITEM_LOOPS
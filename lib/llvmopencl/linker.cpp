@@ -27,6 +27,7 @@
    kernel lib which is so big, that it takes seconds to clone it,  even on
    top-of-the line current processors. */
 
+#include <algorithm>
 #include <iostream>
 #include <set>
 
@@ -43,6 +44,7 @@ IGNORE_COMPILER_WARNING("-Wunused-parameter")
 #include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/GlobalValue.h>
+#include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Module.h>
@@ -50,6 +52,7 @@ IGNORE_COMPILER_WARNING("-Wunused-parameter")
 #include <llvm/PassInfo.h>
 #include <llvm/PassRegistry.h>
 #include <llvm/Transforms/IPO/AlwaysInliner.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
 #include <llvm/Transforms/Utils/ValueMapper.h>
 
 #include "pocl_cl.h"
@@ -148,9 +151,34 @@ static void fixCallingConv(llvm::Module *Mod, std::string &Log) {
   }
 }
 
+static const char *VectorVariantsAttr = "vector-function-abi-variant";
+
+static void find_called_functions(llvm::Function *F,
+                                  llvm::StringSet<> &FNameSet);
+
+// The vector variants of a call added by attachVectorMathVariants() are
+// referenced only by name in its attributes; treat them as called so they
+// are kept when the kernel is copied to its own module.
+static void find_vector_variants(llvm::CallInst *CI,
+                                 llvm::StringSet<> &FNameSet) {
+  if (!CI->hasFnAttr(VectorVariantsAttr))
+    return;
+  llvm::Module *M = CI->getModule();
+  SmallVector<StringRef, 4> Variants;
+  CI->getFnAttr(VectorVariantsAttr).getValueAsString().split(Variants, ',');
+  for (StringRef V : Variants) {
+    StringRef Name = V.split('(').second.split(')').first;
+    llvm::Function *VecF = M->getFunction(Name);
+    if (VecF == nullptr || FNameSet.count(Name) > 0)
+      continue;
+    FNameSet.insert(Name);
+    find_called_functions(VecF, FNameSet);
+  }
+}
+
 // Find all functions in the calltree of F, append their
 // name to function name set.
-static inline void
+static void
 find_called_functions(llvm::Function *F,
                       llvm::StringSet<> &FNameSet)
 {
@@ -206,6 +234,7 @@ find_called_functions(llvm::Function *F,
           Callee->setName("__noname_function");
         }
       }
+      find_vector_variants(CI, FNameSet);
       const char* Name = Callee->getName().data();
       DB_PRINT("search: %s calls %s\n",
                F->getName().data(), Name);
@@ -359,6 +388,89 @@ static void shared_copy(llvm::Module *program, const llvm::Module *lib,
     program->eraseNamedMetadata(DebugCU);
 }
 
+// The math builtins whose vector overloads in the kernel library use the
+// SLEEF SIMD functions, and the number of their arguments.
+static const std::pair<const char *, unsigned> VectorMathBuiltins[] = {
+    {"acos", 1},   {"acosh", 1}, {"asin", 1},   {"asinh", 1},
+    {"atan", 1},   {"atan2", 2}, {"atanh", 1},  {"cbrt", 1},
+    {"cos", 1},    {"cosh", 1},  {"cospi", 1},  {"erf", 1},
+    {"erfc", 1},   {"exp", 1},   {"exp10", 1},  {"exp2", 1},
+    {"expm1", 1},  {"fmod", 2},  {"hypot", 2},  {"lgamma", 1},
+    {"log", 1},    {"log10", 1}, {"log1p", 1},  {"pow", 2},
+    {"powr", 2},   {"sin", 1},   {"sinh", 1},   {"sinpi", 1},
+    {"tan", 1},    {"tanh", 1},  {"tgamma", 1}, {"native_cos", 1},
+    {"native_sin", 1}, {"native_tan", 1}};
+
+// Returns the mangled name of the kernel library overload of the builtin
+// taking NumArgs arguments of type Elem ('f' or 'd'), or of Width-wide
+// vectors of it if Width > 1.
+static std::string mangleMathBuiltin(StringRef Builtin, unsigned NumArgs,
+                                     char Elem, unsigned Width) {
+  std::string Name = "_cl_" + Builtin.str();
+  std::string Mangled = "_Z" + std::to_string(Name.size()) + Name;
+  if (Width == 1)
+    return Mangled + std::string(NumArgs, Elem);
+  Mangled += "Dv" + std::to_string(Width) + "_" + Elem;
+  for (unsigned i = 1; i < NumArgs; ++i)
+    Mangled += "S_";
+  return Mangled;
+}
+
+// Maps the calls of the scalar math builtins in the program to the vector
+// overloads of the kernel library for the widths 2 up to FloatWidth or
+// DoubleWidth, so the loop vectorizer can vectorize work-item loops calling
+// them. The calls are kept out of line until then, as the vectorizer sees
+// only the calls, not the inlined bodies; the inline-vector-math pass inlines
+// them after the vectorizer. The names of the used overloads are added to
+// Functions to link them in, and keepVectorMathVariants() keeps them in the
+// kernel module until the vectorizer.
+static void attachVectorMathVariants(llvm::Module *Program,
+                                     const llvm::Module *Lib,
+                                     unsigned FloatWidth,
+                                     unsigned DoubleWidth,
+                                     llvm::StringSet<> &Functions) {
+  for (const auto &B : VectorMathBuiltins) {
+    for (char Elem : {'f', 'd'}) {
+      unsigned MaxWidth = std::min(Elem == 'f' ? FloatWidth : DoubleWidth, 16u);
+      Function *Scalar =
+          Program->getFunction(mangleMathBuiltin(B.first, B.second, Elem, 1));
+      if (Scalar == nullptr || MaxWidth < 2)
+        continue;
+
+      std::string Variants;
+      std::vector<std::string> VecNames;
+      for (unsigned Width = 2; Width <= MaxWidth; Width *= 2) {
+        std::string VecName = mangleMathBuiltin(B.first, B.second, Elem, Width);
+        const Function *VecF = Lib->getFunction(VecName);
+        if (VecF == nullptr || VecF->isDeclaration())
+          continue;
+        if (!Variants.empty())
+          Variants += ",";
+        Variants += "_ZGV_LLVM_N" + std::to_string(Width) +
+                    std::string(B.second, 'v') + "_" + Scalar->getName().str() +
+                    "(" + VecName + ")";
+        VecNames.push_back(VecName);
+      }
+      if (Variants.empty())
+        continue;
+
+      bool Called = false;
+      for (User *U : Scalar->users()) {
+        CallInst *Call = dyn_cast<CallInst>(U);
+        if (Call == nullptr || Call->getCalledFunction() != Scalar)
+          continue;
+        Call->addFnAttr(llvm::Attribute::get(Call->getContext(),
+                                             VectorVariantsAttr, Variants));
+        Call->addFnAttr(Attribute::NoInline);
+        Called = true;
+      }
+      if (Called)
+        for (const std::string &Name : VecNames)
+          Functions.insert(Name);
+    }
+  }
+}
+
 
 
 }
@@ -366,7 +478,8 @@ static void shared_copy(llvm::Module *program, const llvm::Module *lib,
 using namespace pocl;
 
 int link(llvm::Module *Program, const llvm::Module *Lib, std::string &Log,
-         const char **DevAuxFuncs, bool DeviceSidePrintf) {
+         const char **DevAuxFuncs, bool DeviceSidePrintf,
+         unsigned MathVecWidthFloat, unsigned MathVecWidthDouble) {
 
   assert(Program);
   assert(Lib);
@@ -403,6 +516,9 @@ int link(llvm::Module *Program, const llvm::Module *Lib, std::string &Log,
     find_called_functions(&*fi, DeclaredFunctions);
   }
 
+  attachVectorMathVariants(Program, Lib, MathVecWidthFloat, MathVecWidthDouble,
+                           DeclaredFunctions);
+
   // Copy all the globals from lib to program.
   // It probably is faster to just copy them all, than to inspect
   // both program and lib to find which actually are used.
@@ -512,6 +628,47 @@ int link(llvm::Module *Program, const llvm::Module *Lib, std::string &Log,
   return 0;
 }
 
+// Adds the vector overloads the calls in M refer to in their
+// vector-function-abi-variant attributes to llvm.compiler.used. Nothing
+// else refers to them, so once the workgroup pass has made them internal,
+// the optimizations before the loop vectorizer would delete them, and the
+// vectorizer only uses the variants it finds in the module. The
+// inline-vector-math pass removes them from the list again; their names
+// also go to the pocl.vector_math_variants metadata, as the scalar calls may
+// be gone by then if the vectorizer left no remainder loop. This is done on
+// the module of a single kernel rather than when the attributes are
+// attached, as the list of the program module would refer to the overloads
+// of all its kernels.
+static void keepVectorMathVariants(llvm::Module *M) {
+  std::vector<GlobalValue *> Used;
+  llvm::StringSet<> Seen;
+  for (Function &F : *M) {
+    for (Instruction &I : instructions(F)) {
+      CallInst *CI = dyn_cast<CallInst>(&I);
+      if (CI == nullptr || !CI->hasFnAttr(VectorVariantsAttr))
+        continue;
+      SmallVector<StringRef, 4> Variants;
+      CI->getFnAttr(VectorVariantsAttr).getValueAsString().split(Variants,
+                                                                 ',');
+      for (StringRef V : Variants) {
+        StringRef Name = V.split('(').second.split(')').first;
+        Function *VecF = M->getFunction(Name);
+        if (VecF != nullptr && !VecF->isDeclaration() &&
+            Seen.insert(Name).second)
+          Used.push_back(VecF);
+      }
+    }
+  }
+  if (Used.empty())
+    return;
+  appendToCompilerUsed(*M, Used);
+  llvm::NamedMDNode *Names =
+      M->getOrInsertNamedMetadata("pocl.vector_math_variants");
+  for (GlobalValue *GV : Used)
+    Names->addOperand(llvm::MDNode::get(
+        M->getContext(), llvm::MDString::get(M->getContext(), GV->getName())));
+}
+
 int copyKernelFromBitcode(const char* Name, llvm::Module *ParallelBC,
                           const llvm::Module *Program,
                           const char **DevAuxFuncs) {
@@ -544,6 +701,7 @@ int copyKernelFromBitcode(const char* Name, llvm::Module *ParallelBC,
 
   std::string Log;
   shared_copy(ParallelBC, Program, Log, vvm);
+  keepVectorMathVariants(ParallelBC);
 
   if (pocl_get_bool_option("POCL_LLVM_ALWAYS_INLINE", 0)) {
     llvm::Module::iterator MI, ME;
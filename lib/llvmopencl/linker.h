@@ -38,9 +38,14 @@
  * running DCE.
  *
  * log is used to report errors if we run into undefined symbols
+ *
+ * If MathVecWidthFloat/Double > 1, the calls of scalar math builtins are
+ * mapped to their vector overloads up to that width for the loop vectorizer
+ * (vector-function-abi-variant).
  */
 int link(llvm::Module *Program, const llvm::Module *Lib, std::string &Log,
-         const char **DevAuxFuncs, bool DeviceSidePrintf);
+         const char **DevAuxFuncs, bool DeviceSidePrintf,
+         unsigned MathVecWidthFloat = 0, unsigned MathVecWidthDouble = 0);
 
 int copyKernelFromBitcode(const char* Name, llvm::Module *ParallelBC,
                           const llvm::Module *Program,
@@ -0,0 +1,150 @@
+/* Tests async_work_group_(strided_)copy() with data sizes which do not
+   divide evenly to the work-items of the work-group.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+#include "pocl_opencl.h"
+
+// Enable OpenCL C++ exceptions
+#define CL_HPP_ENABLE_EXCEPTIONS
+#define CL_HPP_MINIMUM_OPENCL_VERSION 120
+#define CL_HPP_TARGET_OPENCL_VERSION 120
+#include <CL/opencl.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#define WORK_ITEMS 8
+#define ELEMENTS 101
+
+/* Each work-item reads elements copied by the other work-items to check
+   the copy has completed at wait_group_events(). The data is then written
+   back with every other element of the output skipped. */
+static char
+kernelSourceCode[] =
+"#define ELEMENTS 101\n"
+"kernel \n"
+"void test_kernel(__global const int *input, \n"
+"                 __global int *output) {\n"
+"   __local int data[ELEMENTS];\n"
+"   event_t e = async_work_group_copy(data, input, ELEMENTS, 0);\n"
+"   wait_group_events(1, &e);\n"
+"   int mirrored[ELEMENTS / 8 + 1];\n"
+"   for (size_t i = get_local_id(0), j = 0; i < ELEMENTS;\n"
+"        i += get_local_size(0), ++j)\n"
+"     mirrored[j] = data[ELEMENTS - 1 - i] * 2;\n"
+"   barrier(CLK_LOCAL_MEM_FENCE);\n"
+"   for (size_t i = get_local_id(0), j = 0; i < ELEMENTS;\n"
+"        i += get_local_size(0), ++j)\n"
+"     data[i] = mirrored[j];\n"
+"   barrier(CLK_LOCAL_MEM_FENCE);\n"
+"   e = async_work_group_strided_copy(output, data, ELEMENTS, 2, 0);\n"
+"   wait_group_events(1, &e);\n"
+"}\n";
+
+int
+main(void)
+{
+    int A[ELEMENTS];
+    int R[ELEMENTS * 2];
+
+    for (int i = 0; i < ELEMENTS; i++) {
+        A[i] = i + 1;
+    }
+
+    for (int i = 0; i < ELEMENTS * 2; i++) {
+        R[i] = -1;
+    }
+
+    std::vector<cl::Platform> platformList;
+    bool ok = false;
+    try {
+        cl::Platform::get(&platformList);
+
+        cl_context_properties cprops[] = {
+            CL_CONTEXT_PLATFORM, (cl_context_properties)(platformList[0])(), 0};
+        cl::Context context(CL_DEVICE_TYPE_ALL, cprops);
+
+        std::vector<cl::Device> devices = context.getInfo<CL_CONTEXT_DEVICES>();
+
+        cl::Program::Sources sources({kernelSourceCode});
+        cl::Program program(context, sources);
+
+        program.build(devices);
+
+        cl::Buffer aBuffer = cl::Buffer(
+            context,
+            CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+            ELEMENTS * sizeof(int),
+            (void *) &A[0]);
+
+        cl::Buffer rBuffer = cl::Buffer(
+            context,
+            CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+            ELEMENTS * 2 * sizeof(int),
+            (void *) &R[0]);
+
+        cl::Kernel kernel(program, "test_kernel");
+
+        kernel.setArg(0, aBuffer);
+        kernel.setArg(1, rBuffer);
+
+        cl::CommandQueue queue(context, devices[0], 0);
+
+        queue.enqueueNDRangeKernel(
+            kernel,
+            cl::NullRange,
+            cl::NDRange(WORK_ITEMS),
+            cl::NDRange(WORK_ITEMS));
+
+        queue.enqueueReadBuffer(rBuffer, CL_TRUE, 0,
+                                ELEMENTS * 2 * sizeof(int), (void *) &R[0]);
+
+        ok = true;
+        for (int i = 0; i < ELEMENTS * 2; i++) {
+            int Expected = (i % 2) ? -1 : (ELEMENTS - i / 2) * 2;
+            if (R[i] != Expected) {
+                std::cout
+                    << "F(" << i << ": " << Expected << " != " << R[i]
+                    << ") ";
+                ok = false;
+            }
+        }
+
+        queue.finish();
+    }
+    catch (cl::Error &err) {
+        std::cerr << "ERROR: " << err.what() << "(" << err.err() << ")"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    platformList[0].unloadCompiler();
+
+    if (ok) {
+        std::cout << "OK" << std::endl;
+        return EXIT_SUCCESS;
+    } else {
+        std::cout << "FAIL" << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,149 @@
+/* Tests the context data footprint report of the work-item handlers.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+/* The kernel keeps values live across barriers, so the work-group function
+   needs context arrays. Checks that the results are right and that the
+   footprint the kernel compiler appends to the build log counts at least
+   as many values as there are arrays. One of the values reaches a PHI after
+   the last barrier only through one of its incoming blocks. */
+
+#include "poclu.h"
+#include <CL/cl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WG_SIZE 64
+#define NUM_WGS 4
+#define N (WG_SIZE * NUM_WGS)
+
+const char *source
+    = "__kernel __attribute__((reqd_work_group_size(64, 1, 1)))\n"
+      "void footprint(__global int *data, __local int *tmp)\n"
+      "{\n"
+      "  size_t l = get_local_id(0);\n"
+      "  size_t g = get_global_id(0);\n"
+      "  int a = data[g] * 3;\n"
+      "  tmp[l] = a;\n"
+      "  barrier(CLK_LOCAL_MEM_FENCE);\n"
+      "  int b = tmp[(l + 1) % 64] + a;\n"
+      "  barrier(CLK_LOCAL_MEM_FENCE);\n"
+      "  tmp[l] = b;\n"
+      "  barrier(CLK_LOCAL_MEM_FENCE);\n"
+      "  int c = b;\n"
+      "  if (l & 1)\n"
+      "    c = tmp[(l + 63) % 64];\n"
+      "  data[g] = c + b;\n"
+      "}\n";
+
+int
+main (int argc, char **argv)
+{
+  cl_int err;
+  cl_platform_id platform;
+  cl_device_id device;
+  cl_context context;
+  cl_command_queue queue;
+  cl_program program;
+  cl_kernel kernel;
+  cl_mem buf;
+  int data[N], expected[N];
+
+  err = poclu_get_any_device2 (&context, &device, &queue, &platform);
+  CHECK_OPENCL_ERROR_IN ("poclu_get_any_device");
+
+  program = clCreateProgramWithSource (context, 1, &source, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateProgramWithSource");
+  err = clBuildProgram (program, 1, &device, NULL, NULL, NULL);
+  CHECK_OPENCL_ERROR_IN ("clBuildProgram");
+  kernel = clCreateKernel (program, "footprint", &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateKernel");
+
+  for (int i = 0; i < N; ++i)
+    data[i] = i;
+  for (int w = 0; w < NUM_WGS; ++w)
+    for (int l = 0; l < WG_SIZE; ++l)
+      {
+        int base = w * WG_SIZE;
+        int b = data[base + (l + 1) % WG_SIZE] * 3 + data[base + l] * 3;
+        int b_prev = data[base + (l + WG_SIZE - 1) % WG_SIZE] * 3
+                     + data[base + l] * 3;
+        expected[base + l] = (l & 1) ? b_prev + b : 2 * b;
+      }
+
+  buf = clCreateBuffer (context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                        sizeof (data), data, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 0, sizeof (cl_mem), &buf));
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 1, sizeof (int) * WG_SIZE, NULL));
+
+  size_t global = N, local = WG_SIZE;
+  CHECK_CL_ERROR (clEnqueueNDRangeKernel (queue, kernel, 1, NULL, &global,
+                                          &local, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, buf, CL_TRUE, 0, sizeof (data),
+                                       data, 0, NULL, NULL));
+  for (int i = 0; i < N; ++i)
+    TEST_ASSERT (data[i] == expected[i]);
+
+  /* The work-group function is generated at the first launch, after which
+     the report is in the build log. */
+  size_t log_size = 0;
+  CHECK_CL_ERROR (clGetProgramBuildInfo (program, device, CL_PROGRAM_BUILD_LOG,
+                                         0, NULL, &log_size));
+  char *log = (char *)malloc (log_size + 1);
+  TEST_ASSERT (log != NULL);
+  CHECK_CL_ERROR (clGetProgramBuildInfo (program, device, CL_PROGRAM_BUILD_LOG,
+                                         log_size, log, NULL));
+  log[log_size] = 0;
+
+  const char *report = strstr (log, "kernel 'footprint' (local size 64x1x1): ");
+  if (report == NULL)
+    {
+      /* Devices which do not use the work-item handlers have no report. */
+      printf ("no context footprint report for the device\n");
+    }
+  else
+    {
+      unsigned long arrays = 0, values = 0, bytes_per_wi = 0;
+      report = strchr (report, ':') + 1;
+      TEST_ASSERT (sscanf (report,
+                           " %lu context arrays for %lu values, %lu bytes "
+                           "per work-item",
+                           &arrays, &values, &bytes_per_wi)
+                   == 3);
+      TEST_ASSERT (arrays > 0);
+      TEST_ASSERT (values >= arrays);
+      TEST_ASSERT (bytes_per_wi > 0);
+    }
+  free (log);
+
+  CHECK_CL_ERROR (clReleaseMemObject (buf));
+  CHECK_CL_ERROR (clReleaseKernel (kernel));
+  CHECK_CL_ERROR (clReleaseProgram (program));
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (context));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (platform));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,303 @@
+/* Tests the math builtins with and without -cl-fast-relaxed-math.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+/* Builds the same kernel without options and with -cl-fast-relaxed-math,
+   and checks exp, exp2, exp10, log, log2, log10, sin, cos, tan and powr and
+   their native_ versions against the host math library. The standard
+   builtins must stay within the ulp limits of the OpenCL C specification
+   without the option, and within its relaxed-math limits with it. The
+   native_ ones are always checked against the relaxed-math limits.
+
+   The specification bounds the error of sin and cos only for |x| <= pi in
+   the relaxed mode. Two thirds of their inputs are beyond that, up to 2^17,
+   where the lower precision versions still keep the same 2^-11 absolute
+   error bound, as their single-step reduction by pi/2 is exact there. */
+
+#include "poclu.h"
+#include <CL/cl.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N 12288
+#define NUM_FUNCS 10
+
+const char *source
+    = "__kernel void math(int f, __global const float *x,\n"
+      "                   __global const float *y, __global float *out)\n"
+      "{\n"
+      "  size_t i = get_global_id(0);\n"
+      "  float a = x[i], b = y[i], r;\n"
+      "  switch (f) {\n"
+      "  case 0: r = exp(a); break;\n"
+      "  case 1: r = exp2(a); break;\n"
+      "  case 2: r = exp10(a); break;\n"
+      "  case 3: r = log(a); break;\n"
+      "  case 4: r = log2(a); break;\n"
+      "  case 5: r = log10(a); break;\n"
+      "  case 6: r = sin(a); break;\n"
+      "  case 7: r = cos(a); break;\n"
+      "  case 8: r = tan(a); break;\n"
+      "  case 9: r = powr(a, b); break;\n"
+      "  case 10: r = native_exp(a); break;\n"
+      "  case 11: r = native_exp2(a); break;\n"
+      "  case 12: r = native_exp10(a); break;\n"
+      "  case 13: r = native_log(a); break;\n"
+      "  case 14: r = native_log2(a); break;\n"
+      "  case 15: r = native_log10(a); break;\n"
+      "  case 16: r = native_sin(a); break;\n"
+      "  case 17: r = native_cos(a); break;\n"
+      "  case 18: r = native_tan(a); break;\n"
+      "  default: r = native_powr(a, b); break;\n"
+      "  }\n"
+      "  out[i] = r;\n"
+      "}\n";
+
+enum kind
+{
+  EXPONENTIAL,
+  LOGARITHM,
+  TRIGONOMETRIC,
+  TANGENT,
+  POWER
+};
+
+struct func
+{
+  const char *name;
+  enum kind kind;
+  /* the input range of the exponentials and the ulp limit without
+     -cl-fast-relaxed-math */
+  float min, max;
+  double max_ulps;
+};
+
+static const struct func funcs[NUM_FUNCS] = {
+  { "exp", EXPONENTIAL, -87.0f, 88.0f, 3 },
+  { "exp2", EXPONENTIAL, -126.0f, 127.0f, 3 },
+  { "exp10", EXPONENTIAL, -37.0f, 38.0f, 3 },
+  { "log", LOGARITHM, 0, 0, 3 },
+  { "log2", LOGARITHM, 0, 0, 3 },
+  { "log10", LOGARITHM, 0, 0, 3 },
+  { "sin", TRIGONOMETRIC, 0, 0, 4 },
+  { "cos", TRIGONOMETRIC, 0, 0, 4 },
+  { "tan", TANGENT, 0, 0, 5 },
+  { "powr", POWER, 0, 0, 16 },
+};
+
+static double
+reference (int f, double x, double y)
+{
+  switch (f)
+    {
+    case 0:
+      return exp (x);
+    case 1:
+      return exp2 (x);
+    case 2:
+      return pow (10.0, x);
+    case 3:
+      return log (x);
+    case 4:
+      return log2 (x);
+    case 5:
+      return log10 (x);
+    case 6:
+      return sin (x);
+    case 7:
+      return cos (x);
+    case 8:
+      return tan (x);
+    default:
+      return pow (x, y);
+    }
+}
+
+static void
+make_inputs (const struct func *fn, float *x, float *y)
+{
+  for (int i = 0; i < N; ++i)
+    {
+      double t = (i + 0.5) / N;
+      double u = (i % (N / 3) + 0.5) / (N / 3);
+      y[i] = 0.0f;
+      switch (fn->kind)
+        {
+        case EXPONENTIAL:
+          x[i] = fn->min + (fn->max - fn->min) * t;
+          break;
+        case LOGARITHM:
+          /* half in [0.5, 2], half over the normal range */
+          if (i & 1)
+            x[i] = (float)(0.5 + 1.5 * t);
+          else
+            x[i] = (float)exp2 (-125.0 + 252.0 * t);
+          break;
+        case TRIGONOMETRIC:
+        case TANGENT:
+          /* a third in [-pi, pi], the rest logarithmically spaced in
+             (pi, 2^17) with alternating signs */
+          if (i < N / 3)
+            x[i] = (float)(-M_PI + 2.0 * M_PI * u);
+          else
+            x[i] = (float)((i & 1 ? -1.0 : 1.0) * M_PI
+                           * pow (131072.0 / M_PI, u));
+          break;
+        case POWER:
+          x[i] = (float)(0.5 + 3.5 * t);
+          y[i] = (float)(-4.0 + 8.0 * ((i * 37) % N) / N);
+          break;
+        }
+    }
+}
+
+/* The ulp of ref as a float, at least that of FLT_MIN. */
+static double
+ulp (double ref)
+{
+  return ldexp (1.0, ilogb (fmax (fabs (ref), FLT_MIN)) - 23);
+}
+
+/* Whether got is within the -cl-fast-relaxed-math limits of the
+   specification. */
+static int
+within_relaxed (const struct func *fn, double x, double got, double ref)
+{
+  double err = fabs (got - ref);
+  switch (fn->kind)
+    {
+    case EXPONENTIAL:
+      return err <= (3 + floor (fabs (2.0 * x))) * ulp (ref);
+    case LOGARITHM:
+      if (x >= 0.5 && x <= 2.0)
+        return err <= ldexp (1.0, -21);
+      return err <= 3 * ulp (ref);
+    case TRIGONOMETRIC:
+      return err <= ldexp (1.0, -11);
+    case TANGENT:
+      /* tan may be derived from sin and cos; their error is scaled by the
+         derivative */
+      return err <= ldexp (1.0, -10) * (1.0 + ref * ref);
+    default:
+      return err <= 8192 * ulp (ref);
+    }
+}
+
+static int
+check (cl_command_queue queue, cl_kernel kernel, cl_mem x_buf, cl_mem y_buf,
+       cl_mem out_buf, int relaxed)
+{
+  static float x[N], y[N], out[N];
+  int errors = 0;
+
+  for (int f = 0; f < 2 * NUM_FUNCS; ++f)
+    {
+      const struct func *fn = &funcs[f % NUM_FUNCS];
+      int native = f >= NUM_FUNCS;
+      make_inputs (fn, x, y);
+      CHECK_CL_ERROR (clEnqueueWriteBuffer (queue, x_buf, CL_FALSE, 0,
+                                            sizeof (x), x, 0, NULL, NULL));
+      CHECK_CL_ERROR (clEnqueueWriteBuffer (queue, y_buf, CL_FALSE, 0,
+                                            sizeof (y), y, 0, NULL, NULL));
+      CHECK_CL_ERROR (clSetKernelArg (kernel, 0, sizeof (cl_int), &f));
+      size_t global = N;
+      CHECK_CL_ERROR (clEnqueueNDRangeKernel (queue, kernel, 1, NULL, &global,
+                                              NULL, 0, NULL, NULL));
+      CHECK_CL_ERROR (clEnqueueReadBuffer (queue, out_buf, CL_TRUE, 0,
+                                           sizeof (out), out, 0, NULL, NULL));
+
+      for (int i = 0; i < N; ++i)
+        {
+          double ref = reference (f % NUM_FUNCS, x[i], y[i]);
+          int ok;
+          if (relaxed || native)
+            ok = within_relaxed (fn, x[i], out[i], ref);
+          else
+            ok = fabs (out[i] - ref) <= fn->max_ulps * ulp (ref);
+          if (!ok && errors++ < 10)
+            printf ("%s%s(%a, %a)%s: %a, expected %a\n",
+                    native ? "native_" : "", fn->name, x[i], y[i],
+                    relaxed ? " with -cl-fast-relaxed-math" : "", out[i],
+                    ref);
+        }
+    }
+  return errors;
+}
+
+int
+main (int argc, char **argv)
+{
+  cl_int err;
+  cl_platform_id platform;
+  cl_device_id device;
+  cl_context context;
+  cl_command_queue queue;
+  cl_mem x_buf, y_buf, out_buf;
+  const char *options[2] = { "", "-cl-fast-relaxed-math" };
+
+  err = poclu_get_any_device2 (&context, &device, &queue, &platform);
+  CHECK_OPENCL_ERROR_IN ("poclu_get_any_device");
+
+  x_buf = clCreateBuffer (context, CL_MEM_READ_ONLY, N * sizeof (cl_float),
+                          NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  y_buf = clCreateBuffer (context, CL_MEM_READ_ONLY, N * sizeof (cl_float),
+                          NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  out_buf = clCreateBuffer (context, CL_MEM_WRITE_ONLY,
+                            N * sizeof (cl_float), NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+
+  for (int relaxed = 0; relaxed < 2; ++relaxed)
+    {
+      cl_program program
+          = clCreateProgramWithSource (context, 1, &source, NULL, &err);
+      CHECK_OPENCL_ERROR_IN ("clCreateProgramWithSource");
+      err = clBuildProgram (program, 1, &device, options[relaxed], NULL,
+                            NULL);
+      CHECK_OPENCL_ERROR_IN ("clBuildProgram");
+      cl_kernel kernel = clCreateKernel (program, "math", &err);
+      CHECK_OPENCL_ERROR_IN ("clCreateKernel");
+      CHECK_CL_ERROR (clSetKernelArg (kernel, 1, sizeof (cl_mem), &x_buf));
+      CHECK_CL_ERROR (clSetKernelArg (kernel, 2, sizeof (cl_mem), &y_buf));
+      CHECK_CL_ERROR (clSetKernelArg (kernel, 3, sizeof (cl_mem), &out_buf));
+
+      TEST_ASSERT (check (queue, kernel, x_buf, y_buf, out_buf, relaxed)
+                   == 0);
+
+      CHECK_CL_ERROR (clReleaseKernel (kernel));
+      CHECK_CL_ERROR (clReleaseProgram (program));
+    }
+
+  CHECK_CL_ERROR (clReleaseMemObject (x_buf));
+  CHECK_CL_ERROR (clReleaseMemObject (y_buf));
+  CHECK_CL_ERROR (clReleaseMemObject (out_buf));
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (context));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (platform));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
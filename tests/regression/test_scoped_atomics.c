@@ -0,0 +1,220 @@
+/* Tests the OpenCL 2.0 atomics with work-group and device scopes.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+/* Each work-group updates __local atomics with work_group scope and
+   different orderings: a histogram, a sum, a maximum and a minimum, a bit
+   mask, a sum through a compare-exchange loop and a flag that only one
+   work-item may find clear. It then merges the histogram to a global one
+   with device scope, and all work-items add to a global total with the
+   default seq_cst ordering and device scope. The CPU drivers relax the
+   orderings the scope does not need; the results must not change. */
+
+#include "poclu.h"
+#include <CL/cl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WG_SIZE 64
+#define NUM_WGS 8
+#define N (WG_SIZE * NUM_WGS)
+
+const char *source
+    = "__kernel void scoped(__global const int *in,\n"
+      "                     __global atomic_int *bins,\n"
+      "                     __global atomic_int *total, __global int *out)\n"
+      "{\n"
+      "  __local atomic_int local_bins[16];\n"
+      "  __local atomic_int sum, max, min, bits, cas_sum, firsts;\n"
+      "  __local atomic_flag flag;\n"
+      "  size_t l = get_local_id(0);\n"
+      "  size_t g = get_group_id(0);\n"
+      "  int v = in[get_global_id(0)];\n"
+      "  if (l < 16)\n"
+      "    atomic_store_explicit(&local_bins[l], 0, memory_order_relaxed,\n"
+      "                          memory_scope_work_group);\n"
+      "  if (l == 0) {\n"
+      "    atomic_store_explicit(&sum, 0, memory_order_relaxed,\n"
+      "                          memory_scope_work_group);\n"
+      "    atomic_store_explicit(&max, INT_MIN, memory_order_relaxed,\n"
+      "                          memory_scope_work_group);\n"
+      "    atomic_store_explicit(&min, INT_MAX, memory_order_relaxed,\n"
+      "                          memory_scope_work_group);\n"
+      "    atomic_store_explicit(&bits, 0, memory_order_relaxed,\n"
+      "                          memory_scope_work_group);\n"
+      "    atomic_store_explicit(&cas_sum, 0, memory_order_relaxed,\n"
+      "                          memory_scope_work_group);\n"
+      "    atomic_store_explicit(&firsts, 0, memory_order_relaxed,\n"
+      "                          memory_scope_work_group);\n"
+      "    atomic_flag_clear_explicit(&flag, memory_order_release,\n"
+      "                               memory_scope_work_group);\n"
+      "  }\n"
+      "  barrier(CLK_LOCAL_MEM_FENCE);\n"
+      "  atomic_fetch_add_explicit(&local_bins[v & 15], 1,\n"
+      "                            memory_order_relaxed,\n"
+      "                            memory_scope_work_group);\n"
+      "  atomic_fetch_add_explicit(&sum, v, memory_order_acq_rel,\n"
+      "                            memory_scope_work_group);\n"
+      "  atomic_fetch_max_explicit(&max, v, memory_order_seq_cst,\n"
+      "                            memory_scope_work_group);\n"
+      "  atomic_fetch_min_explicit(&min, v, memory_order_seq_cst,\n"
+      "                            memory_scope_work_group);\n"
+      "  atomic_fetch_or_explicit(&bits, 1 << (v & 31),\n"
+      "                           memory_order_release,\n"
+      "                           memory_scope_work_group);\n"
+      "  int old = atomic_load_explicit(&cas_sum, memory_order_acquire,\n"
+      "                                 memory_scope_work_group);\n"
+      "  while (!atomic_compare_exchange_weak_explicit(\n"
+      "             &cas_sum, &old, old + v, memory_order_acq_rel,\n"
+      "             memory_order_acquire, memory_scope_work_group))\n"
+      "    ;\n"
+      "  if (!atomic_flag_test_and_set_explicit(&flag, memory_order_acq_rel,\n"
+      "                                         memory_scope_work_group))\n"
+      "    atomic_fetch_add_explicit(&firsts, 1, memory_order_relaxed,\n"
+      "                              memory_scope_work_group);\n"
+      "  atomic_fetch_add(total, v);\n"
+      "  barrier(CLK_LOCAL_MEM_FENCE);\n"
+      "  if (l < 16) {\n"
+      "    int n = atomic_load_explicit(&local_bins[l],\n"
+      "                                 memory_order_relaxed,\n"
+      "                                 memory_scope_work_group);\n"
+      "    atomic_fetch_add_explicit(&bins[l], n, memory_order_relaxed,\n"
+      "                              memory_scope_device);\n"
+      "  }\n"
+      "  if (l == 0) {\n"
+      "    out[g * 6] = atomic_load(&sum);\n"
+      "    out[g * 6 + 1] = atomic_load(&max);\n"
+      "    out[g * 6 + 2] = atomic_load(&min);\n"
+      "    out[g * 6 + 3] = atomic_load(&bits);\n"
+      "    out[g * 6 + 4] = atomic_load(&cas_sum);\n"
+      "    out[g * 6 + 5] = atomic_load(&firsts);\n"
+      "  }\n"
+      "}\n";
+
+int
+main (int argc, char **argv)
+{
+  cl_int err;
+  cl_platform_id platform;
+  cl_device_id device;
+  cl_context context;
+  cl_command_queue queue;
+  cl_program program;
+  cl_kernel kernel;
+  cl_mem in_buf, bins_buf, total_buf, out_buf;
+  cl_int in[N], bins[16], total = 0, out[NUM_WGS * 6];
+  cl_int expected_bins[16];
+  char version[64];
+
+  err = poclu_get_any_device2 (&context, &device, &queue, &platform);
+  CHECK_OPENCL_ERROR_IN ("poclu_get_any_device");
+
+  CHECK_CL_ERROR (clGetDeviceInfo (device, CL_DEVICE_OPENCL_C_VERSION,
+                                   sizeof (version), version, NULL));
+  if (strncmp (version, "OpenCL C 1.", 11) == 0)
+    {
+      printf ("SKIP: the atomics need OpenCL C 2.0\n");
+      return 77;
+    }
+
+  program = clCreateProgramWithSource (context, 1, &source, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateProgramWithSource");
+  err = clBuildProgram (program, 1, &device, "-cl-std=CL2.0", NULL, NULL);
+  CHECK_OPENCL_ERROR_IN ("clBuildProgram");
+  kernel = clCreateKernel (program, "scoped", &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateKernel");
+
+  for (int i = 0; i < N; ++i)
+    in[i] = (i * 7919) % 1001 - 500;
+  memset (bins, 0, sizeof (bins));
+
+  in_buf = clCreateBuffer (context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                           sizeof (in), in, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  bins_buf
+      = clCreateBuffer (context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                        sizeof (bins), bins, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  total_buf
+      = clCreateBuffer (context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                        sizeof (total), &total, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  out_buf
+      = clCreateBuffer (context, CL_MEM_WRITE_ONLY, sizeof (out), NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 0, sizeof (cl_mem), &in_buf));
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 1, sizeof (cl_mem), &bins_buf));
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 2, sizeof (cl_mem), &total_buf));
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 3, sizeof (cl_mem), &out_buf));
+
+  size_t global = N, local = WG_SIZE;
+  CHECK_CL_ERROR (clEnqueueNDRangeKernel (queue, kernel, 1, NULL, &global,
+                                          &local, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, bins_buf, CL_TRUE, 0,
+                                       sizeof (bins), bins, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, total_buf, CL_TRUE, 0,
+                                       sizeof (total), &total, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, out_buf, CL_TRUE, 0,
+                                       sizeof (out), out, 0, NULL, NULL));
+
+  memset (expected_bins, 0, sizeof (expected_bins));
+  int expected_total = 0;
+  for (int g = 0; g < NUM_WGS; ++g)
+    {
+      int sum = 0, max = INT_MIN, min = INT_MAX;
+      unsigned bits = 0;
+      for (int l = 0; l < WG_SIZE; ++l)
+        {
+          int v = in[g * WG_SIZE + l];
+          ++expected_bins[v & 15];
+          sum += v;
+          max = v > max ? v : max;
+          min = v < min ? v : min;
+          bits |= 1u << (v & 31);
+        }
+      expected_total += sum;
+      TEST_ASSERT (out[g * 6] == sum);
+      TEST_ASSERT (out[g * 6 + 1] == max);
+      TEST_ASSERT (out[g * 6 + 2] == min);
+      TEST_ASSERT ((unsigned)out[g * 6 + 3] == bits);
+      TEST_ASSERT (out[g * 6 + 4] == sum);
+      TEST_ASSERT (out[g * 6 + 5] == 1);
+    }
+  for (int b = 0; b < 16; ++b)
+    TEST_ASSERT (bins[b] == expected_bins[b]);
+  TEST_ASSERT (total == expected_total);
+
+  CHECK_CL_ERROR (clReleaseMemObject (in_buf));
+  CHECK_CL_ERROR (clReleaseMemObject (bins_buf));
+  CHECK_CL_ERROR (clReleaseMemObject (total_buf));
+  CHECK_CL_ERROR (clReleaseMemObject (out_buf));
+  CHECK_CL_ERROR (clReleaseKernel (kernel));
+  CHECK_CL_ERROR (clReleaseProgram (program));
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (context));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (platform));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
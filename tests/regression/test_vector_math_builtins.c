@@ -0,0 +1,198 @@
+/* Tests the math builtins mapped to their vector overloads.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+/* Run with POCL_VECTORIZE_MATH_BUILTINS=1. The kernel calls math builtins
+   the kernel library implements with SLEEF, so the loop vectorizer turns the
+   work-item loop into calls of their vector overloads. The local size is
+   not a multiple of the vector width, so the remainder iterations call the
+   scalar builtins. Both are inlined after the vectorizer. Checks the
+   results against the host math library, and on CPU devices that the build
+   log reports calls of the vector overloads. */
+
+#include "poclu.h"
+#include <CL/cl.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WG_SIZE 100
+#define NUM_WGS 5
+#define N (WG_SIZE * NUM_WGS)
+#define NUM_FUNCS 6
+
+const char *source
+    = "__kernel void math(__global const float *x, __global const float *y,\n"
+      "                   __global float *out)\n"
+      "{\n"
+      "  size_t i = get_global_id(0);\n"
+      "  size_t n = get_global_size(0);\n"
+      "  out[i] = exp(x[i]);\n"
+      "  out[n + i] = sin(y[i]);\n"
+      "  out[2 * n + i] = pow(x[i] + 4.5f, x[i]);\n"
+      "  out[3 * n + i] = atan2(y[i], x[i]);\n"
+      "  out[4 * n + i] = log(x[i] + 8.0f);\n"
+      "  out[5 * n + i] = cos(y[i]);\n"
+      "}\n";
+
+/* The ulp limits of the builtins in the OpenCL C specification. */
+static const char *names[NUM_FUNCS]
+    = { "exp", "sin", "pow", "atan2", "log", "cos" };
+static const double max_ulps[NUM_FUNCS] = { 3, 4, 16, 6, 3, 4 };
+
+static double
+reference (int f, double x, double y)
+{
+  switch (f)
+    {
+    case 0:
+      return exp (x);
+    case 1:
+      return sin (y);
+    case 2:
+      return pow (x + 4.5, x);
+    case 3:
+      return atan2 (y, x);
+    case 4:
+      return log (x + 8.0);
+    default:
+      return cos (y);
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  cl_int err;
+  cl_platform_id platform;
+  cl_device_id device;
+  cl_context context;
+  cl_command_queue queue;
+  cl_program program;
+  cl_kernel kernel;
+  cl_mem x_buf, y_buf, out_buf;
+  static float x[N], y[N], out[NUM_FUNCS * N];
+
+  /* x in [-4, 4), y in [-20, 20) */
+  for (int i = 0; i < N; ++i)
+    {
+      x[i] = -4.0f + 8.0f * i / N;
+      y[i] = -20.0f + 40.0f * ((i * 37) % N) / N;
+    }
+
+  err = poclu_get_any_device2 (&context, &device, &queue, &platform);
+  CHECK_OPENCL_ERROR_IN ("poclu_get_any_device");
+
+  program = clCreateProgramWithSource (context, 1, &source, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateProgramWithSource");
+  err = clBuildProgram (program, 1, &device, NULL, NULL, NULL);
+  CHECK_OPENCL_ERROR_IN ("clBuildProgram");
+  kernel = clCreateKernel (program, "math", &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateKernel");
+
+  x_buf = clCreateBuffer (context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                          sizeof (x), x, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  y_buf = clCreateBuffer (context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                          sizeof (y), y, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  out_buf = clCreateBuffer (context, CL_MEM_WRITE_ONLY, sizeof (out), NULL,
+                            &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 0, sizeof (cl_mem), &x_buf));
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 1, sizeof (cl_mem), &y_buf));
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 2, sizeof (cl_mem), &out_buf));
+
+  size_t global = N, local = WG_SIZE;
+  CHECK_CL_ERROR (clEnqueueNDRangeKernel (queue, kernel, 1, NULL, &global,
+                                          &local, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, out_buf, CL_TRUE, 0,
+                                       sizeof (out), out, 0, NULL, NULL));
+
+  int errors = 0;
+  for (int f = 0; f < NUM_FUNCS; ++f)
+    for (int i = 0; i < N; ++i)
+      {
+        double ref = reference (f, x[i], y[i]);
+        /* the ulp of ref as a float, at least that of FLT_MIN */
+        double ulp = ldexp (1.0, ilogb (fmax (fabs (ref), FLT_MIN)) - 23);
+        double got = out[f * N + i];
+        if (fabs (got - ref) > max_ulps[f] * ulp)
+          {
+            if (errors++ < 10)
+              printf ("%s(%a, %a): %a, expected %a\n", names[f], x[i], y[i],
+                      got, ref);
+          }
+      }
+  TEST_ASSERT (errors == 0);
+
+  /* The work-group function is generated at the first launch, after which
+     the report is in the build log. The report of the vectorized calls is
+     one of the reports of the kernel. */
+  cl_device_type type;
+  cl_uint float_width;
+  CHECK_CL_ERROR (clGetDeviceInfo (device, CL_DEVICE_TYPE, sizeof (type),
+                                   &type, NULL));
+  CHECK_CL_ERROR (clGetDeviceInfo (device, CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT,
+                                   sizeof (float_width), &float_width, NULL));
+  const char *vectorize = getenv ("POCL_VECTORIZE_MATH_BUILTINS");
+  if ((type & CL_DEVICE_TYPE_CPU) && float_width >= 2 && vectorize != NULL
+      && atoi (vectorize) != 0)
+    {
+      size_t log_size = 0;
+      CHECK_CL_ERROR (clGetProgramBuildInfo (
+          program, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size));
+      char *log = (char *)malloc (log_size + 1);
+      TEST_ASSERT (log != NULL);
+      CHECK_CL_ERROR (clGetProgramBuildInfo (
+          program, device, CL_PROGRAM_BUILD_LOG, log_size, log, NULL));
+      log[log_size] = 0;
+
+      unsigned long calls = 0;
+      for (const char *report = strstr (log, "kernel 'math': ");
+           report != NULL && calls == 0;
+           report = strstr (report + 1, "kernel 'math': "))
+        {
+          int end = 0;
+          int scanned = sscanf (report, "kernel 'math': %lu vector math%n",
+                                &calls, &end);
+          if (scanned != 1 || end == 0)
+            calls = 0;
+        }
+      TEST_ASSERT (calls > 0);
+      free (log);
+    }
+
+  CHECK_CL_ERROR (clReleaseMemObject (x_buf));
+  CHECK_CL_ERROR (clReleaseMemObject (y_buf));
+  CHECK_CL_ERROR (clReleaseMemObject (out_buf));
+  CHECK_CL_ERROR (clReleaseKernel (kernel));
+  CHECK_CL_ERROR (clReleaseProgram (program));
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (context));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (platform));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,310 @@
+/* Tests the work-group vote and reduction functions.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+/* Each work-group votes on a predicate that is set for all, some or none
+   of its work-items, and reduces, scans and broadcasts the local ids. A
+   loop reduces a different value in each iteration, which checks that the
+   work-group shared accumulator the kernel compiler lowers the reductions
+   to is reset between the calls. If the device supports sub-groups, the
+   rows of a 2D work-group, the default sub-groups of the CPU devices,
+   are reduced, scanned and broadcast as well. With the work-item loops,
+   the build log of a CPU device must report the lowered collectives. */
+
+#include "poclu.h"
+#include <CL/cl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WG_SIZE 64
+#define NUM_WGS 3
+#define N (WG_SIZE * NUM_WGS)
+#define SUMS 10
+
+#define SG_SIZE 16
+#define SG_ROWS 4
+#define SG_SUMS 6
+
+const char *source
+    = "__kernel void collectives(__global int *votes, __global int *sums,\n"
+      "                          __global float *fsums)\n"
+      "{\n"
+      "  size_t l = get_local_id(0);\n"
+      "  size_t g = get_group_id(0);\n"
+      "  __global int *s = sums + get_global_id(0) * 10;\n"
+      "  /* group 0: all set, group 1: only work-item 5 set, group 2: none */\n"
+      "  int p = (g == 0) || (g == 1 && l == 5);\n"
+      "  int all = work_group_all(p);\n"
+      "  int any = work_group_any(p);\n"
+      "  int sum = work_group_reduce_add((int)l);\n"
+      "  int max = work_group_reduce_max((int)l);\n"
+      "  int scan = work_group_scan_inclusive_add((int)l);\n"
+      "  votes[get_global_id(0) * 2] = all;\n"
+      "  votes[get_global_id(0) * 2 + 1] = any;\n"
+      "  s[0] = sum;\n"
+      "  s[1] = max;\n"
+      "  s[2] = scan;\n"
+      "  s[3] = work_group_reduce_min((int)l - 10);\n"
+      "  s[4] = work_group_scan_exclusive_add((int)l);\n"
+      "  s[5] = (int)work_group_scan_exclusive_max((uint)(l % 8));\n"
+      "  s[6] = work_group_scan_inclusive_min(100 - (int)l);\n"
+      "  s[7] = (int)work_group_broadcast((long)l * 3, (size_t)7);\n"
+      "  s[8] = (int)work_group_broadcast((ulong)l, g, (size_t)0);\n"
+      "  int acc = 0;\n"
+      "  for (int i = 1; i <= 3; ++i)\n"
+      "    acc += work_group_reduce_add((int)l * i);\n"
+      "  s[9] = acc;\n"
+      "  fsums[get_global_id(0)] = work_group_reduce_add((float)l * 0.5f);\n"
+      "}\n";
+
+const char *sg_source
+    = "#pragma OPENCL EXTENSION cl_khr_subgroups : enable\n"
+      "__kernel void sub_group_collectives(__global int *sums)\n"
+      "{\n"
+      "  int x = get_local_id(0), y = get_local_id(1);\n"
+      "  __global int *s = sums + (y * get_local_size(0) + x) * 6;\n"
+      "  s[0] = sub_group_reduce_add(x + y);\n"
+      "  s[1] = (int)sub_group_reduce_max((uint)(x * y));\n"
+      "  s[2] = sub_group_scan_exclusive_add(x);\n"
+      "  s[3] = sub_group_broadcast(y * 100 + x, 3u);\n"
+      "  s[4] = sub_group_any(x == y);\n"
+      "  s[5] = get_sub_group_size();\n"
+      "}\n";
+
+/* Returns the number of collectives the build log reports lowered for the
+   kernel, or -1 if there is no report. */
+static long
+lowered_collectives (cl_program program, cl_device_id device,
+                     const char *kernel)
+{
+  size_t log_size = 0;
+  if (clGetProgramBuildInfo (program, device, CL_PROGRAM_BUILD_LOG, 0, NULL,
+                             &log_size)
+      != CL_SUCCESS)
+    return -1;
+  char *log = (char *)malloc (log_size + 1);
+  if (log == NULL
+      || clGetProgramBuildInfo (program, device, CL_PROGRAM_BUILD_LOG,
+                                log_size, log, NULL)
+             != CL_SUCCESS)
+    {
+      free (log);
+      return -1;
+    }
+  log[log_size] = 0;
+
+  char prefix[128];
+  snprintf (prefix, sizeof (prefix), "kernel '%s': ", kernel);
+  long calls = -1;
+  for (const char *report = strstr (log, prefix); report != NULL && calls < 0;
+       report = strstr (report + 1, prefix))
+    {
+      unsigned long n = 0;
+      int end = 0;
+      if (sscanf (report + strlen (prefix), "%lu collectives lowered%n", &n,
+                  &end)
+              == 1
+          && end > 0)
+        calls = (long)n;
+    }
+  free (log);
+  return calls;
+}
+
+/* Runs the sub-group kernel on a SG_SIZE x SG_ROWS work-group. The
+   sub-groups are formed of the consecutive linear local ids. */
+static int
+test_sub_groups (cl_context context, cl_device_id device,
+                 cl_command_queue queue)
+{
+  cl_int err;
+  cl_int sums[SG_SIZE * SG_ROWS * SG_SUMS];
+  cl_program program
+      = clCreateProgramWithSource (context, 1, &sg_source, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateProgramWithSource");
+  err = clBuildProgram (program, 1, &device, "-cl-std=CL2.0", NULL, NULL);
+  CHECK_OPENCL_ERROR_IN ("clBuildProgram");
+  cl_kernel kernel = clCreateKernel (program, "sub_group_collectives", &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateKernel");
+
+  cl_mem sums_buf
+      = clCreateBuffer (context, CL_MEM_WRITE_ONLY, sizeof (sums), NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 0, sizeof (cl_mem), &sums_buf));
+
+  size_t size[2] = { SG_SIZE, SG_ROWS };
+  CHECK_CL_ERROR (clEnqueueNDRangeKernel (queue, kernel, 2, NULL, size, size,
+                                          0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, sums_buf, CL_TRUE, 0,
+                                       sizeof (sums), sums, 0, NULL, NULL));
+
+  int sg_size = sums[5];
+  if (sg_size <= 3)
+    printf ("sub-group size %d, skipping the sub-group checks\n", sg_size);
+  for (int i = 0; i < SG_SIZE * SG_ROWS && sg_size > 3; ++i)
+    {
+      int first = i - i % sg_size;
+      int last = first + sg_size;
+      /* the value of the work-item 3 of the sub-group */
+      int third = (first + 3) / SG_SIZE * 100 + (first + 3) % SG_SIZE;
+      int sum = 0, max = 0, scan = 0, any = 0;
+      if (last > SG_SIZE * SG_ROWS)
+        last = SG_SIZE * SG_ROWS;
+      for (int j = first; j < last; ++j)
+        {
+          int x = j % SG_SIZE, y = j / SG_SIZE;
+          sum += x + y;
+          max = x * y > max ? x * y : max;
+          scan += j < i ? x : 0;
+          any |= x == y;
+        }
+      const cl_int *s = sums + i * SG_SUMS;
+      TEST_ASSERT (s[0] == sum);
+      TEST_ASSERT (s[1] == max);
+      TEST_ASSERT (s[2] == scan);
+      TEST_ASSERT (s[3] == third);
+      TEST_ASSERT ((s[4] != 0) == (any != 0));
+      TEST_ASSERT (s[5] == sg_size);
+    }
+
+  cl_device_type type;
+  CHECK_CL_ERROR (clGetDeviceInfo (device, CL_DEVICE_TYPE, sizeof (type),
+                                   &type, NULL));
+  const char *method = getenv ("POCL_WORK_GROUP_METHOD");
+  if ((type & CL_DEVICE_TYPE_CPU) && method != NULL
+      && strcmp (method, "loopvec") == 0)
+    TEST_ASSERT (
+        lowered_collectives (program, device, "sub_group_collectives") == 5);
+
+  CHECK_CL_ERROR (clReleaseMemObject (sums_buf));
+  CHECK_CL_ERROR (clReleaseKernel (kernel));
+  CHECK_CL_ERROR (clReleaseProgram (program));
+  return EXIT_SUCCESS;
+}
+
+int
+main (int argc, char **argv)
+{
+  cl_int err;
+  cl_platform_id platform;
+  cl_device_id device;
+  cl_context context;
+  cl_command_queue queue;
+  cl_program program;
+  cl_kernel kernel;
+  cl_mem votes_buf, sums_buf, fsums_buf;
+  cl_int votes[N * 2], sums[N * SUMS];
+  cl_float fsums[N];
+  char version[64];
+  char extensions[4096];
+
+  err = poclu_get_any_device2 (&context, &device, &queue, &platform);
+  CHECK_OPENCL_ERROR_IN ("poclu_get_any_device");
+
+  CHECK_CL_ERROR (clGetDeviceInfo (device, CL_DEVICE_OPENCL_C_VERSION,
+                                   sizeof (version), version, NULL));
+  if (strncmp (version, "OpenCL C 1.", 11) == 0)
+    {
+      printf ("SKIP: work-group functions need OpenCL C 2.0\n");
+      return 77;
+    }
+
+  program = clCreateProgramWithSource (context, 1, &source, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateProgramWithSource");
+  err = clBuildProgram (program, 1, &device, "-cl-std=CL2.0", NULL, NULL);
+  CHECK_OPENCL_ERROR_IN ("clBuildProgram");
+  kernel = clCreateKernel (program, "collectives", &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateKernel");
+
+  votes_buf = clCreateBuffer (context, CL_MEM_WRITE_ONLY, sizeof (votes),
+                              NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  sums_buf
+      = clCreateBuffer (context, CL_MEM_WRITE_ONLY, sizeof (sums), NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  fsums_buf = clCreateBuffer (context, CL_MEM_WRITE_ONLY, sizeof (fsums),
+                              NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 0, sizeof (cl_mem), &votes_buf));
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 1, sizeof (cl_mem), &sums_buf));
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 2, sizeof (cl_mem), &fsums_buf));
+
+  size_t global = N, local = WG_SIZE;
+  CHECK_CL_ERROR (clEnqueueNDRangeKernel (queue, kernel, 1, NULL, &global,
+                                          &local, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, votes_buf, CL_TRUE, 0,
+                                       sizeof (votes), votes, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, sums_buf, CL_TRUE, 0,
+                                       sizeof (sums), sums, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, fsums_buf, CL_TRUE, 0,
+                                       sizeof (fsums), fsums, 0, NULL, NULL));
+
+  const int sum = WG_SIZE * (WG_SIZE - 1) / 2;
+  for (int i = 0; i < N; ++i)
+    {
+      int g = i / WG_SIZE, l = i % WG_SIZE;
+      const cl_int *s = sums + i * SUMS;
+      TEST_ASSERT ((votes[i * 2] != 0) == (g == 0));
+      TEST_ASSERT ((votes[i * 2 + 1] != 0) == (g != 2));
+      TEST_ASSERT (s[0] == sum);
+      TEST_ASSERT (s[1] == WG_SIZE - 1);
+      TEST_ASSERT (s[2] == l * (l + 1) / 2);
+      TEST_ASSERT (s[3] == -10);
+      TEST_ASSERT (s[4] == l * (l - 1) / 2);
+      TEST_ASSERT (s[5] == (l == 0 ? 0 : (l - 1 < 7 ? l - 1 : 7)));
+      TEST_ASSERT (s[6] == 100 - l);
+      TEST_ASSERT (s[7] == 7 * 3);
+      TEST_ASSERT (s[8] == g);
+      TEST_ASSERT (s[9] == sum * (1 + 2 + 3));
+      /* halves of small integers, exact in any order */
+      TEST_ASSERT (fsums[i] == sum * 0.5f);
+    }
+
+  /* The work-group function is generated at the first launch, after which
+     the report is in the build log. The kernel calls 14 collectives, the
+     one in the loop possibly unrolled. */
+  cl_device_type type;
+  CHECK_CL_ERROR (clGetDeviceInfo (device, CL_DEVICE_TYPE, sizeof (type),
+                                   &type, NULL));
+  const char *method = getenv ("POCL_WORK_GROUP_METHOD");
+  if ((type & CL_DEVICE_TYPE_CPU) && method != NULL
+      && strcmp (method, "loopvec") == 0)
+    TEST_ASSERT (lowered_collectives (program, device, "collectives") >= 14);
+
+  CHECK_CL_ERROR (clGetDeviceInfo (device, CL_DEVICE_EXTENSIONS,
+                                   sizeof (extensions), extensions, NULL));
+  if (strstr (extensions, "cl_khr_subgroups") != NULL)
+    TEST_ASSERT (test_sub_groups (context, device, queue) == EXIT_SUCCESS);
+
+  CHECK_CL_ERROR (clReleaseMemObject (votes_buf));
+  CHECK_CL_ERROR (clReleaseMemObject (sums_buf));
+  CHECK_CL_ERROR (clReleaseMemObject (fsums_buf));
+  CHECK_CL_ERROR (clReleaseKernel (kernel));
+  CHECK_CL_ERROR (clReleaseProgram (program));
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (context));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (platform));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
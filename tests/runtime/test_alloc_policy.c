@@ -0,0 +1,108 @@
+/* Tests the CL_MEM_ALLOC_POLICY_POCL buffer property.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/* Creates buffers with each allocation policy, checks that the property is
+   returned by CL_MEM_PROPERTIES and that the buffers work, and that the
+   invalid uses of the property are rejected. */
+
+#include "pocl_opencl.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* must be sourced from PoCL */
+#include "include/CL/cl_ext_pocl.h"
+
+/* large enough for the policies to apply */
+#define BUFFER_SIZE (4 * 1024 * 1024)
+
+_Static_assert (CL_MEM_ALLOC_POLICY_POCL > CL_POCL_EXPERIMENTAL_ENUM_BASE
+                    && CL_MEM_ALLOC_POLICY_POCL != CL_MEM_DEVICE_PTR_EXT
+                    && CL_MEM_ALLOC_POLICY_POCL != CL_MEM_DEVICE_PTRS_EXT,
+                "CL_MEM_ALLOC_POLICY_POCL is outside pocl's enum block");
+
+int
+main (int argc, char **argv)
+{
+  cl_int err;
+  cl_platform_id pid = NULL;
+  cl_context ctx = NULL;
+  cl_device_id did = NULL;
+  cl_command_queue queue = NULL;
+  const cl_mem_alloc_policy_pocl policies[]
+      = { 0, CL_MEM_ALLOC_HUGE_PAGES_POCL, CL_MEM_ALLOC_PREFAULT_POCL,
+          CL_MEM_ALLOC_HUGE_PAGES_POCL | CL_MEM_ALLOC_PREFAULT_POCL };
+
+  CHECK_CL_ERROR (poclu_get_any_device2 (&ctx, &did, &queue, &pid));
+  cl_int *result = (cl_int *)malloc (BUFFER_SIZE);
+  TEST_ASSERT (result != NULL);
+
+  for (cl_int p = 0; p < (cl_int)(sizeof (policies) / sizeof (policies[0]));
+       ++p)
+    {
+      cl_mem_properties props[] = { CL_MEM_ALLOC_POLICY_POCL, policies[p], 0 };
+      cl_mem_properties ret_props[3] = { 0 };
+      size_t ret_size = 0;
+
+      cl_mem buf = clCreateBufferWithProperties (
+          ctx, props, CL_MEM_READ_WRITE, BUFFER_SIZE, NULL, &err);
+      CHECK_OPENCL_ERROR_IN ("clCreateBufferWithProperties");
+      CHECK_CL_ERROR (clGetMemObjectInfo (buf, CL_MEM_PROPERTIES,
+                                          sizeof (ret_props), ret_props,
+                                          &ret_size));
+      TEST_ASSERT (ret_size == sizeof (props));
+      TEST_ASSERT (ret_props[0] == CL_MEM_ALLOC_POLICY_POCL);
+      TEST_ASSERT (ret_props[1] == policies[p]);
+      TEST_ASSERT (ret_props[2] == 0);
+
+      CHECK_CL_ERROR (clEnqueueFillBuffer (queue, buf, &p, sizeof (p), 0,
+                                           BUFFER_SIZE, 0, NULL, NULL));
+      CHECK_CL_ERROR (clEnqueueReadBuffer (queue, buf, CL_TRUE, 0,
+                                           BUFFER_SIZE, result, 0, NULL,
+                                           NULL));
+      for (size_t i = 0; i < BUFFER_SIZE / sizeof (cl_int); ++i)
+        TEST_ASSERT (result[i] == p);
+      CHECK_CL_ERROR (clReleaseMemObject (buf));
+    }
+
+  cl_mem_properties unknown_flags[]
+      = { CL_MEM_ALLOC_POLICY_POCL, CL_MEM_ALLOC_PREFAULT_POCL << 1, 0 };
+  cl_mem buf = clCreateBufferWithProperties (ctx, unknown_flags,
+                                             CL_MEM_READ_WRITE, BUFFER_SIZE,
+                                             NULL, &err);
+  TEST_ASSERT (buf == NULL && err == CL_INVALID_VALUE);
+
+  cl_mem_properties twice[] = { CL_MEM_ALLOC_POLICY_POCL, 0,
+                                CL_MEM_ALLOC_POLICY_POCL, 0, 0 };
+  buf = clCreateBufferWithProperties (ctx, twice, CL_MEM_READ_WRITE,
+                                      BUFFER_SIZE, NULL, &err);
+  TEST_ASSERT (buf == NULL && err == CL_INVALID_PROPERTY);
+
+  free (result);
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (ctx));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (pid));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
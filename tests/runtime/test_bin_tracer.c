@@ -0,0 +1,150 @@
+/* Tests the binary event tracer with more devices than it has names for.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/* Without arguments, runs commands on more sub-devices than the tracer's
+   device table holds, with POCL_TRACING=bin writing the trace to the file
+   in POCL_TRACING_OPT. With "check <file>", reads that trace back and
+   checks that every command has an event record and that only the devices
+   which fit in the table got a device record, once each. */
+
+#include "pocl_opencl.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* as in pocl_tracing.c */
+#define BIN_TRACER_MAX_DEVICES 64
+#define BIN_RECORD_EVENT 1
+#define BIN_RECORD_DEVICE 2
+
+#define NUM_SUBDEVICES (BIN_TRACER_MAX_DEVICES + 6)
+#define FILLS_PER_DEVICE 2
+
+static int
+run_commands (void)
+{
+  cl_int err;
+  cl_platform_id pid = NULL;
+  cl_context ctx = NULL;
+  cl_device_id did = NULL;
+  cl_command_queue queue = NULL;
+  cl_uint max_cus = 0;
+
+  CHECK_CL_ERROR (poclu_get_any_device2 (&ctx, &did, &queue, &pid));
+  CHECK_CL_ERROR (clGetDeviceInfo (did, CL_DEVICE_PARTITION_MAX_SUB_DEVICES,
+                                   sizeof (max_cus), &max_cus, NULL));
+  if (max_cus < 1)
+    {
+      printf ("the device can not be partitioned, skipping\n");
+      return 77;
+    }
+
+  const cl_device_partition_property props[]
+      = { CL_DEVICE_PARTITION_BY_COUNTS, 1,
+          CL_DEVICE_PARTITION_BY_COUNTS_LIST_END, 0 };
+  for (int i = 0; i < NUM_SUBDEVICES; ++i)
+    {
+      cl_device_id subdev;
+      cl_int pattern = i;
+      CHECK_CL_ERROR (clCreateSubDevices (did, props, 1, &subdev, NULL));
+      cl_context subctx = clCreateContext (NULL, 1, &subdev, NULL, NULL, &err);
+      CHECK_OPENCL_ERROR_IN ("clCreateContext");
+      cl_command_queue subq = clCreateCommandQueue (subctx, subdev, 0, &err);
+      CHECK_OPENCL_ERROR_IN ("clCreateCommandQueue");
+      cl_mem buf = clCreateBuffer (subctx, CL_MEM_READ_WRITE, 4096, NULL,
+                                   &err);
+      CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+      for (int j = 0; j < FILLS_PER_DEVICE; ++j)
+        CHECK_CL_ERROR (clEnqueueFillBuffer (subq, buf, &pattern,
+                                             sizeof (pattern), 0, 4096, 0,
+                                             NULL, NULL));
+      CHECK_CL_ERROR (clFinish (subq));
+      CHECK_CL_ERROR (clReleaseMemObject (buf));
+      CHECK_CL_ERROR (clReleaseCommandQueue (subq));
+      CHECK_CL_ERROR (clReleaseContext (subctx));
+      CHECK_CL_ERROR (clReleaseDevice (subdev));
+    }
+
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (ctx));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (pid));
+  return EXIT_SUCCESS;
+}
+
+static int
+check_trace (const char *path)
+{
+  char magic[8];
+  uint32_t record_size = 0;
+  unsigned num_events = 0, num_devices = 0;
+  uint64_t device_ids[NUM_SUBDEVICES + 1];
+
+  FILE *f = fopen (path, "rb");
+  TEST_ASSERT (f != NULL);
+  TEST_ASSERT (fread (magic, 1, 8, f) == 8);
+  TEST_ASSERT (memcmp (magic, "POCLTRC1", 8) == 0);
+  TEST_ASSERT (fread (&record_size, sizeof (record_size), 1, f) == 1);
+  TEST_ASSERT (record_size >= 5 * sizeof (uint64_t));
+
+  char *record = (char *)malloc (record_size);
+  TEST_ASSERT (record != NULL);
+  while (fread (record, record_size, 1, f) == 1)
+    {
+      uint32_t type;
+      uint64_t device_id;
+      memcpy (&type, record, sizeof (type));
+      /* after type, command_type, event_id and queue_id */
+      memcpy (&device_id, record + 3 * sizeof (uint64_t), sizeof (device_id));
+      if (type == BIN_RECORD_EVENT)
+        ++num_events;
+      else
+        {
+          TEST_ASSERT (type == BIN_RECORD_DEVICE);
+          TEST_ASSERT (num_devices < BIN_TRACER_MAX_DEVICES);
+          for (unsigned i = 0; i < num_devices; ++i)
+            TEST_ASSERT (device_ids[i] != device_id);
+          device_ids[num_devices++] = device_id;
+        }
+    }
+  free (record);
+  fclose (f);
+
+  TEST_ASSERT (num_events == NUM_SUBDEVICES * FILLS_PER_DEVICE);
+  TEST_ASSERT (num_devices == BIN_TRACER_MAX_DEVICES);
+  return EXIT_SUCCESS;
+}
+
+int
+main (int argc, char **argv)
+{
+  int ret;
+  if (argc == 3 && strcmp (argv[1], "check") == 0)
+    ret = check_trace (argv[2]);
+  else
+    ret = run_commands ();
+  if (ret == EXIT_SUCCESS)
+    printf ("OK\n");
+  return ret;
+}
@@ -0,0 +1,263 @@
+/* Test that fusing kernels recorded to a command buffer preserves results
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+/* Records chains of kernels which can (scale + add_offset) and cannot
+ * (scale + neighbor_sum, which reads elements written by other work-items)
+ * be fused. A second command buffer writes and updates two partially
+ * overlapping sub-buffers of one buffer (scale + increment), which must not
+ * be fused either. Run with POCL_KERNEL_FUSION=1 and POCL_DEBUG=general:
+ * the test checks the fusion messages from the output. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "poclu.h"
+
+#define STR(x) #x
+
+#define N 4096
+
+int
+main (int _argc, char **_argv)
+{
+#if defined(cl_khr_command_buffer) && cl_khr_command_buffer == 1
+  struct
+  {
+    clCreateCommandBufferKHR_fn clCreateCommandBufferKHR;
+    clCommandNDRangeKernelKHR_fn clCommandNDRangeKernelKHR;
+    clFinalizeCommandBufferKHR_fn clFinalizeCommandBufferKHR;
+    clEnqueueCommandBufferKHR_fn clEnqueueCommandBufferKHR;
+    clReleaseCommandBufferKHR_fn clReleaseCommandBufferKHR;
+  } ext;
+
+  cl_platform_id platform;
+  CHECK_CL_ERROR (clGetPlatformIDs (1, &platform, NULL));
+  cl_device_id device;
+  CHECK_CL_ERROR (
+      clGetDeviceIDs (platform, CL_DEVICE_TYPE_ALL, 1, &device, NULL));
+
+  ext.clCreateCommandBufferKHR = clGetExtensionFunctionAddressForPlatform (
+      platform, "clCreateCommandBufferKHR");
+  ext.clCommandNDRangeKernelKHR = clGetExtensionFunctionAddressForPlatform (
+      platform, "clCommandNDRangeKernelKHR");
+  ext.clFinalizeCommandBufferKHR = clGetExtensionFunctionAddressForPlatform (
+      platform, "clFinalizeCommandBufferKHR");
+  ext.clEnqueueCommandBufferKHR = clGetExtensionFunctionAddressForPlatform (
+      platform, "clEnqueueCommandBufferKHR");
+  ext.clReleaseCommandBufferKHR = clGetExtensionFunctionAddressForPlatform (
+      platform, "clReleaseCommandBufferKHR");
+
+  cl_int error;
+  cl_context context = clCreateContext (NULL, 1, &device, NULL, NULL, &error);
+  CHECK_CL_ERROR (error);
+
+  const char *code = STR (
+      kernel void scale (global const float *in, global float *out,
+                         float factor) {
+        size_t i = get_global_id (0);
+        out[i] = in[i] * factor;
+      }
+
+      kernel void add_offset (global float *buf, float offset) {
+        size_t i = get_global_id (0);
+        buf[i] = buf[i] + offset;
+      }
+
+      kernel void neighbor_sum (global const float *in, global float *out) {
+        size_t i = get_global_id (0);
+        size_t n = get_global_size (0);
+        out[i] = in[i] + in[(i + 1) % n];
+      }
+
+      kernel void increment (global float *buf) {
+        size_t i = get_global_id (0);
+        buf[i] = buf[i] + 1.0f;
+      });
+  const size_t length = strlen (code);
+
+  cl_program program
+      = clCreateProgramWithSource (context, 1, &code, &length, &error);
+  CHECK_CL_ERROR (error);
+  CHECK_CL_ERROR (clBuildProgram (program, 1, &device, NULL, NULL, NULL));
+  cl_kernel scale = clCreateKernel (program, "scale", &error);
+  CHECK_CL_ERROR (error);
+  cl_kernel add_offset = clCreateKernel (program, "add_offset", &error);
+  CHECK_CL_ERROR (error);
+  cl_kernel neighbor_sum = clCreateKernel (program, "neighbor_sum", &error);
+  CHECK_CL_ERROR (error);
+  cl_kernel increment = clCreateKernel (program, "increment", &error);
+  CHECK_CL_ERROR (error);
+
+  cl_float src[N];
+  for (size_t i = 0; i < N; ++i)
+    src[i] = (cl_float)i;
+
+  cl_mem buf_src
+      = clCreateBuffer (context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                        sizeof (src), src, &error);
+  CHECK_CL_ERROR (error);
+  cl_mem buf_tmp
+      = clCreateBuffer (context, CL_MEM_READ_WRITE, sizeof (src), NULL, &error);
+  CHECK_CL_ERROR (error);
+  cl_mem buf_tmp2
+      = clCreateBuffer (context, CL_MEM_READ_WRITE, sizeof (src), NULL, &error);
+  CHECK_CL_ERROR (error);
+  cl_mem buf_dst
+      = clCreateBuffer (context, CL_MEM_READ_WRITE, sizeof (src), NULL, &error);
+  CHECK_CL_ERROR (error);
+
+  /* Two sub-buffers of N elements, the second starting at the middle of the
+   * first one. */
+  static cl_float zeros[2 * N];
+  cl_mem buf_big
+      = clCreateBuffer (context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                        sizeof (zeros), zeros, &error);
+  CHECK_CL_ERROR (error);
+  cl_buffer_region region = { 0, sizeof (src) };
+  cl_mem buf_sub_a = clCreateSubBuffer (
+      buf_big, 0, CL_BUFFER_CREATE_TYPE_REGION, &region, &error);
+  CHECK_CL_ERROR (error);
+  region.origin = sizeof (src) / 2;
+  cl_mem buf_sub_b = clCreateSubBuffer (
+      buf_big, 0, CL_BUFFER_CREATE_TYPE_REGION, &region, &error);
+  CHECK_CL_ERROR (error);
+
+  cl_command_queue command_queue
+      = clCreateCommandQueue (context, device, 0, &error);
+  CHECK_CL_ERROR (error);
+
+  cl_command_buffer_khr command_buffer
+      = ext.clCreateCommandBufferKHR (1, &command_queue, NULL, &error);
+  CHECK_CL_ERROR (error);
+
+  size_t global = N;
+  size_t local = 64;
+  cl_float factor = 2.0f;
+  cl_float offset = 1.0f;
+
+  /* tmp = src * 2 + 1: fusable */
+  CHECK_CL_ERROR (clSetKernelArg (scale, 0, sizeof (cl_mem), &buf_src));
+  CHECK_CL_ERROR (clSetKernelArg (scale, 1, sizeof (cl_mem), &buf_tmp));
+  CHECK_CL_ERROR (clSetKernelArg (scale, 2, sizeof (cl_float), &factor));
+  CHECK_CL_ERROR (ext.clCommandNDRangeKernelKHR (
+      command_buffer, NULL, NULL, scale, 1, NULL, &global, &local, 0, NULL,
+      NULL, NULL));
+  CHECK_CL_ERROR (clSetKernelArg (add_offset, 0, sizeof (cl_mem), &buf_tmp));
+  CHECK_CL_ERROR (clSetKernelArg (add_offset, 1, sizeof (cl_float), &offset));
+  CHECK_CL_ERROR (ext.clCommandNDRangeKernelKHR (
+      command_buffer, NULL, NULL, add_offset, 1, NULL, &global, &local, 0,
+      NULL, NULL, NULL));
+
+  /* tmp2 = tmp * 2, dst[i] = tmp2[i] + tmp2[i + 1]: not fusable */
+  CHECK_CL_ERROR (clSetKernelArg (scale, 0, sizeof (cl_mem), &buf_tmp));
+  CHECK_CL_ERROR (clSetKernelArg (scale, 1, sizeof (cl_mem), &buf_tmp2));
+  CHECK_CL_ERROR (ext.clCommandNDRangeKernelKHR (
+      command_buffer, NULL, NULL, scale, 1, NULL, &global, &local, 0, NULL,
+      NULL, NULL));
+  CHECK_CL_ERROR (
+      clSetKernelArg (neighbor_sum, 0, sizeof (cl_mem), &buf_tmp2));
+  CHECK_CL_ERROR (clSetKernelArg (neighbor_sum, 1, sizeof (cl_mem), &buf_dst));
+  CHECK_CL_ERROR (ext.clCommandNDRangeKernelKHR (
+      command_buffer, NULL, NULL, neighbor_sum, 1, NULL, &global, &local, 0,
+      NULL, NULL, NULL));
+
+  CHECK_CL_ERROR (ext.clFinalizeCommandBufferKHR (command_buffer));
+
+  /* sub_a = src * 2, sub_b += 1: not fusable, the sub-buffers overlap */
+  cl_command_buffer_khr alias_command_buffer
+      = ext.clCreateCommandBufferKHR (1, &command_queue, NULL, &error);
+  CHECK_CL_ERROR (error);
+  CHECK_CL_ERROR (clSetKernelArg (scale, 0, sizeof (cl_mem), &buf_src));
+  CHECK_CL_ERROR (clSetKernelArg (scale, 1, sizeof (cl_mem), &buf_sub_a));
+  CHECK_CL_ERROR (ext.clCommandNDRangeKernelKHR (
+      alias_command_buffer, NULL, NULL, scale, 1, NULL, &global, &local, 0,
+      NULL, NULL, NULL));
+  CHECK_CL_ERROR (clSetKernelArg (increment, 0, sizeof (cl_mem), &buf_sub_b));
+  CHECK_CL_ERROR (ext.clCommandNDRangeKernelKHR (
+      alias_command_buffer, NULL, NULL, increment, 1, NULL, &global, &local,
+      0, NULL, NULL, NULL));
+  CHECK_CL_ERROR (ext.clFinalizeCommandBufferKHR (alias_command_buffer));
+
+  for (int iter = 0; iter < 3; ++iter)
+    {
+      CHECK_CL_ERROR (ext.clEnqueueCommandBufferKHR (0, NULL, command_buffer,
+                                                     0, NULL, NULL));
+
+      cl_float tmp[N], dst[N];
+      CHECK_CL_ERROR (clEnqueueReadBuffer (command_queue, buf_tmp, CL_TRUE, 0,
+                                           sizeof (tmp), tmp, 0, NULL, NULL));
+      CHECK_CL_ERROR (clEnqueueReadBuffer (command_queue, buf_dst, CL_TRUE, 0,
+                                           sizeof (dst), dst, 0, NULL, NULL));
+      for (size_t i = 0; i < N; ++i)
+        {
+          cl_float t = src[i] * factor + offset;
+          cl_float t_next = src[(i + 1) % N] * factor + offset;
+          TEST_ASSERT (tmp[i] == t);
+          TEST_ASSERT (dst[i] == t * factor + t_next * factor);
+        }
+    }
+
+  for (int iter = 0; iter < 3; ++iter)
+    {
+      CHECK_CL_ERROR (ext.clEnqueueCommandBufferKHR (
+          0, NULL, alias_command_buffer, 0, NULL, NULL));
+
+      static cl_float big[2 * N];
+      CHECK_CL_ERROR (clEnqueueReadBuffer (command_queue, buf_big, CL_TRUE, 0,
+                                           sizeof (big), big, 0, NULL, NULL));
+      for (size_t i = 0; i < N / 2; ++i)
+        TEST_ASSERT (big[i] == src[i] * factor);
+      for (size_t i = N / 2; i < N; ++i)
+        TEST_ASSERT (big[i] == src[i] * factor + 1.0f);
+      for (size_t i = N; i < N + N / 2; ++i)
+        TEST_ASSERT (big[i] == (cl_float)(iter + 1));
+    }
+
+  CHECK_CL_ERROR (ext.clReleaseCommandBufferKHR (command_buffer));
+  CHECK_CL_ERROR (ext.clReleaseCommandBufferKHR (alias_command_buffer));
+  CHECK_CL_ERROR (clReleaseCommandQueue (command_queue));
+
+  CHECK_CL_ERROR (clReleaseMemObject (buf_src));
+  CHECK_CL_ERROR (clReleaseMemObject (buf_tmp));
+  CHECK_CL_ERROR (clReleaseMemObject (buf_tmp2));
+  CHECK_CL_ERROR (clReleaseMemObject (buf_dst));
+  CHECK_CL_ERROR (clReleaseMemObject (buf_sub_a));
+  CHECK_CL_ERROR (clReleaseMemObject (buf_sub_b));
+  CHECK_CL_ERROR (clReleaseMemObject (buf_big));
+
+  CHECK_CL_ERROR (clReleaseKernel (scale));
+  CHECK_CL_ERROR (clReleaseKernel (add_offset));
+  CHECK_CL_ERROR (clReleaseKernel (neighbor_sum));
+  CHECK_CL_ERROR (clReleaseKernel (increment));
+  CHECK_CL_ERROR (clReleaseProgram (program));
+  CHECK_CL_ERROR (clReleaseContext (context));
+
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (platform));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+#else
+  return 77;
+#endif
+}
@@ -0,0 +1,208 @@
+/* Tests the periodic printouts of the command queue profiler.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/* Without arguments, user threads keep completing commands on queues of
+   their own for a bit over a second, which with POCL_TRACING=cq,
+   POCL_CQ_PROFILING_FORMAT=json and POCL_CQ_PROFILING_INTERVAL=1 makes the
+   profiler print while the other threads' commands finish. With
+   "check <file>", checks that each line in the output is a well-formed JSON
+   object and that the counts only grow, and that the final printout counts
+   all the commands. */
+
+#include "pocl_opencl.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NUM_THREADS 3
+#define RUN_SECONDS 1.3
+#define MAX_LINE 65536
+
+static cl_context ctx;
+static cl_device_id did;
+
+static double
+now_seconds (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *
+run_thread (void *arg)
+{
+  cl_int err;
+  cl_int pattern = 0;
+  cl_command_queue queue = clCreateCommandQueue (ctx, did, 0, &err);
+  if (err != CL_SUCCESS)
+    return (void *)1;
+  cl_mem buf = clCreateBuffer (ctx, CL_MEM_READ_WRITE, 4096, NULL, &err);
+  if (err != CL_SUCCESS)
+    return (void *)1;
+
+  double end = now_seconds () + RUN_SECONDS;
+  while (now_seconds () < end)
+    {
+      err |= clEnqueueFillBuffer (queue, buf, &pattern, sizeof (pattern), 0,
+                                  4096, 0, NULL, NULL);
+      err |= clFinish (queue);
+      if (err != CL_SUCCESS)
+        return (void *)1;
+    }
+
+  clReleaseMemObject (buf);
+  clReleaseCommandQueue (queue);
+  return NULL;
+}
+
+static int
+run_commands (void)
+{
+  cl_platform_id pid = NULL;
+  cl_command_queue queue = NULL;
+  pthread_t threads[NUM_THREADS];
+
+  CHECK_CL_ERROR (poclu_get_any_device2 (&ctx, &did, &queue, &pid));
+  for (size_t i = 0; i < NUM_THREADS; ++i)
+    TEST_ASSERT (pthread_create (&threads[i], NULL, run_thread, NULL) == 0);
+  for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+      void *failed = NULL;
+      TEST_ASSERT (pthread_join (threads[i], &failed) == 0);
+      TEST_ASSERT (failed == NULL);
+    }
+
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (ctx));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (pid));
+  return EXIT_SUCCESS;
+}
+
+/* Returns nonzero if the brackets of the line balance outside the strings
+   and the strings only use valid escapes. */
+static int
+well_formed (const char *line)
+{
+  int depth = 0, in_string = 0;
+  for (const char *c = line; *c && *c != '\n'; ++c)
+    {
+      if (in_string)
+        {
+          if ((unsigned char)*c < 0x20)
+            return 0;
+          if (*c == '"')
+            in_string = 0;
+          else if (*c == '\\')
+            {
+              ++c;
+              if (*c == 'u')
+                {
+                  for (int i = 1; i <= 4; ++i)
+                    if (!strchr ("0123456789abcdefABCDEF", c[i]) || !c[i])
+                      return 0;
+                  c += 4;
+                }
+              else if (!*c || !strchr ("\"\\/bfnrt", *c))
+                return 0;
+            }
+          continue;
+        }
+      if (*c == '"')
+        in_string = 1;
+      else if (*c == '{' || *c == '[')
+        ++depth;
+      else if (*c == '}' || *c == ']')
+        {
+          if (--depth < 0)
+            return 0;
+        }
+    }
+  return depth == 0 && !in_string && line[0] == '{';
+}
+
+/* Sums the "count" fields of the entries of the given array. */
+static unsigned long
+sum_counts (const char *line, const char *array)
+{
+  char key[32];
+  unsigned long sum = 0;
+  snprintf (key, sizeof (key), "\"%s\":[", array);
+  const char *p = strstr (line, key);
+  if (p == NULL)
+    return 0;
+  const char *end = strchr (p, ']');
+  while ((p = strstr (p, "\"count\":")) != NULL && p < end)
+    {
+      p += strlen ("\"count\":");
+      sum += strtoul (p, NULL, 10);
+    }
+  return sum;
+}
+
+static int
+check_output (const char *path)
+{
+  static char line[MAX_LINE];
+  unsigned lines = 0;
+  unsigned long prev_time = 0, prev_commands = 0, commands = 0;
+
+  FILE *f = fopen (path, "r");
+  TEST_ASSERT (f != NULL);
+  while (fgets (line, sizeof (line), f) != NULL)
+    {
+      TEST_ASSERT (strchr (line, '\n') != NULL);
+      TEST_ASSERT (well_formed (line));
+      unsigned long time = 0;
+      TEST_ASSERT (sscanf (line, "{\"time_ns\":%lu,", &time) == 1);
+      TEST_ASSERT (time > prev_time);
+      commands = sum_counts (line, "commands");
+      TEST_ASSERT (commands >= prev_commands);
+      TEST_ASSERT (sum_counts (line, "queues") == commands);
+      prev_time = time;
+      prev_commands = commands;
+      ++lines;
+    }
+  fclose (f);
+
+  /* at least one periodic printout and the one at exit */
+  TEST_ASSERT (lines >= 2);
+  TEST_ASSERT (commands > 0);
+  return EXIT_SUCCESS;
+}
+
+int
+main (int argc, char **argv)
+{
+  int ret;
+  if (argc == 3 && strcmp (argv[1], "check") == 0)
+    ret = check_output (argv[2]);
+  else
+    ret = run_commands ();
+  if (ret == EXIT_SUCCESS)
+    printf ("OK\n");
+  return ret;
+}
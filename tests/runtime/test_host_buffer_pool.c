@@ -0,0 +1,84 @@
+/* Tests the reuse of the host memory of released buffers.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/* Creates, uses and releases buffers of a pooled size twice, checking the
+   contents. The CMake tests run this with POCL_DEBUG=memory and check the
+   pool statistics printed when the context is released. With the default
+   32 MiB limit all eight 1 MiB blocks released in the first round are
+   reused in the second. With POCL_HOST_BUFFER_POOL_MB=4 only the last four
+   released in the first round are kept and reused, the older ones are
+   freed to make room for them. */
+
+#include "pocl_opencl.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_BUFFERS 8
+#define BUFFER_SIZE (1024 * 1024)
+
+int
+main (int argc, char **argv)
+{
+  cl_int err;
+  cl_platform_id pid = NULL;
+  cl_context ctx = NULL;
+  cl_device_id did = NULL;
+  cl_command_queue queue = NULL;
+  cl_mem bufs[NUM_BUFFERS];
+
+  CHECK_CL_ERROR (poclu_get_any_device2 (&ctx, &did, &queue, &pid));
+  cl_int *result = (cl_int *)malloc (BUFFER_SIZE);
+  TEST_ASSERT (result != NULL);
+
+  for (cl_int round = 0; round < 2; ++round)
+    {
+      for (cl_int i = 0; i < NUM_BUFFERS; ++i)
+        {
+          cl_int pattern = round * NUM_BUFFERS + i;
+          bufs[i] = clCreateBuffer (ctx, CL_MEM_READ_WRITE, BUFFER_SIZE,
+                                    NULL, &err);
+          CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+          CHECK_CL_ERROR (clEnqueueFillBuffer (queue, bufs[i], &pattern,
+                                               sizeof (pattern), 0,
+                                               BUFFER_SIZE, 0, NULL, NULL));
+        }
+      for (cl_int i = 0; i < NUM_BUFFERS; ++i)
+        {
+          CHECK_CL_ERROR (clEnqueueReadBuffer (queue, bufs[i], CL_TRUE, 0,
+                                               BUFFER_SIZE, result, 0, NULL,
+                                               NULL));
+          for (size_t j = 0; j < BUFFER_SIZE / sizeof (cl_int); ++j)
+            TEST_ASSERT (result[j] == round * NUM_BUFFERS + i);
+          CHECK_CL_ERROR (clReleaseMemObject (bufs[i]));
+        }
+    }
+
+  free (result);
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (ctx));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (pid));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
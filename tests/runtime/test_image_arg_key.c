@@ -0,0 +1,230 @@
+/* Tests work-group functions specialized for image formats and samplers.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+/* Launches the same kernel with images of different formats and with
+   samplers of different addressing modes, in an order where a work-group
+   function specialized for an earlier launch would give wrong results for a
+   later one if the image argument key did not tell them apart. Then
+   launches a kernel with so many image arguments that the key does not fit,
+   which must fall back to the unspecialized work-group function. */
+
+#include "poclu.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_MANY_IMAGES 14
+
+static const char *source
+    = "__kernel void probe (read_only image2d_t img, sampler_t smp, int x,\n"
+      "                     __global int *fmt, __global float4 *px)\n"
+      "{\n"
+      "  fmt[0] = get_image_channel_order (img);\n"
+      "  fmt[1] = get_image_channel_data_type (img);\n"
+      "  px[0] = read_imagef (img, smp, (int2)(x, 0));\n"
+      "}\n"
+      "#define I(n) read_only image2d_t i##n\n"
+      "#define R(n) read_imagef (i##n, s, (int2)(0, 0)).x\n"
+      "__kernel void many (I(0), I(1), I(2), I(3), I(4), I(5), I(6),\n"
+      "                    I(7), I(8), I(9), I(10), I(11), I(12), I(13),\n"
+      "                    sampler_t s, __global float *sum)\n"
+      "{\n"
+      "  sum[0] = R(0) + R(1) + R(2) + R(3) + R(4) + R(5) + R(6)\n"
+      "           + R(7) + R(8) + R(9) + R(10) + R(11) + R(12) + R(13);\n"
+      "}\n";
+
+struct format_case
+{
+  cl_channel_order order;
+  cl_channel_type type;
+  /* Pixel (0, 0); the other pixel is zero. */
+  unsigned char data[16];
+  /* The red channel of pixel (0, 0). */
+  float red;
+};
+
+static const cl_uchar unorm_rgba[4] = { 64, 128, 192, 255 };
+static const cl_uchar unorm_bgra[4] = { 192, 128, 64, 255 };
+static const cl_float float_rgba[4] = { 0.25f, 0.5f, 0.75f, 1.0f };
+static const cl_float float_r[1] = { 0.25f };
+
+int
+main (int argc, char **argv)
+{
+  cl_int err;
+  cl_platform_id platform;
+  cl_device_id device;
+  cl_context context;
+  cl_command_queue queue;
+  cl_bool image_support = CL_FALSE;
+  struct format_case cases[4] = {
+    { CL_RGBA, CL_UNORM_INT8, { 0 }, 64.0f / 255.0f },
+    { CL_BGRA, CL_UNORM_INT8, { 0 }, 64.0f / 255.0f },
+    { CL_RGBA, CL_FLOAT, { 0 }, 0.25f },
+    { CL_R, CL_FLOAT, { 0 }, 0.25f },
+  };
+  memcpy (cases[0].data, unorm_rgba, sizeof (unorm_rgba));
+  memcpy (cases[1].data, unorm_bgra, sizeof (unorm_bgra));
+  memcpy (cases[2].data, float_rgba, sizeof (float_rgba));
+  memcpy (cases[3].data, float_r, sizeof (float_r));
+
+  err = poclu_get_any_device2 (&context, &device, &queue, &platform);
+  CHECK_OPENCL_ERROR_IN ("poclu_get_any_device");
+  CHECK_CL_ERROR (clGetDeviceInfo (device, CL_DEVICE_IMAGE_SUPPORT,
+                                   sizeof (image_support), &image_support,
+                                   NULL));
+  if (!image_support)
+    {
+      printf ("the device does not support images, skipping\n");
+      return 77;
+    }
+
+  cl_program program
+      = clCreateProgramWithSource (context, 1, &source, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateProgramWithSource");
+  CHECK_CL_ERROR (clBuildProgram (program, 1, &device, NULL, NULL, NULL));
+  cl_kernel probe = clCreateKernel (program, "probe", &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateKernel probe");
+  cl_kernel many = clCreateKernel (program, "many", &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateKernel many");
+
+  cl_sampler edge = clCreateSampler (context, CL_FALSE,
+                                     CL_ADDRESS_CLAMP_TO_EDGE,
+                                     CL_FILTER_NEAREST, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateSampler edge");
+  cl_sampler border = clCreateSampler (context, CL_FALSE, CL_ADDRESS_CLAMP,
+                                       CL_FILTER_NEAREST, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateSampler border");
+
+  cl_mem fmt_buf = clCreateBuffer (context, CL_MEM_WRITE_ONLY,
+                                   2 * sizeof (cl_int), NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer fmt");
+  cl_mem px_buf = clCreateBuffer (context, CL_MEM_WRITE_ONLY,
+                                  sizeof (cl_float4), NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer px");
+  CHECK_CL_ERROR (clSetKernelArg (probe, 3, sizeof (cl_mem), &fmt_buf));
+  CHECK_CL_ERROR (clSetKernelArg (probe, 4, sizeof (cl_mem), &px_buf));
+
+  cl_image_desc desc;
+  memset (&desc, 0, sizeof (desc));
+  desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+  desc.image_width = 2;
+  desc.image_height = 1;
+
+  /* Twice over the formats, so that the second round reuses the
+     work-group functions built in the first one. */
+  for (int round = 0; round < 2; ++round)
+    for (unsigned c = 0; c < sizeof (cases) / sizeof (cases[0]); ++c)
+      {
+        cl_image_format format = { cases[c].order, cases[c].type };
+        unsigned char pixels[32];
+        memset (pixels, 0, sizeof (pixels));
+        memcpy (pixels, cases[c].data, sizeof (cases[c].data));
+        cl_mem img = clCreateImage (
+            context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, &format, &desc,
+            pixels, &err);
+        if (err == CL_IMAGE_FORMAT_NOT_SUPPORTED)
+          continue;
+        CHECK_OPENCL_ERROR_IN ("clCreateImage");
+        CHECK_CL_ERROR (clSetKernelArg (probe, 0, sizeof (cl_mem), &img));
+
+        /* Reading left of the image gives pixel (0, 0) with clamp to edge
+           and the border color, whose red channel is 0, with clamp. */
+        for (int s = 0; s < 2; ++s)
+          {
+            cl_sampler smp = s ? border : edge;
+            cl_int x = -1;
+            cl_int fmt[2];
+            cl_float4 px;
+            CHECK_CL_ERROR (
+                clSetKernelArg (probe, 1, sizeof (cl_sampler), &smp));
+            CHECK_CL_ERROR (clSetKernelArg (probe, 2, sizeof (cl_int), &x));
+            size_t global = 1;
+            CHECK_CL_ERROR (clEnqueueNDRangeKernel (
+                queue, probe, 1, NULL, &global, NULL, 0, NULL, NULL));
+            CHECK_CL_ERROR (clEnqueueReadBuffer (queue, fmt_buf, CL_TRUE, 0,
+                                                 sizeof (fmt), fmt, 0, NULL,
+                                                 NULL));
+            CHECK_CL_ERROR (clEnqueueReadBuffer (queue, px_buf, CL_TRUE, 0,
+                                                 sizeof (px), &px, 0, NULL,
+                                                 NULL));
+            TEST_ASSERT ((cl_uint)fmt[0] == cases[c].order);
+            TEST_ASSERT ((cl_uint)fmt[1] == cases[c].type);
+            float expected = s ? 0.0f : cases[c].red;
+            if (fabsf (px.s[0] - expected) > 1e-3f)
+              {
+                printf ("format %04x/%04x, %s: red %f, expected %f\n",
+                        cases[c].order, cases[c].type,
+                        s ? "clamp" : "clamp to edge", px.s[0], expected);
+                return EXIT_FAILURE;
+              }
+          }
+        CHECK_CL_ERROR (clReleaseMemObject (img));
+      }
+
+  /* The key of 'many' does not fit to POCL_IMAGE_ARG_KEY_LENGTH. */
+  cl_image_format format = { CL_RGBA, CL_UNORM_INT8 };
+  cl_uchar pixels[8] = { 64, 128, 192, 255, 0, 0, 0, 0 };
+  cl_mem images[NUM_MANY_IMAGES];
+  for (int i = 0; i < NUM_MANY_IMAGES; ++i)
+    {
+      images[i] = clCreateImage (context,
+                                 CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                 &format, &desc, pixels, &err);
+      CHECK_OPENCL_ERROR_IN ("clCreateImage many");
+      CHECK_CL_ERROR (clSetKernelArg (many, i, sizeof (cl_mem), &images[i]));
+    }
+  cl_mem sum_buf = clCreateBuffer (context, CL_MEM_WRITE_ONLY,
+                                   sizeof (cl_float), NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer sum");
+  CHECK_CL_ERROR (
+      clSetKernelArg (many, NUM_MANY_IMAGES, sizeof (cl_sampler), &edge));
+  CHECK_CL_ERROR (
+      clSetKernelArg (many, NUM_MANY_IMAGES + 1, sizeof (cl_mem), &sum_buf));
+  size_t global = 1;
+  cl_float sum = 0.0f;
+  CHECK_CL_ERROR (clEnqueueNDRangeKernel (queue, many, 1, NULL, &global,
+                                          NULL, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, sum_buf, CL_TRUE, 0,
+                                       sizeof (sum), &sum, 0, NULL, NULL));
+  TEST_ASSERT (fabsf (sum - NUM_MANY_IMAGES * 64.0f / 255.0f) < 1e-3f);
+
+  for (int i = 0; i < NUM_MANY_IMAGES; ++i)
+    CHECK_CL_ERROR (clReleaseMemObject (images[i]));
+  CHECK_CL_ERROR (clReleaseMemObject (sum_buf));
+  CHECK_CL_ERROR (clReleaseMemObject (fmt_buf));
+  CHECK_CL_ERROR (clReleaseMemObject (px_buf));
+  CHECK_CL_ERROR (clReleaseSampler (edge));
+  CHECK_CL_ERROR (clReleaseSampler (border));
+  CHECK_CL_ERROR (clReleaseKernel (probe));
+  CHECK_CL_ERROR (clReleaseKernel (many));
+  CHECK_CL_ERROR (clReleaseProgram (program));
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (context));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (platform));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
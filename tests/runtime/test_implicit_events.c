@@ -0,0 +1,132 @@
+/* Tests commands which complete without an event handle for the user.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/* The commands are enqueued with a NULL event, so pocl creates implicit
+   events for them. Some of them wait on a user event, others are waited on
+   by a barrier, by clFinish() from another thread and by clWaitForEvents()
+   through a later command's event. Checks the results on an in-order and on
+   an out-of-order queue. */
+
+#include "pocl_opencl.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_ITERATIONS 100
+#define NUM_INTS 1024
+
+static void *
+finish_queue (void *arg)
+{
+  cl_command_queue queue = (cl_command_queue)arg;
+  return (void *)(size_t)(clFinish (queue) != CL_SUCCESS);
+}
+
+static int
+run_queue (cl_context ctx, cl_device_id did,
+           cl_command_queue_properties props)
+{
+  cl_int err;
+  cl_int result[NUM_INTS];
+  cl_command_queue queue = clCreateCommandQueue (ctx, did, props, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateCommandQueue");
+  cl_mem src = clCreateBuffer (ctx, CL_MEM_READ_WRITE, sizeof (result), NULL,
+                               &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  cl_mem dst = clCreateBuffer (ctx, CL_MEM_READ_WRITE, sizeof (result), NULL,
+                               &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+
+  for (int i = 0; i < NUM_ITERATIONS; ++i)
+    {
+      cl_int pattern = i;
+      cl_event copied;
+      cl_int status = 0;
+      pthread_t finisher;
+      void *failed = NULL;
+
+      cl_event gate = clCreateUserEvent (ctx, &err);
+      CHECK_OPENCL_ERROR_IN ("clCreateUserEvent");
+      CHECK_CL_ERROR (clEnqueueFillBuffer (queue, src, &pattern,
+                                           sizeof (pattern), 0,
+                                           sizeof (result), 1, &gate, NULL));
+      CHECK_CL_ERROR (clEnqueueBarrierWithWaitList (queue, 0, NULL, NULL));
+      CHECK_CL_ERROR (clEnqueueCopyBuffer (queue, src, dst, 0, 0,
+                                           sizeof (result), 0, NULL,
+                                           &copied));
+      TEST_ASSERT (pthread_create (&finisher, NULL, finish_queue, queue)
+                   == 0);
+
+      CHECK_CL_ERROR (clGetEventInfo (copied,
+                                      CL_EVENT_COMMAND_EXECUTION_STATUS,
+                                      sizeof (cl_int), &status, NULL));
+      TEST_ASSERT (status > CL_COMPLETE);
+
+      CHECK_CL_ERROR (clSetUserEventStatus (gate, CL_COMPLETE));
+      CHECK_CL_ERROR (clWaitForEvents (1, &copied));
+      TEST_ASSERT (pthread_join (finisher, &failed) == 0);
+      TEST_ASSERT (failed == NULL);
+
+      CHECK_CL_ERROR (clEnqueueReadBuffer (queue, dst, CL_TRUE, 0,
+                                           sizeof (result), result, 0, NULL,
+                                           NULL));
+      for (int j = 0; j < NUM_INTS; ++j)
+        TEST_ASSERT (result[j] == pattern);
+      CHECK_CL_ERROR (clReleaseEvent (copied));
+      CHECK_CL_ERROR (clReleaseEvent (gate));
+    }
+
+  CHECK_CL_ERROR (clReleaseMemObject (src));
+  CHECK_CL_ERROR (clReleaseMemObject (dst));
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  return EXIT_SUCCESS;
+}
+
+int
+main (int argc, char **argv)
+{
+  cl_platform_id pid = NULL;
+  cl_context ctx = NULL;
+  cl_device_id did = NULL;
+  cl_command_queue queue = NULL;
+  cl_command_queue_properties props = 0;
+
+  CHECK_CL_ERROR (poclu_get_any_device2 (&ctx, &did, &queue, &pid));
+  TEST_ASSERT (ctx);
+  TEST_ASSERT (did);
+
+  TEST_ASSERT (run_queue (ctx, did, 0) == EXIT_SUCCESS);
+  CHECK_CL_ERROR (clGetDeviceInfo (did, CL_DEVICE_QUEUE_PROPERTIES,
+                                   sizeof (props), &props, NULL));
+  if (props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)
+    TEST_ASSERT (run_queue (ctx, did, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)
+                 == EXIT_SUCCESS);
+
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (ctx));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (pid));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,128 @@
+/* Test blocking waits from several user threads with POCL_CPU_INLINE_EXEC
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/* Each user thread has an in-order queue of its own, on which it enqueues
+   chains of fills and copies ending with a blocking read, clFinish() or
+   clWaitForEvents(). The threads compete for executing their commands
+   inline; the ones which do not get to must fall back to the normal wait.
+   Run with POCL_CPU_INLINE_EXEC=1. */
+
+#include "pocl_opencl.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_THREADS 4
+#define NUM_ITERATIONS 200
+#define NUM_INTS 1024
+
+static cl_context ctx;
+static cl_device_id did;
+
+static void *
+run_thread (void *arg)
+{
+  cl_int err;
+  cl_int base = (cl_int)(size_t)arg * NUM_ITERATIONS;
+  cl_int result[NUM_INTS];
+  cl_command_queue queue = clCreateCommandQueue (ctx, did, 0, &err);
+  if (err != CL_SUCCESS)
+    return (void *)1;
+  cl_mem src = clCreateBuffer (ctx, CL_MEM_READ_WRITE, sizeof (result), NULL,
+                               &err);
+  if (err != CL_SUCCESS)
+    return (void *)1;
+  cl_mem dst = clCreateBuffer (ctx, CL_MEM_READ_WRITE, sizeof (result), NULL,
+                               &err);
+  if (err != CL_SUCCESS)
+    return (void *)1;
+
+  for (int i = 0; i < NUM_ITERATIONS; ++i)
+    {
+      cl_int pattern = base + i;
+      cl_event copied;
+      err |= clEnqueueFillBuffer (queue, src, &pattern, sizeof (pattern), 0,
+                                  sizeof (result), 0, NULL, NULL);
+      err |= clEnqueueCopyBuffer (queue, src, dst, 0, 0, sizeof (result), 0,
+                                  NULL, &copied);
+      switch (i % 3)
+        {
+        case 0:
+          err |= clEnqueueReadBuffer (queue, dst, CL_TRUE, 0, sizeof (result),
+                                      result, 0, NULL, NULL);
+          break;
+        case 1:
+          err |= clWaitForEvents (1, &copied);
+          err |= clEnqueueReadBuffer (queue, dst, CL_FALSE, 0,
+                                      sizeof (result), result, 0, NULL, NULL);
+          err |= clFinish (queue);
+          break;
+        default:
+          err |= clEnqueueReadBuffer (queue, dst, CL_FALSE, 0,
+                                      sizeof (result), result, 0, NULL, NULL);
+          err |= clFinish (queue);
+          break;
+        }
+      err |= clReleaseEvent (copied);
+      if (err != CL_SUCCESS)
+        return (void *)1;
+      for (int j = 0; j < NUM_INTS; ++j)
+        if (result[j] != pattern)
+          return (void *)1;
+    }
+
+  clReleaseMemObject (src);
+  clReleaseMemObject (dst);
+  clReleaseCommandQueue (queue);
+  return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+  cl_platform_id pid = NULL;
+  cl_command_queue queue = NULL;
+  pthread_t threads[NUM_THREADS];
+
+  CHECK_CL_ERROR (poclu_get_any_device2 (&ctx, &did, &queue, &pid));
+  TEST_ASSERT (ctx);
+  TEST_ASSERT (did);
+
+  for (size_t i = 0; i < NUM_THREADS; ++i)
+    TEST_ASSERT (pthread_create (&threads[i], NULL, run_thread, (void *)i)
+                 == 0);
+  for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+      void *failed = NULL;
+      TEST_ASSERT (pthread_join (threads[i], &failed) == 0);
+      TEST_ASSERT (failed == NULL);
+    }
+
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (ctx));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (pid));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+/* Tests the LLVM pass statistics of the kernel compiler.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+/* Run with POCL_LLVM_PASS_STATS=1 and POCL_DEBUG=llvm. Checks that the
+ * per-pass table of the kernel compilation is in the build log after the
+ * first launch. The process totals are printed by clUnloadPlatformCompiler,
+ * which the test output is checked for. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "poclu.h"
+
+#define STR(x) #x
+
+int
+main (int _argc, char **_argv)
+{
+  cl_platform_id platform;
+  cl_device_id device;
+  cl_context context;
+  cl_command_queue queue;
+  cl_int err;
+
+  err = poclu_get_any_device2 (&context, &device, &queue, &platform);
+  CHECK_OPENCL_ERROR_IN ("poclu_get_any_device");
+
+  const char *code = STR (kernel void twice (global int *buf) {
+    size_t i = get_global_id (0);
+    buf[i] = buf[i] * 2;
+  });
+  cl_program program
+      = clCreateProgramWithSource (context, 1, &code, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateProgramWithSource");
+  CHECK_CL_ERROR (clBuildProgram (program, 1, &device, NULL, NULL, NULL));
+  cl_kernel kernel = clCreateKernel (program, "twice", &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateKernel");
+
+  cl_int data[64];
+  for (int i = 0; i < 64; ++i)
+    data[i] = i;
+  cl_mem buf
+      = clCreateBuffer (context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                        sizeof (data), data, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 0, sizeof (cl_mem), &buf));
+  size_t global = 64;
+  CHECK_CL_ERROR (clEnqueueNDRangeKernel (queue, kernel, 1, NULL, &global,
+                                          NULL, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, buf, CL_TRUE, 0, sizeof (data),
+                                       data, 0, NULL, NULL));
+  for (int i = 0; i < 64; ++i)
+    TEST_ASSERT (data[i] == 2 * i);
+
+  size_t log_size = 0;
+  CHECK_CL_ERROR (clGetProgramBuildInfo (program, device, CL_PROGRAM_BUILD_LOG,
+                                         0, NULL, &log_size));
+  char *log = (char *)malloc (log_size + 1);
+  TEST_ASSERT (log != NULL);
+  CHECK_CL_ERROR (clGetProgramBuildInfo (program, device, CL_PROGRAM_BUILD_LOG,
+                                         log_size, log, NULL));
+  log[log_size] = 0;
+  cl_device_type type;
+  CHECK_CL_ERROR (clGetDeviceInfo (device, CL_DEVICE_TYPE, sizeof (type),
+                                   &type, NULL));
+  if (type & CL_DEVICE_TYPE_CPU)
+    TEST_ASSERT (strstr (log, "LLVM pass statistics for '") != NULL);
+  free (log);
+
+  CHECK_CL_ERROR (clReleaseMemObject (buf));
+  CHECK_CL_ERROR (clReleaseKernel (kernel));
+  CHECK_CL_ERROR (clReleaseProgram (program));
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (context));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (platform));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
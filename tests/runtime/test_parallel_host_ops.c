@@ -0,0 +1,217 @@
+/* Tests the buffer and image commands the CPU driver splits to its threads.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+/* Each user thread has an out-of-order queue of its own, on which it
+   enqueues fills, copies, writes and reads of buffers and images large
+   enough for the driver to split them into chunks processed by all of its
+   threads. Several such commands then run at the same time, so the worker
+   threads help with the jobs of each other's commands while the threads
+   that started them wait. Checks the contents after each round. Run with
+   POCL_CPU_MAX_CU_COUNT > 1. */
+
+#include "pocl_opencl.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_THREADS 3
+#define NUM_ROUNDS 8
+#define BUF_INTS (3 << 20)
+#define IMG_WIDTH 1024
+#define IMG_HEIGHT 384
+
+static cl_context ctx;
+static cl_device_id dev;
+static cl_bool image_support;
+
+static int
+run_thread (unsigned id)
+{
+  cl_int err;
+  size_t buf_size = BUF_INTS * sizeof (cl_int);
+  size_t img_size = IMG_WIDTH * IMG_HEIGHT * 4;
+  cl_int *host = (cl_int *)malloc (buf_size);
+  cl_uchar *pixels = (cl_uchar *)malloc (img_size);
+  TEST_ASSERT (host != NULL && pixels != NULL);
+
+  cl_command_queue q = clCreateCommandQueue (
+      ctx, dev, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateCommandQueue");
+  cl_mem a = clCreateBuffer (ctx, CL_MEM_READ_WRITE, buf_size, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  cl_mem b = clCreateBuffer (ctx, CL_MEM_READ_WRITE, buf_size, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+
+  cl_mem img = NULL, img2 = NULL;
+  if (image_support)
+    {
+      cl_image_format format = { CL_RGBA, CL_UNSIGNED_INT8 };
+      cl_image_desc desc;
+      memset (&desc, 0, sizeof (desc));
+      desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+      desc.image_width = IMG_WIDTH;
+      desc.image_height = IMG_HEIGHT;
+      img = clCreateImage (ctx, CL_MEM_READ_WRITE, &format, &desc, NULL,
+                           &err);
+      CHECK_OPENCL_ERROR_IN ("clCreateImage");
+      img2 = clCreateImage (ctx, CL_MEM_READ_WRITE, &format, &desc, NULL,
+                            &err);
+      CHECK_OPENCL_ERROR_IN ("clCreateImage");
+    }
+
+  for (unsigned round = 0; round < NUM_ROUNDS; ++round)
+    {
+      cl_int pattern = (cl_int)(id * 1000 + round);
+      cl_event fill_ev, copy_ev;
+
+      /* fill a, copy its second half over the first half of b, fill the
+         rest of b */
+      CHECK_CL_ERROR (clEnqueueFillBuffer (q, a, &pattern, sizeof (pattern),
+                                           0, buf_size, 0, NULL, &fill_ev));
+      CHECK_CL_ERROR (clEnqueueCopyBuffer (q, a, b, buf_size / 2, 0,
+                                           buf_size / 2, 1, &fill_ev,
+                                           &copy_ev));
+      cl_int other = -pattern;
+      CHECK_CL_ERROR (clEnqueueFillBuffer (q, b, &other, sizeof (other),
+                                           buf_size / 2, buf_size / 2, 0,
+                                           NULL, NULL));
+
+      if (image_support)
+        {
+          size_t origin[3] = { 0, 0, 0 };
+          size_t region[3] = { IMG_WIDTH, IMG_HEIGHT, 1 };
+          cl_uint4 color = { { id, round, 7, 255 } };
+          cl_event img_ev;
+          CHECK_CL_ERROR (clEnqueueFillImage (q, img, &color, origin, region,
+                                              0, NULL, &img_ev));
+          CHECK_CL_ERROR (clEnqueueCopyImage (q, img, img2, origin, origin,
+                                              region, 1, &img_ev, NULL));
+          CHECK_CL_ERROR (clReleaseEvent (img_ev));
+        }
+      CHECK_CL_ERROR (clFinish (q));
+      CHECK_CL_ERROR (clReleaseEvent (fill_ev));
+      CHECK_CL_ERROR (clReleaseEvent (copy_ev));
+
+      CHECK_CL_ERROR (clEnqueueReadBuffer (q, b, CL_TRUE, 0, buf_size, host,
+                                           0, NULL, NULL));
+      for (size_t i = 0; i < BUF_INTS; ++i)
+        if (host[i] != (i < BUF_INTS / 2 ? pattern : other))
+          {
+            printf ("thread %u round %u: int %zu is %d\n", id, round, i,
+                    host[i]);
+            return EXIT_FAILURE;
+          }
+
+      if (image_support)
+        {
+          size_t origin[3] = { 0, 0, 0 };
+          size_t region[3] = { IMG_WIDTH, IMG_HEIGHT, 1 };
+          CHECK_CL_ERROR (clEnqueueReadImage (q, img2, CL_TRUE, origin,
+                                              region, 0, 0, pixels, 0, NULL,
+                                              NULL));
+          for (size_t i = 0; i < IMG_WIDTH * IMG_HEIGHT; ++i)
+            if (pixels[i * 4] != id || pixels[i * 4 + 1] != round
+                || pixels[i * 4 + 2] != 7 || pixels[i * 4 + 3] != 255)
+              {
+                printf ("thread %u round %u: pixel %zu differs\n", id, round,
+                        i);
+                return EXIT_FAILURE;
+              }
+
+          /* write the image from the host and read back a part of it */
+          for (size_t i = 0; i < img_size; ++i)
+            pixels[i] = (cl_uchar)(i * 7 + round + id);
+          CHECK_CL_ERROR (clEnqueueWriteImage (q, img, CL_TRUE, origin,
+                                               region, 0, 0, pixels, 0, NULL,
+                                               NULL));
+          size_t part_origin[3] = { 3, 5, 0 };
+          size_t part_region[3] = { IMG_WIDTH - 3, IMG_HEIGHT - 5, 1 };
+          cl_uchar *part = (cl_uchar *)host;
+          CHECK_CL_ERROR (clEnqueueReadImage (
+              q, img, CL_TRUE, part_origin, part_region, 0, 0, part, 0, NULL,
+              NULL));
+          size_t part_pitch = part_region[0] * 4;
+          for (size_t y = 0; y < part_region[1]; ++y)
+            if (memcmp (part + y * part_pitch,
+                        pixels + (y + 5) * IMG_WIDTH * 4 + 3 * 4, part_pitch)
+                != 0)
+              {
+                printf ("thread %u round %u: image row %zu differs\n", id,
+                        round, y + 5);
+                return EXIT_FAILURE;
+              }
+        }
+    }
+
+  if (image_support)
+    {
+      CHECK_CL_ERROR (clReleaseMemObject (img));
+      CHECK_CL_ERROR (clReleaseMemObject (img2));
+    }
+  CHECK_CL_ERROR (clReleaseMemObject (a));
+  CHECK_CL_ERROR (clReleaseMemObject (b));
+  CHECK_CL_ERROR (clReleaseCommandQueue (q));
+  free (host);
+  free (pixels);
+  return EXIT_SUCCESS;
+}
+
+static void *
+thread_func (void *arg)
+{
+  return (void *)(size_t)run_thread ((unsigned)(size_t)arg);
+}
+
+int
+main (int argc, char **argv)
+{
+  cl_int err;
+  cl_platform_id platform;
+  cl_command_queue queue;
+  pthread_t threads[NUM_THREADS];
+
+  err = poclu_get_any_device2 (&ctx, &dev, &queue, &platform);
+  CHECK_OPENCL_ERROR_IN ("poclu_get_any_device");
+  CHECK_CL_ERROR (clGetDeviceInfo (dev, CL_DEVICE_IMAGE_SUPPORT,
+                                   sizeof (image_support), &image_support,
+                                   NULL));
+
+  for (unsigned i = 0; i < NUM_THREADS; ++i)
+    TEST_ASSERT (pthread_create (&threads[i], NULL, thread_func,
+                                 (void *)(size_t)i)
+                 == 0);
+  for (unsigned i = 0; i < NUM_THREADS; ++i)
+    {
+      void *res = NULL;
+      TEST_ASSERT (pthread_join (threads[i], &res) == 0);
+      TEST_ASSERT (res == (void *)EXIT_SUCCESS);
+    }
+
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (ctx));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+/* Tests the order in which the cpu driver runs the ready commands.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/* Run with a single worker thread (POCL_CPU_MAX_CU_COUNT=1). A native
+   kernel keeps the worker busy while the commands of a low and a high
+   priority queue become ready, and each command records when it ran. By
+   default they run oldest first; with POCL_CPU_PRIORITY_SCHEDULING=1 the
+   command of the high priority queue goes first. */
+
+#include "pocl_opencl.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_LOW 4
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static int blocker_started = 0;
+static int blocker_released = 0;
+static int order[NUM_LOW + 1];
+static int num_ran = 0;
+
+static void
+blocker (void *data)
+{
+  pthread_mutex_lock (&lock);
+  blocker_started = 1;
+  pthread_cond_broadcast (&cond);
+  while (!blocker_released)
+    pthread_cond_wait (&cond, &lock);
+  pthread_mutex_unlock (&lock);
+}
+
+static void
+record (void *data)
+{
+  pthread_mutex_lock (&lock);
+  order[num_ran++] = *(int *)data;
+  pthread_mutex_unlock (&lock);
+}
+
+int
+main (int argc, char **argv)
+{
+  cl_int err;
+  cl_platform_id pid = NULL;
+  cl_context ctx = NULL;
+  cl_device_id did = NULL;
+  cl_command_queue queue = NULL;
+  cl_device_exec_capabilities caps = 0;
+
+  CHECK_CL_ERROR (poclu_get_any_device2 (&ctx, &did, &queue, &pid));
+  TEST_ASSERT (ctx);
+  TEST_ASSERT (did);
+
+  CHECK_CL_ERROR (clGetDeviceInfo (did, CL_DEVICE_EXECUTION_CAPABILITIES,
+                                   sizeof (caps), &caps, NULL));
+  if (!(caps & CL_EXEC_NATIVE_KERNEL))
+    {
+      printf ("native kernels are not supported, skipping\n");
+      return 77;
+    }
+
+  const char *env = getenv ("POCL_CPU_PRIORITY_SCHEDULING");
+  int priority = env != NULL && strcmp (env, "0") != 0;
+
+  cl_queue_properties low_props[]
+      = { CL_QUEUE_PROPERTIES, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE,
+          CL_QUEUE_PRIORITY_KHR, CL_QUEUE_PRIORITY_LOW_KHR, 0 };
+  cl_queue_properties high_props[]
+      = { CL_QUEUE_PRIORITY_KHR, CL_QUEUE_PRIORITY_HIGH_KHR, 0 };
+  cl_command_queue low
+      = clCreateCommandQueueWithProperties (ctx, did, low_props, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateCommandQueueWithProperties");
+  cl_command_queue high
+      = clCreateCommandQueueWithProperties (ctx, did, high_props, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateCommandQueueWithProperties");
+
+  CHECK_CL_ERROR (clEnqueueNativeKernel (queue, blocker, NULL, 0, 0, NULL,
+                                         NULL, 0, NULL, NULL));
+  pthread_mutex_lock (&lock);
+  while (!blocker_started)
+    pthread_cond_wait (&cond, &lock);
+  pthread_mutex_unlock (&lock);
+
+  /* the worker is busy, so these all wait in the driver's queue */
+  for (int i = 0; i < NUM_LOW; ++i)
+    CHECK_CL_ERROR (clEnqueueNativeKernel (low, record, &i, sizeof (i), 0,
+                                           NULL, NULL, 0, NULL, NULL));
+  int high_id = NUM_LOW;
+  CHECK_CL_ERROR (clEnqueueNativeKernel (high, record, &high_id,
+                                         sizeof (high_id), 0, NULL, NULL, 0,
+                                         NULL, NULL));
+  CHECK_CL_ERROR (clFlush (low));
+  CHECK_CL_ERROR (clFlush (high));
+
+  pthread_mutex_lock (&lock);
+  blocker_released = 1;
+  pthread_cond_broadcast (&cond);
+  pthread_mutex_unlock (&lock);
+
+  CHECK_CL_ERROR (clFinish (queue));
+  CHECK_CL_ERROR (clFinish (low));
+  CHECK_CL_ERROR (clFinish (high));
+
+  TEST_ASSERT (num_ran == NUM_LOW + 1);
+  if (priority)
+    TEST_ASSERT (order[0] == high_id);
+  else
+    for (int i = 0; i <= NUM_LOW; ++i)
+      TEST_ASSERT (order[i] == i);
+
+  CHECK_CL_ERROR (clReleaseCommandQueue (low));
+  CHECK_CL_ERROR (clReleaseCommandQueue (high));
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (ctx));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (pid));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,181 @@
+/* Tests the non-temporal stores to large write-only buffer arguments.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+/* Launches three kernels on a buffer twice the size of the last level
+   cache: one writing it contiguously, one writing every other element and
+   one reading and writing it. Only the stores of the first one may become
+   non-temporal. Checks the contents after each kernel, which also checks
+   that the weakly ordered stores are visible once the command completes,
+   and on CPU devices that only the first kernel is reported in the build
+   log as having non-temporal stores. */
+
+#include "poclu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *source
+    = "__kernel void fill (__global float *out, float v)\n"
+      "{\n"
+      "  size_t i = get_global_id (0);\n"
+      "  out[i] = v * (float)(i % 1000);\n"
+      "}\n"
+      "__kernel void strided (__global float *out)\n"
+      "{\n"
+      "  size_t i = get_global_id (0);\n"
+      "  out[2 * i] = 1.0f;\n"
+      "}\n"
+      "__kernel void rmw (__global float *out)\n"
+      "{\n"
+      "  size_t i = get_global_id (0);\n"
+      "  out[i] += 2.0f;\n"
+      "}\n";
+
+/* Whether the build log reports non-temporal stores for the kernel. */
+static int
+reported (const char *log, const char *kernel)
+{
+  char prefix[64];
+  snprintf (prefix, sizeof (prefix), "kernel '%s': ", kernel);
+  for (const char *line = strstr (log, prefix); line != NULL;
+       line = strstr (line + 1, prefix))
+    {
+      const char *end = strchr (line, '\n');
+      const char *found = strstr (line, " non-temporal stores to ");
+      if (found != NULL && (end == NULL || found < end))
+        return 1;
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  cl_int err;
+  cl_platform_id platform;
+  cl_device_id device;
+  cl_context context;
+  cl_command_queue queue;
+  cl_ulong cache_size = 0, max_alloc = 0;
+  cl_device_type type;
+
+  err = poclu_get_any_device2 (&context, &device, &queue, &platform);
+  CHECK_OPENCL_ERROR_IN ("poclu_get_any_device");
+  CHECK_CL_ERROR (clGetDeviceInfo (device, CL_DEVICE_GLOBAL_MEM_CACHE_SIZE,
+                                   sizeof (cache_size), &cache_size, NULL));
+  CHECK_CL_ERROR (clGetDeviceInfo (device, CL_DEVICE_MAX_MEM_ALLOC_SIZE,
+                                   sizeof (max_alloc), &max_alloc, NULL));
+  CHECK_CL_ERROR (clGetDeviceInfo (device, CL_DEVICE_TYPE, sizeof (type),
+                                   &type, NULL));
+
+  size_t size = cache_size > 0 ? 2 * cache_size : (8 << 20);
+  if (size > max_alloc)
+    {
+      printf ("SKIP: a buffer larger than the cache cannot be allocated\n");
+      return 77;
+    }
+  size_t n = size / sizeof (cl_float);
+  float *host = (float *)malloc (size);
+  TEST_ASSERT (host != NULL);
+
+  cl_program program
+      = clCreateProgramWithSource (context, 1, &source, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateProgramWithSource");
+  CHECK_CL_ERROR (clBuildProgram (program, 1, &device, NULL, NULL, NULL));
+  cl_kernel fill = clCreateKernel (program, "fill", &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateKernel fill");
+  cl_kernel strided = clCreateKernel (program, "strided", &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateKernel strided");
+  cl_kernel rmw = clCreateKernel (program, "rmw", &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateKernel rmw");
+
+  cl_mem buf = clCreateBuffer (context, CL_MEM_READ_WRITE, size, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  cl_float v = 3.0f;
+  CHECK_CL_ERROR (clSetKernelArg (fill, 0, sizeof (cl_mem), &buf));
+  CHECK_CL_ERROR (clSetKernelArg (fill, 1, sizeof (cl_float), &v));
+  CHECK_CL_ERROR (clSetKernelArg (strided, 0, sizeof (cl_mem), &buf));
+  CHECK_CL_ERROR (clSetKernelArg (rmw, 0, sizeof (cl_mem), &buf));
+
+  /* fill, then overwrite the even elements, then add to all of them */
+  size_t global = n, half = n / 2;
+  CHECK_CL_ERROR (clEnqueueNDRangeKernel (queue, fill, 1, NULL, &global,
+                                          NULL, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, buf, CL_TRUE, 0, size, host, 0,
+                                       NULL, NULL));
+  for (size_t i = 0; i < n; ++i)
+    if (host[i] != v * (float)(i % 1000))
+      {
+        printf ("fill: element %zu is %f\n", i, host[i]);
+        return EXIT_FAILURE;
+      }
+
+  CHECK_CL_ERROR (clEnqueueNDRangeKernel (queue, strided, 1, NULL, &half,
+                                          NULL, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueNDRangeKernel (queue, rmw, 1, NULL, &global, NULL,
+                                          0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, buf, CL_TRUE, 0, size, host, 0,
+                                       NULL, NULL));
+  for (size_t i = 0; i < n; ++i)
+    {
+      float expected = (i % 2 == 0 ? 1.0f : v * (float)(i % 1000)) + 2.0f;
+      if (host[i] != expected)
+        {
+          printf ("rmw: element %zu is %f, expected %f\n", i, host[i],
+                  expected);
+          return EXIT_FAILURE;
+        }
+    }
+
+  /* The work-group functions are generated at the first launches, after
+     which the reports are in the build log. */
+  if ((type & CL_DEVICE_TYPE_CPU) && cache_size > 0)
+    {
+      size_t log_size = 0;
+      CHECK_CL_ERROR (clGetProgramBuildInfo (
+          program, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size));
+      char *log = (char *)malloc (log_size + 1);
+      TEST_ASSERT (log != NULL);
+      CHECK_CL_ERROR (clGetProgramBuildInfo (
+          program, device, CL_PROGRAM_BUILD_LOG, log_size, log, NULL));
+      log[log_size] = 0;
+      TEST_ASSERT (reported (log, "fill"));
+      TEST_ASSERT (!reported (log, "strided"));
+      TEST_ASSERT (!reported (log, "rmw"));
+      free (log);
+    }
+
+  CHECK_CL_ERROR (clReleaseMemObject (buf));
+  CHECK_CL_ERROR (clReleaseKernel (fill));
+  CHECK_CL_ERROR (clReleaseKernel (strided));
+  CHECK_CL_ERROR (clReleaseKernel (rmw));
+  CHECK_CL_ERROR (clReleaseProgram (program));
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (context));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (platform));
+  free (host);
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,492 @@
+/* Tests the host access paths of the tiled image layout of the CPU devices.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+/* Writes, reads, fills, copies and maps regions of 2D and 3D images whose
+   sizes are not multiples of the tile size, and checks the content against
+   a linear model of each image after every step. Run with
+   POCL_CPU_TILED_IMAGES=1. The images created with CL_MEM_USE_HOST_PTR stay
+   linear, so the copies between them and the other images cross layouts.
+   With the argument "kernel" it instead checks that the image builtins
+   address the tiled pixels where the host side puts them. */
+
+#include "poclu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cl_context context;
+static cl_command_queue queue;
+
+struct test_format
+{
+  cl_image_format format;
+  size_t px;
+  /* The fill color and the pixel it stores. */
+  cl_uint4 color;
+  unsigned char pixel[16];
+};
+
+/* A device image and the linear model of its content. */
+struct image
+{
+  cl_mem mem;
+  unsigned char *ref;
+  size_t size[3];
+  size_t px;
+};
+
+static unsigned seed = 12345;
+
+static unsigned char
+random_byte (void)
+{
+  seed = seed * 1103515245 + 12345;
+  return (unsigned char)(seed >> 16);
+}
+
+static unsigned char *
+ref_pixel (struct image *img, size_t x, size_t y, size_t z)
+{
+  return img->ref
+         + ((z * img->size[1] + y) * img->size[0] + x) * img->px;
+}
+
+static void CL_CALLBACK
+free_host_ptr (cl_mem mem, void *host_ptr)
+{
+  free (host_ptr);
+}
+
+static int
+create_image (struct image *img, const struct test_format *f,
+              const size_t *size, cl_mem_flags flags)
+{
+  cl_int err;
+  cl_image_desc desc;
+  size_t bytes = size[0] * size[1] * size[2] * f->px;
+
+  img->px = f->px;
+  memcpy (img->size, size, sizeof (img->size));
+  img->ref = (unsigned char *)malloc (bytes);
+  TEST_ASSERT (img->ref != NULL);
+  for (size_t i = 0; i < bytes; ++i)
+    img->ref[i] = random_byte ();
+
+  memset (&desc, 0, sizeof (desc));
+  desc.image_type
+      = size[2] > 1 ? CL_MEM_OBJECT_IMAGE3D : CL_MEM_OBJECT_IMAGE2D;
+  desc.image_width = size[0];
+  desc.image_height = size[1];
+  desc.image_depth = size[2] > 1 ? size[2] : 0;
+
+  /* With CL_MEM_USE_HOST_PTR a copy of the model backs the image, so the
+     model is updated only by the test like for the other images. */
+  void *host_ptr = img->ref;
+  if (flags & CL_MEM_USE_HOST_PTR)
+    {
+      host_ptr = malloc (bytes);
+      TEST_ASSERT (host_ptr != NULL);
+      memcpy (host_ptr, img->ref, bytes);
+    }
+  img->mem = clCreateImage (context, flags, &f->format, &desc, host_ptr,
+                            &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateImage");
+  if (flags & CL_MEM_USE_HOST_PTR)
+    CHECK_CL_ERROR (clSetMemObjectDestructorCallback (
+        img->mem, free_host_ptr, host_ptr));
+  return CL_SUCCESS;
+}
+
+static void
+release_image (struct image *img)
+{
+  clReleaseMemObject (img->mem);
+  free (img->ref);
+}
+
+/* Reads back the whole image and compares it with the model. */
+static int
+check_image (struct image *img, const char *step)
+{
+  size_t origin[3] = { 0, 0, 0 };
+  size_t bytes = img->size[0] * img->size[1] * img->size[2] * img->px;
+  unsigned char *data = (unsigned char *)malloc (bytes);
+  TEST_ASSERT (data != NULL);
+  CHECK_CL_ERROR (clEnqueueReadImage (queue, img->mem, CL_TRUE, origin,
+                                      img->size, 0, 0, data, 0, NULL, NULL));
+  for (size_t z = 0; z < img->size[2]; ++z)
+    for (size_t y = 0; y < img->size[1]; ++y)
+      for (size_t x = 0; x < img->size[0]; ++x)
+        {
+          size_t i = ((z * img->size[1] + y) * img->size[0] + x) * img->px;
+          if (memcmp (data + i, img->ref + i, img->px) != 0)
+            {
+              printf ("%s: %zux%zux%zu image differs at (%zu, %zu, %zu)\n",
+                      step, img->size[0], img->size[1], img->size[2], x, y,
+                      z);
+              free (data);
+              return EXIT_FAILURE;
+            }
+        }
+  free (data);
+  return CL_SUCCESS;
+}
+
+#define CHECK_IMAGE(img, step)                                                \
+  do                                                                          \
+    {                                                                         \
+      if (check_image (img, step) != CL_SUCCESS)                              \
+        return EXIT_FAILURE;                                                  \
+    }                                                                         \
+  while (0)
+
+/* A region of the image clipped to its size. */
+static void
+clip_region (const struct image *img, const size_t *origin,
+             const size_t *wanted, size_t *region)
+{
+  for (int i = 0; i < 3; ++i)
+    region[i] = origin[i] + wanted[i] <= img->size[i]
+                    ? wanted[i]
+                    : img->size[i] - origin[i];
+}
+
+static int
+test_images (const struct test_format *f, const size_t *size,
+             const size_t *origin, const size_t *wanted)
+{
+  struct image a, b, lin;
+  size_t zero[3] = { 0, 0, 0 };
+  size_t region[3];
+  size_t px = f->px;
+
+  TEST_ASSERT (create_image (&a, f, size, CL_MEM_READ_WRITE
+                                              | CL_MEM_COPY_HOST_PTR)
+               == CL_SUCCESS);
+  TEST_ASSERT (create_image (&b, f, size, CL_MEM_READ_WRITE
+                                              | CL_MEM_COPY_HOST_PTR)
+               == CL_SUCCESS);
+  TEST_ASSERT (create_image (&lin, f, size, CL_MEM_READ_WRITE
+                                                | CL_MEM_USE_HOST_PTR)
+               == CL_SUCCESS);
+  clip_region (&a, origin, wanted, region);
+  CHECK_IMAGE (&a, "create");
+
+  /* Write a region from host memory with padded pitches. */
+  size_t row_pitch = (region[0] + 3) * px;
+  size_t slice_pitch = row_pitch * (region[1] + 1);
+  unsigned char *host
+      = (unsigned char *)malloc (slice_pitch * region[2]);
+  TEST_ASSERT (host != NULL);
+  for (size_t i = 0; i < slice_pitch * region[2]; ++i)
+    host[i] = random_byte ();
+  CHECK_CL_ERROR (clEnqueueWriteImage (queue, a.mem, CL_TRUE, origin, region,
+                                       row_pitch, slice_pitch, host, 0, NULL,
+                                       NULL));
+  for (size_t z = 0; z < region[2]; ++z)
+    for (size_t y = 0; y < region[1]; ++y)
+      memcpy (ref_pixel (&a, origin[0], origin[1] + y, origin[2] + z),
+              host + z * slice_pitch + y * row_pitch, region[0] * px);
+  CHECK_IMAGE (&a, "write region");
+
+  /* Read the region back with the same padded pitches. */
+  memset (host, 0, slice_pitch * region[2]);
+  CHECK_CL_ERROR (clEnqueueReadImage (queue, a.mem, CL_TRUE, origin, region,
+                                      row_pitch, slice_pitch, host, 0, NULL,
+                                      NULL));
+  for (size_t z = 0; z < region[2]; ++z)
+    for (size_t y = 0; y < region[1]; ++y)
+      TEST_ASSERT (memcmp (ref_pixel (&a, origin[0], origin[1] + y,
+                                      origin[2] + z),
+                           host + z * slice_pitch + y * row_pitch,
+                           region[0] * px)
+                   == 0);
+  free (host);
+
+  /* Fill a region. */
+  CHECK_CL_ERROR (clEnqueueFillImage (queue, b.mem, &f->color, origin,
+                                      region, 0, NULL, NULL));
+  for (size_t z = 0; z < region[2]; ++z)
+    for (size_t y = 0; y < region[1]; ++y)
+      for (size_t x = 0; x < region[0]; ++x)
+        memcpy (ref_pixel (&b, origin[0] + x, origin[1] + y, origin[2] + z),
+                f->pixel, px);
+  CHECK_IMAGE (&b, "fill region");
+
+  /* Copy a region between tiled images, to a different origin. */
+  CHECK_CL_ERROR (clEnqueueCopyImage (queue, a.mem, b.mem, origin, zero,
+                                      region, 0, NULL, NULL));
+  for (size_t z = 0; z < region[2]; ++z)
+    for (size_t y = 0; y < region[1]; ++y)
+      memcpy (ref_pixel (&b, 0, y, z),
+              ref_pixel (&a, origin[0], origin[1] + y, origin[2] + z),
+              region[0] * px);
+  CHECK_IMAGE (&b, "copy tiled to tiled");
+
+  /* Copy from the linear image and back. */
+  CHECK_CL_ERROR (clEnqueueCopyImage (queue, lin.mem, a.mem, zero, origin,
+                                      region, 0, NULL, NULL));
+  for (size_t z = 0; z < region[2]; ++z)
+    for (size_t y = 0; y < region[1]; ++y)
+      memcpy (ref_pixel (&a, origin[0], origin[1] + y, origin[2] + z),
+              ref_pixel (&lin, 0, y, z), region[0] * px);
+  CHECK_IMAGE (&a, "copy linear to tiled");
+  CHECK_CL_ERROR (clEnqueueCopyImage (queue, b.mem, lin.mem, zero, origin,
+                                      region, 0, NULL, NULL));
+  for (size_t z = 0; z < region[2]; ++z)
+    for (size_t y = 0; y < region[1]; ++y)
+      memcpy (ref_pixel (&lin, origin[0], origin[1] + y, origin[2] + z),
+              ref_pixel (&b, 0, y, z), region[0] * px);
+  CHECK_IMAGE (&lin, "copy tiled to linear");
+
+  /* Through a buffer: the region of 'a' to the start of 'b'. */
+  cl_int err;
+  size_t buf_size = region[0] * region[1] * region[2] * px;
+  cl_mem buf = clCreateBuffer (context, CL_MEM_READ_WRITE, buf_size, NULL,
+                               &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+  CHECK_CL_ERROR (clEnqueueCopyImageToBuffer (queue, a.mem, buf, origin,
+                                              region, 0, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueCopyBufferToImage (queue, buf, b.mem, 0, zero,
+                                              region, 0, NULL, NULL));
+  for (size_t z = 0; z < region[2]; ++z)
+    for (size_t y = 0; y < region[1]; ++y)
+      memcpy (ref_pixel (&b, 0, y, z),
+              ref_pixel (&a, origin[0], origin[1] + y, origin[2] + z),
+              region[0] * px);
+  CHECK_IMAGE (&b, "copy through a buffer");
+  CHECK_CL_ERROR (clReleaseMemObject (buf));
+
+  /* Map a region for reading, then for writing. */
+  size_t map_row_pitch = 0, map_slice_pitch = 0;
+  unsigned char *map = (unsigned char *)clEnqueueMapImage (
+      queue, a.mem, CL_TRUE, CL_MAP_READ, origin, region, &map_row_pitch,
+      &map_slice_pitch, 0, NULL, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clEnqueueMapImage read");
+  for (size_t z = 0; z < region[2]; ++z)
+    for (size_t y = 0; y < region[1]; ++y)
+      TEST_ASSERT (memcmp (ref_pixel (&a, origin[0], origin[1] + y,
+                                      origin[2] + z),
+                           map + z * map_slice_pitch + y * map_row_pitch,
+                           region[0] * px)
+                   == 0);
+  CHECK_CL_ERROR (
+      clEnqueueUnmapMemObject (queue, a.mem, map, 0, NULL, NULL));
+
+  map = (unsigned char *)clEnqueueMapImage (
+      queue, a.mem, CL_TRUE, CL_MAP_WRITE, origin, region, &map_row_pitch,
+      &map_slice_pitch, 0, NULL, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clEnqueueMapImage write");
+  for (size_t z = 0; z < region[2]; ++z)
+    for (size_t y = 0; y < region[1]; ++y)
+      for (size_t i = 0; i < region[0] * px; ++i)
+        {
+          unsigned char v = random_byte ();
+          map[z * map_slice_pitch + y * map_row_pitch + i] = v;
+          ref_pixel (&a, origin[0], origin[1] + y, origin[2] + z)[i] = v;
+        }
+  CHECK_CL_ERROR (
+      clEnqueueUnmapMemObject (queue, a.mem, map, 0, NULL, NULL));
+  CHECK_CL_ERROR (clFinish (queue));
+  CHECK_IMAGE (&a, "map for writing");
+
+  release_image (&a);
+  release_image (&b);
+  release_image (&lin);
+  return CL_SUCCESS;
+}
+
+static const char *kernel_source
+    = "__kernel void copy2d (read_only image2d_t src, write_only image2d_t "
+      "dst,\n"
+      "                      __global uint4 *out, __global const uint4 *in)\n"
+      "{\n"
+      "  int2 c = (int2)(get_global_id (0), get_global_id (1));\n"
+      "  size_t i = c.y * get_global_size (0) + c.x;\n"
+      "  out[i] = read_imageui (src, c);\n"
+      "  write_imageui (dst, c, in[i]);\n"
+      "}\n"
+      "#pragma OPENCL EXTENSION cl_khr_3d_image_writes : enable\n"
+      "__kernel void copy3d (read_only image3d_t src, write_only image3d_t "
+      "dst,\n"
+      "                      __global uint4 *out, __global const uint4 *in)\n"
+      "{\n"
+      "  int4 c = (int4)(get_global_id (0), get_global_id (1),\n"
+      "                  get_global_id (2), 0);\n"
+      "  size_t i = (c.z * get_global_size (1) + c.y) * get_global_size (0)\n"
+      "             + c.x;\n"
+      "  out[i] = read_imageui (src, c);\n"
+      "  write_imageui (dst, c, in[i]);\n"
+      "}\n";
+
+/* Reads every pixel of a tiled image and writes every pixel of another one
+   in a kernel, and compares them with the linear host view. */
+static int
+test_kernel_access (cl_device_id device, const struct test_format *f,
+                    const size_t *size)
+{
+  cl_int err;
+  struct image src, dst;
+  size_t num_pixels = size[0] * size[1] * size[2];
+  int is_3d = size[2] > 1;
+
+  cl_program program
+      = clCreateProgramWithSource (context, 1, &kernel_source, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateProgramWithSource");
+  CHECK_CL_ERROR (clBuildProgram (program, 1, &device, NULL, NULL, NULL));
+  cl_kernel kernel
+      = clCreateKernel (program, is_3d ? "copy3d" : "copy2d", &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateKernel");
+
+  TEST_ASSERT (create_image (&src, f, size, CL_MEM_READ_ONLY
+                                                | CL_MEM_COPY_HOST_PTR)
+               == CL_SUCCESS);
+  TEST_ASSERT (create_image (&dst, f, size, CL_MEM_WRITE_ONLY
+                                                | CL_MEM_COPY_HOST_PTR)
+               == CL_SUCCESS);
+
+  cl_uint4 *in = (cl_uint4 *)malloc (num_pixels * sizeof (cl_uint4));
+  cl_uint4 *out = (cl_uint4 *)malloc (num_pixels * sizeof (cl_uint4));
+  TEST_ASSERT (in != NULL && out != NULL);
+  for (size_t i = 0; i < num_pixels; ++i)
+    for (int c = 0; c < 4; ++c)
+      {
+        in[i].s[c] = random_byte ();
+        dst.ref[i * 4 + c] = (unsigned char)in[i].s[c];
+      }
+  cl_mem out_buf = clCreateBuffer (context, CL_MEM_WRITE_ONLY,
+                                   num_pixels * sizeof (cl_uint4), NULL,
+                                   &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer out");
+  cl_mem in_buf = clCreateBuffer (context,
+                                  CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                  num_pixels * sizeof (cl_uint4), in, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer in");
+
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 0, sizeof (cl_mem), &src.mem));
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 1, sizeof (cl_mem), &dst.mem));
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 2, sizeof (cl_mem), &out_buf));
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 3, sizeof (cl_mem), &in_buf));
+  CHECK_CL_ERROR (clEnqueueNDRangeKernel (queue, kernel, is_3d ? 3 : 2,
+                                          NULL, size, NULL, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, out_buf, CL_TRUE, 0,
+                                       num_pixels * sizeof (cl_uint4), out, 0,
+                                       NULL, NULL));
+  for (size_t i = 0; i < num_pixels; ++i)
+    for (int c = 0; c < 4; ++c)
+      if (out[i].s[c] != src.ref[i * 4 + c])
+        {
+          printf ("read_imageui: pixel %zu differs\n", i);
+          return EXIT_FAILURE;
+        }
+  CHECK_IMAGE (&dst, "write_imageui");
+
+  free (in);
+  free (out);
+  CHECK_CL_ERROR (clReleaseMemObject (in_buf));
+  CHECK_CL_ERROR (clReleaseMemObject (out_buf));
+  release_image (&src);
+  release_image (&dst);
+  CHECK_CL_ERROR (clReleaseKernel (kernel));
+  CHECK_CL_ERROR (clReleaseProgram (program));
+  return CL_SUCCESS;
+}
+
+int
+main (int argc, char **argv)
+{
+  cl_int err;
+  cl_platform_id platform;
+  cl_device_id device;
+  cl_bool image_support = CL_FALSE;
+
+  err = poclu_get_any_device2 (&context, &device, &queue, &platform);
+  CHECK_OPENCL_ERROR_IN ("poclu_get_any_device");
+  CHECK_CL_ERROR (clGetDeviceInfo (device, CL_DEVICE_IMAGE_SUPPORT,
+                                   sizeof (image_support), &image_support,
+                                   NULL));
+  if (!image_support)
+    {
+      printf ("the device does not support images, skipping\n");
+      return 77;
+    }
+
+  struct test_format formats[3];
+  memset (formats, 0, sizeof (formats));
+  formats[0].format.image_channel_order = CL_RGBA;
+  formats[0].format.image_channel_data_type = CL_UNSIGNED_INT8;
+  formats[0].px = 4;
+  formats[0].color.s[0] = 1;
+  formats[0].color.s[1] = 2;
+  formats[0].color.s[2] = 3;
+  formats[0].color.s[3] = 4;
+  memcpy (formats[0].pixel, "\1\2\3\4", 4);
+
+  cl_float4 color = { { 0.5f, -1.0f, 2.0f, 4.0f } };
+  formats[1].format.image_channel_order = CL_RGBA;
+  formats[1].format.image_channel_data_type = CL_FLOAT;
+  formats[1].px = 16;
+  memcpy (&formats[1].color, &color, sizeof (color));
+  memcpy (formats[1].pixel, &color, sizeof (color));
+
+  cl_ushort r16 = 0x1234;
+  formats[2].format.image_channel_order = CL_R;
+  formats[2].format.image_channel_data_type = CL_UNSIGNED_INT16;
+  formats[2].px = 2;
+  formats[2].color.s[0] = r16;
+  memcpy (formats[2].pixel, &r16, sizeof (r16));
+
+  /* Sizes and regions that are not aligned to the tiles. */
+  const size_t size_2d[3] = { 13, 7, 1 };
+  const size_t origin_2d[3] = { 3, 2, 0 };
+  const size_t region_2d[3] = { 7, 4, 1 };
+  const size_t size_3d[3] = { 9, 6, 5 };
+  const size_t origin_3d[3] = { 1, 3, 2 };
+  const size_t region_3d[3] = { 6, 3, 3 };
+
+  if (argc > 1 && strcmp (argv[1], "kernel") == 0)
+    {
+      if (test_kernel_access (device, &formats[0], size_2d) != CL_SUCCESS
+          || test_kernel_access (device, &formats[0], size_3d)
+                 != CL_SUCCESS)
+        return EXIT_FAILURE;
+      CHECK_CL_ERROR (clUnloadPlatformCompiler (platform));
+    }
+  else
+    for (unsigned i = 0; i < sizeof (formats) / sizeof (formats[0]); ++i)
+      {
+        if (test_images (&formats[i], size_2d, origin_2d, region_2d)
+            != CL_SUCCESS)
+          return EXIT_FAILURE;
+        if (test_images (&formats[i], size_3d, origin_3d, region_3d)
+            != CL_SUCCESS)
+          return EXIT_FAILURE;
+      }
+
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (context));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
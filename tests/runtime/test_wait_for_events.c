@@ -0,0 +1,106 @@
+/* Test waiting for many events from several queues, and a user event
+   completed by another thread, with a single clWaitForEvents call
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+#include "pocl_opencl.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define NUM_COMMANDS 1000
+#define BUF_SIZE 4096
+
+static cl_event user_event;
+
+static void *
+complete_user_event (void *arg)
+{
+  usleep (100000);
+  clSetUserEventStatus (user_event, CL_COMPLETE);
+  return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+  cl_int err;
+  cl_platform_id pid = NULL;
+  cl_context ctx = NULL;
+  cl_device_id did = NULL;
+  cl_command_queue queues[2] = { NULL, NULL };
+  cl_event events[NUM_COMMANDS + 1];
+  cl_int pattern = 7;
+  cl_int status;
+  pthread_t thread;
+  unsigned i;
+
+  CHECK_CL_ERROR (poclu_get_any_device2 (&ctx, &did, &queues[0], &pid));
+  TEST_ASSERT (ctx);
+  TEST_ASSERT (did);
+  TEST_ASSERT (queues[0]);
+
+  queues[1] = clCreateCommandQueue (ctx, did, 0, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateCommandQueue");
+
+  cl_mem buf = clCreateBuffer (ctx, CL_MEM_READ_WRITE, BUF_SIZE, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer");
+
+  user_event = clCreateUserEvent (ctx, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateUserEvent");
+
+  /* the first command of both queues waits for the user event */
+  for (i = 0; i < NUM_COMMANDS; ++i)
+    CHECK_CL_ERROR (clEnqueueFillBuffer (
+        queues[i % 2], buf, &pattern, sizeof (pattern), 0, BUF_SIZE,
+        i < 2 ? 1 : 0, i < 2 ? &user_event : NULL, &events[i]));
+  events[NUM_COMMANDS] = user_event;
+
+  TEST_ASSERT (pthread_create (&thread, NULL, complete_user_event, NULL)
+               == 0);
+  CHECK_CL_ERROR (clWaitForEvents (NUM_COMMANDS + 1, events));
+
+  for (i = 0; i <= NUM_COMMANDS; ++i)
+    {
+      CHECK_CL_ERROR (clGetEventInfo (events[i],
+                                      CL_EVENT_COMMAND_EXECUTION_STATUS,
+                                      sizeof (status), &status, NULL));
+      TEST_ASSERT (status == CL_COMPLETE);
+    }
+  TEST_ASSERT (pthread_join (thread, NULL) == 0);
+
+  /* waiting again for completed events returns immediately */
+  CHECK_CL_ERROR (clWaitForEvents (NUM_COMMANDS + 1, events));
+
+  for (i = 0; i <= NUM_COMMANDS; ++i)
+    CHECK_CL_ERROR (clReleaseEvent (events[i]));
+  CHECK_CL_ERROR (clReleaseMemObject (buf));
+  CHECK_CL_ERROR (clReleaseCommandQueue (queues[0]));
+  CHECK_CL_ERROR (clReleaseCommandQueue (queues[1]));
+  CHECK_CL_ERROR (clReleaseContext (ctx));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (pid));
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,199 @@
+/* Tests the software prefetching of the strided work-item loads.
+
+   Copyright (c) 2024 pocl developers
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+/* Run with POCL_WI_PREFETCH_DISTANCE > 0 and the loopvec work-group
+   method. Each work-item sums a row of a matrix whose width is a kernel
+   argument, so consecutive work-items load with a stride known only at
+   run time, and gathers every 32nd float, a constant stride of 128 bytes.
+   Both loads are prefetched for the later work-items. The prefetches of
+   the last work-items point past the buffers, which must not fault. The
+   kernel also calls prefetch() on its row, on an empty range and on a
+   range ending at the last byte of the buffer. Checks the results, and on
+   CPU devices that the build log reports the prefetched loads.
+
+   The prefetches are inserted after the loop vectorizer. The scale kernel
+   has a work-item loop the vectorizer handles, with a load of the same
+   stride. It runs first, and with POCL_VECTORIZER_REMARKS=1 the test
+   passes only if a loop is reported vectorized before "scale done". */
+
+#include "poclu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH 300
+#define HEIGHT 256
+#define STRIDE 32
+
+static const char *source
+    = "__kernel void row_sums (__global const float *m, int width,\n"
+      "                        __global const float *sparse,\n"
+      "                        __global float *sums)\n"
+      "{\n"
+      "  int x = get_global_id (0);\n"
+      "  prefetch (m + x * width, width);\n"
+      "  prefetch (m, 0);\n"
+      "  prefetch (sparse + get_global_size (0) * 32 - 1, 1);\n"
+      "  float s = 0.0f;\n"
+      "  for (int i = 0; i < width; ++i)\n"
+      "    s += m[x * width + i];\n"
+      "  sums[x] = s + sparse[x * 32];\n"
+      "}\n"
+      "__kernel void scale (__global const float *sparse,\n"
+      "                     __global float *out)\n"
+      "{\n"
+      "  int x = get_global_id (0);\n"
+      "  out[x] = sparse[x * 32] * 2.0f;\n"
+      "}\n";
+
+int
+main (int argc, char **argv)
+{
+  cl_int err;
+  cl_platform_id platform;
+  cl_device_id device;
+  cl_context context;
+  cl_command_queue queue;
+  float *m = (float *)malloc (WIDTH * HEIGHT * sizeof (float));
+  float *sparse = (float *)malloc (HEIGHT * STRIDE * sizeof (float));
+  float sums[HEIGHT];
+  TEST_ASSERT (m != NULL && sparse != NULL);
+
+  /* small integers, so that the sums are exact in any order */
+  for (int i = 0; i < WIDTH * HEIGHT; ++i)
+    m[i] = (float)(i % 7);
+  for (int i = 0; i < HEIGHT * STRIDE; ++i)
+    sparse[i] = (float)(i % 5);
+
+  err = poclu_get_any_device2 (&context, &device, &queue, &platform);
+  CHECK_OPENCL_ERROR_IN ("poclu_get_any_device");
+
+  cl_program program
+      = clCreateProgramWithSource (context, 1, &source, NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateProgramWithSource");
+  CHECK_CL_ERROR (clBuildProgram (program, 1, &device, NULL, NULL, NULL));
+  cl_kernel kernel = clCreateKernel (program, "row_sums", &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateKernel");
+  cl_kernel scale = clCreateKernel (program, "scale", &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateKernel scale");
+
+  cl_mem m_buf = clCreateBuffer (
+      context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+      WIDTH * HEIGHT * sizeof (float), m, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer m");
+  cl_mem sparse_buf = clCreateBuffer (
+      context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+      HEIGHT * STRIDE * sizeof (float), sparse, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer sparse");
+  cl_mem sums_buf = clCreateBuffer (context, CL_MEM_WRITE_ONLY,
+                                    sizeof (sums), NULL, &err);
+  CHECK_OPENCL_ERROR_IN ("clCreateBuffer sums");
+
+  /* The work-group function of the scale kernel is generated, and the
+     remarks of the vectorizer printed, at its launch. */
+  size_t global = HEIGHT, local = 64;
+  CHECK_CL_ERROR (clSetKernelArg (scale, 0, sizeof (cl_mem), &sparse_buf));
+  CHECK_CL_ERROR (clSetKernelArg (scale, 1, sizeof (cl_mem), &sums_buf));
+  CHECK_CL_ERROR (clEnqueueNDRangeKernel (queue, scale, 1, NULL, &global,
+                                          &local, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, sums_buf, CL_TRUE, 0,
+                                       sizeof (sums), sums, 0, NULL, NULL));
+  for (int y = 0; y < HEIGHT; ++y)
+    {
+      float expected = sparse[y * STRIDE] * 2.0f;
+      if (sums[y] != expected)
+        {
+          printf ("scale %d: %f, expected %f\n", y, sums[y], expected);
+          return EXIT_FAILURE;
+        }
+    }
+  printf ("scale done\n");
+  fflush (stdout);
+
+  cl_int width = WIDTH;
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 0, sizeof (cl_mem), &m_buf));
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 1, sizeof (cl_int), &width));
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 2, sizeof (cl_mem), &sparse_buf));
+  CHECK_CL_ERROR (clSetKernelArg (kernel, 3, sizeof (cl_mem), &sums_buf));
+  CHECK_CL_ERROR (clEnqueueNDRangeKernel (queue, kernel, 1, NULL, &global,
+                                          &local, 0, NULL, NULL));
+  CHECK_CL_ERROR (clEnqueueReadBuffer (queue, sums_buf, CL_TRUE, 0,
+                                       sizeof (sums), sums, 0, NULL, NULL));
+
+  for (int y = 0; y < HEIGHT; ++y)
+    {
+      float expected = sparse[y * STRIDE];
+      for (int i = 0; i < WIDTH; ++i)
+        expected += m[y * WIDTH + i];
+      if (sums[y] != expected)
+        {
+          printf ("row %d: sum %f, expected %f\n", y, sums[y], expected);
+          return EXIT_FAILURE;
+        }
+    }
+
+  /* The work-group function is generated at the first launch, after which
+     the report is in the build log. */
+  cl_device_type type;
+  CHECK_CL_ERROR (clGetDeviceInfo (device, CL_DEVICE_TYPE, sizeof (type),
+                                   &type, NULL));
+  if (type & CL_DEVICE_TYPE_CPU)
+    {
+      size_t log_size = 0;
+      CHECK_CL_ERROR (clGetProgramBuildInfo (
+          program, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size));
+      char *log = (char *)malloc (log_size + 1);
+      TEST_ASSERT (log != NULL);
+      CHECK_CL_ERROR (clGetProgramBuildInfo (
+          program, device, CL_PROGRAM_BUILD_LOG, log_size, log, NULL));
+      log[log_size] = 0;
+
+      const char *report = strstr (log, "kernel 'row_sums': ");
+      unsigned long loads = 0, distance = 0;
+      TEST_ASSERT (report != NULL);
+      int scanned = sscanf (report,
+                            "kernel 'row_sums': %lu loads prefetched %lu "
+                            "work-items ahead",
+                            &loads, &distance);
+      TEST_ASSERT (scanned == 2);
+      TEST_ASSERT (loads > 0);
+      TEST_ASSERT (distance > 0);
+      free (log);
+    }
+
+  CHECK_CL_ERROR (clReleaseMemObject (m_buf));
+  CHECK_CL_ERROR (clReleaseMemObject (sparse_buf));
+  CHECK_CL_ERROR (clReleaseMemObject (sums_buf));
+  CHECK_CL_ERROR (clReleaseKernel (kernel));
+  CHECK_CL_ERROR (clReleaseKernel (scale));
+  CHECK_CL_ERROR (clReleaseProgram (program));
+  CHECK_CL_ERROR (clReleaseCommandQueue (queue));
+  CHECK_CL_ERROR (clReleaseContext (context));
+  CHECK_CL_ERROR (clUnloadPlatformCompiler (platform));
+  free (m);
+  free (sparse);
+
+  printf ("OK\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# Copyright (c) 2024 pocl developers
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to
+# deal in the Software without restriction, including without limitation the
+# rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+# sell copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+#
+# Converts the output of the binary event tracer (POCL_TRACING=bin) to the
+# Chrome trace event JSON format, which can be opened in Perfetto
+# (https://ui.perfetto.dev) or chrome://tracing. Each device is shown as a
+# process and each command queue as a thread of it.
+#
+# Usage: bintrace_to_json.py [pocl_trace_event.bin] [output.json]
+
+import json
+import struct
+import sys
+
+MAGIC = b"POCLTRC1"
+# must match struct bin_trace_record in lib/CL/pocl_tracing.c
+RECORD = struct.Struct("=IIQQQQQQQQiI48s")
+RECORD_EVENT = 1
+RECORD_DEVICE = 2
+
+COMMAND_NAMES = {
+    0x11F0: "ndrange_kernel",
+    0x11F1: "task",
+    0x11F2: "native_kernel",
+    0x11F3: "read_buffer",
+    0x11F4: "write_buffer",
+    0x11F5: "copy_buffer",
+    0x11F6: "read_image",
+    0x11F7: "write_image",
+    0x11F8: "copy_image",
+    0x11F9: "copy_image_to_buffer",
+    0x11FA: "copy_buffer_to_image",
+    0x11FB: "map_buffer",
+    0x11FC: "map_image",
+    0x11FD: "unmap_mem_object",
+    0x11FE: "marker",
+    0x1201: "read_buffer_rect",
+    0x1202: "write_buffer_rect",
+    0x1203: "copy_buffer_rect",
+    0x1204: "user",
+    0x1205: "barrier",
+    0x1206: "migrate_mem_objects",
+    0x1207: "fill_buffer",
+    0x1208: "fill_image",
+    0x1209: "svm_free",
+    0x120A: "svm_memcpy",
+    0x120B: "svm_memfill",
+    0x120C: "svm_map",
+    0x120D: "svm_unmap",
+    0x120E: "svm_migrate_mem",
+    0x12A8: "command_buffer",
+}
+
+KERNEL_COMMANDS = (0x11F0, 0x11F1)
+
+
+def read_records(path):
+    with open(path, "rb") as f:
+        if f.read(len(MAGIC)) != MAGIC:
+            sys.exit("%s: not a pocl binary trace" % path)
+        (record_size,) = struct.unpack("=I", f.read(4))
+        if record_size != RECORD.size:
+            sys.exit("%s: unsupported record size %d" % (path, record_size))
+        while True:
+            data = f.read(record_size)
+            if len(data) < record_size:
+                break
+            yield RECORD.unpack(data)
+
+
+def convert(path):
+    events = []
+    queues = set()
+    t0 = None
+    for (rtype, command_type, event_id, queue_id, device_id, t_queue,
+         t_submit, t_start, t_end, size, status, _, name) in read_records(path):
+        name = name.split(b"\0", 1)[0].decode("utf-8", "replace")
+        if rtype == RECORD_DEVICE:
+            events.append({"ph": "M", "name": "process_name", "pid": device_id,
+                           "args": {"name": name}})
+            continue
+        if rtype != RECORD_EVENT:
+            continue
+        if queue_id not in queues:
+            queues.add(queue_id)
+            events.append({"ph": "M", "name": "thread_name", "pid": device_id,
+                           "tid": queue_id,
+                           "args": {"name": "queue %d" % queue_id}})
+        if t0 is None or t_queue < t0:
+            t0 = t_queue
+        command = COMMAND_NAMES.get(command_type, hex(command_type))
+        args = {"event": event_id, "command": command,
+                "queued_ns": t_queue, "submitted_ns": t_submit}
+        if command_type in KERNEL_COMMANDS:
+            args["work_items"] = size
+        elif size:
+            args["bytes"] = size
+        if status < 0:
+            args["error"] = status
+        events.append({"ph": "X", "name": name or command, "cat": command,
+                       "pid": device_id, "tid": queue_id,
+                       "ts": t_start, "dur": max(t_end - t_start, 0),
+                       "args": args})
+
+    # Chrome traces use microseconds
+    for e in events:
+        if e["ph"] == "X":
+            e["ts"] = (e["ts"] - t0) / 1000.0
+            e["dur"] = e["dur"] / 1000.0
+    return {"traceEvents": events, "displayTimeUnit": "ns"}
+
+
+def main(argv):
+    src = argv[1] if len(argv) > 1 else "pocl_trace_event.bin"
+    trace = convert(src)
+    if len(argv) > 2:
+        with open(argv[2], "w") as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))